@@ -0,0 +1,78 @@
+#include <Arduino.h> // Remove this import when using Arduino IDE
+#include <WiFi.h>
+#include <ESP32_OTA_Updater.h>
+
+// Find all SSL Certificates from Githubs endpoints and concatenate them into the char (see the GettingStarted example)
+static const char *ROOT_CA_CERTIFICATE_GITHUB =
+    "-----BEGIN CERTIFICATE-----\n"
+    // Cert 1 here
+    "-----END CERTIFICATE-----\n"
+    "-----BEGIN CERTIFICATE-----\n"
+    // Cert 2 here
+    "-----END CERTIFICATE-----\n";
+// Define the github repository to download the update from
+#define OWNER ""
+#define REPO ""
+#define FIRMWARE "firmware.bin"
+
+#ifndef PROJ_GIT_TAG
+#define PROJ_GIT_TAG "v0.0.0" // If not set in a build flag the version is set to 0.0.0
+#endif
+static_assert(Version::validate(PROJ_GIT_TAG) == Version::NONE, "PROJ_GIT_TAG has to be a semantic version, e.g. v1.2.0");
+ESP32_OTA_Updater ota(ROOT_CA_CERTIFICATE_GITHUB, PROJ_GIT_TAG);
+
+// Set to true to let a FreeRTOS task do the work, false to drive the updater with poll() from loop()
+#define USE_UPDATER_TASK true
+
+void setup()
+{
+    Serial.begin(115200);
+    WiFi.begin("SSID", "PASSWORD");
+    while (WiFi.status() != WL_CONNECTED)
+    {
+        delay(1000);
+        Serial.println("Connecting to WiFi..");
+    }
+
+    ota.setDebug(&Serial);
+    ota.setCheckInterval(10 * 60 * 1000);
+    ota.setAutoInstall(true); // Download and install as soon as a check finds an update
+    ota.onStateChange([](ESP32_OTA_Updater_State state)
+                      { Serial.printf("OTA state changed to %d\n", state); });
+    ota.onMetrics([](const UpdateMetrics &metrics)
+                  {
+                      // E.g. report slow updates from the field to a backend
+                      const UpdatePhaseMetrics &download = metrics.getPhase(UPDATE_PHASE_DOWNLOAD);
+                      Serial.printf("OTA check %u ms, download %u ms (%u B/s), %u handshakes, min free heap %u, error %d\n",
+                                    metrics.getPhase(UPDATE_PHASE_CHECK).duration_ms, download.duration_ms,
+                                    download.getThroughput(), metrics.handshakes, metrics.heap_min_free, metrics.error); });
+
+    if (!ota.begin(OWNER, REPO, FIRMWARE))
+    {
+        Serial.printf("OTA Updater init failed: %d, %s\n", ota.getErrorCode(), ota.getErrorDescription());
+    }
+
+#if USE_UPDATER_TASK
+    ota.startTask(0); // Run the updater on core 0, the Arduino loop runs on core 1
+#endif
+}
+
+void loop()
+{
+    // Requests are ignored while a check or download is running, so this can be called on every iteration
+    ota.startCheck();
+
+#if !USE_UPDATER_TASK
+    // Every call only processes data which is already received, so the loop keeps running during the download
+    ota.poll();
+#endif
+
+    if (ota.getState() == ESP32_OTA_Updater_State::OTA_READY_TO_REBOOT)
+    {
+        // PUT ANY WORK THAT SHOULD BE DONE BEFORE REBOOTING HERE!
+        ota.reboot();
+    }
+
+    // The application keeps doing its work here
+    delay(10);
+}
@@ -0,0 +1,105 @@
+#include <Arduino.h> // Remove this import when using Arduino IDE
+#include <WiFi.h>
+#include <ESP32_OTA_Updater.h>
+
+// Find all SSL Certificates from Githubs endpoints and concatenate them into the char (see the GettingStarted example)
+static const char *ROOT_CA_CERTIFICATE_GITHUB =
+    "-----BEGIN CERTIFICATE-----\n"
+    // Cert 1 here
+    "-----END CERTIFICATE-----\n"
+    "-----BEGIN CERTIFICATE-----\n"
+    // Cert 2 here
+    "-----END CERTIFICATE-----\n";
+// Define the github repository to download the update from
+#define OWNER ""
+#define REPO ""
+#define FIRMWARE "firmware.bin"
+// Public key the release assets are signed with (see the Signed Releases section of the README)
+static const char *SIGNING_KEY =
+    "-----BEGIN PUBLIC KEY-----\n"
+    // Key here
+    "-----END PUBLIC KEY-----\n";
+
+#ifndef PROJ_GIT_TAG
+#define PROJ_GIT_TAG "v0.0.0" // If not set in a build flag the version is set to 0.0.0
+#endif
+static_assert(Version::validate(PROJ_GIT_TAG) == Version::NONE, "PROJ_GIT_TAG has to be a semantic version, e.g. v1.2.0");
+ESP32_OTA_Updater ota(ROOT_CA_CERTIFICATE_GITHUB, PROJ_GIT_TAG);
+CertificateStore certificates;
+
+// Number of connections opened with each kind of trust anchors
+#define HANDSHAKES 5
+
+// Opens new connections to the GitHub API and prints the handshake time and the heap used while a connection is open
+static void measureHandshakes(const char *label, CertificateStore *store)
+{
+    uint32_t connect_ms = 0;
+    uint32_t heap_used = 0;
+    uint32_t succeeded = 0;
+    for (int i = 0; i < HANDSHAKES; i++)
+    {
+        Esp32HttpTransport *transport = new Esp32HttpTransport(); // A new transport does not reuse a connection
+        transport->setCACert(ROOT_CA_CERTIFICATE_GITHUB);
+        transport->setCertificateStore(store);
+        const uint32_t free_before = ESP.getFreeHeap();
+        if (transport->begin("https://api.github.com/rate_limit") && transport->GET() > 0)
+        {
+            HttpRequestTiming timing;
+            transport->getTiming(&timing);
+            connect_ms += timing.connect_ms;
+            heap_used += free_before - ESP.getFreeHeap();
+            succeeded++;
+        }
+        transport->end();
+        delete transport;
+    }
+    if (succeeded == 0)
+    {
+        Serial.printf("%s: no connection succeeded\n", label);
+        return;
+    }
+    Serial.printf("%s: %u ms per handshake, %u bytes of heap per open connection (%u of %u connections)\n", label,
+                  connect_ms / succeeded, heap_used / succeeded, succeeded, HANDSHAKES);
+}
+
+void setup()
+{
+    Serial.begin(115200);
+    WiFi.begin("SSID", "PASSWORD");
+    while (WiFi.status() != WL_CONNECTED)
+    {
+        delay(1000);
+        Serial.println("Connecting to WiFi..");
+    }
+
+    // The first boot parses the PEM certificates and stores the anchors in NVS, later boots only read them
+    const unsigned long start = millis();
+    if (!certificates.load(ROOT_CA_CERTIFICATE_GITHUB))
+    {
+        Serial.println("The root certificates could not be loaded into the store");
+    }
+    Serial.printf("Loaded %u trust anchors (%u bytes%s) in %lu ms\n", certificates.getCertificateCount(), (unsigned int)certificates.getBundleSize(),
+                  certificates.isInstalled() ? ", installed with a release" : "", millis() - start);
+
+    measureHandshakes("PEM certificates", NULL);
+    measureHandshakes("Certificate store", &certificates);
+
+    ota.setDebug(&Serial);
+    ota.setSigningKey(SIGNING_KEY);
+    certificates.setSigningKey(SIGNING_KEY);
+    // Releases with a "cacerts.bin" asset replace the trust anchors, e.g. before GitHub changes its certificate authority
+    ota.setCertificateStore(&certificates, "cacerts.bin");
+    if (!ota.begin(OWNER, REPO, FIRMWARE))
+    {
+        Serial.printf("An error occurred when trying to initialize the OTA Updater, Error Code: %d, Description: %s\n", ota.getErrorCode(), ota.getErrorMessage());
+    }
+}
+
+void loop()
+{
+    if (ota.available() && ota.downloadAndInstall())
+    {
+        ota.reboot();
+    }
+    delay(10000);
+}
@@ -21,6 +21,7 @@ static const char *ROOT_CA_CERTIFICATE_GITHUB =
 #ifndef PROJ_GIT_TAG
 #define PROJ_GIT_TAG "v0.0.0" // If not set in a build flag the version is set to 0.0.0
 #endif
+static_assert(Version::validate(PROJ_GIT_TAG) == Version::NONE, "PROJ_GIT_TAG has to be a semantic version, e.g. v1.2.0");
 ESP32_OTA_Updater ota(ROOT_CA_CERTIFICATE_GITHUB, PROJ_GIT_TAG);
 void setup()
 {
@@ -38,6 +39,8 @@ void setup()
     // Initialize the OTA Updater
     // Setup debug
     ota.setDebug(&Serial);
+    // Only ask GitHub for a new release once per minute, calls in between return the cached result
+    ota.setCheckInterval(60 * 1000);
 
     if (!ota.begin(OWNER, REPO, FIRMWARE, GITHUB_ACCESS_TOKEN))
     {
@@ -53,7 +56,7 @@ void setup()
 
 void loop()
 {
-    // This has to be run repeatedly (the library uses millis internally to not make an api call to often...)
+    // This has to be run repeatedly (the library rate limits the api calls with the interval set by setCheckInterval())
     if (ota.available())
     {
         Serial.println("Update Available!");
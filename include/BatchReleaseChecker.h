@@ -0,0 +1,125 @@
+#ifndef BATCH_RELEASE_CHECKER_H_
+#define BATCH_RELEASE_CHECKER_H_
+
+#include "ESP32_OTA_Updater_Config.h"
+#include "HttpTransport.h"
+#include "JsonStreamScanner.h"
+
+/**
+ * @file BatchReleaseChecker.h
+ * @brief Contains the declaration of the BatchReleaseChecker class.
+ */
+
+#define BATCH_RELEASE_CHECKER_ENDPOINT "https://api.github.com/graphql" /**< The GraphQL endpoint of the GitHub API. */
+
+/**
+ * @struct BatchComponent
+ * @brief A repository whose latest release is resolved by the BatchReleaseChecker, the results are filled in by check().
+ */
+struct BatchComponent
+{
+    const char *owner;                             /**< The owner of the repository. */
+    const char *repo;                              /**< The name of the repository. */
+    const char *asset;                             /**< The exact name of the asset, e.g. "firmware.bin". */
+    const char *current_version;                   /**< The running version of the component, NULL to not compare. */
+    char tag[ESP32_OTA_UPDATER_SHORTSTRING_LENGTH]; /**< The tag of the latest release, valid if has_release is true. */
+    char url[ESP32_OTA_UPDATER_LONGSTRING_LENGTH]; /**< The release download URL of the asset, valid if found is true. */
+    int32_t size;                                  /**< The size of the asset in bytes, valid if found is true. */
+    bool has_release;                              /**< True if the repository has a latest release. */
+    bool found;                                    /**< True if the latest release has the asset. */
+    bool newer;                                    /**< True if the tag is a newer version than current_version. */
+};
+
+/**
+ * @class BatchReleaseChecker
+ * @brief Resolves the latest release of several repositories with a single request to the GitHub GraphQL API.
+ *
+ * A device with several independently released components (e.g. the firmware, the image of a co-processor and a
+ * configuration bundle) would otherwise send one request over one connection per component and check. The checker
+ * puts all components into one query, every repository under the alias "c<index>":
+ *
+ *     {c0:repository(owner:"o",name:"r"){latestRelease{tagName releaseAssets(first:1,name:"a"){nodes{size downloadUrl}}}} c1:...}
+ *
+ * and streams the response into the components like the ReleaseParser, so the memory used is fixed by the
+ * number of components and the string capacities. The latest release is the one of the REST API
+ * ("/releases/latest"), i.e. the newest release which is neither a draft nor a prerelease.
+ *
+ * The GraphQL API requires a token, also for public repositories. The result only tells which components have a
+ * newer release: pass it to ESP32_OTA_Updater::setBatchResult(), updaters whose release is unchanged then skip their
+ * own request and only updaters with a newer release request it (with signature, delta patch and digests).
+ */
+class BatchReleaseChecker : public JsonStreamScanner
+{
+public:
+    /**
+     * @brief Adds a repository to check.
+     * @param component The component, it has to stay valid while the checker is used. Its results are reset.
+     * @return True if the component was added, false if ESP32_OTA_UPDATER_BATCH_MAX_COMPONENTS is reached or a
+     *         name contains characters which would have to be escaped in the query.
+     */
+    bool addComponent(BatchComponent *component);
+
+    /**
+     * @brief Removes all components.
+     */
+    void clearComponents()
+    {
+        component_count = 0;
+    }
+
+    /**
+     * @brief Gets the number of components.
+     * @return The number of components.
+     */
+    uint8_t getComponentCount() const
+    {
+        return component_count;
+    }
+
+    /**
+     * @brief Resolves the latest release of all components with one request.
+     * @param transport The transport the request is sent with, e.g. the one of an updater.
+     * @param api_key The GitHub token, the GraphQL API rejects requests without one.
+     * @param endpoint The URL of the GraphQL API.
+     * @return True if the response was received and parsed, the results of the components are then valid.
+     */
+    bool check(HttpTransport *transport, const char *api_key, const char *endpoint = BATCH_RELEASE_CHECKER_ENDPOINT);
+
+    /**
+     * @brief Gets the HTTP status of the last check.
+     * @return The status code, negative if no response was received.
+     */
+    int getStatusCode() const
+    {
+        return status_code;
+    }
+
+    /**
+     * @brief Checks if the last check failed because a tag or URL does not fit into its buffer.
+     * @return True if a value is too long, false otherwise.
+     */
+    bool isValueTooLong() const
+    {
+        return value_too_long;
+    }
+
+protected:
+    void onContainerBegin(bool is_array) override;
+    void onContainerEnd(bool is_array) override;
+    char *onValueBegin(ValueType type, size_t *capacity) override;
+    void onValueEnd(ValueType type, const char *value, size_t length, bool truncated) override;
+
+private:
+    BatchComponent *components[ESP32_OTA_UPDATER_BATCH_MAX_COMPONENTS];
+    uint8_t component_count = 0;
+    char query[ESP32_OTA_UPDATER_BATCH_QUERY_SIZE];
+    int status_code = 0;
+    bool value_too_long = false;
+    bool in_data = false;             /**< True while inside of the "data" object. */
+    BatchComponent *current = nullptr; /**< The component whose alias object is parsed. */
+    char size_value[12];
+
+    size_t buildQuery();
+};
+
+#endif // BATCH_RELEASE_CHECKER_H_
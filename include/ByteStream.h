@@ -0,0 +1,72 @@
+#ifndef BYTE_STREAM_H_
+#define BYTE_STREAM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @file ByteStream.h
+ * @brief Interfaces of the stages the downloaded firmware streams through until it is written to flash.
+ */
+
+/**
+ * @class ByteSink
+ * @brief Receives a stream of bytes, e.g. the flash writer or the next stage of a decoding chain.
+ */
+class ByteSink
+{
+public:
+    virtual ~ByteSink() {}
+
+    /**
+     * @brief Writes the next chunk of the stream.
+     * @param data The chunk.
+     * @param length The length of the chunk.
+     * @return True if the chunk was completely written, false otherwise.
+     */
+    virtual bool write(const uint8_t *data, size_t length) = 0;
+};
+
+/**
+ * @class ByteSource
+ * @brief Random access to a block of bytes, e.g. the running app partition.
+ */
+class ByteSource
+{
+public:
+    virtual ~ByteSource() {}
+
+    /**
+     * @brief Reads bytes from the source.
+     * @param offset The offset of the first byte.
+     * @param data The buffer to read into.
+     * @param length The number of bytes to read.
+     * @return True if all bytes were read, false otherwise.
+     */
+    virtual bool read(uint32_t offset, uint8_t *data, size_t length) = 0;
+
+    /**
+     * @brief Gets the number of bytes which can be read.
+     * @return The size of the source.
+     */
+    virtual uint32_t getSize() = 0;
+};
+
+/**
+ * @class Crc32
+ * @brief CRC32 (IEEE 802.3) as used by zlib, gzip and the delta patch format.
+ */
+class Crc32
+{
+public:
+    /**
+     * @brief Calculates the CRC32 of a block of data.
+     * @param crc The CRC of the previous blocks, 0 for the first block.
+     * @param data The block of data.
+     * @param length The length of the block.
+     * @return The CRC including the block.
+     */
+    static uint32_t update(uint32_t crc, const uint8_t *data, size_t length);
+};
+
+#endif // BYTE_STREAM_H_
@@ -0,0 +1,199 @@
+#ifndef CERTIFICATE_STORE_H_
+#define CERTIFICATE_STORE_H_
+
+#include "ESP32_OTA_Updater_Config.h"
+#include "FirmwareSink.h"
+#include "ImageVerifier.h"
+
+/**
+ * @file CertificateStore.h
+ * @brief Contains the declaration of the CertificateStore class.
+ */
+
+#define CERTIFICATE_STORE_HEADER_SIZE 2 /**< Big endian number of certificates at the start of a bundle. */
+#define CERTIFICATE_STORE_ENTRY_HEADER_SIZE 4 /**< Big endian length of the subject and of the public key of an entry. */
+#define CERTIFICATE_STORE_BUFFER_SIZE (ESP32_OTA_UPDATER_CERT_BUNDLE_SIZE + IMAGE_VERIFIER_DIGEST_SIZE + ESP32_OTA_UPDATER_MAX_SIGNATURE_SIZE)
+
+/**
+ * @class CertificateStore
+ * @brief Trust anchors in the certificate bundle format of ESP-IDF, parsed once instead of on every TLS handshake.
+ *
+ * With a PEM string (like the one passed to WiFiClientSecure::setCACert()) mbedtls parses every certificate of the
+ * string for every connection, although only the anchor of the chain the server presents is needed. The store keeps
+ * the anchors as ESP-IDF x509 certificate bundle: the number of certificates (2 bytes, big endian) followed by one
+ * entry per certificate with the length of the subject and of the public key (2 bytes each, big endian), the DER
+ * encoded subject name and the DER encoded SubjectPublicKeyInfo. Entries are sorted by subject, so the verify callback
+ * of the bundle finds the anchor of a host by the issuer of its chain with a binary search and only parses that key.
+ *
+ * The anchors come from, in this order:
+ * - a bundle installed with the release asset (e.g. "cacerts.bin", created by tools/ota_certs.py), which is written
+ *   through the store as a component of the update. The asset is the bundle followed by its SHA-256 and the signature
+ *   of the signing key, like "firmware.sig". It is only accepted with a valid signature, and used and kept in NVS
+ *   once the app of the update is activated as well (see commitInstall()).
+ * - the anchors of the firmware, either a PEM string, which is parsed once and cached in NVS (ESP32 only), or a
+ *   bundle built with the firmware, e.g. the one embedded by CONFIG_MBEDTLS_CERTIFICATE_BUNDLE, used in place.
+ *
+ * The store holds two buffers of CERTIFICATE_STORE_BUFFER_SIZE bytes, the active bundle and the one which is
+ * received, so a failed install keeps the anchors in use.
+ */
+class CertificateStore : public FirmwareSink
+{
+public:
+    /**
+     * @brief Loads the installed bundle, otherwise the anchors of a PEM string.
+     *
+     * The PEM string is only parsed if it changed since the last boot, the result is cached in NVS.
+     *
+     * @param pem The root certificates, concatenated in one string.
+     * @return True if a bundle is loaded, false otherwise (e.g. the PEM string is invalid or does not fit).
+     */
+    bool load(const char *pem);
+
+    /**
+     * @brief Loads the installed bundle, otherwise the given bundle.
+     * @param bundle The bundle in the ESP-IDF format, it is used in place and has to stay valid.
+     * @param size The size of the bundle.
+     * @return True if a bundle is loaded, false otherwise.
+     */
+    bool load(const uint8_t *bundle, size_t size);
+
+    /**
+     * @brief Sets the key installed bundles are checked with, without a key no bundle is installed.
+     * @param public_key The PEM encoded public key, usually the one of setSigningKey() of the updater.
+     */
+    void setSigningKey(const char *public_key)
+    {
+        signing_key = public_key;
+    }
+
+    /**
+     * @brief Looks up the anchor of a certificate chain.
+     * @param subject The DER encoded subject of the anchor, i.e. the issuer of the last certificate of the chain.
+     * @param subject_length The length of the subject.
+     * @param key Receives the DER encoded public key of the anchor.
+     * @param key_length Receives the length of the public key.
+     * @return True if the anchor was found, false otherwise.
+     */
+    bool findAnchor(const uint8_t *subject, size_t subject_length, const uint8_t **key, size_t *key_length) const;
+
+    /**
+     * @brief Removes the installed bundle and the cached anchors, the next load() uses the anchors of the firmware.
+     */
+    void clear();
+
+    /**
+     * @brief Checks if a bundle is loaded.
+     * @return True if a bundle is loaded, false otherwise.
+     */
+    bool hasBundle() const
+    {
+        return bundle != NULL;
+    }
+
+    /**
+     * @brief Gets the loaded bundle, e.g. for WiFiClientSecure::setCACertBundle().
+     * @return The bundle, NULL if none is loaded.
+     */
+    const uint8_t *getBundle() const
+    {
+        return bundle;
+    }
+
+    /**
+     * @brief Gets the size of the loaded bundle.
+     * @return The size in bytes.
+     */
+    size_t getBundleSize() const
+    {
+        return bundle_size;
+    }
+
+    /**
+     * @brief Gets the number of trust anchors of the loaded bundle.
+     * @return The number of certificates.
+     */
+    uint16_t getCertificateCount() const
+    {
+        return certificate_count;
+    }
+
+    /**
+     * @brief Checks if the loaded bundle was installed with a release instead of coming from the firmware.
+     * @return True if the bundle was installed, false otherwise.
+     */
+    bool isInstalled() const
+    {
+        return installed;
+    }
+
+    /**
+     * @brief Checks the structure of a bundle.
+     * @param bundle The bundle.
+     * @param size The number of available bytes, they may continue after the bundle.
+     * @param length Receives the length of the bundle.
+     * @param count Receives the number of certificates.
+     * @param sorted Receives true if the entries are sorted by subject, can be NULL.
+     * @return True if the bundle is valid, false otherwise.
+     */
+    static bool validate(const uint8_t *bundle, size_t size, size_t *length, uint16_t *count, bool *sorted = NULL);
+
+    uint32_t getCapacity() override
+    {
+        return CERTIFICATE_STORE_BUFFER_SIZE;
+    }
+
+    bool begin(uint32_t offset = 0, uint32_t crc = 0, const uint8_t *head = NULL) override;
+    bool write(const uint8_t *data, size_t length) override;
+    bool finish() override;
+    void abort() override;
+    void commitInstall() override;
+    bool read(uint32_t offset, uint8_t *data, size_t length) override;
+
+    bool verify(uint32_t offset, uint32_t crc, const uint8_t *head) override
+    {
+        return false; // The received bundle is not kept, an interrupted install starts over
+    }
+
+    uint32_t getCommitted() const override
+    {
+        return received;
+    }
+
+    uint32_t getCommittedCrc() const override
+    {
+        return received_crc;
+    }
+
+    const uint8_t *getHead() const override
+    {
+        return buffers[active_buffer ^ 1];
+    }
+
+private:
+    uint8_t buffers[2][CERTIFICATE_STORE_BUFFER_SIZE];
+    uint8_t active_buffer = 0;       /**< The buffer of the loaded bundle, the other one receives. */
+    const uint8_t *bundle = nullptr; /**< The loaded bundle, a buffer or a bundle of the firmware. */
+    size_t bundle_size = 0;
+    uint16_t certificate_count = 0;
+    bool sorted = false;             /**< True if anchors are looked up with a binary search. */
+    bool installed = false;
+    const char *signing_key = nullptr;
+
+    bool receiving = false;
+    bool pending = false;            /**< True if a finished bundle waits for commitInstall(). */
+    size_t pending_size = 0;
+    uint16_t pending_count = 0;
+    bool pending_sorted = false;
+    uint32_t received = 0;
+    uint32_t received_crc = 0;
+    ImageVerifier verifier;
+
+    bool restore(bool require_installed, uint32_t pem_crc);
+    void store(uint32_t pem_crc);
+    void activate(const uint8_t *bundle, size_t size, uint16_t count, bool sorted, bool installed);
+#ifdef ARDUINO
+    static bool parse(const char *pem, uint8_t *bundle, size_t capacity, size_t *size);
+#endif
+};
+
+#endif // CERTIFICATE_STORE_H_
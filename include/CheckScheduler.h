@@ -0,0 +1,184 @@
+#ifndef CHECK_SCHEDULER_H_
+#define CHECK_SCHEDULER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @file CheckScheduler.h
+ * @brief Contains the declaration of the CheckScheduler class.
+ */
+
+#ifndef ESP32_OTA_UPDATER_CHECK_JITTER
+#define ESP32_OTA_UPDATER_CHECK_JITTER 0UL /**< Default maximum random delay in ms of the first check after boot and added to every interval. */
+#endif
+#ifndef ESP32_OTA_UPDATER_NETWORK_BACKOFF_BASE
+#define ESP32_OTA_UPDATER_NETWORK_BACKOFF_BASE 15000UL /**< Delay in ms after the first failure to connect, doubled with every further failure. */
+#endif
+#ifndef ESP32_OTA_UPDATER_NETWORK_BACKOFF_MAX
+#define ESP32_OTA_UPDATER_NETWORK_BACKOFF_MAX 900000UL /**< Maximum delay in ms after failures to connect. */
+#endif
+#ifndef ESP32_OTA_UPDATER_SERVER_BACKOFF_BASE
+#define ESP32_OTA_UPDATER_SERVER_BACKOFF_BASE 60000UL /**< Delay in ms after the first HTTP error or invalid response, doubled with every further failure. */
+#endif
+#ifndef ESP32_OTA_UPDATER_SERVER_BACKOFF_MAX
+#define ESP32_OTA_UPDATER_SERVER_BACKOFF_MAX 21600000UL /**< Maximum delay in ms after HTTP errors or invalid responses. */
+#endif
+#ifndef ESP32_OTA_UPDATER_RATELIMIT_RESERVE
+#define ESP32_OTA_UPDATER_RATELIMIT_RESERVE 0 /**< Checks wait for the rate limit reset once X-RateLimit-Remaining is at or below this. */
+#endif
+#ifndef ESP32_OTA_UPDATER_RATELIMIT_FALLBACK
+#define ESP32_OTA_UPDATER_RATELIMIT_FALLBACK 3600UL /**< Seconds to wait for an exhausted rate limit if the reset time can not be related to the server time. */
+#endif
+
+/**
+ * @brief Schedule of the next release check, kept in RTC memory so it holds across deep sleep.
+ */
+struct CheckSchedule
+{
+    int64_t scheduled_at_ms;  /**< Clock time the current delay was set at. */
+    uint32_t delay_ms;        /**< Time from scheduled_at_ms until the next check is due. */
+    uint8_t network_failures; /**< Consecutive failures to connect. */
+    uint8_t server_failures;  /**< Consecutive HTTP errors and invalid responses. */
+    bool rate_limited;        /**< True if the delay waits for the reset of an exhausted rate limit. */
+    bool valid;               /**< False until the first schedule was set. */
+};
+
+/**
+ * @class CheckScheduler
+ * @brief Decides when the next release check is due, so a fleet of devices spreads its requests.
+ *
+ * After a successful check the next one is due after the check interval plus a random jitter, the first check after
+ * boot only after the jitter, so devices which are powered up together do not all check at once. Failures back off
+ * exponentially with a random spread, separately for connection failures (which are usually short) and HTTP
+ * errors (which usually need the server or the release to change). The GitHub rate limit headers
+ * (X-RateLimit-Remaining, X-RateLimit-Reset, Retry-After) defer the next check until requests are accepted again.
+ *
+ * All times are passed in, in milliseconds of a clock which keeps running in deep sleep, so the scheduler also runs
+ * on a host with a simulated clock.
+ */
+class CheckScheduler
+{
+public:
+    /**
+     * @brief Classes of failures, each one backs off separately.
+     */
+    enum Failure : uint8_t
+    {
+        FAILURE_NETWORK = 0, /**< No connection to the server (WIFI_NOT_CONNECTED). */
+        FAILURE_SERVER       /**< HTTP error status or an invalid response. */
+    };
+
+    /**
+     * @brief Starts scheduling, the first check after boot is due after a random part of the jitter.
+     * @param schedule The schedule, kept by the caller (e.g. in RTC memory). A valid schedule is continued.
+     * @param now_ms The current time.
+     * @param device_id The ID of the device, it seeds the random jitter so devices spread out.
+     */
+    void begin(CheckSchedule *schedule, int64_t now_ms, const char *device_id);
+
+    /**
+     * @brief Sets the interval between two successful checks.
+     * @param interval_ms The interval in milliseconds.
+     */
+    void setInterval(uint32_t interval_ms)
+    {
+        interval = interval_ms;
+    }
+
+    /**
+     * @brief Sets the maximum random delay added to every interval and to the rate limit reset.
+     * @param jitter_ms The jitter in milliseconds, 0 to check at exact intervals.
+     */
+    void setJitter(uint32_t jitter_ms)
+    {
+        jitter = jitter_ms;
+    }
+
+    /**
+     * @brief Sets the backoff of a failure class.
+     * @param failure The failure class.
+     * @param base_ms The delay after the first failure, doubled with every further one.
+     * @param max_ms The maximum delay.
+     */
+    void setBackoff(Failure failure, uint32_t base_ms, uint32_t max_ms);
+
+    /**
+     * @brief Checks if the next release check is due.
+     * @param now_ms The current time.
+     * @return True if a check should be sent now.
+     */
+    bool isDue(int64_t now_ms) const;
+
+    /**
+     * @brief Gets the time until the next check is due.
+     * @param now_ms The current time.
+     * @return The time in milliseconds, 0 if a check is due.
+     */
+    uint32_t getTimeUntilDue(int64_t now_ms) const;
+
+    /**
+     * @brief Evaluates the rate limit headers of a response, they are applied by the following onSuccess() or onFailure().
+     * @param remaining The X-RateLimit-Remaining header, empty if not received.
+     * @param reset The X-RateLimit-Reset header (Unix time in seconds), empty if not received.
+     * @param retry_after The Retry-After header in seconds, empty if not received.
+     * @param date The Date header, which relates the reset time to the local clock, empty if not received.
+     * @return True if the checks have to wait for the rate limit.
+     */
+    bool onRateLimit(const char *remaining, const char *reset, const char *retry_after, const char *date);
+
+    /**
+     * @brief Schedules the next check after a successful one.
+     * @param now_ms The current time.
+     */
+    void onSuccess(int64_t now_ms);
+
+    /**
+     * @brief Schedules a retry after a failed check.
+     * @param now_ms The current time.
+     * @param failure The failure class.
+     */
+    void onFailure(int64_t now_ms, Failure failure);
+
+    /**
+     * @brief Makes the next check due now, unless it waits for a failure backoff or a rate limit.
+     * @param now_ms The current time.
+     */
+    void expedite(int64_t now_ms);
+
+    /**
+     * @brief Checks if a device takes part in the staged rollout of a release.
+     *
+     * Devices are assigned to one of 100 buckets by a hash of their ID and the release, so raising the percentage
+     * of a release only adds devices, and every release starts with another group of devices.
+     *
+     * @param device_id The ID of the device.
+     * @param release The release, e.g. its tag.
+     * @param percent The percentage of devices the release is rolled out to.
+     * @return True if the device takes part.
+     */
+    static bool inRollout(const char *device_id, const char *release, uint8_t percent);
+
+    /**
+     * @brief Parses an HTTP date (RFC 7231 IMF-fixdate, e.g. "Sun, 06 Nov 1994 08:49:37 GMT").
+     * @param date The date.
+     * @return The Unix time in seconds, 0 if the date can not be parsed.
+     */
+    static int64_t parseHttpDate(const char *date);
+
+private:
+    CheckSchedule own_schedule = {};
+    CheckSchedule *schedule = &own_schedule; /**< The schedule passed to begin(), own_schedule before. */
+    uint32_t interval = 0;
+    uint32_t jitter = ESP32_OTA_UPDATER_CHECK_JITTER;
+    uint32_t backoff_base[2] = {ESP32_OTA_UPDATER_NETWORK_BACKOFF_BASE, ESP32_OTA_UPDATER_SERVER_BACKOFF_BASE};
+    uint32_t backoff_max[2] = {ESP32_OTA_UPDATER_NETWORK_BACKOFF_MAX, ESP32_OTA_UPDATER_SERVER_BACKOFF_MAX};
+    uint32_t limit_delay_ms = 0; /**< Delay required by the rate limit headers of the last response. */
+    uint32_t random_state = 1;
+
+    uint32_t random(uint32_t bound);
+    static uint32_t hash(uint32_t value, const char *text);
+    void scheduleIn(int64_t now_ms, uint32_t delay_ms);
+};
+
+#endif // CHECK_SCHEDULER_H_
@@ -0,0 +1,165 @@
+#ifndef DELTA_PATCHER_H_
+#define DELTA_PATCHER_H_
+
+#include "ByteStream.h"
+
+/**
+ * @file DeltaPatcher.h
+ * @brief Contains the declaration of the DeltaPatcher class.
+ */
+
+#ifndef DELTA_PATCHER_BUFFER_SIZE
+#define DELTA_PATCHER_BUFFER_SIZE 256 /**< Size of the buffer used to read source data. */
+#endif
+#ifndef DELTA_PATCHER_STASH_SIZE
+#define DELTA_PATCHER_STASH_SIZE 1024 /**< Patch bytes kept while source work is pending, one poll() slice of an uncompressed patch. */
+#endif
+
+#define DELTA_PATCHER_MAGIC "OTAD"
+#define DELTA_PATCHER_VERSION 1
+#define DELTA_PATCHER_HEADER_SIZE 20
+
+/**
+ * @class DeltaPatcher
+ * @brief Reconstructs a firmware image from a patch stream and the previous image.
+ *
+ * The patch starts with a header (magic "OTAD", format version, 3 reserved bytes, then little endian source size,
+ * source CRC32 and target size) followed by operations:
+ * - 0x01 COPY offset length: copy length bytes of the source starting at offset.
+ * - 0x02 INSERT length data: output the following length bytes of the patch.
+ * - 0x03 ADD offset length data: output source bytes starting at offset plus the following length bytes (mod 256).
+ *
+ * The patch is applied while it streams in and the reconstructed image is written to the output sink, nothing but
+ * a small read buffer and the stash is kept in memory. The CRC32 of the source is checked before any output is
+ * written, so a patch that does not belong to the running firmware is rejected before the download continues.
+ *
+ * Reading the source for its CRC32 and for COPY operations is pending work, which step() performs in bounded
+ * slices while isBusy() is true. Patch bytes received meanwhile are kept in a stash of DELTA_PATCHER_STASH_SIZE bytes
+ * and applied once the work is done. Only if more than that arrives before, e.g. from a highly compressed patch, the
+ * pending work is done right away.
+ */
+class DeltaPatcher : public ByteSink
+{
+public:
+    /**
+     * @brief Errors reported by the patcher.
+     */
+    enum Error : uint8_t
+    {
+        NONE = 0,
+        INVALID_PATCH,      /**< The patch is malformed or references data outside of the images. */
+        SOURCE_MISMATCH,    /**< The patch was created for a different source image. */
+        SOURCE_READ_FAILED, /**< The source could not be read. */
+        OUTPUT_FAILED       /**< The output sink did not accept the data. */
+    };
+
+    /**
+     * @brief Prepares the patcher for a new patch.
+     * @param source The previous image.
+     * @param source_capacity The number of bytes which can be read from the source.
+     * @param output The sink receiving the reconstructed image.
+     */
+    void begin(ByteSource *source, uint32_t source_capacity, ByteSink *output);
+
+    /**
+     * @brief Applies the next chunk of the patch.
+     * @param data The chunk of the patch.
+     * @param length The length of the chunk.
+     * @return True on success, false if the patch can not be applied, see getError().
+     */
+    bool write(const uint8_t *data, size_t length) override;
+
+    /**
+     * @brief Checks that the patch was completely applied, performs the pending work first.
+     * @return True if the complete target image was written, false otherwise.
+     */
+    bool finish();
+
+    /**
+     * @brief Tells whether source reads or stashed patch bytes are pending, see step().
+     * @return True if step() has work to do.
+     */
+    bool isBusy() const
+    {
+        return state == SOURCE_CRC || state == COPY_DATA || stash_length > 0;
+    }
+
+    /**
+     * @brief Performs a slice of the pending work: reads the source for its CRC32 or a COPY operation, then applies
+     *        stashed patch bytes once nothing is left to read.
+     * @param budget The number of source bytes to read and stashed bytes to apply at most.
+     * @return True on success, false if the patch can not be applied, see getError().
+     */
+    bool step(uint32_t budget);
+
+    /**
+     * @brief Gets the error which stopped the patcher.
+     * @return The error, NONE if no error occurred.
+     */
+    Error getError() const
+    {
+        return error;
+    }
+
+    /**
+     * @brief Gets the size of the reconstructed image.
+     * @return The size from the patch header, 0 if the header was not received yet.
+     */
+    uint32_t getTargetSize() const
+    {
+        return target_size;
+    }
+
+private:
+    enum State : uint8_t
+    {
+        HEADER = 0,
+        SOURCE_CRC,
+        OPCODE,
+        ARGUMENTS,
+        INSERT_DATA,
+        ADD_DATA,
+        COPY_DATA,
+        STOPPED
+    };
+
+    enum Opcode : uint8_t
+    {
+        OP_COPY = 0x01,
+        OP_INSERT = 0x02,
+        OP_ADD = 0x03
+    };
+
+    ByteSource *source;
+    uint32_t source_capacity;
+    ByteSink *output;
+
+    State state;
+    Error error;
+    uint8_t header[DELTA_PATCHER_HEADER_SIZE];
+    uint8_t header_length;
+    uint8_t opcode;
+    uint8_t arguments[8];
+    uint8_t arguments_length;
+    uint8_t arguments_needed;
+
+    uint32_t source_size;
+    uint32_t source_crc;
+    uint32_t source_crc_read; /**< CRC32 of the source read so far. */
+    uint32_t target_size;
+    uint32_t produced;
+    uint32_t operation_offset;
+    uint32_t operation_remaining;
+    uint8_t buffer[DELTA_PATCHER_BUFFER_SIZE];
+    uint8_t stash[DELTA_PATCHER_STASH_SIZE]; /**< Patch bytes received while source reads are pending. */
+    size_t stash_length;
+
+    size_t apply(const uint8_t *data, size_t length);
+    bool parseHeader();
+    bool executeOperation();
+    bool emit(const uint8_t *data, size_t length);
+    bool stop(Error reason);
+    static uint32_t readLE32(const uint8_t *data);
+};
+
+#endif // DELTA_PATCHER_H_
@@ -6,15 +6,30 @@
  */
 
 #include <WString.h>
-#include <WiFi.h>
-#include <WiFiClientSecure.h>
-#include <HTTPClient.h>
 
+#include "BatchReleaseChecker.h"
+#include "CertificateStore.h"
+#include "CheckScheduler.h"
+#include "DeltaPatcher.h"
+#include "ESP32_OTA_Updater_Config.h"
 #include "Errors.h"
+#include "Esp32HttpTransport.h"
+#include "Esp32PeerNetwork.h"
+#include "FirmwareSink.h"
+#include "FlashPipeline.h"
+#include "HttpTransport.h"
+#include "ImageHeaderCheck.h"
+#include "ImageVerifier.h"
+#include "ManifestParser.h"
+#include "PartitionWriter.h"
+#include "PeerNetwork.h"
+#include "ReleaseParser.h"
 #include "SemanticVersion.h"
-
-#define ESP32_OTA_UPDATER_SHORTSTRING_LENGTH 50
-#define ESP32_OTA_UPDATER_LONGSTRING_LENGTH 150
+#include "States.h"
+#include "StreamDecompressor.h"
+#include "StreamDecryptor.h"
+#include "TokenBucket.h"
+#include "UpdateMetrics.h"
 
 /**
  * @class ESP32_OTA_Updater
@@ -22,6 +37,9 @@
  *
  * This class checks for new Github Releases compares the semantic version and downloads/installs the firmware update. For now the System automatically uses the LittleFS file system, but a custom fs:FS can be specified on begin().
  *
+ * All requests go through a HttpTransport and the image is installed through a FirmwareSink. On the ESP32 these are
+ * WiFiClientSecure/HTTPClient and the next OTA partition, other implementations allow to run the update logic on
+ * a host (see the native environment in platformio.ini).
  */
 class ESP32_OTA_Updater
 {
@@ -31,27 +49,190 @@ private:
     char gh_api_key[ESP32_OTA_UPDATER_LONGSTRING_LENGTH];           /**< (Fine Grained) Github Personal Access Token. Required for private repositries! */
     bool api_key_defined;                                           /**< True if the Github API key is defined, false otherwise. */
     char firmware_asset_path[ESP32_OTA_UPDATER_SHORTSTRING_LENGTH]; /**< The path to the firmware binary file on the Github Release -> the asset name. */
-    const char *http_useragent = "ESP32-OTA-Updater";
+    uint32_t source_crc = 0;                                        /**< CRC32 of "<owner>/<repo>/<asset>", identifies the state of this updater in RTC memory and NVS. */
 
     bool new_version_available = false;                            /**< True if a new firmware version is available, false otherwise. */
     char binary_download_url[ESP32_OTA_UPDATER_LONGSTRING_LENGTH]; /**< The URL to download the firmware binary file. */
     int binary_size = 0;                                           /**< The size of the firmware binary file. */
+    uint8_t binary_digest[RELEASE_ASSET_DIGEST_SIZE];              /**< The SHA-256 GitHub lists for the firmware asset, valid if binary_digest_known is true. */
+    bool binary_digest_known = false;                              /**< True if the release lists a digest of the firmware asset. */
+
+    bool delta_updates = true;                                    /**< True to download delta patches instead of the full binary if available. */
+    char patch_asset_pattern[ESP32_OTA_UPDATER_SHORTSTRING_LENGTH]; /**< Asset name of patches from the current version, e.g. "firmware-1.2.3-*.patch". */
+    char patch_download_url[ESP32_OTA_UPDATER_LONGSTRING_LENGTH];  /**< The URL to download the delta patch from the current version. */
+    int patch_size = 0;                                           /**< The size of the delta patch. */
+    bool installing_patch = false;                                /**< True while a delta patch is downloaded and applied. */
+    DeltaPatcher delta_patcher;                                   /**< Reconstructs the new image from the patch and the running partition. */
+    StreamDecryptor download_decryptor;                           /**< Decrypts encrypted assets in the download buffer. */
+    uint8_t decryption_key[STREAM_DECRYPTOR_KEY_SIZE];            /**< AES-256 key of encrypted assets, valid if decryption_key_set is true. */
+    bool decryption_key_set = false;                              /**< True if assets are encrypted and have to be decrypted. */
+    StreamDecompressor download_decompressor;                     /**< Decompresses gzip, zlib and heatshrink assets while they are downloaded. */
+    FlashPipeline flash_pipeline;                                 /**< Writes to firmware_sink from a task on the other core. */
+    uint8_t pipeline_buffers = ESP32_OTA_UPDATER_PIPELINE_BUFFERS;         /**< Number of buffers between download and flash writer. */
+    size_t pipeline_buffer_size = ESP32_OTA_UPDATER_PIPELINE_BUFFER_SIZE;  /**< Size of each buffer between download and flash writer. */
+    uint32_t reported_committed = 0;                              /**< Committed image bytes at the last progress report. */
+
+    char signature_asset_name[ESP32_OTA_UPDATER_SHORTSTRING_LENGTH];  /**< Asset name of the image digest and signature, e.g. "firmware.sig". */
+    char signature_download_url[ESP32_OTA_UPDATER_LONGSTRING_LENGTH]; /**< The URL to download the signature asset of the latest release. */
+    int signature_size = 0;                                           /**< The size of the signature asset. */
+    const char *signing_key = NULL;                                   /**< PEM public key releases have to be signed with, NULL to only check digests. */
+    bool verifying_image = false;                                     /**< True if the image which is installed is hashed and verified. */
+    ImageVerifier image_verifier;                                     /**< Hashes the image on its way to the flash. */
+    ImageHeaderCheck image_header_check;                              /**< Rejects an app image for another device from its header. */
+    bool image_header_checks = true;                                  /**< True to check the header of app images before they are written. */
+    bool image_version_check = false;                                 /**< True to also require an embedded version newer than the running one. */
+    bool checking_header = false;                                     /**< True while the header check is part of the install chain. */
+
+    /**
+     * @brief A partition which is updated together with the app, e.g. the file system.
+     */
+    struct Component
+    {
+        ReleaseAsset asset; /**< The asset of the latest release, looked up by release_parser. */
+        FirmwareSink *sink; /**< The sink the asset is installed through. */
+        bool pending;       /**< True if the asset differs from the installed one and is part of the current install. */
+    };
+    Component components[ESP32_OTA_UPDATER_MAX_COMPONENTS]; /**< The components added with addComponent(). */
+    uint8_t component_count = 0;                             /**< Number of components. */
+    static const uint8_t APP_COMPONENT = 0xFF;               /**< Value of active_component while the app is installed. */
+    uint8_t active_component = APP_COMPONENT;                /**< The component which is downloaded. */
+    FirmwareSink *active_sink = nullptr;                     /**< The sink of active_component. */
+    bool hashing_asset = false;                              /**< True if the downloaded asset is checked against its release digest. */
+    ImageVerifier asset_verifier;                            /**< Hashes component assets as they are received. */
+
+    PeerNetwork *peer_network = nullptr; /**< Shares verified images with devices on the local network, NULL to only use GitHub. */
+    bool peer_download = false;          /**< True while the image is downloaded from a peer. */
+    bool peer_failed = false;            /**< True if the download from a peer failed, the install then uses GitHub. */
+    bool peer_serving = false;           /**< True while a peer is served, the updater task polls without delay then. */
+    bool image_verified = false;         /**< True if the installed app matched its expected digest, so it can be offered to peers. */
+
+    bool resumable_downloads = true;                              /**< True to record the download progress in NVS and continue with a Range request. */
+    uint32_t resume_checkpoint = 0;                               /**< Number of committed image bytes recorded in NVS. */
+
+    CheckScheduler check_scheduler;                                /**< Decides when the next release check is due. */
+    char device_id[ESP32_OTA_UPDATER_SHORTSTRING_LENGTH];          /**< ID of this device, seeds the check jitter and selects staged rollouts. */
+    bool staged_rollout = false;                                   /**< True to only install releases whose rollout percentage includes this device. */
+    uint8_t rollout_percent = 100;                                 /**< Rollout percentage of the latest release seen. */
+    bool check_cache_valid = false;                                /**< True if latest_tag/binary_download_url hold the result of a previous check. */
+    bool check_cache_persistent = true;                            /**< True if the check cache is stored in NVS to survive reboots. */
+    char latest_tag[ESP32_OTA_UPDATER_SHORTSTRING_LENGTH];         /**< The tag name of the latest release seen. */
+    char release_etag[ESP32_OTA_UPDATER_LONGSTRING_LENGTH];        /**< The ETag of the last release response, used for If-None-Match. */
 
     const Version current_version;       /**< The current semantic version of the firmware. */
     ESP32_OTA_Updater_Error error;       /**< The error status of the OTA updater. */
-    WiFiClientSecure wifi_client_secure; /**< The WifiClientSecure object for HTTPS communication. */
-    HTTPClient http_client;              /**< The HTTPClient object for making HTTP requests. */
+#ifdef ARDUINO
+    Esp32HttpTransport esp32_transport;             /**< Default transport, HTTPS with WiFiClientSecure. */
+    PartitionWriter esp32_partition_writer;         /**< Default firmware sink, the next OTA partition. */
+    RunningPartitionSource esp32_running_partition; /**< Default source of delta patches, the running partition. */
+    PartitionWriter esp32_data_partitions[ESP32_OTA_UPDATER_MAX_COMPONENTS]; /**< Sinks of addDataPartition(). */
+#endif
+    HttpTransport *http_transport; /**< The transport all requests are sent with. */
+    FirmwareSink *firmware_sink;   /**< The sink the new image is installed through. */
+    ByteSource *running_image;     /**< The image delta patches are applied to, NULL to not use delta patches. */
+
+public:
+    typedef std::function<void(ESP32_OTA_Updater_State)> StateCallback; /**< Callback for state changes. */
+    typedef std::function<void(size_t, size_t)> ProgressCallback;       /**< Callback for the install progress (written bytes, total bytes). */
+    typedef std::function<void(const UpdateMetrics &)> MetricsCallback; /**< Callback for the metrics at the end of a check or an install. */
+
+private:
+    enum Request : uint8_t
+    {
+        REQUEST_NONE = 0,
+        REQUEST_CHECK,
+        REQUEST_INSTALL
+    };
+
+    volatile ESP32_OTA_Updater_State state = ESP32_OTA_Updater_State::OTA_IDLE; /**< The current state of the update engine. */
+    volatile uint8_t pending_request = REQUEST_NONE;                            /**< Request from startCheck()/startInstall() which poll() picks up. */
+    bool auto_install = false;                                                  /**< True to install an update found by an asynchronous check right away. */
+    bool prefetch = false;                                                      /**< True to stop installs before the activation, see setPrefetch(). */
+    bool staged = false;                                                        /**< True while a written and verified update waits for commitStaged(). */
+    char staged_tag[ESP32_OTA_UPDATER_SHORTSTRING_LENGTH];                      /**< The release of the staged update. */
+    TokenBucket download_limiter;                                               /**< Caps the rate of image downloads. */
+    volatile uint32_t throttle_wait = 0;                                        /**< Time in ms until the limiter allows the next slice. */
+    StateCallback state_callback = nullptr;
+    ProgressCallback progress_callback = nullptr;
+    MetricsCallback metrics_callback = nullptr;
+    TaskHandle_t task_handle = NULL;
 
-    const char *rootCert;
+    ReleaseParser release_parser;                                /**< Parser of the release which is currently received. */
+    ReleaseAsset firmware_asset;                                 /**< The firmware asset looked up by release_parser. */
+    ReleaseAsset patch_asset;                                    /**< The delta patch asset looked up by release_parser. */
+    ReleaseAsset signature_asset;                                /**< The signature asset looked up by release_parser. */
+    char pending_etag[ESP32_OTA_UPDATER_LONGSTRING_LENGTH];      /**< ETag of the release which is currently received. */
+    ManifestParser manifest_parser;                              /**< Parser of the release manifest which is currently received. */
+    char manifest_asset_name[ESP32_OTA_UPDATER_SHORTSTRING_LENGTH] = ""; /**< Asset name of the release manifest, empty to use the API. */
+    char download_base[ESP32_OTA_UPDATER_LONGSTRING_LENGTH];     /**< Release download URL of the repository, the manifest assets are below it. */
+    bool manifest_check = false;                                 /**< True while the release is checked through the manifest. */
+    ReleaseChannel release_channel;                              /**< Decides which releases are installed. */
+    char channel_spec[ESP32_OTA_UPDATER_SHORTSTRING_LENGTH] = "stable"; /**< The specification release_channel was parsed from. */
+    uint8_t release_page = 0;                                    /**< Page of the releases list which is received, 0 for the latest release. */
+    int response_length_total = 0;                               /**< Length of the current response body. */
+    int response_remaining = 0;                                  /**< Bytes of the current response body which are not read yet. */
+    unsigned long step_start = 0;                                /**< Time the current check or download started. */
+    unsigned long last_data_received = 0;                        /**< Time data was last received, used for the non-blocking timeout. */
+    uint32_t cycle_handshakes = 0;                               /**< Handshake count of the transport when the last release check started. */
+    UpdateMetrics metrics;                                       /**< Metrics of the current or last update cycle. */
+    UpdatePhase active_phase = UPDATE_PHASE_COUNT;               /**< The network phase which is timed right now, UPDATE_PHASE_COUNT if none. */
+    unsigned long phase_start = 0;                               /**< Time active_phase started. */
+    uint32_t phase_bytes = 0;                                    /**< Bytes received in active_phase. */
+    static const int RESPONSE_LENGTH_UNKNOWN = 0x7FFFFFFF;       /**< Length of chunked responses, which end when the transport says so. */
 
     void updateProgressCallback(size_t progress, size_t size);
-    int httpclientSendRequest(HTTPClient &http_client);
-    inline void _begin(const char *owner, const char *repo, const char *firmware_path);
+    int sendRequest(UpdatePhase phase);
+    inline bool _begin(const char *owner, const char *repo, const char *firmware_path);
+
+    bool beginCheck();
+    bool requestRelease();
+    void checkStep(bool blocking);
+    void finishCheck();
+    bool beginDownload(bool signature_loaded = false);
+    bool beginNextComponent();
+    bool openDownload(const char *url, int expected_size, bool resume_recorded, uint32_t resume_offset, uint32_t resume_crc,
+                      const uint8_t *resume_head);
+    bool fetchSignature();
+    void downloadStep(bool blocking);
+    void failImageWrite();
+    void finishInstall();
+    void commitInstall();
+    void discardStaged();
+    ESP32_OTA_Updater_State releaseState();
+    void fallbackToFullImage();
+    bool findPeer(char *url, size_t capacity, int *size);
+    void fallbackFromPeer();
+    void offerInstalledImage();
+    void storeInstalledImage(uint32_t size);
+    int readResponseChunk(uint8_t *buffer, size_t size, bool blocking);
+    void failUpdate(ESP32_OTA_Updater_Error reason);
+    void setState(ESP32_OTA_Updater_State new_state);
+    bool isBusy() const;
+    static void updaterTask(void *parameter);
+
+    void beginPhase(UpdatePhase phase);
+    void endPhase();
+    void addPhase(UpdatePhase phase, uint32_t duration_ms, uint32_t bytes);
+    void sampleHeap();
+    void finishMetrics();
+
+    void scheduleNextCheck();
+    bool evaluateCachedRelease();
+    void loadCheckCache();
+    void storeCheckCache();
+    const char *preferencesNamespace(const char *prefix, char *name) const;
+
+    bool isComponentInstalled(const Component &component);
+    void storeInstalledComponent(const Component &component);
+
+    bool loadResumeState(const char *url, int size, uint32_t *offset, uint32_t *crc, uint8_t *head);
+    void storeResumeState(uint32_t committed, uint32_t crc);
+    void clearResumeState();
 
     Print *debugPrinter = NULL;
     void debugf(const char *format, ...);
 
 public:
+#ifdef ARDUINO
     /**
      * @brief Constructor for the ESP32_OTA_Updater class.
      *
@@ -61,9 +242,24 @@ public:
      * @note Please supply the all Certs for all Github endpoints concatenated in one string
      *
      * @param rootCertificate The root certificates for GitHub's HTTPS server and Githubs Download Server.
-     * @param current_version The semantic version of the fimware currently installed, should be "v.0.0.0" or "0.0.0"
+     * @param current_version The semantic version of the fimware currently installed, e.g. "v1.2.0" or "1.3.0-rc.1",
+     *                        see Version. It can be checked at compile time with `Version::validate()`.
      */
     ESP32_OTA_Updater(const char *rootCertificate, const char *current_version);
+#endif
+
+    /**
+     * @brief Constructor for the ESP32_OTA_Updater class with custom transport and storage.
+     *
+     * Allows to replace the HTTP client and the flash access, e.g. to run the update logic on a host.
+     *
+     * @param transport The transport all requests are sent with.
+     * @param firmware_sink The sink the new image is installed through.
+     * @param running_image The image delta patches are applied to, NULL to not use delta patches.
+     * @param current_version The semantic version of the fimware currently installed, e.g. "v1.2.0" or "1.3.0-rc.1",
+     *                        see Version. It can be checked at compile time with `Version::validate()`.
+     */
+    ESP32_OTA_Updater(HttpTransport *transport, FirmwareSink *firmware_sink, ByteSource *running_image, const char *current_version);
 
     /**
      * @brief Initializes the ESP32 OTA Updater.
@@ -71,9 +267,12 @@ public:
      * @param owner The owner of the repository where the firmware is build an released.
      * @param repo The name of the repository where the firmware is build an released.
      * @param firmware_path The path to the firmware binary file on the Github Release -> the asset name.
+     *                      Compressed assets are decompressed while they are downloaded: gzip ("firmware.bin.gz"),
+     *                      zlib ("firmware.bin.zz") and heatshrink ("firmware.bin.hs", window and lookahead set by
+     *                      ESP32_OTA_UPDATER_HEATSHRINK_WINDOW_BITS/LOOKAHEAD_BITS).
      * @param gh_api_key The (Fine Grained) Github Personal Access Token.
      *
-     * @return true if the initialization was successful, false otherwise.
+     * @return true if the initialization was successful, false otherwise (e.g. the current version is invalid).
      */
     bool begin(const char *owner, const char *repo, const char *firmware_path, const char *api_key);
 
@@ -84,7 +283,7 @@ public:
      * @param repo The name of the repository where the firmware is build an released.
      * @param firmware_path The path to the firmware binary file on the Github Release -> the asset name.
      *
-     * @return true if the initialization was successful, false otherwise.
+     * @return true if the initialization was successful, false otherwise (e.g. the current version is invalid).
      */
     bool begin(const char *owner, const char *repo, const char *firmware_path);
 
@@ -92,21 +291,447 @@ public:
      * @brief Checks if a firmware update is available.
      *
      * This function checks if a new firmware update is available by comparing the current version with the version
-     * specified in the firmware update file.
+     * specified in the firmware update file. Checks are scheduled by `setCheckInterval()`, `setCheckJitter()` and
+     * `setCheckBackoff()` and sent as conditional requests (If-None-Match), so an unchanged release is answered without
+     * a response body. A check that failed does not block the next one, it only delays it by the backoff.
      *
-     * @return True if a firmware update is available, false otherwise.
+     * @return True if a firmware update is available, false otherwise. False while the update is staged (see
+     *         `setPrefetch()`) or installed and waiting for the reboot.
      */
     bool available();
 
+    /**
+     * @brief Applies the result of a BatchReleaseChecker, which checked this and other repositories with one request.
+     *
+     * If the latest release is the cached one or not newer than the running version, the result counts as a check:
+     * `available()` answers without a request until the check interval elapsed again. If the release is newer, the
+     * next `available()` requests it right away, to get its assets, signature and delta patch. Updaters which select
+     * releases from another channel than the latest stable release ignore the result.
+     *
+     * @param component The result for the repository and asset of this updater.
+     * @return True if `available()` requests the release, false if no request is needed.
+     */
+    bool setBatchResult(const BatchComponent &component);
+
+    /**
+     * @brief Sets the minimum interval between two release checks.
+     *
+     * Calls to `available()` before the next check is due return the result of the last check without any network
+     * traffic. The schedule is kept in RTC memory for up to ESP32_OTA_UPDATER_MAX_INSTANCES repositories, so the
+     * interval also holds across deep sleep.
+     *
+     * @param interval_ms The minimum interval in milliseconds, 0 checks on every call.
+     */
+    void setCheckInterval(unsigned long interval_ms);
+
+    /**
+     * @brief Sets the maximum random delay of the first check after boot, added to every interval.
+     *
+     * Devices which are powered up together (e.g. after a power failure) spread their checks over the jitter instead
+     * of exhausting the API rate limit at once. The random delay is seeded by the device ID.
+     *
+     * @param jitter_ms The jitter in milliseconds, 0 to check right away (default ESP32_OTA_UPDATER_CHECK_JITTER).
+     */
+    void setCheckJitter(unsigned long jitter_ms);
+
+    /**
+     * @brief Sets the exponential backoff after failed checks.
+     *
+     * Failures to connect (WIFI_NOT_CONNECTED) and HTTP errors or invalid responses back off separately. An exhausted
+     * rate limit (X-RateLimit-Remaining, X-RateLimit-Reset, Retry-After) defers the next check until its reset.
+     *
+     * @param failure The failure class.
+     * @param base_ms The delay after the first failure, doubled with every further one.
+     * @param max_ms The maximum delay.
+     */
+    void setCheckBackoff(CheckScheduler::Failure failure, unsigned long base_ms, unsigned long max_ms);
+
+    /**
+     * @brief Gets the time until `available()` or `startCheck()` send the next request, e.g. to sleep until then.
+     * @return The time in milliseconds, 0 if a check is due.
+     */
+    unsigned long getTimeUntilCheck() const;
+
+    /**
+     * @brief Sets the ID of this device, call it before `begin()`.
+     * @param id The ID, it is copied. The default on the ESP32 is the factory MAC address.
+     */
+    void setDeviceId(const char *id);
+
+    /**
+     * @brief Enables or disables staged rollouts.
+     *
+     * A release whose notes start with a line like "Rollout: 25%" is only installed by the given percentage of
+     * devices, selected by a hash of the device ID and the tag. Raising the percentage in the release notes adds
+     * devices, devices that were included stay included.
+     *
+     * @param enabled True to follow the rollout percentage, false to install every release (default).
+     */
+    void setStagedRollout(bool enabled);
+
+    /**
+     * @brief Selects the releases this device installs, e.g. a beta channel or only updates within a major version.
+     *
+     * The default "stable" channel requests the latest release. Every other channel streams through the pages of the
+     * releases list (ESP32_OTA_UPDATER_RELEASES_PER_PAGE per request) and picks the highest version of the channel,
+     * only keeping the best release so far, so the memory used does not depend on the number of releases. The scan
+     * stops at the first release of the channel which is not newer than the running version, the list is ordered by
+     * creation date. See ReleaseChannel for the specification, e.g. "beta ^2".
+     *
+     * @param spec The channel specification, it is copied.
+     * @return True if the specification is valid, false otherwise (the channel stays unchanged).
+     */
+    bool setReleaseChannel(const char *spec);
+
+    /**
+     * @brief Enables or disables storing the release check cache (tag, ETag and asset URL) in NVS.
+     *
+     * With a persistent cache the first check after a reboot is a conditional request, which GitHub answers
+     * with an empty 304 response if the latest release did not change.
+     *
+     * @param persistent True to keep the cache in NVS (default), false to only keep it in RAM.
+     */
+    void setCheckCachePersistent(bool persistent);
+
+    /**
+     * @brief Discards the cached release information, the next call to `available()` performs a full check.
+     */
+    void clearCheckCache();
+
     /**
      * @brief Downloads and installs the firmware update. Use 'reboot()' for the esp to reboot and the update to take effect!
      *
      * This function downloads the firmware update file from the specified URL and installs it on the ESP32 device.
      *
      * @note This function should only be called if a firmware update is available (i.e., `available()` returns true).
+     * @note If the connection is lost, the next call continues an uncompressed image where it stopped, see
+     *       `setResumableDownloads()`.
      */
     bool downloadAndInstall();
 
+    /**
+     * @brief Updates another partition together with the app, e.g. the file system with the web UI.
+     *
+     * The asset is looked up in the same release as the firmware and installed after the app image, in the order the
+     * components were added. Nothing is activated before every component was written and checked against the SHA-256
+     * digest GitHub lists for the asset: if one fails, the new app is not booted. Components whose digest matches the
+     * one installed last are skipped and not downloaded. Compressed (e.g. "littlefs.bin.gz") and, with a key, encrypted
+     * assets are decoded like the firmware. A release without the asset leaves the partition unchanged.
+     *
+     * @note A data partition has no second slot and is overwritten in place, which is why components are written
+     *       last. If its download fails, the old app keeps running with an incomplete partition until the next
+     *       attempt completes the update.
+     * @note Components have to be added before `begin()`, which loads the cached release including their assets.
+     *
+     * @param asset_name The name of the asset, it has to stay valid.
+     * @param sink The sink the asset is installed through.
+     * @return True if the component was added, false if ESP32_OTA_UPDATER_MAX_COMPONENTS is reached.
+     */
+    bool addComponent(const char *asset_name, FirmwareSink *sink);
+
+    /**
+     * @brief Checks for releases with a binary manifest asset instead of the release JSON of the GitHub API.
+     *
+     * The manifest (e.g. "manifest.bin", created by tools/ota_manifest.py in the release workflow) lists the tag,
+     * the rollout percentage and the name, size and SHA-256 of every asset in a few hundred bytes. It is requested
+     * from the stable download URL of the latest release ("https://github.com/<owner>/<repo>/releases/latest/download/<name>"),
+     * which does not count against the API rate limit, and the assets are downloaded from the release download
+     * URLs. The manifest is only used for public repositories (no API key) and the default stable channel. If the
+     * latest release has no manifest, the check continues with the API.
+     *
+     * @param asset_name The asset name of the manifest, NULL or "" to use the API (default).
+     */
+    void setManifest(const char *asset_name);
+
+    /**
+     * @brief Shares verified images with other devices on the local network, so a site downloads a release once.
+     *
+     * Before an install the device asks its peers for the image of the release, identified by the tag and the
+     * SHA-256 of the image, and downloads it from a peer offering it instead of GitHub (also instead of a delta
+     * patch). Once the update is booted, the device offers the image from its running partition. The digest has to
+     * be known before the download: the release needs the signature asset (e.g. "firmware.sig") or an uncompressed
+     * firmware asset (e.g. "firmware.bin"), whose digest GitHub lists. An image from a peer is verified like one from
+     * GitHub (including the signature with `setSigningKey()`), if the peer fails or the image does not match, the
+     * install continues from GitHub. Images of encrypted releases are never shared.
+     *
+     * @note Peers are served while `poll()` is called (it does nothing else if no check or install was requested) or
+     *       by the updater task. Set the network before `begin()`, which offers the running image.
+     *
+     * @param network The peer network, e.g. an Esp32PeerNetwork, it has to stay valid. NULL to disable (default).
+     */
+    void setPeerNetwork(PeerNetwork *network);
+
+#ifdef ARDUINO
+    /**
+     * @brief Updates a data partition (e.g. LittleFS, SPIFFS or FAT) together with the app, see `addComponent()`.
+     * @param asset_name The name of the asset, e.g. "littlefs.bin", it has to stay valid.
+     * @param partition_label The label of the partition in the partition table, e.g. "spiffs", it has to stay valid.
+     * @return True if the component was added, false if ESP32_OTA_UPDATER_MAX_COMPONENTS is reached.
+     */
+    bool addDataPartition(const char *asset_name, const char *partition_label);
+
+    /**
+     * @brief Checks the servers against the trust anchors of a certificate store instead of the root certificates of
+     *        the constructor, so a TLS handshake does not parse every root certificate again.
+     *
+     * With an asset name, a bundle of the release (e.g. "cacerts.bin" created by tools/ota_certs.py and signed like
+     * "firmware.sig") is installed through the store as a component, see `addComponent()`. This way the anchors are
+     * replaced before a server changes its certificate authority, without a firmware update.
+     *
+     * @param store The store, loaded with `CertificateStore::load()`, it has to stay valid.
+     * @param asset_name The name of the bundle asset, it has to stay valid. NULL to only use the loaded bundle.
+     * @return True if the store is used, false if ESP32_OTA_UPDATER_MAX_COMPONENTS is reached.
+     */
+    bool setCertificateStore(CertificateStore *store, const char *asset_name = NULL);
+#endif
+
+    /**
+     * @brief Enables or disables resumable downloads.
+     *
+     * While an uncompressed firmware binary is downloaded, the number of bytes written to the update partition and
+     * their CRC32 are recorded in NVS every ESP32_OTA_UPDATER_RESUME_CHECKPOINT_SIZE bytes. If the connection is lost,
+     * the next attempt (also after a reboot) checks the partition against the record and only requests the rest of
+     * the asset with an HTTP Range request. Compressed assets and delta patches always start from the beginning,
+     * since the decoder state can not be restored. Disabling it discards the recorded progress of this updater, also
+     * if it is called before `begin()` (which then discards it).
+     *
+     * @param enabled True to record the progress and resume downloads (default), false to always start over.
+     */
+    void setResumableDownloads(bool enabled);
+
+    /**
+     * @brief Configures the pipeline between the download and the flash writer.
+     *
+     * The download fills a ring of buffers while a task on the other core writes them to flash and erases the next
+     * sectors ahead of time, so network and TLS processing overlap with the flash erases and writes.
+     *
+     * @param buffer_count The number of buffers, 0 to write to flash synchronously (default ESP32_OTA_UPDATER_PIPELINE_BUFFERS).
+     * @param buffer_size The size of each buffer (default ESP32_OTA_UPDATER_PIPELINE_BUFFER_SIZE).
+     */
+    void setPipeline(uint8_t buffer_count, size_t buffer_size = ESP32_OTA_UPDATER_PIPELINE_BUFFER_SIZE);
+
+    /**
+     * @brief Lets installs use memory of the caller instead of the heap, see StaticOtaUpdater.
+     *
+     * @param pipeline_storage Memory of the pipeline buffers (see setPipeline()), NULL to allocate them per install.
+     * @param pipeline_capacity The size of pipeline_storage.
+     * @param decompressor_workspace INFLATE_DECODER_WORKSPACE_SIZE bytes for gzip and zlib assets, aligned to 8 bytes,
+     *                               NULL to allocate them per install.
+     */
+    void setWorkBuffers(uint8_t *pipeline_storage, size_t pipeline_capacity, void *decompressor_workspace);
+
+    /**
+     * @brief Gets the stall counters of the download and flash stages of the current or last install.
+     *
+     * Many reader stalls mean the flash limits the install speed, many writer stalls mean the download does.
+     *
+     * @return The counters.
+     */
+    const FlashPipelineStats &getPipelineStats() const;
+
+    /**
+     * @brief Requires releases to be signed with the private key belonging to a public key.
+     *
+     * The image is hashed with SHA-256 while it is written (using the SHA accelerator of the ESP32), so verification
+     * needs no second pass over the partition. The expected digest and the signature are taken from the asset
+     * "<firmware>.sig" of the release (e.g. "firmware.sig" for "firmware.bin", "firmware.bin.gz" and delta patches):
+     * the raw SHA-256 of the uncompressed image followed by the DER encoded ECDSA or RSA signature of it, see the
+     * example workflow. The image is only activated if both match. Without a key the digest of a published
+     * signature asset is still checked.
+     *
+     * @note mbedtls on the ESP32 does not support Ed25519, use an ECDSA (e.g. P-256) or RSA key.
+     *
+     * @param public_key The PEM encoded public key, it has to stay valid. NULL to accept unsigned releases (default).
+     */
+    void setSigningKey(const char *public_key);
+
+    /**
+     * @brief Sets the key of encrypted firmware assets.
+     *
+     * With a key, all assets (also delta patches) have to be encrypted with AES-256-CTR: the magic "OTAE", a 12 byte
+     * nonce and the ciphertext, see StreamDecryptor and the example workflow. They are decrypted in the download
+     * buffer before decompression, so no extra buffer or second pass is needed. Encrypted downloads always start over,
+     * like compressed ones. Keep the key out of the firmware image, e.g. in encrypted NVS provisioned per device.
+     *
+     * @param key The 32 byte key, it is copied. NULL for plain assets (default).
+     */
+    void setDecryptionKey(const uint8_t *key);
+
+    /**
+     * @brief Enables or disables delta updates.
+     *
+     * If the release contains a patch from the running version (an asset named "<firmware>-<current>-<new>.patch",
+     * e.g. "firmware-1.2.3-1.3.0.patch" or "firmware-1.2.3-1.3.0.patch.gz" for the asset "firmware.bin", see
+     * tools/ota_delta.py) only the patch is downloaded and applied to the running app partition. Without a matching
+     * patch, or if the patch does not apply, the full binary is downloaded.
+     *
+     * @param enabled True to use delta patches if available (default), false to always download the full binary.
+     */
+    void setDeltaUpdates(bool enabled);
+
+    /**
+     * @brief Enables or disables the check of the app image header before anything is written to flash.
+     *
+     * The first bytes of the decoded image (the image header and the app description) have to match the running
+     * image: the magic bytes, the chip, a flash size not larger than the running one and the project name. An image
+     * which does not match is rejected after about a hundred bytes with `OTA_IMAGE_MISMATCH`, before the download
+     * continues and before any flash sector is erased. Resumed downloads are not checked again.
+     *
+     * @param enabled True to check the header (default), false to write any image.
+     * @param require_newer_version True to also require the embedded version (PROJECT_VER of esp_app_desc_t) to be a
+     *                              semantic version newer than the running version, for builds which set it to the tag.
+     */
+    void setImageHeaderCheck(bool enabled, bool require_newer_version = false);
+
+    /**
+     * @brief Requests an asynchronous release check, which is performed by `poll()` or the updater task.
+     *
+     * @note The connection setup (DNS, TLS handshake, time to first byte) of a request is performed in a single
+     *       poll() step, all other work is split into slices of at most ESP32_OTA_UPDATER_POLL_SLICE_SIZE bytes.
+     *
+     * @return True if the request was accepted, false if the updater is busy or in an error state.
+     */
+    bool startCheck();
+
+    /**
+     * @brief Requests the asynchronous download and installation of the update found by the last check.
+     *
+     * @return True if the request was accepted, false if no update is available or the updater is busy.
+     */
+    bool startInstall();
+
+    /**
+     * @brief Installs updates found by asynchronous checks without an additional call to `startInstall()`.
+     *
+     * @param enabled True to install updates right away, false to stop in the OTA_UPDATE_AVAILABLE state (default).
+     */
+    void setAutoInstall(bool enabled);
+
+    /**
+     * @brief Caps the rate of image downloads, so an update trickles in next to the traffic of the application.
+     *
+     * The download connection is read no faster than the cap and TCP flow control slows the server down to it. The
+     * rate can be changed at any time, also while the updater task downloads. Release checks are not limited.
+     *
+     * @param bytes_per_second The average rate, 0 for no limit (default).
+     * @param burst_bytes The number of bytes which may be read at once after a pause, 0 for a tenth of the rate (at
+     *                    least two slices of ESP32_OTA_UPDATER_POLL_SLICE_SIZE).
+     */
+    void setDownloadRateLimit(uint32_t bytes_per_second, uint32_t burst_bytes = 0);
+
+    /**
+     * @brief Stops installs before the activation, so the update is prefetched while the application keeps running.
+     *
+     * With prefetching, `downloadAndInstall()` and asynchronous installs write and verify the update (and its
+     * components) in the inactive partition and stop in the OTA_STAGED state. `commitStaged()` then only activates it,
+     * e.g. in a maintenance window. A check which finds another release discards the staged update, the same release
+     * stays staged and is not downloaded again. A check which fails (e.g. on a broken response) keeps the staged
+     * update, `isStaged()` stays true and `commitStaged()` still activates it. The staged update is kept in RAM, a
+     * reboot before the commit starts the download over (resuming an uncompressed image from its last checkpoint).
+     *
+     * @param enabled True to prefetch updates, false to activate them right away (default).
+     */
+    void setPrefetch(bool enabled);
+
+    /**
+     * @brief Activates the staged update, which takes effect after `reboot()`.
+     *
+     * The image is already written and verified, the commit only writes its held back first bytes and selects the
+     * boot partition (and finishes the components), which takes a few milliseconds. The error of a check which
+     * failed since the update was staged is cleared, it did not touch the staged update.
+     *
+     * @return True if the update is activated, false if none is staged, the updater is busy or the activation failed.
+     */
+    bool commitStaged();
+
+    /**
+     * @brief Checks if an update is staged.
+     *
+     * @return True if an update waits for `commitStaged()`, false otherwise.
+     */
+    bool isStaged() const
+    {
+        return staged;
+    }
+
+    /**
+     * @brief Performs a bounded slice of the pending asynchronous work, call this repeatedly from the main loop.
+     *
+     * Only already received data is processed, so apart from the connection setup a call never waits on the network.
+     * Do not call poll() when the updater task is running.
+     *
+     * @return The state after the slice.
+     */
+    ESP32_OTA_Updater_State poll();
+
+    /**
+     * @brief Gets the state of the update engine.
+     *
+     * @return The current state.
+     */
+    ESP32_OTA_Updater_State getState() const;
+
+    /**
+     * @brief Gets the download progress of a running installation.
+     *
+     * @param progress Out: the number of bytes downloaded so far.
+     * @param size Out: the total number of bytes, 0 if no download is running.
+     */
+    void getProgress(size_t *progress, size_t *size) const;
+
+    /**
+     * @brief Sets a callback which is called on every state change.
+     *
+     * @note With the updater task the callback runs in the context of the task.
+     *
+     * @param callback The callback, nullptr to remove it.
+     */
+    void onStateChange(StateCallback callback);
+
+    /**
+     * @brief Sets a callback which is called with the install progress.
+     *
+     * @param callback The callback, nullptr to remove it.
+     */
+    void onProgress(ProgressCallback callback);
+
+    /**
+     * @brief Gets the metrics of the current or last update cycle.
+     *
+     * A cycle starts with a release check and ends with the install following it. The metrics hold the duration and
+     * bytes of every phase (check, signature, download, flash, verification, activation), the HTTP status and
+     * connection timing of every request, retries, the lowest free heap and the error the cycle ended with.
+     *
+     * @return The metrics, valid until the next check starts.
+     */
+    const UpdateMetrics &getMetrics() const;
+
+    /**
+     * @brief Sets a callback which is called with the metrics whenever a check or an install ends, also on failure.
+     *
+     * @note With the updater task the callback runs in the context of the task.
+     *
+     * @param callback The callback, nullptr to remove it.
+     */
+    void onMetrics(MetricsCallback callback);
+
+    /**
+     * @brief Starts a FreeRTOS task pinned to a core which performs all asynchronous work by calling `poll()`.
+     *
+     * Use `startCheck()` and `startInstall()` to request work and `getState()` or the callbacks to get the results.
+     *
+     * @param core The core the task is pinned to.
+     * @param stack_size The stack size of the task in bytes.
+     * @param priority The priority of the task.
+     * @return True if the task was started, false if it is already running or could not be created.
+     */
+    bool startTask(BaseType_t core = 0, uint32_t stack_size = 8192, UBaseType_t priority = 1);
+
+    /**
+     * @brief Stops the updater task, do not call this while an update is downloading.
+     */
+    void stopTask();
+
     /**
      * @brief Initiates a reboot of the esp32, which effectively finished a previously installed update.
      */
@@ -129,9 +754,25 @@ public:
      */
     String getErrorDescription();
 
+    /**
+     * @brief Returns the description of the last error without copying it, see describe().
+     * @return The description.
+     */
+    const char *getErrorMessage() const;
+
+    /**
+     * @brief Gets the description of an error code.
+     * @param error The error code.
+     * @return The description, a constant string which is never allocated.
+     */
+    static const char *describe(ESP32_OTA_Updater_Error error);
+
     /**
      * @brief Sets the debug output stream for logging messages.
      *
+     * Which messages are compiled in is set by ESP32_OTA_UPDATER_LOG_LEVEL, with ESP32_OTA_UPDATER_LOG_NONE no log
+     * statement is compiled in at all.
+     *
      * @param debugStream A pointer to a Print object, e.g. Serial.
      *                     Pass NULL to disable debug logging.
      */
@@ -0,0 +1,98 @@
+#ifndef ESP32_OTA_UPDATER_CONFIG_H_
+#define ESP32_OTA_UPDATER_CONFIG_H_
+/**
+ * @file ESP32_OTA_Updater_Config.h
+ * @brief Compile time configuration of the ESP32 OTA Updater, every value can be overridden with a build flag.
+ */
+
+#ifndef ESP32_OTA_UPDATER_SHORTSTRING_LENGTH
+#define ESP32_OTA_UPDATER_SHORTSTRING_LENGTH 50 /**< Capacity of short strings (owner, repository, asset name, tag). */
+#endif
+#ifndef ESP32_OTA_UPDATER_LONGSTRING_LENGTH
+#define ESP32_OTA_UPDATER_LONGSTRING_LENGTH 150 /**< Capacity of long strings (URLs, API key, ETag). */
+#endif
+
+#ifndef ESP32_OTA_UPDATER_DEFAULT_CHECK_INTERVAL
+#define ESP32_OTA_UPDATER_DEFAULT_CHECK_INTERVAL 60000UL /**< Default minimum time in ms between two release checks. */
+#endif
+// The namespaces of an updater are the prefix followed by the CRC32 of "<owner>/<repo>/<asset>" in hex, so several
+// updaters in one firmware keep their state apart. NVS limits namespaces to 15 characters.
+#define ESP32_OTA_UPDATER_PREFERENCES_NAMESPACE "ota-" /**< NVS namespace prefix of the release check cache. */
+#define ESP32_OTA_UPDATER_RESUME_NAMESPACE "ota-dl-" /**< NVS namespace prefix of the download progress, kept apart from the check cache. */
+#define ESP32_OTA_UPDATER_COMPONENTS_NAMESPACE "ota-cm-" /**< NVS namespace prefix of the digests of the installed components. */
+#define ESP32_OTA_UPDATER_PEER_NAMESPACE "ota-pr-" /**< NVS namespace prefix of the installed image which is offered to peers. */
+#define ESP32_OTA_UPDATER_CERTS_NAMESPACE "esp32-ota-crt" /**< NVS namespace of the parsed trust anchors of the certificate store. */
+#ifndef ESP32_OTA_UPDATER_RESUME_CHECKPOINT_SIZE
+#define ESP32_OTA_UPDATER_RESUME_CHECKPOINT_SIZE 65536UL /**< Bytes between two download progress records in NVS, a multiple of 4096. */
+#endif
+
+#ifndef ESP32_OTA_UPDATER_PARSE_BUFFER_SIZE
+#define ESP32_OTA_UPDATER_PARSE_BUFFER_SIZE 256 /**< Size of the read buffer used while parsing release information. */
+#endif
+#ifndef ESP32_OTA_UPDATER_HTTP_TIMEOUT
+#define ESP32_OTA_UPDATER_HTTP_TIMEOUT 15000UL /**< Timeout in ms for HTTP requests and for waiting on response data. */
+#endif
+#ifndef ESP32_OTA_UPDATER_HTTP_CONNECTIONS
+#define ESP32_OTA_UPDATER_HTTP_CONNECTIONS 2 /**< Number of kept-alive connections (one per host), e.g. the API and the asset download server. */
+#endif
+#ifndef ESP32_OTA_UPDATER_HTTP_DRAIN_LIMIT
+#define ESP32_OTA_UPDATER_HTTP_DRAIN_LIMIT 4096 /**< Unread response bytes which are still received to keep a connection alive, more close it. */
+#endif
+#ifndef ESP32_OTA_UPDATER_HTTP_MAX_REDIRECTS
+#define ESP32_OTA_UPDATER_HTTP_MAX_REDIRECTS 5 /**< Maximum number of redirects followed by a request. */
+#endif
+#ifndef ESP32_OTA_UPDATER_POLL_SLICE_SIZE
+#define ESP32_OTA_UPDATER_POLL_SLICE_SIZE 1024 /**< Maximum number of bytes downloaded and written in a single poll() step. */
+#endif
+#ifndef ESP32_OTA_UPDATER_TASK_IDLE_DELAY
+#define ESP32_OTA_UPDATER_TASK_IDLE_DELAY 100 /**< Time in ms the updater task sleeps between polls while idle. */
+#endif
+#ifndef ESP32_OTA_UPDATER_MAX_COMPONENTS
+#define ESP32_OTA_UPDATER_MAX_COMPONENTS 2 /**< Maximum number of partitions updated together with the app, e.g. the file system. */
+#endif
+#ifndef ESP32_OTA_UPDATER_MAX_ASSETS
+#define ESP32_OTA_UPDATER_MAX_ASSETS (4 + ESP32_OTA_UPDATER_MAX_COMPONENTS) /**< Maximum number of assets which are looked up in a single release. */
+#endif
+#ifndef ESP32_OTA_UPDATER_RELEASES_PER_PAGE
+#define ESP32_OTA_UPDATER_RELEASES_PER_PAGE 10 /**< Releases requested per page when a channel scans the releases list. */
+#endif
+#ifndef ESP32_OTA_UPDATER_RELEASES_MAX_PAGES
+#define ESP32_OTA_UPDATER_RELEASES_MAX_PAGES 5 /**< Maximum number of pages of the releases list scanned in one check. */
+#endif
+#ifndef ESP32_OTA_UPDATER_PEER_PORT
+#define ESP32_OTA_UPDATER_PEER_PORT 3233 /**< UDP port of the peer discovery and TCP port peers serve their image on. */
+#endif
+#ifndef ESP32_OTA_UPDATER_PEER_QUERY_TIMEOUT
+#define ESP32_OTA_UPDATER_PEER_QUERY_TIMEOUT 300 /**< Time in ms a device waits for peers to answer before it downloads from GitHub. */
+#endif
+#ifndef ESP32_OTA_UPDATER_PEER_SLICE_SIZE
+#define ESP32_OTA_UPDATER_PEER_SLICE_SIZE 8192 /**< Maximum number of image bytes sent to a peer in a single handle() step. */
+#endif
+#ifndef ESP32_OTA_UPDATER_ROLLOUT_LINE_LENGTH
+#define ESP32_OTA_UPDATER_ROLLOUT_LINE_LENGTH 32 /**< Number of characters of the release notes read for the rollout percentage. */
+#endif
+#ifndef ESP32_OTA_UPDATER_CERT_BUNDLE_SIZE
+#define ESP32_OTA_UPDATER_CERT_BUNDLE_SIZE 4096 /**< Capacity of the trust anchor bundle of the certificate store, about 10 root certificates. */
+#endif
+#ifndef ESP32_OTA_UPDATER_BATCH_MAX_COMPONENTS
+#define ESP32_OTA_UPDATER_BATCH_MAX_COMPONENTS 4 /**< Maximum number of repositories resolved by one batched release check. */
+#endif
+#ifndef ESP32_OTA_UPDATER_BATCH_QUERY_SIZE
+#define ESP32_OTA_UPDATER_BATCH_QUERY_SIZE 1024 /**< Capacity of the GraphQL request of a batched release check. */
+#endif
+#ifndef ESP32_OTA_UPDATER_MAX_INSTANCES
+#define ESP32_OTA_UPDATER_MAX_INSTANCES 4 /**< Number of updaters (repositories) whose check schedules are kept in RTC memory. */
+#endif
+#ifndef ESP32_OTA_UPDATER_METRICS_MAX_REQUESTS
+#define ESP32_OTA_UPDATER_METRICS_MAX_REQUESTS 6 /**< Number of requests per update cycle whose status and timing are kept in the metrics. */
+#endif
+
+#define ESP32_OTA_UPDATER_LOG_NONE 0  /**< No log output, the log statements are not compiled in. */
+#define ESP32_OTA_UPDATER_LOG_ERROR 1 /**< Only failures. */
+#define ESP32_OTA_UPDATER_LOG_INFO 2  /**< Failures and one line per step of the update cycle. */
+#define ESP32_OTA_UPDATER_LOG_DEBUG 3 /**< Everything, including a line for every chunk written. */
+#ifndef ESP32_OTA_UPDATER_LOG_LEVEL
+#define ESP32_OTA_UPDATER_LOG_LEVEL ESP32_OTA_UPDATER_LOG_INFO /**< Log statements above this level are removed at compile time. */
+#endif
+
+#endif // ESP32_OTA_UPDATER_CONFIG_H_
@@ -1,3 +1,6 @@
+#ifndef ERRORS_H_
+#define ERRORS_H_
+
 #include "stdint.h"
 
 enum ESP32_OTA_Updater_Error: uint8_t
@@ -9,5 +12,10 @@ enum ESP32_OTA_Updater_Error: uint8_t
     OTA_DOWNLOAD_FAILED,
     OTA_INSTALL_FAILED,
     OTA_FAILED_TO_DESERIALIZE,
-    OTA_RESPONSE_INVALID
-};
\ No newline at end of file
+    OTA_RESPONSE_INVALID,
+    OTA_VERIFICATION_FAILED,
+    OTA_IMAGE_MISMATCH,
+    OTA_IMAGE_TRUNCATED
+};
+
+#endif // ERRORS_H_
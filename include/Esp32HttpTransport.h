@@ -0,0 +1,125 @@
+#ifndef ESP32_HTTP_TRANSPORT_H_
+#define ESP32_HTTP_TRANSPORT_H_
+
+#ifdef ARDUINO
+
+#include <WiFi.h>
+#include <WiFiClientSecure.h>
+#include <HTTPClient.h>
+
+#include "CertificateStore.h"
+#include "ESP32_OTA_Updater_Config.h"
+#include "HttpTransport.h"
+
+/**
+ * @file Esp32HttpTransport.h
+ * @brief Contains the declaration of the Esp32HttpTransport class.
+ */
+
+#define ESP32_HTTP_TRANSPORT_MAX_HEADERS 8 /**< Maximum number of request headers and of collected response headers. */
+
+/**
+ * @class Esp32HttpTransport
+ * @brief Default HttpTransport on the ESP32, HTTPS requests with WiFiClientSecure and HTTPClient.
+ *
+ * Plain "http://" URLs (e.g. images served by peers, see PeerNetwork) use a WiFiClient without TLS.
+ * Requests use HTTP/1.1 with keep-alive. Every host gets its own connection from a pool of
+ * ESP32_OTA_UPDATER_HTTP_CONNECTIONS, so the release check, the redirect from the GitHub API and the download from
+ * the asset server all reuse their connection instead of performing a new TLS handshake. Redirects are followed by
+ * the transport (the authorization is not sent to other hosts) and chunked responses are decoded. Requests time out
+ * after ESP32_OTA_UPDATER_HTTP_TIMEOUT. Requests to a host of ESP32_OTA_UPDATER_SHORTSTRING_LENGTH characters or more
+ * fail with HTTPC_ERROR_CONNECTION_REFUSED.
+ *
+ * The URL, the request headers, the host names and the redirect locations are Arduino Strings, like in the HTTPClient
+ * the transport is built on, so every request allocates on the heap.
+ */
+class Esp32HttpTransport : public HttpTransport
+{
+public:
+    /**
+     * @brief Sets the root certificates the server certificates are checked against.
+     * @param root_certificate The root certificates for all hosts which are requested, concatenated in one string.
+     */
+    void setCACert(const char *root_certificate);
+
+    /**
+     * @brief Checks server certificates against the bundle of a certificate store instead of the PEM root certificates.
+     *
+     * The bundle is applied to every new connection while the store has one, otherwise the root certificates of
+     * setCACert() are used.
+     *
+     * @param store The store, NULL to use the root certificates of setCACert().
+     */
+    void setCertificateStore(CertificateStore *store)
+    {
+        certificate_store = store;
+    }
+
+    bool begin(const char *url) override;
+    void addHeader(const char *name, const char *value) override;
+    void setAuthorization(const char *token) override;
+    void collectHeaders(const char *names[], size_t count) override;
+    int GET() override;
+    int POST(const uint8_t *body, size_t length) override;
+    int getSize() override;
+    void getHeader(const char *name, char *value, size_t capacity) override;
+    int available() override;
+    bool connected() override;
+    size_t read(uint8_t *buffer, size_t size) override;
+    void end() override;
+
+    uint32_t getHandshakeCount() const override
+    {
+        return handshake_count;
+    }
+
+    void getTiming(HttpRequestTiming *timing) const override
+    {
+        *timing = this->timing;
+    }
+
+private:
+    struct Connection
+    {
+        WiFiClientSecure secure_client;                /**< The WifiClientSecure object for HTTPS communication. */
+        WiFiClient plain_client;                       /**< The client for plain HTTP, e.g. to peers on the local network. */
+        WiFiClient *client = &secure_client;           /**< The client of the host the connection belongs to. */
+        HTTPClient http;                               /**< The HTTPClient object for making HTTP requests. */
+        char host[ESP32_OTA_UPDATER_SHORTSTRING_LENGTH] = ""; /**< The host the connection belongs to, empty if unused. */
+        unsigned long last_used = 0;
+    };
+
+    Connection connections[ESP32_OTA_UPDATER_HTTP_CONNECTIONS];
+    Connection *active = nullptr;
+    const char *http_useragent = "ESP32-OTA-Updater";
+    const char *root_certificate = nullptr;
+    CertificateStore *certificate_store = nullptr;
+
+    String url;
+    String header_names[ESP32_HTTP_TRANSPORT_MAX_HEADERS];
+    String header_values[ESP32_HTTP_TRANSPORT_MAX_HEADERS];
+    uint8_t header_count = 0;
+    String authorization;
+    const char *collect_names[ESP32_HTTP_TRANSPORT_MAX_HEADERS + 2]; /**< Headers of the caller plus Location and Transfer-Encoding. */
+    size_t collect_count = 0;
+
+    int content_length = -1;
+    uint32_t body_read = 0;
+    bool chunked = false;
+    uint32_t chunk_remaining = 0;
+    bool body_complete = true;
+    uint32_t handshake_count = 0;
+    HttpRequestTiming timing = {};
+
+    Connection *connectionFor(const String &host);
+    bool connect(Connection *connection, const String &host);
+    void applyTrustAnchors(WiFiClientSecure &client);
+    int sendRequest(Connection *connection, bool authorize, const uint8_t *body = NULL, size_t length = 0);
+    void beginResponse(Connection *connection, int code);
+    bool readChunkHeader(WiFiClient *stream);
+    void finishResponse();
+};
+
+#endif // ARDUINO
+
+#endif // ESP32_HTTP_TRANSPORT_H_
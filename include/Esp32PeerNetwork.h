@@ -0,0 +1,64 @@
+#ifndef ESP32_PEER_NETWORK_H_
+#define ESP32_PEER_NETWORK_H_
+
+#ifdef ARDUINO
+
+#include <WiFi.h>
+#include <WiFiUdp.h>
+
+#include "ESP32_OTA_Updater_Config.h"
+#include "PeerNetwork.h"
+
+/**
+ * @file Esp32PeerNetwork.h
+ * @brief Contains the declaration of the Esp32PeerNetwork class.
+ */
+
+/**
+ * @class Esp32PeerNetwork
+ * @brief Default PeerNetwork on the ESP32, UDP broadcast discovery and a plain HTTP server on the same port.
+ *
+ * A device looking for an image broadcasts "OTAPEER? <tag> <digest>" and every device offering it answers
+ * "OTAPEER! <tag> <digest> <size> <port>". The image is then served as "http://<address>:<port>/ota/<digest>" from
+ * the offered source, e.g. the running app partition, to one peer at a time and in slices of
+ * ESP32_OTA_UPDATER_PEER_SLICE_SIZE, so serving does not block the caller of handle(). The sockets are opened by the
+ * first handle() once WiFi is connected.
+ *
+ * @note The image is served unencrypted to the local network, the updater does not offer images of encrypted
+ *       releases.
+ */
+class Esp32PeerNetwork : public PeerNetwork
+{
+public:
+    /**
+     * @brief Constructs the peer network.
+     * @param port The UDP port of the discovery and the TCP port of the HTTP server.
+     */
+    explicit Esp32PeerNetwork(uint16_t port = ESP32_OTA_UPDATER_PEER_PORT);
+
+    void offer(const PeerImage &image, ByteSource *source) override;
+    bool find(PeerImage *image, char *url, size_t capacity) override;
+    bool handle() override;
+
+private:
+    uint16_t port;
+    WiFiUDP udp;
+    WiFiServer server;
+    WiFiClient client;              /**< The peer which is served. */
+    bool started = false;           /**< True once the sockets are open. */
+    PeerImage offered;              /**< The image which is offered, valid if source is set. */
+    ByteSource *source = nullptr;   /**< The offered image, NULL if nothing is offered. */
+    bool responding = false;        /**< True once the request of client was answered and the image is sent. */
+    uint32_t sent = 0;              /**< Image bytes sent to client. */
+    unsigned long last_activity = 0; /**< Time client last sent or received data. */
+
+    bool start();
+    void answerQueries();
+    bool readRequest();
+    bool serveSlice();
+    void closeClient();
+};
+
+#endif // ARDUINO
+
+#endif // ESP32_PEER_NETWORK_H_
@@ -0,0 +1,109 @@
+#ifndef FIRMWARE_SINK_H_
+#define FIRMWARE_SINK_H_
+
+#include "ByteStream.h"
+
+/**
+ * @file FirmwareSink.h
+ * @brief Contains the declaration of the FirmwareSink interface the new image is installed through.
+ */
+
+#define FIRMWARE_SINK_SECTOR_SIZE 4096 /**< Erase unit, resumed images continue at a multiple of it. */
+#define FIRMWARE_SINK_HEAD_SIZE 16     /**< Number of leading image bytes recorded to resume an image. */
+
+/**
+ * @class FirmwareSink
+ * @brief Final stage of the install chain, stores the new image and activates it.
+ *
+ * The default implementation on the ESP32 is PartitionWriter, which writes into the next OTA partition. Data is
+ * committed in whole sectors, so an interrupted image can be continued at getCommitted() by a later attempt.
+ * The committed image can be read back as a ByteSource.
+ */
+class FirmwareSink : public ByteSink, public ByteSource
+{
+public:
+    /**
+     * @brief Gets the maximum size of an image.
+     * @return The size in bytes, 0 if there is no place to install an image.
+     */
+    virtual uint32_t getCapacity() = 0;
+
+    /**
+     * @brief Prepares writing an image.
+     * @param offset The number of image bytes already committed by an earlier attempt, a multiple of the sector size.
+     * @param crc The CRC32 of the committed bytes, 0 for a new image.
+     * @param head The first FIRMWARE_SINK_HEAD_SIZE bytes of the committed image, NULL for a new image.
+     * @return True on success, false otherwise.
+     */
+    virtual bool begin(uint32_t offset = 0, uint32_t crc = 0, const uint8_t *head = NULL) = 0;
+
+    /**
+     * @brief Prepares storage ahead of the write position while the writer has nothing else to do.
+     * @param distance The maximum number of bytes ahead of the committed data to prepare.
+     * @return True if work was done, false if there is nothing to prepare.
+     */
+    virtual bool eraseAhead(uint32_t distance)
+    {
+        return false;
+    }
+
+    /**
+     * @brief Writes the remaining data, validates the image and activates it for the next boot.
+     * @return True if the image is valid and activated, false otherwise.
+     */
+    virtual bool finish() = 0;
+
+    /**
+     * @brief Stops writing, the committed data is kept for a later attempt.
+     */
+    virtual void abort() = 0;
+
+    /**
+     * @brief Puts a finished image into effect once every part of the update is finished.
+     *
+     * Components of an update are finished before the app, which is activated last. A component whose image takes
+     * effect right away, e.g. the anchors of a CertificateStore, waits for this call, so it is not used while the
+     * update can still fail.
+     */
+    virtual void commitInstall()
+    {
+    }
+
+    /**
+     * @brief Gets the number of image bytes committed to storage.
+     * @return The number of bytes.
+     */
+    virtual uint32_t getCommitted() const = 0;
+
+    /**
+     * @brief Gets the CRC32 of the committed bytes.
+     * @return The CRC32.
+     */
+    virtual uint32_t getCommittedCrc() const = 0;
+
+    /**
+     * @brief Gets the first FIRMWARE_SINK_HEAD_SIZE bytes of the image, valid once data is committed.
+     * @return The bytes.
+     */
+    virtual const uint8_t *getHead() const = 0;
+
+    /**
+     * @brief Checks that the storage still contains the committed bytes of an earlier attempt.
+     * @param offset The number of committed bytes.
+     * @param crc The CRC32 of the committed bytes.
+     * @param head The first FIRMWARE_SINK_HEAD_SIZE bytes.
+     * @return True if the stored data matches the CRC, false otherwise.
+     */
+    virtual bool verify(uint32_t offset, uint32_t crc, const uint8_t *head) = 0;
+
+    /**
+     * @brief Gets the number of bytes which can be read back.
+     * @return The number of committed bytes.
+     */
+    uint32_t getSize() override
+    {
+        return getCommitted();
+    }
+};
+
+#endif // FIRMWARE_SINK_H_
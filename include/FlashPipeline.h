@@ -0,0 +1,167 @@
+#ifndef FLASH_PIPELINE_H_
+#define FLASH_PIPELINE_H_
+
+#include <Arduino.h>
+#include "FirmwareSink.h"
+
+/**
+ * @file FlashPipeline.h
+ * @brief Contains the declaration of the FlashPipeline class.
+ */
+
+#ifndef ESP32_OTA_UPDATER_PIPELINE_BUFFERS
+#define ESP32_OTA_UPDATER_PIPELINE_BUFFERS 4 /**< Default number of buffers in the ring between download and flash, 0 writes synchronously. */
+#endif
+#ifndef ESP32_OTA_UPDATER_PIPELINE_BUFFER_SIZE
+#define ESP32_OTA_UPDATER_PIPELINE_BUFFER_SIZE 4096 /**< Default size of each buffer in the ring. */
+#endif
+#ifndef ESP32_OTA_UPDATER_PIPELINE_ERASE_AHEAD
+#define ESP32_OTA_UPDATER_PIPELINE_ERASE_AHEAD 4 /**< Number of sectors the flash writer erases ahead of the write position while it waits. */
+#endif
+#ifndef ESP32_OTA_UPDATER_PIPELINE_WRITE_TIMEOUT
+#define ESP32_OTA_UPDATER_PIPELINE_WRITE_TIMEOUT 5000UL /**< Time in ms write() and flush() wait for the flash writer before they fail. */
+#endif
+#ifndef ESP32_OTA_UPDATER_PIPELINE_TASK_STACK_SIZE
+#define ESP32_OTA_UPDATER_PIPELINE_TASK_STACK_SIZE 3072 /**< Stack size of the flash writer task. */
+#endif
+
+/**
+ * @brief Counters of the stages of the FlashPipeline, showing which side limits the install speed.
+ *
+ * Reader stalls mean the flash is the bottleneck (all buffers were waiting to be written), writer stalls mean the
+ * download is the bottleneck (the flash writer had nothing to write and nothing left to erase).
+ */
+struct FlashPipelineStats
+{
+    uint32_t reader_stalls;        /**< Number of times the download waited for a free buffer. */
+    uint32_t reader_stall_ms;      /**< Total time the download waited for a free buffer. */
+    uint32_t writer_stalls;        /**< Number of times the flash writer waited for data. */
+    uint32_t writer_stall_ms;      /**< Total time the flash writer waited for data. */
+    uint32_t sectors_erased_ahead; /**< Number of sectors erased before they were written. */
+    uint32_t flash_us;             /**< Total time spent in the firmware sink erasing and writing, in microseconds. */
+    uint32_t bytes_written;        /**< Bytes passed to write(), including the last partial sector. */
+};
+
+/**
+ * @class FlashPipeline
+ * @brief Decouples the download from the flash writes with a ring of buffers and a writer task on the other core.
+ *
+ * The download (network, TLS and decoding) fills the buffers while the writer task drains them into the
+ * FirmwareSink and uses idle time to erase the next sectors, so TLS decryption and flash erases overlap.
+ * On single core chips, with 0 buffers or if the buffers can not be allocated, data is written synchronously.
+ * The buffers are allocated in begin() unless storage was provided with setStorage().
+ */
+class FlashPipeline : public ByteSink
+{
+public:
+    /**
+     * @brief Starts the pipeline and the writer task.
+     * @param writer The firmware sink, already begun. It must not be used directly until end().
+     * @param buffer_count The number of buffers in the ring, 0 to write synchronously.
+     * @param buffer_size The size of each buffer.
+     */
+    void begin(FirmwareSink *writer, uint8_t buffer_count, size_t buffer_size);
+
+    /**
+     * @brief Provides the memory of the buffers, so begin() does not allocate them.
+     * @param storage The memory, it has to stay valid while the pipeline is used. NULL to allocate the buffers.
+     * @param capacity The size of storage, rings which do not fit into it are allocated.
+     */
+    void setStorage(uint8_t *storage, size_t capacity);
+    /**
+     * @brief Passes data to the flash writer, waits for a free buffer if all are full.
+     * @param data The data.
+     * @param length The length of the data.
+     * @return True if the data was taken, false if the firmware sink failed or no buffer was freed within
+     *         ESP32_OTA_UPDATER_PIPELINE_WRITE_TIMEOUT, e.g. because the flash hangs.
+     */
+    bool write(const uint8_t *data, size_t length) override;
+
+    /**
+     * @brief Tells whether write() takes data without waiting for the flash writer, for callers which must not block.
+     *
+     * The time until the buffers have room again counts as a download stall. If they stay full for
+     * ESP32_OTA_UPDATER_PIPELINE_WRITE_TIMEOUT, the pipeline fails like a write() which timed out.
+     *
+     * @param length The length of the data.
+     * @return True if the buffers have room for length bytes, writes are synchronous or the pipeline failed.
+     */
+    bool canWrite(size_t length);
+
+    /**
+     * @brief Waits until all data passed to write() is written to the firmware sink.
+     * @return True if all data was written, false if the firmware sink failed or did not finish within
+     *         ESP32_OTA_UPDATER_PIPELINE_WRITE_TIMEOUT.
+     */
+    bool flush();
+
+    /**
+     * @brief Stops the writer task and releases the buffers, data which is not written yet is discarded.
+     *
+     * A writer task which does not stop within ESP32_OTA_UPDATER_PIPELINE_WRITE_TIMEOUT is deleted.
+     */
+    void end();
+
+    /**
+     * @brief Checks if the writer task is running.
+     * @return True if writes are pipelined, false if they are synchronous.
+     */
+    bool isPipelined() const
+    {
+        return task_handle != NULL;
+    }
+
+    /**
+     * @brief Gets a consistent snapshot of the committed data of the firmware sink.
+     * @param committed Out: the number of committed bytes.
+     * @param crc Out: the CRC32 of the committed bytes.
+     */
+    void getCommitted(uint32_t *committed, uint32_t *crc);
+
+    /**
+     * @brief Gets the stall counters of the current or last pipelined write.
+     * @return The counters.
+     */
+    const FlashPipelineStats &getStats() const
+    {
+        return stats;
+    }
+
+private:
+    struct Block
+    {
+        uint8_t *data; /**< NULL for a control block acknowledged through the done semaphore. */
+        size_t length;
+    };
+
+    FirmwareSink *writer = nullptr;
+    uint8_t *buffers = nullptr;
+    uint8_t *storage = nullptr;  /**< Memory of the caller for the buffers, NULL to allocate them. */
+    size_t storage_capacity = 0;
+    size_t buffer_size = 0;
+    uint8_t *current = nullptr;
+    size_t current_length = 0;
+
+    TaskHandle_t task_handle = NULL;
+    QueueHandle_t free_queue = NULL;
+    QueueHandle_t full_queue = NULL;
+    SemaphoreHandle_t done = NULL;
+    volatile bool failed = false;
+    volatile bool discard = false;
+    volatile bool stopping = false;
+    bool writer_hung = false; /**< True if the writer task did not answer in time, end() deletes it then. */
+    bool waiting = false;            /**< True while canWrite() reports full buffers. */
+    unsigned long waiting_since = 0; /**< Time canWrite() first reported full buffers. */
+
+    portMUX_TYPE snapshot_lock = portMUX_INITIALIZER_UNLOCKED;
+    uint32_t committed = 0;
+    uint32_t committed_crc = 0;
+    FlashPipelineStats stats;
+
+    void sendCurrent();
+    bool sendControl();
+    void writeBlock(const Block &block);
+    static void writerTask(void *parameter);
+};
+
+#endif // FLASH_PIPELINE_H_
@@ -0,0 +1,156 @@
+#ifndef HTTP_TRANSPORT_H_
+#define HTTP_TRANSPORT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * @file HttpTransport.h
+ * @brief Contains the declaration of the HttpTransport interface the updater uses for all requests.
+ */
+
+/**
+ * @brief HTTP status codes the updater handles.
+ */
+enum HttpStatus : int
+{
+    HTTP_STATUS_OK = 200,
+    HTTP_STATUS_PARTIAL_CONTENT = 206,
+    HTTP_STATUS_NOT_MODIFIED = 304,
+    HTTP_STATUS_NOT_FOUND = 404
+};
+
+/**
+ * @brief Timing of the last request, to tell connection setup from server response time.
+ */
+struct HttpRequestTiming
+{
+    uint32_t dns_ms;     /**< Time to resolve the host names of new connections. */
+    uint32_t connect_ms; /**< Time to open new connections, including the TLS handshake. */
+    uint32_t ttfb_ms;    /**< Time from sending the request to receiving the response headers, over all redirects. */
+    uint8_t redirects;   /**< Number of redirects followed. */
+    uint8_t retries;     /**< Number of times the request was sent again because a kept-alive connection was closed. */
+    bool reused;         /**< True if the final response was received over a kept-alive connection. */
+};
+
+/**
+ * @class HttpTransport
+ * @brief A single HTTP(S) request at a time, with request headers and a streamed response body.
+ *
+ * The default implementation on the ESP32 is Esp32HttpTransport (WiFiClientSecure and HTTPClient). Implementations
+ * follow redirects, decode the transfer encoding and configure TLS, timeouts and the user agent themselves, and
+ * should keep connections alive between requests. On other platforms a stand-in can be passed to the updater, e.g.
+ * to run the update logic on a host.
+ */
+class HttpTransport
+{
+public:
+    virtual ~HttpTransport() {}
+
+    /**
+     * @brief Prepares a request, headers are added afterwards.
+     * @param url The URL to request.
+     * @return True on success, false if the URL can not be used.
+     */
+    virtual bool begin(const char *url) = 0;
+
+    /**
+     * @brief Adds a request header.
+     * @param name The header name.
+     * @param value The header value.
+     */
+    virtual void addHeader(const char *name, const char *value) = 0;
+
+    /**
+     * @brief Sends the token as bearer authorization with the request.
+     * @param token The token.
+     */
+    virtual void setAuthorization(const char *token) = 0;
+
+    /**
+     * @brief Sets the response headers which are kept for getHeader().
+     * @param names The header names.
+     * @param count The number of header names.
+     */
+    virtual void collectHeaders(const char *names[], size_t count) = 0;
+
+    /**
+     * @brief Sends the request and receives the response headers.
+     * @return The HTTP status code, or a negative value if no response was received.
+     */
+    virtual int GET() = 0;
+
+    /**
+     * @brief Sends the request as POST with a body and receives the response headers, redirects are not followed.
+     *
+     * Only used for queries which are answered by the requested host itself, e.g. the GitHub GraphQL API.
+     *
+     * @param body The request body, e.g. a JSON document (the Content-Type is added with addHeader()).
+     * @param length The length of the body.
+     * @return The HTTP status code, or a negative value if no response was received or the transport only supports GET.
+     */
+    virtual int POST(const uint8_t *body, size_t length)
+    {
+        return -1;
+    }
+
+    /**
+     * @brief Gets the length of the response body.
+     * @return The length, -1 if unknown (chunked transfer encoding), the body then ends when connected() turns false.
+     */
+    virtual int getSize() = 0;
+
+    /**
+     * @brief Gets a collected response header.
+     * @param name The header name.
+     * @param value Out: the zero terminated value, empty if the header was not received or does not fit.
+     * @param capacity The capacity of value.
+     */
+    virtual void getHeader(const char *name, char *value, size_t capacity) = 0;
+
+    /**
+     * @brief Gets the number of body bytes which can be read without waiting.
+     * @return The number of bytes.
+     */
+    virtual int available() = 0;
+
+    /**
+     * @brief Checks if more body data can be received.
+     * @return True if the body is not complete and the connection is open, false otherwise.
+     */
+    virtual bool connected() = 0;
+
+    /**
+     * @brief Reads body bytes, waits until the buffer is filled, the connection is closed or the timeout expires.
+     * @param buffer The buffer to read into.
+     * @param size The number of bytes to read.
+     * @return The number of bytes read.
+     */
+    virtual size_t read(uint8_t *buffer, size_t size) = 0;
+
+    /**
+     * @brief Ends the request, the connection is kept for the next request to the same host if possible.
+     */
+    virtual void end() = 0;
+
+    /**
+     * @brief Gets the number of connections (TLS handshakes) opened so far, to see how many requests reused one.
+     * @return The number of connections, 0 if the transport does not count them.
+     */
+    virtual uint32_t getHandshakeCount() const
+    {
+        return 0;
+    }
+
+    /**
+     * @brief Gets the timing of the last request sent with GET() or POST().
+     * @param timing Out: the timing, all zero if the transport does not measure it.
+     */
+    virtual void getTiming(HttpRequestTiming *timing) const
+    {
+        memset(timing, 0, sizeof(*timing));
+    }
+};
+
+#endif // HTTP_TRANSPORT_H_
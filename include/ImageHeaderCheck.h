@@ -0,0 +1,138 @@
+#ifndef IMAGE_HEADER_CHECK_H_
+#define IMAGE_HEADER_CHECK_H_
+
+#include "ByteStream.h"
+#include "SemanticVersion.h"
+
+/**
+ * @file ImageHeaderCheck.h
+ * @brief Contains the declaration of the ImageHeaderCheck class.
+ */
+
+#define IMAGE_HEADER_MAGIC 0xE9                /**< First byte of every ESP app image (esp_image_header_t). */
+#define IMAGE_HEADER_SIZE 24                   /**< Size of esp_image_header_t. */
+#define IMAGE_SEGMENT_HEADER_SIZE 8            /**< Size of esp_image_segment_header_t. */
+#define IMAGE_MAX_SEGMENTS 16                  /**< ESP_IMAGE_MAX_SEGMENTS of the bootloader. */
+#define IMAGE_APP_DESC_MAGIC 0xABCD5432        /**< Magic word of esp_app_desc_t. */
+#define IMAGE_APP_DESC_OFFSET (IMAGE_HEADER_SIZE + IMAGE_SEGMENT_HEADER_SIZE) /**< esp_app_desc_t starts the first segment. */
+#define IMAGE_APP_DESC_STRING_SIZE 32          /**< Size of the version and project name fields of esp_app_desc_t. */
+#define IMAGE_HEADER_CHECK_SIZE (IMAGE_APP_DESC_OFFSET + 16 + 2 * IMAGE_APP_DESC_STRING_SIZE) /**< Bytes up to the project name. */
+
+/**
+ * @brief The fields of an app image header which tell what the image was built for.
+ */
+struct ImageHeaderInfo
+{
+    uint16_t chip_id;                                /**< esp_chip_id_t of the target, e.g. 0 for the ESP32, 9 for the ESP32-S3. */
+    uint8_t flash_size;                              /**< esp_image_flash_size_t, 0 for 1 MB up to 7 for 128 MB. */
+    uint8_t segment_count;                           /**< Number of segments. */
+    char version[IMAGE_APP_DESC_STRING_SIZE + 1];      /**< The embedded version (PROJECT_VER). */
+    char project_name[IMAGE_APP_DESC_STRING_SIZE + 1]; /**< The embedded project name. */
+};
+
+/**
+ * @class ImageHeaderCheck
+ * @brief Stage of the install chain which rejects an image for another device from its first bytes.
+ *
+ * An asset for another chip, flash size or project, or one which is no app image at all, would otherwise only be
+ * detected when the bootloader refuses it, after the whole image was downloaded and written. The stage holds back the
+ * first IMAGE_HEADER_CHECK_SIZE bytes of the decoded image (the image header, the first segment header and the start
+ * of esp_app_desc_t) and only passes them on once they match: the magic bytes and the segment count always, the chip,
+ * the flash size and the project name of the reference (usually the running image) and, if set, a minimum version.
+ * Nothing reaches the flash before, so a rejected image costs a few hundred downloaded bytes and no flash erase.
+ */
+class ImageHeaderCheck : public ByteSink
+{
+public:
+    /**
+     * @brief Outcome of the check.
+     */
+    enum Result : uint8_t
+    {
+        PENDING = 0,      /**< Not enough bytes received yet. */
+        VALID,            /**< The header matches, the image is passed on. */
+        NOT_AN_IMAGE,     /**< Wrong magic bytes, segment count or no app description. */
+        WRONG_CHIP,       /**< The image was built for another chip. */
+        WRONG_FLASH_SIZE, /**< The image expects more flash than the reference. */
+        WRONG_PROJECT,    /**< The image belongs to another project. */
+        WRONG_VERSION,    /**< The embedded version is not a semantic version newer than the minimum. */
+        TRUNCATED         /**< The image ended before the header was complete. */
+    };
+
+    /**
+     * @brief Parses the header of an app image.
+     * @param head The first bytes of the image.
+     * @param length The number of bytes, at least IMAGE_HEADER_CHECK_SIZE.
+     * @param info Receives the fields of the header.
+     * @return True if the bytes are the header of an app image, false otherwise.
+     */
+    static bool parse(const uint8_t *head, size_t length, ImageHeaderInfo *info);
+
+    /**
+     * @brief Sets the image whose chip, flash size and project the checked image has to match.
+     * @param reference The header of the reference, e.g. of the running image, NULL to only check the structure.
+     */
+    void setReference(const ImageHeaderInfo *reference);
+
+    /**
+     * @brief Requires the embedded version to be a semantic version newer than the given one.
+     * @param minimum The version, e.g. the running version, NULL to not check the version (default).
+     */
+    void setMinimumVersion(const Version *minimum)
+    {
+        minimum_version = minimum;
+    }
+
+    /**
+     * @brief Starts checking a new image.
+     * @param next The stage the image is passed on to once the header matches.
+     */
+    void begin(ByteSink *next);
+    bool write(const uint8_t *data, size_t length) override;
+
+    /**
+     * @brief Ends the image, an image shorter than the held back header never reached the next stage.
+     * @return True if the header was checked and passed on, false otherwise (the result is then TRUNCATED if the
+     *         image ended early).
+     */
+    bool finish();
+
+    /**
+     * @brief Gets the outcome of the check.
+     * @return The result, a write fails with a result after VALID.
+     */
+    Result getResult() const
+    {
+        return result;
+    }
+
+    /**
+     * @brief Gets the header of the checked image.
+     * @return The fields, valid once the result is not PENDING or NOT_AN_IMAGE.
+     */
+    const ImageHeaderInfo &getInfo() const
+    {
+        return info;
+    }
+
+    /**
+     * @brief Describes a result for the log.
+     * @param result The result.
+     * @return A constant description.
+     */
+    static const char *describe(Result result);
+
+private:
+    ByteSink *next = nullptr;
+    uint8_t head[IMAGE_HEADER_CHECK_SIZE];
+    size_t head_length = 0;
+    Result result = PENDING;
+    ImageHeaderInfo info = {};
+    ImageHeaderInfo reference = {};
+    bool has_reference = false;
+    const Version *minimum_version = nullptr;
+
+    Result check();
+};
+
+#endif // IMAGE_HEADER_CHECK_H_
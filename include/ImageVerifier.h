@@ -0,0 +1,120 @@
+#ifndef IMAGE_VERIFIER_H_
+#define IMAGE_VERIFIER_H_
+
+#include <mbedtls/pk.h>
+#include <mbedtls/sha256.h>
+
+#include "ByteStream.h"
+
+/**
+ * @file ImageVerifier.h
+ * @brief Contains the declaration of the ImageVerifier class.
+ */
+
+#define IMAGE_VERIFIER_DIGEST_SIZE 32 /**< Size of a SHA-256 digest. */
+#ifndef ESP32_OTA_UPDATER_MAX_SIGNATURE_SIZE
+#define ESP32_OTA_UPDATER_MAX_SIGNATURE_SIZE 512 /**< Maximum size of a DER encoded signature (RSA-4096, ECDSA needs at most 72 bytes for P-256). */
+#endif
+
+/**
+ * @class ImageVerifier
+ * @brief Stage of the install chain which hashes the image with SHA-256 while it passes on to the flash.
+ *
+ * The hash is computed over every chunk on its way to the flash, so the image is never read back for verification.
+ * On the ESP32 mbedtls uses the SHA hardware accelerator. The expected digest and an optional signature are loaded
+ * from the signature asset of the release: the raw 32 byte SHA-256 of the image followed by the DER encoded
+ * signature of that digest (ECDSA or RSA, depending on the public key), e.g. created with
+ * `openssl dgst -sha256 -binary firmware.bin > firmware.sig && openssl dgst -sha256 -sign key.pem firmware.bin >> firmware.sig`.
+ */
+class ImageVerifier : public ByteSink
+{
+public:
+    ImageVerifier();
+    ~ImageVerifier();
+
+    /**
+     * @brief Starts hashing a new image.
+     * @param next The stage the image is passed on to.
+     */
+    void begin(ByteSink *next);
+    bool write(const uint8_t *data, size_t length) override;
+
+    /**
+     * @brief Hashes bytes without passing them on, e.g. an asset before it is decrypted and decompressed.
+     * @param data The bytes.
+     * @param length The number of bytes.
+     */
+    void hash(const uint8_t *data, size_t length);
+
+    /**
+     * @brief Hashes image bytes which were written by an earlier attempt and are not streamed again.
+     * @param source The stored image, e.g. the firmware sink of a resumed download.
+     * @param length The number of bytes to hash from the beginning of the source.
+     * @return True if all bytes were read, false otherwise.
+     */
+    bool hashStored(ByteSource *source, uint32_t length);
+
+    /**
+     * @brief Loads the expected digest and signature.
+     * @param data The content of the signature asset, the digest followed by the signature (if any).
+     * @param length The length of the content.
+     * @return True if the content contains at least a digest and fits into the buffers, false otherwise.
+     */
+    bool setExpected(const uint8_t *data, size_t length);
+
+    /**
+     * @brief Checks if an expected digest was loaded.
+     * @return True if the image can be verified, false otherwise.
+     */
+    bool hasExpected() const
+    {
+        return expected_loaded;
+    }
+
+    /**
+     * @brief Gets the expected digest, e.g. to identify the verified image.
+     * @return The SHA-256 digest, valid if hasExpected() is true.
+     */
+    const uint8_t *getExpectedDigest() const
+    {
+        return expected_digest;
+    }
+
+    /**
+     * @brief Finishes the hash and compares it with the expected digest and, with a public key, the signature.
+     * @param public_key The PEM encoded public key the signature is checked with, NULL to only check the digest.
+     * @return True if the image matches, false otherwise.
+     */
+    bool verify(const char *public_key);
+
+    /**
+     * @brief Gets the number of bytes hashed so far.
+     * @return The number of bytes.
+     */
+    uint32_t getBytesHashed() const
+    {
+        return bytes_hashed;
+    }
+
+    /**
+     * @brief Gets the time spent in SHA-256 and signature operations, to measure the cost of verification.
+     * @return The time in microseconds.
+     */
+    uint32_t getHashTime() const
+    {
+        return hash_time_us;
+    }
+
+private:
+    mbedtls_sha256_context sha256;
+    ByteSink *next = nullptr;
+    uint32_t bytes_hashed = 0;
+    uint32_t hash_time_us = 0;
+
+    bool expected_loaded = false;
+    uint8_t expected_digest[IMAGE_VERIFIER_DIGEST_SIZE];
+    uint8_t signature[ESP32_OTA_UPDATER_MAX_SIGNATURE_SIZE];
+    size_t signature_length = 0;
+};
+
+#endif // IMAGE_VERIFIER_H_
@@ -0,0 +1,178 @@
+#ifndef JSON_STREAM_SCANNER_H_
+#define JSON_STREAM_SCANNER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @file JsonStreamScanner.h
+ * @brief Contains the declaration of the JsonStreamScanner class.
+ */
+
+#ifndef JSON_STREAM_SCANNER_KEY_LENGTH
+#define JSON_STREAM_SCANNER_KEY_LENGTH 32 /**< Capacity of the buffer holding the current object key. */
+#endif
+#define JSON_STREAM_SCANNER_MAX_DEPTH 32 /**< Maximum nesting depth, one bit per level is used to track arrays. */
+
+/**
+ * @class JsonStreamScanner
+ * @brief Event based JSON scanner which is fed with arbitrary chunks of a document.
+ *
+ * The scanner does not build a document tree and does not allocate any memory. Subclasses receive events for
+ * containers and values and decide which values they want to capture by returning a buffer from `onValueBegin()`.
+ * Everything else is skipped while it streams by, so the memory used is constant regardless of the document size.
+ */
+class JsonStreamScanner
+{
+public:
+    /**
+     * @brief State of the scanner after a call to `feed()`.
+     */
+    enum Status : uint8_t
+    {
+        SCANNING = 0, /**< More input is required. */
+        FINISHED,     /**< The root value was completely scanned. */
+        STOPPED,      /**< A subclass called `stop()` because it found everything it was looking for. */
+        FAILED        /**< The input is not valid JSON or nested too deeply. */
+    };
+
+    /**
+     * @brief Type of a scalar value.
+     */
+    enum ValueType : uint8_t
+    {
+        STRING = 0,
+        NUMBER,
+        BOOLEAN,
+        NULL_VALUE
+    };
+
+    virtual ~JsonStreamScanner() {}
+
+    /**
+     * @brief Resets the scanner to scan a new document.
+     */
+    void reset();
+
+    /**
+     * @brief Scans the next chunk of the document.
+     * @param data The chunk of the document.
+     * @param length The length of the chunk.
+     * @return The number of bytes consumed, less than length if the scanner stopped or failed.
+     */
+    size_t feed(const uint8_t *data, size_t length);
+
+    /**
+     * @brief Gets the state of the scanner.
+     * @return The state of the scanner.
+     */
+    Status getStatus() const
+    {
+        return status;
+    }
+
+protected:
+    /**
+     * @brief Gets the number of containers enclosing the current position.
+     * @return The nesting depth, 1 inside the root object or array.
+     */
+    uint8_t getDepth() const
+    {
+        return depth;
+    }
+
+    /**
+     * @brief Gets the key of the current object member. Only valid in value and container begin events.
+     * @return The key, or an empty string inside of arrays and for keys longer than the key buffer.
+     */
+    const char *getKey() const
+    {
+        return key;
+    }
+
+    /**
+     * @brief Checks if the key of the current object member equals the given key.
+     * @param other The key to compare with.
+     * @return True if the keys are equal, false otherwise.
+     */
+    bool keyIs(const char *other) const;
+
+    /**
+     * @brief Called after an object or array was opened, getDepth() already includes the new container.
+     * @param is_array True for arrays, false for objects.
+     */
+    virtual void onContainerBegin(bool is_array) {}
+
+    /**
+     * @brief Called when an object or array is closed, getDepth() still includes the closed container.
+     * @param is_array True for arrays, false for objects.
+     */
+    virtual void onContainerEnd(bool is_array) {}
+
+    /**
+     * @brief Called at the start of a scalar value, return a buffer to capture it.
+     * @param type The type of the value.
+     * @param capacity Out: the capacity of the returned buffer including the terminating zero.
+     * @return The buffer the value is captured into, or NULL to skip the value.
+     */
+    virtual char *onValueBegin(ValueType type, size_t *capacity) { return NULL; }
+
+    /**
+     * @brief Called at the end of a scalar value that was captured.
+     * @param type The type of the value.
+     * @param value The zero terminated value (unescaped for strings).
+     * @param length The length of the value.
+     * @param truncated True if the value did not fit into the buffer.
+     */
+    virtual void onValueEnd(ValueType type, const char *value, size_t length, bool truncated) {}
+
+    /**
+     * @brief Stops scanning, `feed()` returns immediately with the status STOPPED.
+     */
+    void stop();
+
+    /**
+     * @brief Aborts scanning with the status FAILED, e.g. because a required value is too long.
+     */
+    void fail();
+
+private:
+    enum State : uint8_t
+    {
+        EXPECT_VALUE = 0,
+        EXPECT_KEY,
+        EXPECT_COLON,
+        EXPECT_SEPARATOR,
+        IN_STRING,
+        IN_STRING_ESCAPE,
+        IN_STRING_UNICODE,
+        IN_SCALAR
+    };
+
+    Status status;
+    State state;
+    uint8_t depth;
+    uint32_t array_bits; /**< Bit n is set if the container at depth n + 1 is an array. */
+    bool string_is_key;
+    uint8_t unicode_digits;
+
+    char key[JSON_STREAM_SCANNER_KEY_LENGTH];
+    uint8_t key_length;
+    bool key_truncated;
+
+    char *value_buffer;
+    size_t value_capacity;
+    size_t value_length;
+    bool value_truncated;
+    ValueType value_type;
+
+    bool inArray() const;
+    bool beginContainer(bool is_array);
+    bool endContainer(bool is_array);
+    void beginValue(ValueType type);
+    void appendChar(char c);
+    void endValue();
+    void afterValue();
+};
+
+#endif // JSON_STREAM_SCANNER_H_
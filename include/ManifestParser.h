@@ -0,0 +1,156 @@
+#ifndef MANIFEST_PARSER_H_
+#define MANIFEST_PARSER_H_
+
+#include "ESP32_OTA_Updater_Config.h"
+#include "ReleaseParser.h"
+
+/**
+ * @file ManifestParser.h
+ * @brief Contains the declaration of the ManifestParser class.
+ */
+
+#define MANIFEST_MAGIC "OTAM"
+#define MANIFEST_VERSION 1
+#define MANIFEST_HEADER_SIZE 8
+#define MANIFEST_FLAG_DIGEST 0x01 /**< Asset flag: a SHA-256 digest of the asset follows its size. */
+
+/**
+ * @class ManifestParser
+ * @brief Extracts the tag and the requested assets from a binary release manifest while it is streamed.
+ *
+ * The manifest is a small asset of the release (e.g. "manifest.bin", created by tools/ota_manifest.py) which replaces
+ * the release JSON of the GitHub API. It starts with a header (magic "OTAM", format version, rollout percentage,
+ * number of assets, 1 reserved byte) followed by the tag (1 byte length, then the characters) and the assets, each
+ * as name (1 byte length, then the characters), little endian size, flags and, with MANIFEST_FLAG_DIGEST, the
+ * SHA-256 of the asset. A little endian CRC32 of all previous bytes ends the manifest.
+ *
+ * The name of an asset also carries its compression and, for delta patches, the version it applies to, like the
+ * asset names of a GitHub release. The download URL of an asset is the stable release download URL
+ * "<download_base>/<tag>/<name>", so the manifest does not repeat it. The parser works on the received chunks
+ * directly: the tag and digests are written straight to their destination, only asset names are collected (to be
+ * matched) and integers. The result is only valid if the whole manifest was received and the CRC32 matches.
+ */
+class ManifestParser
+{
+public:
+    /**
+     * @brief The state of the parse.
+     */
+    enum Status : uint8_t
+    {
+        SCANNING = 0, /**< More input is required. */
+        FINISHED,     /**< The manifest was received completely and is valid. */
+        FAILED        /**< The manifest is malformed, of an unknown version or a value does not fit into its buffer. */
+    };
+
+    /**
+     * @brief Prepares the parser for a new manifest, all previously added assets are removed.
+     * @param download_base The URL the asset URLs are built from, e.g. "https://github.com/owner/repo/releases/download".
+     *                      It has to stay valid until the parse is complete.
+     */
+    void begin(const char *download_base);
+
+    /**
+     * @brief Adds an asset to look for, the asset is reset and filled in while parsing.
+     * @param asset The asset, it has to stay valid until the parse is complete.
+     * @return True if the asset was added, false if ESP32_OTA_UPDATER_MAX_ASSETS is reached.
+     */
+    bool addAsset(ReleaseAsset *asset);
+
+    /**
+     * @brief Parses the next chunk of the manifest.
+     * @param data The chunk.
+     * @param length The length of the chunk.
+     */
+    void feed(const uint8_t *data, size_t length);
+
+    /**
+     * @brief Gets the state of the parse.
+     * @return The status.
+     */
+    Status getStatus() const
+    {
+        return status;
+    }
+
+    /**
+     * @brief Checks if the tag of the release was found.
+     * @return True if the tag was found, false otherwise.
+     */
+    bool hasTag() const
+    {
+        return tag_found;
+    }
+
+    /**
+     * @brief Gets the tag of the release.
+     * @return The tag, an empty string if it was not found.
+     */
+    const char *getTag() const
+    {
+        return tag_found ? tag : "";
+    }
+
+    /**
+     * @brief Gets the percentage of devices the release is rolled out to.
+     * @return The percentage.
+     */
+    uint8_t getRolloutPercent() const
+    {
+        return rollout_percent;
+    }
+
+    /**
+     * @brief Checks if the parse failed because a required value does not fit into its buffer.
+     * @return True if a required value is too long, false otherwise.
+     */
+    bool isValueTooLong() const
+    {
+        return value_too_long;
+    }
+
+private:
+    enum Field : uint8_t
+    {
+        FIELD_HEADER = 0,
+        FIELD_TAG_LENGTH,
+        FIELD_TAG,
+        FIELD_NAME_LENGTH,
+        FIELD_NAME,
+        FIELD_SIZE,
+        FIELD_FLAGS,
+        FIELD_DIGEST,
+        FIELD_CRC
+    };
+
+    Status status;
+    Field field;
+    uint8_t field_length;                /**< Length of the field which is parsed. */
+    uint8_t field_received;              /**< Bytes of the field received so far. */
+    uint32_t crc;                        /**< CRC32 of the manifest up to the CRC field. */
+    uint8_t value[MANIFEST_HEADER_SIZE]; /**< The header or the little endian integer which is parsed. */
+    uint8_t remaining_assets;
+
+    const char *download_base;
+    char tag[ESP32_OTA_UPDATER_SHORTSTRING_LENGTH];
+    bool tag_found;
+    bool value_too_long;
+    uint8_t rollout_percent;
+
+    ReleaseAsset *assets[ESP32_OTA_UPDATER_MAX_ASSETS];
+    uint8_t asset_count;
+    char name[ESP32_OTA_UPDATER_SHORTSTRING_LENGTH]; /**< Name of the asset which is parsed. */
+    bool name_truncated; /**< True if the name does not fit into name, the asset can not be a requested one. */
+    ReleaseAsset *match; /**< The requested asset the current entry belongs to, NULL if it is not requested. */
+    uint32_t asset_size;
+
+    size_t consume(const uint8_t *data, size_t length);
+    void beginField(Field next, uint8_t length);
+    void finishField();
+    void finishName();
+    void nextAsset();
+    void fail();
+    uint32_t littleEndian() const;
+};
+
+#endif // MANIFEST_PARSER_H_
@@ -0,0 +1,98 @@
+#ifndef PARTITION_WRITER_H_
+#define PARTITION_WRITER_H_
+
+#ifdef ARDUINO
+
+#include "FirmwareSink.h"
+#include <esp_partition.h>
+
+/**
+ * @file PartitionWriter.h
+ * @brief Contains the declaration of the ESP32 flash implementations PartitionWriter and RunningPartitionSource.
+ */
+
+/**
+ * @class PartitionWriter
+ * @brief Default FirmwareSink on the ESP32, writes an app image directly into the next OTA partition.
+ *
+ * With a partition label it writes a data partition instead, e.g. a LittleFS or SPIFFS image (like the U_SPIFFS
+ * target of the Update library). A data partition has no second slot, it is overwritten in place and finish()
+ * only writes the held back first bytes.
+ *
+ * Data is collected in a sector buffer, every full sector is erased and written at once. The first bytes of the
+ * image (containing the magic byte) are only written in finish(), so an interrupted image is never bootable. Unlike
+ * the Update library the writer can continue an image at a sector boundary that was committed by an earlier attempt,
+ * which is what resumable downloads are built on.
+ */
+class PartitionWriter : public FirmwareSink
+{
+public:
+    /**
+     * @brief Constructs the writer.
+     * @param label The label of the data partition to write, NULL for the next OTA app partition.
+     */
+    explicit PartitionWriter(const char *label = NULL) : label(label)
+    {
+    }
+
+    /**
+     * @brief Sets the partition to write.
+     * @param label The label of the data partition to write, NULL for the next OTA app partition.
+     */
+    void setPartition(const char *label)
+    {
+        this->label = label;
+    }
+
+    uint32_t getCapacity() override;
+    bool begin(uint32_t offset = 0, uint32_t crc = 0, const uint8_t *head = NULL) override;
+    bool write(const uint8_t *data, size_t length) override;
+    bool eraseAhead(uint32_t distance) override;
+    bool finish() override;
+    void abort() override;
+    bool verify(uint32_t offset, uint32_t crc, const uint8_t *head) override;
+    bool read(uint32_t offset, uint8_t *data, size_t length) override;
+
+    uint32_t getCommitted() const override
+    {
+        return committed;
+    }
+
+    uint32_t getCommittedCrc() const override
+    {
+        return committed_crc;
+    }
+
+    const uint8_t *getHead() const override
+    {
+        return head;
+    }
+
+private:
+    const char *label;
+    const esp_partition_t *partition = nullptr;
+    uint8_t *buffer = nullptr;
+    size_t buffer_length = 0;
+    uint32_t committed = 0;
+    uint32_t committed_crc = 0;
+    uint32_t erased_until = 0; /**< End of the sectors erased ahead of the committed data. */
+    uint8_t head[FIRMWARE_SINK_HEAD_SIZE];
+
+    bool flush();
+    const esp_partition_t *findPartition() const;
+};
+
+/**
+ * @class RunningPartitionSource
+ * @brief Default source of delta patches on the ESP32, the image of the running app partition.
+ */
+class RunningPartitionSource : public ByteSource
+{
+public:
+    bool read(uint32_t offset, uint8_t *data, size_t length) override;
+    uint32_t getSize() override;
+};
+
+#endif // ARDUINO
+
+#endif // PARTITION_WRITER_H_
@@ -0,0 +1,85 @@
+#ifndef PEER_NETWORK_H_
+#define PEER_NETWORK_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ByteStream.h"
+#include "ESP32_OTA_Updater_Config.h"
+
+/**
+ * @file PeerNetwork.h
+ * @brief Contains the declaration of the PeerNetwork interface devices share verified images through.
+ */
+
+#define PEER_IMAGE_DIGEST_SIZE 32 /**< Size of the SHA-256 digest an image is identified by. */
+
+/**
+ * @brief An image a device installed from a release and verified, identified by the release and its digest.
+ */
+struct PeerImage
+{
+    char tag[ESP32_OTA_UPDATER_SHORTSTRING_LENGTH]; /**< The tag of the release the image belongs to. */
+    uint8_t digest[PEER_IMAGE_DIGEST_SIZE];         /**< The SHA-256 of the image. */
+    uint32_t size;                                  /**< The size of the image in bytes. */
+
+    /**
+     * @brief Formats the digest as lower case hex, e.g. for the URL the image is served under.
+     * @param hex Out: the zero terminated digest, at least 2 * PEER_IMAGE_DIGEST_SIZE + 1 characters.
+     */
+    void formatDigest(char *hex) const;
+
+    /**
+     * @brief Parses a hex digest.
+     * @param hex The digest, exactly 2 * PEER_IMAGE_DIGEST_SIZE hex digits.
+     * @return True if the digest is valid, false otherwise (the digest is unchanged).
+     */
+    bool parseDigest(const char *hex);
+
+    /**
+     * @brief Checks if another image has the same release and digest.
+     * @param other The other image, its size is not compared.
+     * @return True if both are the same image.
+     */
+    bool matches(const PeerImage &other) const;
+};
+
+/**
+ * @class PeerNetwork
+ * @brief Shares installed images with other devices on the local network, so a release crosses the uplink once.
+ *
+ * A device offers the image it booted after verifying it. Devices about to install the same release look for a
+ * peer offering it before they download from GitHub and fetch it with their HttpTransport from the URL the network
+ * returns. The image from a peer is verified against the digest of the release like one from GitHub, so a peer
+ * can not inject an image, at worst the download falls back to GitHub. The default implementation on the ESP32 is
+ * Esp32PeerNetwork (UDP broadcast and a small HTTP server).
+ */
+class PeerNetwork
+{
+public:
+    virtual ~PeerNetwork() {}
+
+    /**
+     * @brief Offers an image to peers, replacing the previous offer.
+     * @param image The release, digest and size of the image.
+     * @param source The image, e.g. the running app partition, it has to stay valid.
+     */
+    virtual void offer(const PeerImage &image, ByteSource *source) = 0;
+
+    /**
+     * @brief Looks for a peer offering an image, waits at most ESP32_OTA_UPDATER_PEER_QUERY_TIMEOUT.
+     * @param image The tag and digest of the image, the size is filled in from the offer.
+     * @param url Out: the URL the image is downloaded from.
+     * @param capacity The capacity of url.
+     * @return True if a peer offers the image, false otherwise.
+     */
+    virtual bool find(PeerImage *image, char *url, size_t capacity) = 0;
+
+    /**
+     * @brief Answers discovery requests and serves a bounded slice of the image to a peer, call it regularly.
+     * @return True while a peer is served, handle() should then be called again right away.
+     */
+    virtual bool handle() = 0;
+};
+
+#endif // PEER_NETWORK_H_
@@ -0,0 +1,63 @@
+#ifndef RELEASE_CHANNEL_H_
+#define RELEASE_CHANNEL_H_
+
+#include <stdint.h>
+#include "SemanticVersion.h"
+
+/**
+ * @file ReleaseChannel.h
+ * @brief Contains the declaration of the ReleaseChannel class.
+ */
+
+#ifndef RELEASE_CHANNEL_LABEL_LENGTH
+#define RELEASE_CHANNEL_LABEL_LENGTH 16 /**< Capacity of the pre-release label of a channel, e.g. "beta". */
+#endif
+
+/**
+ * @class ReleaseChannel
+ * @brief Decides which releases a device installs, e.g. only stable ones or also betas of the same major version.
+ *
+ * A channel is described by a short specification of space separated terms:
+ * - "stable": only releases which are neither marked as pre-release on GitHub nor have a SemVer pre-release (default).
+ * - "prerelease": also every pre-release.
+ * - A label, e.g. "beta": also pre-releases whose first identifier is the label ("2.1.0-beta.3").
+ * - "^2" or "2.x": only versions with the major version 2.
+ * - "~2.3" or "2.3.x": only versions 2.3.*.
+ *
+ * E.g. "beta ^2" installs the highest 2.x release or 2.x beta. Drafts are never installed.
+ */
+class ReleaseChannel
+{
+public:
+    /**
+     * @brief Parses a channel specification.
+     * @param spec The specification, NULL or empty for "stable".
+     * @return True if the specification is valid, false otherwise (the channel is "stable" then).
+     */
+    bool parse(const char *spec);
+
+    /**
+     * @brief Checks if a release belongs to the channel.
+     * @param version The version of the release.
+     * @param marked_prerelease True if the release is marked as pre-release on GitHub.
+     * @return True if the release may be installed.
+     */
+    bool accepts(const Version &version, bool marked_prerelease) const;
+
+    /**
+     * @brief Tells whether the channel is the newest stable release, which GitHub serves as "/releases/latest".
+     * @return True if the latest release can be requested directly instead of scanning the releases list.
+     */
+    bool isLatest() const
+    {
+        return !prereleases && label[0] == '\0' && major < 0;
+    }
+
+private:
+    bool prereleases = false;                  /**< True to accept every pre-release. */
+    char label[RELEASE_CHANNEL_LABEL_LENGTH] = ""; /**< Pre-releases with this first identifier are accepted, empty for none. */
+    int32_t major = -1;                        /**< The required major version, -1 for any. */
+    int32_t minor = -1;                        /**< The required minor version, -1 for any. */
+};
+
+#endif // RELEASE_CHANNEL_H_
@@ -0,0 +1,209 @@
+#ifndef RELEASE_PARSER_H_
+#define RELEASE_PARSER_H_
+
+#include "ESP32_OTA_Updater_Config.h"
+#include "JsonStreamScanner.h"
+#include "ReleaseChannel.h"
+
+/**
+ * @file ReleaseParser.h
+ * @brief Contains the declaration of the ReleaseParser class.
+ */
+
+#define RELEASE_ASSET_DIGEST_SIZE 32 /**< Size of the SHA-256 digest GitHub publishes for every asset. */
+
+/**
+ * @struct ReleaseAsset
+ * @brief An asset which is looked up in a release, filled in by the ReleaseParser.
+ */
+struct ReleaseAsset
+{
+    const char *name;                              /**< The name of the asset to look for, '*' matches any sequence of characters. */
+    char url[ESP32_OTA_UPDATER_LONGSTRING_LENGTH]; /**< The API URL of the asset, valid if found is true. */
+    int32_t size;                                  /**< The size of the asset in bytes, valid if found is true. */
+    uint8_t digest[RELEASE_ASSET_DIGEST_SIZE];     /**< The SHA-256 of the asset ("digest"), valid if has_digest is true. */
+    bool has_digest;                               /**< True if the release lists a SHA-256 digest of the asset. */
+    bool found;                                    /**< True if the asset is part of the release. */
+};
+
+/**
+ * @class ReleaseParser
+ * @brief Extracts the tag and the requested assets from a GitHub release object while it is streamed.
+ *
+ * Only the tag and the name, url and size of the requested assets are kept, the memory used is fixed by the
+ * string capacities in ESP32_OTA_Updater_Config.h. The parser stops as soon as the tag and all requested assets
+ * were found, so the rest of the release (e.g. the release notes after the assets) does not have to be received.
+ * Values which are needed but do not fit into their buffer fail the parse instead of being truncated.
+ *
+ * The parser also scans pages of the releases list ("/releases") and keeps the highest release of a channel across
+ * the pages, again without storing the list. GitHub lists "tag_name", "draft" and "prerelease" before the assets,
+ * so the parser decides whether a release is the best so far when its assets begin and only then overwrites the
+ * assets of the previous best one. The list is ordered by creation date: once a release of the channel which is not
+ * newer than the running version is reached, the older releases are assumed to be older versions as well and the
+ * scan stops.
+ */
+class ReleaseParser : public JsonStreamScanner
+{
+public:
+    /**
+     * @brief Prepares the parser for a new release, all previously added assets are removed.
+     */
+    void begin();
+
+    /**
+     * @brief Prepares the parser for the first page of the releases list, all previously added assets are removed.
+     * @param channel The channel releases are selected by, it has to stay valid until the parse is complete.
+     * @param floor The running version, the scan stops at the first release of the channel which is not newer.
+     */
+    void beginList(const ReleaseChannel *channel, const Version *floor);
+
+    /**
+     * @brief Prepares the parser for the next page of the releases list, the best release so far and its assets are kept.
+     */
+    void nextPage();
+
+    /**
+     * @brief Gets the number of releases on the current page of the releases list.
+     * @return The number of releases, a page with less releases than requested is the last one.
+     */
+    uint8_t getReleaseCount() const
+    {
+        return release_count;
+    }
+
+    /**
+     * @brief Tells whether the scan of the releases list reached a release of the channel which is not newer than the running version.
+     * @return True if the remaining pages do not have to be requested.
+     */
+    bool isFloorReached() const
+    {
+        return floor_reached;
+    }
+
+    /**
+     * @brief Adds an asset to look for, the asset is reset and filled in while parsing.
+     * @param asset The asset, it has to stay valid until the parse is complete.
+     * @return True if the asset was added, false if ESP32_OTA_UPDATER_MAX_ASSETS is reached.
+     */
+    bool addAsset(ReleaseAsset *asset);
+
+    /**
+     * @brief Also reads the rollout percentage from the first line of the release notes ("Rollout: 25%").
+     *
+     * The release notes follow the assets, so the parse only stops once they were received.
+     */
+    void readRollout()
+    {
+        rollout_requested = true;
+    }
+
+    /**
+     * @brief Gets the percentage of devices the release is rolled out to.
+     * @return The percentage, 100 if the release notes do not start with a rollout line or were not read.
+     */
+    uint8_t getRolloutPercent() const
+    {
+        return rollout_percent;
+    }
+
+    /**
+     * @brief Checks if the tag of the release was found.
+     * @return True if the tag was found (for the releases list: a release of the channel was found), false otherwise.
+     */
+    bool hasTag() const
+    {
+        return tag_found;
+    }
+
+    /**
+     * @brief Gets the tag of the release.
+     * @return The tag, an empty string if it was not found.
+     */
+    const char *getTag() const
+    {
+        return tag_found ? tag : "";
+    }
+
+    /**
+     * @brief Checks if the parse failed because a required value does not fit into its buffer.
+     * @return True if a required value is too long, false otherwise.
+     */
+    bool isValueTooLong() const
+    {
+        return value_too_long;
+    }
+
+    /**
+     * @brief Matches an asset name against a pattern.
+     * @param pattern The pattern, '*' matches any sequence of characters.
+     * @param name The asset name.
+     * @return True if the name matches the pattern, false otherwise.
+     */
+    static bool matchName(const char *pattern, const char *name);
+
+protected:
+    void onContainerBegin(bool is_array) override;
+    void onContainerEnd(bool is_array) override;
+    char *onValueBegin(ValueType type, size_t *capacity) override;
+    void onValueEnd(ValueType type, const char *value, size_t length, bool truncated) override;
+
+private:
+    enum Field : uint8_t
+    {
+        FIELD_NONE = 0,
+        FIELD_TAG,
+        FIELD_NAME,
+        FIELD_URL,
+        FIELD_SIZE,
+        FIELD_DIGEST,
+        FIELD_BODY,
+        FIELD_DRAFT,
+        FIELD_PRERELEASE
+    };
+
+    char tag[ESP32_OTA_UPDATER_SHORTSTRING_LENGTH];
+    bool tag_found;
+    bool value_too_long;
+    bool rollout_requested;
+    bool body_found;
+    uint8_t rollout_percent;
+    char body_start[ESP32_OTA_UPDATER_ROLLOUT_LINE_LENGTH]; /**< Beginning of the release notes, the rest is skipped. */
+
+    const ReleaseChannel *channel; /**< The channel of the releases list, NULL while parsing a single release. */
+    const Version *floor;          /**< The running version, the list is scanned until a release of the channel is not newer. */
+    char release_tag[ESP32_OTA_UPDATER_SHORTSTRING_LENGTH]; /**< The tag of the release of the list which is parsed. */
+    char release_flag[8];          /**< "draft" or "prerelease" of the release of the list which is parsed. */
+    bool release_tag_found;
+    bool release_draft;
+    bool release_prerelease;
+    bool release_selected; /**< True if the release of the list which is parsed is the best so far, its assets are kept. */
+    uint8_t release_count;
+    bool floor_reached;
+
+    ReleaseAsset *assets[ESP32_OTA_UPDATER_MAX_ASSETS];
+    uint8_t asset_count;
+    uint8_t assets_found;
+    bool in_assets;       /**< True while inside of the "assets" array. */
+    bool assets_complete; /**< True once the "assets" array was closed. */
+    bool in_asset;        /**< True while inside of an asset object. */
+
+    Field field;
+    char candidate_name[ESP32_OTA_UPDATER_SHORTSTRING_LENGTH];
+    char candidate_url[ESP32_OTA_UPDATER_LONGSTRING_LENGTH];
+    char candidate_size[12];
+    char candidate_digest[8 + 2 * RELEASE_ASSET_DIGEST_SIZE]; /**< "sha256:" and the hex digest. */
+    bool candidate_name_truncated;
+    bool candidate_url_truncated;
+
+    uint8_t releaseDepth() const
+    {
+        return channel != NULL ? 2 : 1;
+    }
+    void beginRelease();
+    void selectRelease();
+    void finishAsset();
+    static bool parseDigest(const char *text, uint8_t *digest);
+    void checkComplete();
+};
+
+#endif // RELEASE_PARSER_H_
@@ -1,7 +1,8 @@
 #ifndef SEMANTIC_VERSION_H_
 #define SEMANTIC_VERSION_H_
 
-#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <string.h>
 
 /**
@@ -9,46 +10,171 @@
  * @brief Contains the declaration of the Version class.
  */
 
+#ifndef SEMANTIC_VERSION_LABEL_LENGTH
+#define SEMANTIC_VERSION_LABEL_LENGTH 32 /**< Buffer size of the pre-release and the build metadata together. */
+#endif
+
+#define SEMANTIC_VERSION_NUMBER_MAX 0x1FFFFF /**< Largest major, minor and patch number, each is packed into 21 bits. */
+
 /**
  * @class Version
- * @brief Represents a semantic version.
+ * @brief Represents a semantic version as specified by SemVer 2.0.0, e.g. "1.4.0-rc.2+build.17".
+ *
+ * Versions are ordered by their precedence: major, minor and patch are compared through one packed 64 bit key, the
+ * first pre-release identifier through a second one, and the remaining identifiers only if both keys are equal. Build
+ * metadata is ignored. A leading 'v' as used by tags is accepted. The parser does not allocate and `validate()` is
+ * `constexpr`, so a version given at build time can be checked with
+ * `static_assert(Version::validate(PROJ_GIT_TAG) == Version::NONE, "...")`.
  */
 class Version
 {
+public:
+    /**
+     * @brief Reason why a string is not a semantic version.
+     */
+    enum ParseError : uint8_t
+    {
+        NONE = 0,
+        EMPTY,             /**< The string is NULL or empty. */
+        MISSING_NUMBER,    /**< Major, minor or patch is missing, e.g. "1.2". */
+        LEADING_ZERO,      /**< A number or a numeric pre-release identifier has a leading zero, e.g. "1.02.0". */
+        NUMBER_TOO_LARGE,  /**< Major, minor or patch exceeds SEMANTIC_VERSION_NUMBER_MAX. */
+        EMPTY_IDENTIFIER,  /**< A pre-release or build identifier is empty, e.g. "1.0.0-rc..1". */
+        INVALID_CHARACTER, /**< A character other than [0-9A-Za-z-] in an identifier, or after the version. */
+        TOO_LONG           /**< The pre-release does not fit into SEMANTIC_VERSION_LABEL_LENGTH. */
+    };
+
 private:
-    int major; /**< The major version number. */
-    int minor; /**< The minor version number. */
-    int patch; /**< The patch version number. */
+    uint64_t key;                                    /**< Major, minor and patch, followed by one bit set if there is no pre-release. */
+    uint64_t pre_release_key;                        /**< Precedence of the first pre-release identifier, see packPreRelease(). */
+    char pre_release[SEMANTIC_VERSION_LABEL_LENGTH]; /**< The pre-release identifiers, e.g. "rc.2", followed by the build metadata. */
+    uint8_t build_offset;                            /**< Index of the build metadata in pre_release. */
+    ParseError error;                                /**< NONE if the version was parsed successfully. */
+
+    // The parser is written in the C++11 constexpr subset (one return statement, recursion instead of loops)
+    static constexpr bool isDigit(char c)
+    {
+        return c >= '0' && c <= '9';
+    }
+    static constexpr bool isIdentifierCharacter(char c)
+    {
+        return isDigit(c) || (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || c == '-';
+    }
+    static constexpr size_t skipPrefix(const char *text)
+    {
+        return text[0] == 'v' || text[0] == 'V' ? 1 : 0;
+    }
+    static constexpr size_t digitsEnd(const char *text, size_t i)
+    {
+        return isDigit(text[i]) ? digitsEnd(text, i + 1) : i;
+    }
+    static constexpr size_t identifierEnd(const char *text, size_t i)
+    {
+        return isIdentifierCharacter(text[i]) ? identifierEnd(text, i + 1) : i;
+    }
+    static constexpr uint32_t numberAt(const char *text, size_t i, size_t end, uint32_t value = 0)
+    {
+        // Saturates at SEMANTIC_VERSION_NUMBER_MAX + 1, so long numbers do not overflow
+        return value > SEMANTIC_VERSION_NUMBER_MAX ? SEMANTIC_VERSION_NUMBER_MAX + 1
+               : i == end ? value
+               : numberAt(text, i + 1, end, value * 10 + (text[i] - '0'));
+    }
+    static constexpr ParseError checkNumber(const char *text, size_t i, size_t end)
+    {
+        return end == i ? MISSING_NUMBER
+               : text[i] == '0' && end > i + 1 ? LEADING_ZERO
+               : numberAt(text, i, end) > SEMANTIC_VERSION_NUMBER_MAX ? NUMBER_TOO_LARGE
+               : NONE;
+    }
+    static constexpr ParseError checkIdentifiers(const char *text, size_t i, size_t end, bool is_pre_release, size_t start)
+    {
+        return end == i ? EMPTY_IDENTIFIER
+               : is_pre_release && text[i] == '0' && end > i + 1 && digitsEnd(text, i) == end ? LEADING_ZERO
+               : text[end] == '.' ? checkIdentifiers(text, end + 1, identifierEnd(text, end + 1), is_pre_release, start)
+               : is_pre_release && end - start >= SEMANTIC_VERSION_LABEL_LENGTH ? TOO_LONG
+               : is_pre_release && text[end] == '+' ? checkIdentifiers(text, end + 1, identifierEnd(text, end + 1), false, end + 1)
+               : text[end] == '\0' ? NONE
+               : INVALID_CHARACTER;
+    }
+    static constexpr ParseError checkCore(const char *text, size_t i, size_t end, uint8_t part)
+    {
+        return checkNumber(text, i, end) != NONE ? checkNumber(text, i, end)
+               : part < 2 ? (text[end] == '.' ? checkCore(text, end + 1, digitsEnd(text, end + 1), part + 1) : MISSING_NUMBER)
+               : text[end] == '-' ? checkIdentifiers(text, end + 1, identifierEnd(text, end + 1), true, end + 1)
+               : text[end] == '+' ? checkIdentifiers(text, end + 1, identifierEnd(text, end + 1), false, end + 1)
+               : text[end] == '\0' ? NONE
+               : INVALID_CHARACTER;
+    }
+    static constexpr uint64_t pack(uint32_t major, uint32_t minor, uint32_t patch, bool is_release)
+    {
+        return (uint64_t)(major & SEMANTIC_VERSION_NUMBER_MAX) << 43 | (uint64_t)(minor & SEMANTIC_VERSION_NUMBER_MAX) << 22 |
+               (uint64_t)(patch & SEMANTIC_VERSION_NUMBER_MAX) << 1 | (is_release ? 1 : 0);
+    }
+
+    static uint64_t packPreRelease(const char *pre_release);
+    int comparePreRelease(const Version &other) const;
 
 public:
+    /**
+     * @brief Checks whether a string is a semantic version, also at compile time.
+     * @param version The version, optionally prefixed with 'v'.
+     * @return NONE if the version is valid, the reason otherwise.
+     */
+    static constexpr ParseError validate(const char *version)
+    {
+        return version == NULL || version[0] == '\0' ? EMPTY : checkCore(version, skipPrefix(version), digitsEnd(version, skipPrefix(version)), 0);
+    }
+
+    /**
+     * @brief Describes a parse error for log output.
+     * @param error The error.
+     * @return A static string, e.g. "leading zero".
+     */
+    static const char *describe(ParseError error);
+
     /**
      * @brief Constructs a Version object with all version numbers set to 0.
      */
-    Version() : major(0), minor(0), patch(0) {}
+    constexpr Version() : key(pack(0, 0, 0, true)), pre_release_key(0), pre_release(), build_offset(0), error(NONE) {}
 
     /**
-     * @brief Constructs a Version object with the specified major, minor, and patch version numbers.
-     * @param major The major version number.
-     * @param minor The minor version number.
-     * @param patch The patch version number.
+     * @brief Constructs a release version with the specified major, minor, and patch version numbers.
+     * @param major The major version number, at most SEMANTIC_VERSION_NUMBER_MAX.
+     * @param minor The minor version number, at most SEMANTIC_VERSION_NUMBER_MAX.
+     * @param patch The patch version number, at most SEMANTIC_VERSION_NUMBER_MAX.
      */
-    Version(int major, int minor, int patch) : major(major), minor(minor), patch(patch) {}
+    constexpr Version(uint32_t major, uint32_t minor, uint32_t patch)
+        : key(pack(major, minor, patch, true)), pre_release_key(0), pre_release(), build_offset(0),
+          error(major > SEMANTIC_VERSION_NUMBER_MAX || minor > SEMANTIC_VERSION_NUMBER_MAX || patch > SEMANTIC_VERSION_NUMBER_MAX ? NUMBER_TOO_LARGE : NONE)
+    {
+    }
 
     /**
      * @brief Constructs a Version object from a string representation of the version.
-     * @param version The string representation of the version.
-     *                The format should be "vX.Y.Z" or "X.Y.Z", where X, Y, and Z are integers.
+     *
+     * An invalid version is 0.0.0 and reports the reason with `getError()`.
+     *
+     * @param version The string representation of the version, "X.Y.Z[-pre-release][+build]" optionally prefixed
+     *                with 'v', e.g. "v1.2.0-rc.1".
+     */
+    Version(const char *version);
+
+    /**
+     * @brief Tells whether the string the version was constructed from is a semantic version.
+     * @return True if the version is valid.
+     */
+    bool isValid() const
+    {
+        return error == NONE;
+    }
+
+    /**
+     * @brief Gets the reason why the version is invalid.
+     * @return NONE if the version is valid.
      */
-    Version(const char *version) : major(0), minor(0), patch(0)
+    ParseError getError() const
     {
-        if (version != NULL && strlen(version) > 0)
-        {
-            if (version[0] == 'v')
-            {
-                version++; // Skip the 'v' prefix
-            }
-            sscanf(version, "%d.%d.%d", &major, &minor, &patch);
-        }
+        return error;
     }
 
     /**
@@ -57,7 +183,7 @@ public:
      */
     int getMajor() const
     {
-        return major;
+        return (int)(key >> 43 & SEMANTIC_VERSION_NUMBER_MAX);
     }
 
     /**
@@ -66,7 +192,7 @@ public:
      */
     int getMinor() const
     {
-        return minor;
+        return (int)(key >> 22 & SEMANTIC_VERSION_NUMBER_MAX);
     }
 
     /**
@@ -75,17 +201,44 @@ public:
      */
     int getPatch() const
     {
-        return patch;
+        return (int)(key >> 1 & SEMANTIC_VERSION_NUMBER_MAX);
+    }
+
+    /**
+     * @brief Gets the pre-release identifiers.
+     * @return The pre-release without the '-', e.g. "rc.1", empty for a release.
+     */
+    const char *getPreRelease() const
+    {
+        return pre_release;
     }
 
     /**
-     * @brief Checks if this Version object is equal to another Version object.
+     * @brief Gets the build metadata, it does not affect the precedence.
+     * @return The build metadata without the '+', truncated to the space the pre-release leaves in the buffer, empty
+     *         if there is none.
+     */
+    const char *getBuild() const
+    {
+        return pre_release + build_offset;
+    }
+
+    /**
+     * @brief Formats the version without prefix and build metadata, e.g. "1.2.0-rc.1".
+     * @param buffer The buffer to write to.
+     * @param size The size of the buffer.
+     * @return The buffer.
+     */
+    char *toString(char *buffer, size_t size) const;
+
+    /**
+     * @brief Checks if this Version object has the same precedence as another Version object.
      * @param other The other Version object to compare with.
-     * @return True if the two Version objects are equal, false otherwise.
+     * @return True if the two versions only differ in their build metadata, false otherwise.
      */
     bool operator==(const Version &other) const
     {
-        return (major == other.major && minor == other.minor && patch == other.patch);
+        return key == other.key && pre_release_key == other.pre_release_key && ((key & 1) != 0 || strcmp(pre_release, other.pre_release) == 0);
     }
 
     /**
@@ -99,21 +252,15 @@ public:
     }
 
     /**
-     * @brief Checks if this Version object is less than another Version object.
+     * @brief Checks if this Version object has a lower precedence than another Version object.
      * @param other The other Version object to compare with.
-     * @return True if this Version object is less than the other Version object, false otherwise.
+     * @return True if this Version object is less than the other Version object, e.g. "1.0.0-rc.1" < "1.0.0".
      */
     bool operator<(const Version &other) const
     {
-        if (major < other.major)
-            return true;
-        if (major > other.major)
-            return false;
-        if (minor < other.minor)
-            return true;
-        if (minor > other.minor)
-            return false;
-        return patch < other.patch;
+        return key != other.key                           ? key < other.key
+               : pre_release_key != other.pre_release_key ? pre_release_key < other.pre_release_key
+                                                          : (key & 1) == 0 && comparePreRelease(other) < 0;
     }
 
     /**
@@ -147,4 +294,4 @@ public:
     }
 };
 
-#endif // SEMANTIC_VERSION_H_
\ No newline at end of file
+#endif // SEMANTIC_VERSION_H_
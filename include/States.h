@@ -0,0 +1,18 @@
+#ifndef STATES_H_
+#define STATES_H_
+
+#include "stdint.h"
+
+enum ESP32_OTA_Updater_State : uint8_t
+{
+    OTA_IDLE = 0,         /**< Nothing to do, no update known. */
+    OTA_CHECKING,         /**< Requesting and parsing the latest release. */
+    OTA_UPDATE_AVAILABLE, /**< A newer release with a firmware asset was found. */
+    OTA_DOWNLOADING,      /**< Downloading the firmware and writing it to flash. */
+    OTA_VERIFYING,        /**< Validating the written image and activating the partition. */
+    OTA_STAGED,           /**< The prefetched update is written and verified, it is activated by commitStaged(). */
+    OTA_READY_TO_REBOOT,  /**< The update is installed and takes effect after reboot(). */
+    OTA_FAILED            /**< The last operation failed, see getErrorCode(). */
+};
+
+#endif // STATES_H_
@@ -0,0 +1,96 @@
+#ifndef STATIC_OTA_UPDATER_H_
+#define STATIC_OTA_UPDATER_H_
+
+#include <type_traits>
+
+#include "ESP32_OTA_Updater.h"
+
+/**
+ * @file StaticOtaUpdater.h
+ * @brief Contains the declaration of the StaticOtaUpdater class template.
+ */
+
+/**
+ * @brief Members of StaticOtaUpdater which have to be constructed before the updater they are passed to.
+ */
+template <class Transport, class Sink, size_t PipelineStorageSize, size_t WorkspaceSize>
+struct StaticOtaUpdaterMembers
+{
+    Transport transport; /**< The transport all requests are sent with. */
+    Sink sink;           /**< The sink the new image is installed through. */
+    alignas(8) uint8_t pipeline_storage[PipelineStorageSize > 0 ? PipelineStorageSize : 1];    /**< Buffers of the flash pipeline. */
+    alignas(8) uint8_t decompressor_workspace[WorkspaceSize > 0 ? WorkspaceSize : 1];          /**< Dictionary and state of the inflater. */
+};
+
+/**
+ * @class StaticOtaUpdater
+ * @brief ESP32_OTA_Updater which owns its transport, its sink and all buffers of the update path.
+ *
+ * The transport and the sink are members of the given types instead of objects passed by pointer, and the buffers
+ * the updater otherwise allocates per install (the flash pipeline ring and the 43 KB gzip/zlib workspace) are sized
+ * by the template parameters and reserved with the updater, e.g. in a global variable. All strings of the update
+ * path have the fixed capacities of ESP32_OTA_UPDATER_SHORTSTRING_LENGTH and ESP32_OTA_UPDATER_LONGSTRING_LENGTH,
+ * which are checked against the release URL formats at compile time, and getErrorMessage() returns constant strings.
+ * Together with an allocation free transport and sink, a check and an install do not use the heap.
+ *
+ * With PipelineBuffers > 0 the writer task and its queues are still created by FreeRTOS for every install.
+ * Esp32HttpTransport is not allocation free: it keeps the URL and the request headers in Arduino Strings and builds
+ * host names and redirect locations with them, and WiFiClientSecure/HTTPClient allocate internally. On a device only
+ * the updater itself stays off the heap, the native `--allocations` mode measures the whole path with an in-memory
+ * transport.
+ *
+ * @tparam Transport The HttpTransport implementation, default constructible.
+ * @tparam Sink The FirmwareSink implementation, default constructible.
+ * @tparam PipelineBuffers Number of buffers between download and flash writer, 0 to write synchronously.
+ * @tparam PipelineBufferSize Size of each pipeline buffer.
+ * @tparam Inflate True to reserve the workspace of gzip and zlib assets, false if only uncompressed or heatshrink
+ *                 assets are installed (compressed assets then allocate it).
+ */
+template <class Transport, class Sink, uint8_t PipelineBuffers = 0, size_t PipelineBufferSize = ESP32_OTA_UPDATER_PIPELINE_BUFFER_SIZE,
+          bool Inflate = true>
+class StaticOtaUpdater : private StaticOtaUpdaterMembers<Transport, Sink, PipelineBuffers * PipelineBufferSize, Inflate ? INFLATE_DECODER_WORKSPACE_SIZE : 0>,
+                         public ESP32_OTA_Updater
+{
+    static_assert(std::is_base_of<HttpTransport, Transport>::value, "Transport has to implement HttpTransport");
+    static_assert(std::is_base_of<FirmwareSink, Sink>::value, "Sink has to implement FirmwareSink");
+    static_assert(PipelineBuffers == 0 || PipelineBufferSize > 0, "Pipeline buffers need a size");
+
+    typedef StaticOtaUpdaterMembers<Transport, Sink, PipelineBuffers * PipelineBufferSize, Inflate ? INFLATE_DECODER_WORKSPACE_SIZE : 0> Members;
+
+public:
+    /**
+     * @brief Constructs the updater with default constructed transport and sink.
+     * @param current_version The current version of the firmware.
+     * @param running_image The image delta patches are applied to, NULL to not use delta patches.
+     */
+    explicit StaticOtaUpdater(const char *current_version, ByteSource *running_image = NULL)
+        : ESP32_OTA_Updater(&this->Members::transport, &this->Members::sink, running_image, current_version)
+    {
+        setPipeline(PipelineBuffers, PipelineBufferSize);
+        setWorkBuffers(this->Members::pipeline_storage, PipelineBuffers * PipelineBufferSize,
+                       Inflate ? this->Members::decompressor_workspace : NULL);
+    }
+
+    StaticOtaUpdater(const StaticOtaUpdater &) = delete;
+    StaticOtaUpdater &operator=(const StaticOtaUpdater &) = delete;
+
+    /**
+     * @brief Gets the transport, e.g. to configure it before begin().
+     * @return The transport.
+     */
+    Transport &getTransport()
+    {
+        return this->Members::transport;
+    }
+
+    /**
+     * @brief Gets the sink, e.g. to configure it before begin().
+     * @return The sink.
+     */
+    Sink &getSink()
+    {
+        return this->Members::sink;
+    }
+};
+
+#endif // STATIC_OTA_UPDATER_H_
@@ -0,0 +1,261 @@
+#ifndef STREAM_DECOMPRESSOR_H_
+#define STREAM_DECOMPRESSOR_H_
+
+#include "ByteStream.h"
+
+/**
+ * @file StreamDecompressor.h
+ * @brief Contains the declaration of the StreamDecompressor class and the decoders it uses.
+ */
+
+#ifndef ESP32_OTA_UPDATER_HEATSHRINK_WINDOW_BITS
+#define ESP32_OTA_UPDATER_HEATSHRINK_WINDOW_BITS 10 /**< Heatshrink window size (-w), has to match the compressor. */
+#endif
+#ifndef ESP32_OTA_UPDATER_HEATSHRINK_LOOKAHEAD_BITS
+#define ESP32_OTA_UPDATER_HEATSHRINK_LOOKAHEAD_BITS 5 /**< Heatshrink lookahead size (-l), has to match the compressor. */
+#endif
+#ifdef ARDUINO
+#define INFLATE_DECODER_STATE_SIZE 11264 /**< Upper bound of the inflater state (tinfl_decompressor), checked at compile time. */
+#else
+#define INFLATE_DECODER_STATE_SIZE 45312 /**< The zlib based host stand-in of the inflater keeps the zlib window in its state. */
+#endif
+#define INFLATE_DECODER_DICTIONARY_SIZE 32768 /**< Size of the deflate window. */
+#define INFLATE_DECODER_WORKSPACE_SIZE (INFLATE_DECODER_STATE_SIZE + INFLATE_DECODER_DICTIONARY_SIZE) /**< Memory of InflateDecoder::setWorkspace(). */
+#ifndef ESP32_OTA_UPDATER_DECOMPRESS_BUFFER_SIZE
+#define ESP32_OTA_UPDATER_DECOMPRESS_BUFFER_SIZE 256 /**< Size of the buffer collecting decoded bytes before they are passed on. */
+#endif
+
+/**
+ * @class InflateDecoder
+ * @brief Streaming gzip/zlib decoder built on the tinfl inflater in the ESP32 ROM.
+ *
+ * Uses a fixed 32 KB dictionary plus the inflater state (about 43 KB in total), which are allocated in begin() and
+ * released in end() unless a workspace was provided with setWorkspace(). The gzip trailer (CRC32 and size of the
+ * decoded data) is verified in finish().
+ */
+class InflateDecoder : public ByteSink
+{
+public:
+    /**
+     * @brief Allocates the buffers and prepares the decoder.
+     * @param zlib True for the zlib format, false for gzip.
+     * @param output The sink receiving the decoded data.
+     * @return True on success, false if the buffers can not be allocated.
+     */
+    bool begin(bool zlib, ByteSink *output);
+    bool write(const uint8_t *data, size_t length) override;
+
+    /**
+     * @brief Checks that the compressed stream is complete and valid.
+     * @return True if the stream was completely decoded, false otherwise.
+     */
+    bool finish();
+
+    /**
+     * @brief Releases the buffers.
+     */
+    void end();
+
+    /**
+     * @brief Provides the memory of the dictionary and the inflater state, so begin() does not allocate them.
+     * @param workspace INFLATE_DECODER_WORKSPACE_SIZE bytes, aligned to 8 bytes, which stay valid while the decoder is
+     *                  used. NULL to allocate the buffers.
+     */
+    void setWorkspace(void *workspace);
+
+private:
+    enum State : uint8_t
+    {
+        GZIP_HEADER = 0,
+        GZIP_EXTRA_LENGTH,
+        GZIP_EXTRA,
+        GZIP_NAME,
+        GZIP_COMMENT,
+        GZIP_HEADER_CRC,
+        DEFLATE,
+        GZIP_TRAILER,
+        DONE,
+        FAILED
+    };
+
+    ByteSink *output = nullptr;
+    bool zlib = false;
+    State state = FAILED;
+    uint8_t flags = 0;
+    uint8_t header[10];
+    uint16_t header_length = 0;
+    uint16_t skip_remaining = 0;
+
+    void *inflator = nullptr;     /**< tinfl_decompressor, kept opaque to not expose the ROM headers. */
+    uint8_t *dictionary = nullptr; /**< Circular output window of the inflater. */
+    void *workspace = nullptr;     /**< Memory of the caller for inflator and dictionary, NULL to allocate them. */
+    size_t dictionary_offset = 0;
+    uint32_t crc = 0;
+    uint32_t decoded = 0;
+
+    bool inflate(const uint8_t *data, size_t length, size_t *consumed);
+    bool nextHeaderField();
+    bool fail();
+};
+
+/**
+ * @class HeatshrinkDecoder
+ * @brief Streaming heatshrink (LZSS) decoder for memory constrained devices.
+ *
+ * Only needs a window of 2^ESP32_OTA_UPDATER_HEATSHRINK_WINDOW_BITS bytes, the window and lookahead sizes are fixed
+ * at compile time and have to match the parameters used to compress the asset.
+ */
+class HeatshrinkDecoder : public ByteSink
+{
+public:
+    /**
+     * @brief Prepares the decoder.
+     * @param output The sink receiving the decoded data.
+     */
+    void begin(ByteSink *output);
+    bool write(const uint8_t *data, size_t length) override;
+
+    /**
+     * @brief Checks that the stream ended with a complete token and passes the remaining decoded data on.
+     *
+     * Only the padding of the last byte may follow the last token. A stream cut off at a token boundary can not be
+     * told apart from a complete one, the size and digest checks of the image catch it.
+     *
+     * @return True on success, false if the stream ended within a token or the output failed.
+     */
+    bool finish();
+
+private:
+    enum State : uint8_t
+    {
+        TAG = 0,
+        LITERAL,
+        BACKREF_INDEX,
+        BACKREF_COUNT
+    };
+
+    ByteSink *output = nullptr;
+    State state = TAG;
+    uint32_t bits = 0;
+    uint8_t bit_count = 0;
+    uint16_t backref_index = 0;
+    uint16_t head = 0;
+    uint8_t window[1 << ESP32_OTA_UPDATER_HEATSHRINK_WINDOW_BITS];
+    uint8_t buffer[ESP32_OTA_UPDATER_DECOMPRESS_BUFFER_SIZE];
+    size_t buffer_length = 0;
+    bool failed = false;
+
+    void emit(uint8_t value);
+    bool flush();
+};
+
+/**
+ * @class StreamDecompressor
+ * @brief Decompresses a firmware asset between the HTTP stream and the next stage, with a fixed size window.
+ */
+class StreamDecompressor : public ByteSink
+{
+public:
+    /**
+     * @brief Compression formats of release assets.
+     */
+    enum Codec : uint8_t
+    {
+        CODEC_AUTO = 0,  /**< Detect gzip or zlib from the first bytes, pass everything else through. Only for streams
+                              whose producer guarantees a header, e.g. delta patches. */
+        CODEC_NONE,      /**< Uncompressed. */
+        CODEC_GZIP,      /**< gzip (".gz"). */
+        CODEC_ZLIB,      /**< zlib wrapped deflate (".zz"). */
+        CODEC_HEATSHRINK /**< heatshrink (".hs"). */
+    };
+
+    /**
+     * @brief Gets the codec of an asset from its name.
+     * @param name The asset name, a trailing ".enc" of encrypted assets is ignored.
+     * @return The codec for the extension of the name, CODEC_NONE for other extensions and names without one.
+     */
+    static Codec codecFromName(const char *name);
+
+    /**
+     * @brief Prepares the decompressor.
+     * @param codec The codec of the stream, CODEC_AUTO to detect it from the first bytes.
+     * @param output The sink receiving the decompressed data.
+     * @return True on success, false if the decoder buffers can not be allocated.
+     */
+    bool begin(Codec codec, ByteSink *output);
+    bool write(const uint8_t *data, size_t length) override;
+
+    /**
+     * @brief Checks that the stream was completely decompressed and passes the remaining data on.
+     * @return True on success, false otherwise.
+     */
+    bool finish();
+
+    /**
+     * @brief Releases the decoder buffers, has to be called after finish() or to abort.
+     */
+    void end();
+
+    /**
+     * @brief Provides the memory of the gzip and zlib decoder, see InflateDecoder::setWorkspace().
+     * @param workspace INFLATE_DECODER_WORKSPACE_SIZE bytes, NULL to allocate the buffers in begin().
+     */
+    void setWorkspace(void *workspace)
+    {
+        inflater.setWorkspace(workspace);
+    }
+
+    /**
+     * @brief Gets the codec in use.
+     * @return The codec, CODEC_AUTO while it is not detected yet.
+     */
+    Codec getCodec() const
+    {
+        return codec;
+    }
+
+    /**
+     * @brief Gets the number of compressed bytes received.
+     * @return The number of bytes.
+     */
+    uint32_t getBytesIn() const
+    {
+        return bytes_in;
+    }
+
+    /**
+     * @brief Gets the number of decompressed bytes passed on.
+     * @return The number of bytes.
+     */
+    uint32_t getBytesOut() const
+    {
+        return counter.count;
+    }
+
+private:
+    class CountingSink : public ByteSink
+    {
+    public:
+        ByteSink *output = nullptr;
+        uint32_t count = 0;
+        bool write(const uint8_t *data, size_t length) override
+        {
+            count += length;
+            return output->write(data, length);
+        }
+    };
+
+    Codec codec = CODEC_NONE;
+    bool failed = false;
+    uint32_t bytes_in = 0;
+    uint8_t detect_buffer[2];
+    uint8_t detect_length = 0;
+    CountingSink counter;
+    InflateDecoder inflater;
+    HeatshrinkDecoder heatshrink;
+
+    bool startDecoder();
+    bool decode(const uint8_t *data, size_t length);
+};
+
+#endif // STREAM_DECOMPRESSOR_H_
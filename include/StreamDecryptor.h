@@ -0,0 +1,79 @@
+#ifndef STREAM_DECRYPTOR_H_
+#define STREAM_DECRYPTOR_H_
+
+#include <mbedtls/aes.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @file StreamDecryptor.h
+ * @brief Contains the declaration of the StreamDecryptor class.
+ */
+
+#define STREAM_DECRYPTOR_KEY_SIZE 32    /**< AES-256 key size. */
+#define STREAM_DECRYPTOR_HEADER_SIZE 16 /**< Magic "OTAE" followed by the 12 byte nonce. */
+#define STREAM_DECRYPTOR_NONCE_SIZE 12  /**< The nonce is the upper part of the counter block, the lower 4 bytes count blocks from 0. */
+
+/**
+ * @class StreamDecryptor
+ * @brief First stage of the install chain, decrypts AES-256-CTR encrypted assets in place as they are received.
+ *
+ * An encrypted asset starts with the magic "OTAE" and a random 12 byte nonce, followed by the ciphertext of the
+ * asset as it would be published otherwise (e.g. a gzip compressed image or a delta patch). The initial counter
+ * block is the nonce followed by 4 zero bytes, which matches `openssl enc -aes-256-ctr -iv <nonce>00000000`.
+ * CTR mode decrypts every chunk of the download buffer in place, so no additional buffer is needed. On the ESP32
+ * mbedtls uses the AES hardware accelerator. CTR does not authenticate the data, the image is authenticated
+ * by its signature (see ImageVerifier).
+ */
+class StreamDecryptor
+{
+public:
+    StreamDecryptor();
+    ~StreamDecryptor();
+
+    /**
+     * @brief Prepares decrypting a new asset.
+     * @param key The 32 byte key, NULL to pass all assets through unchanged.
+     */
+    void begin(const uint8_t *key);
+
+    /**
+     * @brief Decrypts the next chunk of the asset in place.
+     * @param data The chunk, it is overwritten with the plaintext.
+     * @param length In: the length of the chunk, out: the length of the plaintext.
+     * @return A pointer to the plaintext inside of data (the header is skipped), NULL if the asset is not encrypted
+     *         although a key is set.
+     */
+    uint8_t *decrypt(uint8_t *data, size_t *length);
+
+    /**
+     * @brief Checks if assets are decrypted.
+     * @return True if a key is set, false if assets are passed through.
+     */
+    bool isDecrypting() const
+    {
+        return decrypting;
+    }
+
+    /**
+     * @brief Gets the time spent decrypting, to measure the cost of encrypted assets.
+     * @return The time in microseconds.
+     */
+    uint32_t getDecryptTime() const
+    {
+        return decrypt_time_us;
+    }
+
+private:
+    mbedtls_aes_context aes;
+    bool decrypting = false;
+    bool failed = false;
+    uint8_t header[STREAM_DECRYPTOR_HEADER_SIZE];
+    size_t header_length = 0;
+    uint8_t counter[16];
+    uint8_t stream_block[16];
+    size_t stream_offset = 0;
+    uint32_t decrypt_time_us = 0;
+};
+
+#endif // STREAM_DECRYPTOR_H_
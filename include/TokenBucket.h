@@ -0,0 +1,72 @@
+#ifndef TOKEN_BUCKET_H_
+#define TOKEN_BUCKET_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @file TokenBucket.h
+ * @brief Contains the declaration of the TokenBucket class.
+ */
+
+/**
+ * @class TokenBucket
+ * @brief Caps the rate of a transfer, e.g. a download which shares a narrow uplink with the application.
+ *
+ * The bucket fills with the configured number of bytes per second up to the burst size, every transferred byte
+ * takes one token. Over any period the transfer stays below rate * period + burst. All times are passed in, in
+ * milliseconds, so the bucket also runs on a host with a simulated clock. The rate can be changed at any time, e.g.
+ * by the application while the updater task downloads.
+ */
+class TokenBucket
+{
+public:
+    /**
+     * @brief Sets the rate, the bucket keeps its tokens up to the new burst size.
+     * @param bytes_per_second The average rate, 0 for no limit.
+     * @param burst_bytes The maximum number of bytes transferred at once.
+     */
+    void setRate(uint32_t bytes_per_second, uint32_t burst_bytes);
+
+    /**
+     * @brief Gets the rate.
+     * @return The rate in bytes per second, 0 if it is not limited.
+     */
+    uint32_t getRate() const
+    {
+        return rate;
+    }
+
+    /**
+     * @brief Gets the number of bytes which may be transferred now.
+     * @param now The current time in milliseconds.
+     * @param wanted The number of bytes the caller wants to transfer.
+     * @return The number of bytes, at most wanted.
+     */
+    size_t getAvailable(unsigned long now, size_t wanted);
+
+    /**
+     * @brief Takes the tokens of transferred bytes, call getAvailable() before.
+     * @param length The number of bytes transferred.
+     */
+    void consume(size_t length);
+
+    /**
+     * @brief Gets the time until a number of bytes may be transferred.
+     * @param now The current time in milliseconds.
+     * @param wanted The number of bytes, at most the burst size.
+     * @return The time in milliseconds, 0 if the bytes may be transferred now.
+     */
+    unsigned long getWait(unsigned long now, size_t wanted);
+
+private:
+    uint32_t rate = 0;
+    uint32_t burst = 0;
+    uint64_t tokens = 0;           /**< Available bytes in 1/1000 bytes, so slow rates do not round to 0. */
+    unsigned long refilled_at = 0; /**< Time tokens were added last. */
+    bool started = false;
+
+    void refill(unsigned long now);
+};
+
+#endif // TOKEN_BUCKET_H_
@@ -0,0 +1,98 @@
+#ifndef UPDATE_METRICS_H_
+#define UPDATE_METRICS_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#include "ESP32_OTA_Updater_Config.h"
+#include "Errors.h"
+#include "HttpTransport.h"
+
+/**
+ * @file UpdateMetrics.h
+ * @brief Contains the metrics the updater records for every update cycle.
+ */
+
+/**
+ * @brief Phases of an update cycle, each one is timed separately.
+ */
+enum UpdatePhase : uint8_t
+{
+    UPDATE_PHASE_CHECK = 0, /**< Requesting and parsing the latest release. */
+    UPDATE_PHASE_SIGNATURE, /**< Downloading the digest and signature of the image. */
+    UPDATE_PHASE_DOWNLOAD,  /**< Requesting and receiving the firmware asset, including decryption, decompression and patching. */
+    UPDATE_PHASE_FLASH,     /**< Erasing and writing the flash, overlaps with the download if the writes are pipelined. */
+    UPDATE_PHASE_VERIFY,    /**< Hashing the image and checking its signature, overlaps with the download. */
+    UPDATE_PHASE_FINISH,    /**< Validating the written image and activating the partition (Update.end()). */
+    UPDATE_PHASE_COUNT
+};
+
+/**
+ * @brief Duration and amount of data of one phase.
+ */
+struct UpdatePhaseMetrics
+{
+    uint32_t duration_ms; /**< Total time spent in the phase. */
+    uint32_t bytes;       /**< Bytes processed in the phase: received for network phases, written, hashed or validated otherwise. */
+
+    /**
+     * @brief Gets the throughput of the phase.
+     * @return The throughput in bytes per second, 0 if the phase took less than a millisecond.
+     */
+    uint32_t getThroughput() const
+    {
+        return duration_ms > 0 ? (uint32_t)((uint64_t)bytes * 1000 / duration_ms) : 0;
+    }
+};
+
+/**
+ * @brief Status and timing of a single request.
+ */
+struct UpdateRequestMetrics
+{
+    UpdatePhase phase;        /**< The phase the request was sent in. */
+    int16_t status;           /**< The HTTP status code, negative if no response was received. */
+    HttpRequestTiming timing; /**< Connection setup and time to first byte. */
+};
+
+/**
+ * @brief Metrics of an update cycle: the last release check and the install following it.
+ *
+ * They are cleared when a check starts and completed by the install, see ESP32_OTA_Updater::getMetrics() and
+ * ESP32_OTA_Updater::onMetrics().
+ */
+struct UpdateMetrics
+{
+    UpdatePhaseMetrics phases[UPDATE_PHASE_COUNT];                          /**< Duration and bytes of each phase, indexed by UpdatePhase. */
+    UpdateRequestMetrics requests[ESP32_OTA_UPDATER_METRICS_MAX_REQUESTS]; /**< The first requests of the cycle. */
+    uint8_t request_count;                                                  /**< Number of requests sent, may exceed the capacity of requests. */
+    uint32_t handshakes;                                                    /**< Number of new connections (TLS handshakes). */
+    uint16_t retries;                                                       /**< Requests sent again because a kept-alive connection was closed. */
+    uint8_t patch_fallbacks;                                                /**< Number of times a delta patch failed and the full image was downloaded. */
+    uint32_t peer_bytes;                                                    /**< Image bytes received from a peer on the local network instead of GitHub. */
+    uint8_t peer_fallbacks;                                                 /**< Number of times a download from a peer failed and GitHub was used. */
+    uint32_t resumed_at;                                                    /**< Offset an interrupted download was resumed at, 0 if it started over. */
+    uint32_t heap_min_free;                                                 /**< Lowest free heap seen during the cycle, 0 if unknown. */
+    ESP32_OTA_Updater_Error error;                                          /**< The error the cycle ended with. */
+
+    /**
+     * @brief Resets all metrics for a new cycle.
+     */
+    void clear()
+    {
+        memset(this, 0, sizeof(*this));
+        heap_min_free = UINT32_MAX;
+    }
+
+    /**
+     * @brief Gets the metrics of a phase.
+     * @param phase The phase.
+     * @return The duration and bytes of the phase.
+     */
+    const UpdatePhaseMetrics &getPhase(UpdatePhase phase) const
+    {
+        return phases[phase];
+    }
+};
+
+#endif // UPDATE_METRICS_H_
@@ -0,0 +1,47 @@
+#ifndef ALLOCATION_CHECK_H_
+#define ALLOCATION_CHECK_H_
+
+#include <stdint.h>
+
+/**
+ * @file AllocationCheck.h
+ * @brief Contains the declaration of the heap allocation check of the native runner.
+ */
+
+/**
+ * @brief The heap usage between beginHeapCount() and endHeapCount().
+ */
+struct HeapCount
+{
+    uint32_t allocations;     /**< Number of malloc, calloc and realloc calls. */
+    uint64_t allocated_bytes; /**< Bytes requested by them. */
+    int64_t peak_bytes;       /**< Largest increase of the heap in use over the start of the count. */
+};
+
+/**
+ * @brief Starts counting the heap allocations of the process, like runAllocationCheck() does.
+ * @return True if the allocations are counted, false without the malloc of glibc.
+ */
+bool beginHeapCount();
+
+/**
+ * @brief Stops counting the heap allocations.
+ * @param count Receives the usage since beginHeapCount(), all 0 without the malloc of glibc.
+ */
+void endHeapCount(HeapCount *count);
+
+/**
+ * @brief Counts the heap allocations of a complete check and install with a StaticOtaUpdater.
+ *
+ * A gzip compressed image of `image_size` bytes with its SHA-256 digest is published as release in memory and a
+ * StaticOtaUpdater with MemoryHttpTransport and MemoryFirmwareSink checks for it, downloads, decompresses, hashes and
+ * installs it. While available() and downloadAndInstall() run, every malloc, calloc and realloc of the process (which
+ * includes operator new) is counted. The check cache and the download progress are not persisted, the Preferences
+ * stand-in allocates where the NVS of the ESP32 does not. The installed image is compared with the published one.
+ *
+ * @param image_size Size of the published image.
+ * @return 0 if the image was installed without a heap allocation, 1 otherwise.
+ */
+int runAllocationCheck(uint32_t image_size);
+
+#endif // ALLOCATION_CHECK_H_
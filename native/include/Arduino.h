@@ -0,0 +1,103 @@
+#ifndef NATIVE_ARDUINO_H_
+#define NATIVE_ARDUINO_H_
+/**
+ * @file Arduino.h
+ * @brief Minimal host stand-in for the parts of the Arduino core the updater uses, for the native environment.
+ *
+ * FreeRTOS tasks, queues and binary semaphores are emulated with threads, so the flash pipeline and the updater task
+ * run on the host like on a dual core chip. A tick is one millisecond. A task which is deleted by another one stops at
+ * its next delay or wait, vTaskDelete() returns once it stopped.
+ */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <functional>
+
+#include "WString.h"
+
+#define F(string_literal) (string_literal)
+#define RTC_DATA_ATTR
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+
+/**
+ * @class Print
+ * @brief Output stream, e.g. for the debug output of the updater.
+ */
+class Print
+{
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t value) = 0;
+    virtual size_t write(const uint8_t *buffer, size_t size);
+    size_t print(const char *text);
+    size_t println(const char *text);
+    size_t printf(const char *format, ...);
+};
+
+/**
+ * @class StdoutPrint
+ * @brief Print writing to the standard output.
+ */
+class StdoutPrint : public Print
+{
+public:
+    size_t write(uint8_t value) override;
+    size_t write(const uint8_t *buffer, size_t size) override;
+};
+
+class EspClass
+{
+public:
+    void restart();
+    uint32_t getFreeHeap(); /**< Always 0, a host has no fixed heap. */
+};
+extern EspClass ESP;
+
+// FreeRTOS
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+typedef void *TaskHandle_t;
+typedef void *QueueHandle_t;
+typedef void *SemaphoreHandle_t;
+typedef struct
+{
+    volatile int owner;
+} portMUX_TYPE;
+
+#define pdPASS 1
+#define pdFAIL 0
+#define pdTRUE 1
+#define pdFALSE 0
+#define portMAX_DELAY 0xFFFFFFFFUL
+#define portNUM_PROCESSORS 2
+#define portMUX_INITIALIZER_UNLOCKED {0}
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define portENTER_CRITICAL(mux) vPortEnterCritical(mux)
+#define portEXIT_CRITICAL(mux) vPortExitCritical(mux)
+
+void vPortEnterCritical(portMUX_TYPE *mux);
+void vPortExitCritical(portMUX_TYPE *mux);
+BaseType_t xTaskCreatePinnedToCore(void (*task)(void *), const char *name, uint32_t stack_size, void *parameter,
+                                   UBaseType_t priority, TaskHandle_t *handle, BaseType_t core);
+void vTaskDelete(TaskHandle_t handle);
+void vTaskDelay(TickType_t ticks);
+BaseType_t xPortGetCoreID();
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size);
+void vQueueDelete(QueueHandle_t queue);
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks);
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue);
+SemaphoreHandle_t xSemaphoreCreateBinary();
+void vSemaphoreDelete(SemaphoreHandle_t semaphore);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks);
+
+#endif // NATIVE_ARDUINO_H_
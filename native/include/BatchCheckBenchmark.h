@@ -0,0 +1,30 @@
+#ifndef BATCH_CHECK_BENCHMARK_H_
+#define BATCH_CHECK_BENCHMARK_H_
+
+#include <stdint.h>
+
+/**
+ * @file BatchCheckBenchmark.h
+ * @brief Contains the declaration of the batched release check benchmark of the native runner.
+ */
+
+/**
+ * @brief Compares one release check per component with one BatchReleaseChecker request for all components.
+ *
+ * The release published in <root> is offered by `components` repositories ("local/firmware", "local/firmware-1",
+ * ...). The first component runs 1.0.0, so it has an update, the others already run the release. Every component
+ * has its own updater and transport, they share one NVS like on a device with several components. First every
+ * updater checks on its own, then checks again from the check cache it kept in NVS, which needs no request. Then one
+ * batched check resolves all repositories over a single connection and its results are passed to the updaters with
+ * setBatchResult(), after which only the component with an update requests its release. The requests, TLS handshakes
+ * and bytes of the cycles are printed.
+ *
+ * @param root The directory the release was published to, see LoopbackHttpTransport.
+ * @param asset The firmware asset, e.g. "firmware.bin".
+ * @param components Number of components, at most ESP32_OTA_UPDATER_BATCH_MAX_COMPONENTS.
+ * @return 0 if the cached cycle needs no request, the batched cycle one request and handshake for the check, and all
+ *         find the same updates, 1 otherwise.
+ */
+int runBatchCheckBenchmark(const char *root, const char *asset, uint32_t components);
+
+#endif // BATCH_CHECK_BENCHMARK_H_
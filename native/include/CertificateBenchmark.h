@@ -0,0 +1,31 @@
+#ifndef CERTIFICATE_BENCHMARK_H_
+#define CERTIFICATE_BENCHMARK_H_
+
+#include <stdint.h>
+
+/**
+ * @file CertificateBenchmark.h
+ * @brief Contains the declaration of the certificate store benchmark of the native runner.
+ */
+
+/**
+ * @brief Compares the trust anchor lookup of a TLS handshake with a PEM string and with a CertificateStore.
+ *
+ * `certificates` self-signed RSA-2048 root certificates with distinct subjects are concatenated into a PEM string,
+ * like the one passed to setCACert(), and into a sorted bundle loaded into a CertificateStore. Each of `handshakes`
+ * handshakes looks up the anchor of another root: with the PEM string every certificate is parsed and the anchor is
+ * searched among them, like mbedtls does for every connection, with the store findAnchor() finds the entry and only
+ * its public key is parsed. Both have to find the key of the root. The time per handshake and the peak heap while
+ * the anchors are held are printed for both.
+ *
+ * The bundle is then installed as signed release asset together with the app through a StaticOtaUpdater: with an app
+ * image the sink does not accept, the store has to keep the anchors of the firmware, with a valid one the installed
+ * bundle has to be in use and restored by the next load().
+ *
+ * @param certificates Number of root certificates.
+ * @param handshakes Number of handshakes measured for each kind of anchors.
+ * @return 0 if every lookup found the key and the bundle was only installed with the app, 1 otherwise.
+ */
+int runCertificateBenchmark(uint32_t certificates, uint32_t handshakes);
+
+#endif // CERTIFICATE_BENCHMARK_H_
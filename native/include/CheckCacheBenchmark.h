@@ -0,0 +1,30 @@
+#ifndef CHECK_CACHE_BENCHMARK_H_
+#define CHECK_CACHE_BENCHMARK_H_
+
+#include <stdint.h>
+
+/**
+ * @file CheckCacheBenchmark.h
+ * @brief Contains the declaration of the release check cache benchmark of the native runner.
+ */
+
+/**
+ * @brief Counts the requests and bytes of repeated release checks with and without the check cache.
+ *
+ * Release v1.1.0, whose JSON is padded with release notes like a GitHub response, is served from memory by a
+ * MemoryHttpTransport to a StaticOtaUpdater running 1.0.0, which checks `polls` times:
+ * - with available() and a check interval of 0 against a server without ETags, every check downloads the release,
+ * - the same with ETags, every check after the first one is answered with an empty 304,
+ * - after a reboot, a new updater finds the ETag in NVS, so even its first check is answered with 304,
+ * - with a check interval of 200 ms and a check every 10 ms (on a fixed clock), only one in 20 polls sends a request,
+ * - with startCheck() and poll() instead of available(),
+ * - and with v1.2.0 published halfway, which is downloaded once more.
+ * Every poll has to find the update. The requests, the 304 answers, the body bytes of the 200 answers and the bytes
+ * the updater read (it stops once the asset is parsed) are printed per case.
+ *
+ * @param polls Number of checks per case.
+ * @return 0 if no case sent more requests or was sent more body bytes than expected, 1 otherwise.
+ */
+int runCheckCacheBenchmark(uint32_t polls);
+
+#endif // CHECK_CACHE_BENCHMARK_H_
@@ -0,0 +1,27 @@
+#ifndef CODEC_BENCHMARK_H_
+#define CODEC_BENCHMARK_H_
+
+#include <stdint.h>
+
+/**
+ * @file CodecBenchmark.h
+ * @brief Contains the declaration of the decompression benchmark of the native runner.
+ */
+
+/**
+ * @brief Measures the decoding throughput of every codec of StreamDecompressor and checks how streams end.
+ *
+ * An image of `image_size` bytes, structured like firmware, is encoded uncompressed, as gzip and zlib (zlib level 9)
+ * and as heatshrink (a greedy encoder with the window and lookahead of ESP32_OTA_UPDATER_HEATSHRINK_WINDOW_BITS and
+ * ESP32_OTA_UPDATER_HEATSHRINK_LOOKAHEAD_BITS, whose last token is a literal). Each stream is decoded `rounds` times
+ * in slices of ESP32_OTA_UPDATER_POLL_SLICE_SIZE with the codec codecFromName() picks for its asset name, and the
+ * asset size, the ratio and the decoded MB/s are printed. The decoded image has to match, and each compressed stream
+ * without its last byte has to fail. An uncompressed image which starts like a gzip stream has to pass through unchanged.
+ *
+ * @param image_size Size of the image.
+ * @param rounds Number of times each stream is decoded.
+ * @return 0 if every stream decoded to the image and every cut off one failed, 1 otherwise.
+ */
+int runCodecBenchmark(uint32_t image_size, uint32_t rounds);
+
+#endif // CODEC_BENCHMARK_H_
@@ -0,0 +1,91 @@
+#ifndef FILE_FIRMWARE_SINK_H_
+#define FILE_FIRMWARE_SINK_H_
+
+#include <stdio.h>
+#include <string>
+
+#include "FirmwareSink.h"
+
+/**
+ * @file FileFirmwareSink.h
+ * @brief Contains the declaration of the file backed host stand-ins FileFirmwareSink and FileByteSource.
+ */
+
+/**
+ * @class FileFirmwareSink
+ * @brief Host stand-in for the OTA partition, writes the image into a file.
+ *
+ * Like the partition writer, data is committed in whole sectors and an image can be continued at a committed
+ * offset. finish() checks the ESP32 image magic byte of app images and otherwise accepts the image.
+ */
+class FileFirmwareSink : public FirmwareSink
+{
+public:
+    /**
+     * @brief Constructs the sink.
+     * @param path The file the image is written to.
+     * @param capacity The size of the simulated partition.
+     * @param app_image True for an app partition, false for a data partition (e.g. a file system image).
+     */
+    FileFirmwareSink(const char *path, uint32_t capacity, bool app_image = true);
+    ~FileFirmwareSink();
+
+    uint32_t getCapacity() override;
+    bool begin(uint32_t offset = 0, uint32_t crc = 0, const uint8_t *head = NULL) override;
+    bool write(const uint8_t *data, size_t length) override;
+    bool finish() override;
+    void abort() override;
+    bool verify(uint32_t offset, uint32_t crc, const uint8_t *head) override;
+    bool read(uint32_t offset, uint8_t *data, size_t length) override;
+
+    uint32_t getCommitted() const override
+    {
+        return committed;
+    }
+
+    uint32_t getCommittedCrc() const override
+    {
+        return committed_crc;
+    }
+
+    const uint8_t *getHead() const override
+    {
+        return head;
+    }
+
+private:
+    std::string path;
+    uint32_t capacity;
+    bool app_image;
+    FILE *file = nullptr;
+    uint8_t buffer[FIRMWARE_SINK_SECTOR_SIZE];
+    size_t buffer_length = 0;
+    uint32_t committed = 0;
+    uint32_t committed_crc = 0;
+    uint8_t head[FIRMWARE_SINK_HEAD_SIZE];
+
+    bool flush();
+};
+
+/**
+ * @class FileByteSource
+ * @brief Host stand-in for the running partition, reads the image delta patches are applied to from a file.
+ */
+class FileByteSource : public ByteSource
+{
+public:
+    /**
+     * @brief Constructs the source.
+     * @param path The file to read from.
+     */
+    explicit FileByteSource(const char *path);
+    ~FileByteSource();
+
+    bool read(uint32_t offset, uint8_t *data, size_t length) override;
+    uint32_t getSize() override;
+
+private:
+    FILE *file;
+};
+
+#endif // FILE_FIRMWARE_SINK_H_
@@ -0,0 +1,36 @@
+#ifndef FLEET_SIMULATION_H_
+#define FLEET_SIMULATION_H_
+
+#include <stdint.h>
+
+/**
+ * @file FleetSimulation.h
+ * @brief Contains the declaration of the fleet simulation of the native runner.
+ */
+
+/**
+ * @brief Parameters of a fleet simulation.
+ */
+struct FleetSimulationConfig
+{
+    const char *root;     /**< The directory the release is served from, see LoopbackHttpTransport. */
+    uint32_t devices;     /**< Number of devices, all of them boot at the start (e.g. after a power failure). */
+    uint32_t hours;       /**< Simulated time. */
+    uint32_t limit;       /**< API requests accepted per hour, shared by all devices. */
+    uint32_t interval_s;  /**< Check interval of the devices. */
+    uint32_t jitter_s;    /**< Check jitter of the scheduled devices. */
+};
+
+/**
+ * @brief Simulates a fleet of devices checking for releases against one rate limited loopback API.
+ *
+ * The fleet is simulated twice on a simulated clock: once naively (no jitter, a fixed retry after 10 s and the rate
+ * limit headers ignored) and once with the CheckScheduler the updater uses. For both the requests and rejections
+ * (403) per hour and the time until every device completed a check are printed.
+ *
+ * @param config The parameters.
+ * @return 0 if the scheduled fleet never exceeded the limit, 1 otherwise.
+ */
+int runFleetSimulation(const FleetSimulationConfig &config);
+
+#endif // FLEET_SIMULATION_H_
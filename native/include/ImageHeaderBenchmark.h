@@ -0,0 +1,37 @@
+#ifndef IMAGE_HEADER_BENCHMARK_H_
+#define IMAGE_HEADER_BENCHMARK_H_
+
+#include <stdint.h>
+
+/**
+ * @file ImageHeaderBenchmark.h
+ * @brief Contains the declaration of the image header check benchmark of the native runner.
+ */
+
+/**
+ * @brief Writes the header of an app image like esptool does, followed by the start of esp_app_desc_t.
+ * @param image The image, at least IMAGE_HEADER_CHECK_SIZE bytes.
+ * @param chip_id The esp_chip_id_t of the target.
+ * @param flash_size The esp_image_flash_size_t, e.g. 2 for 4 MB.
+ * @param version The embedded version.
+ * @param project_name The embedded project name.
+ */
+void writeAppImageHeader(uint8_t *image, uint16_t chip_id, uint8_t flash_size, const char *version, const char *project_name);
+
+/**
+ * @brief Installs images which do not match the running image and measures how much of them is downloaded.
+ *
+ * An image of `image_size` bytes is published as release v1.1.0 in memory, uncompressed so the downloaded bytes are
+ * the bytes of the image, and installed by a StaticOtaUpdater whose running image is built for an ESP32 with 4 MB
+ * flash. The published image is valid once and then has no app header, another chip, a larger flash, another project,
+ * an embedded version which is not newer (with the version check enabled) and ends within the header. For each the
+ * result, the error and
+ * the bytes downloaded before the install ended are printed, and the simulated partition has to be untouched
+ * unless the image was valid.
+ *
+ * @param image_size Size of the published image.
+ * @return 0 if the valid image was installed and every other one rejected before it reached the flash, 1 otherwise.
+ */
+int runImageHeaderBenchmark(uint32_t image_size);
+
+#endif // IMAGE_HEADER_BENCHMARK_H_
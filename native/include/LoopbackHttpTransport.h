@@ -0,0 +1,218 @@
+#ifndef LOOPBACK_HTTP_TRANSPORT_H_
+#define LOOPBACK_HTTP_TRANSPORT_H_
+
+#include <stdio.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "ESP32_OTA_Updater_Config.h"
+#include "HttpTransport.h"
+#include "LoopbackPeerNetwork.h"
+
+/**
+ * @file LoopbackHttpTransport.h
+ * @brief Contains the declaration of the LoopbackHttpTransport class.
+ */
+
+/**
+ * @brief Rate limit of the loopback API, shared by the transports of all simulated devices.
+ *
+ * Like the GitHub API, every request to the API host counts against a limit per window, answers carry the
+ * X-RateLimit-* and Date headers and requests beyond the limit are rejected with 403. Asset downloads do not count.
+ */
+struct LoopbackRateLimit
+{
+    uint32_t limit;    /**< Requests per window. */
+    uint32_t window_s; /**< Length of a window in seconds. */
+    int64_t now_ms;    /**< The simulated clock (Unix time in ms), set by the caller. */
+    int64_t reset_s;   /**< End of the current window (Unix time in s). */
+    uint32_t used;     /**< Requests counted in the current window. */
+    uint32_t rejected; /**< Requests rejected since the start. */
+};
+
+/**
+ * @brief Network conditions emulated by the loopback, with real delays so the updater sees them like on a device.
+ *
+ * The disconnects are counted down, so a profile can be shared by the transports of several attempts.
+ */
+struct LoopbackNetwork
+{
+    uint32_t latency_ms;       /**< Round trip time, paid per request and redirect and twice more per new connection. */
+    uint32_t bytes_per_second; /**< Bandwidth of the responses, 0 for unlimited. */
+    uint32_t stall_interval;   /**< Response body bytes between two stalls, 0 for none. */
+    uint32_t stall_ms;         /**< Length of a stall, e.g. a retransmission after lost packets. */
+    uint32_t disconnect_after; /**< Download responses lose their connection after this many body bytes, 0 for never. */
+    uint32_t disconnects;      /**< Number of download responses which still lose their connection. */
+};
+
+/**
+ * @class LoopbackHttpTransport
+ * @brief Host stand-in for the HTTP transport, serves files from a local directory.
+ *
+ * The path of a URL is mapped to a file below the root directory, the host is ignored, e.g.
+ * "https://api.github.com/repos/owner/repo/releases/latest" is served from "<root>/repos/owner/repo/releases/latest".
+ * Like GitHub and its download server it answers with an ETag (304 for a matching If-None-Match) and supports
+ * "Range: bytes=<start>-" requests (206 with Content-Range). A directory is served as paginated list, page N
+ * ("?page=N", 1 by default) from the file "page-N" in it, e.g. "<root>/repos/owner/repo/releases/page-2".
+ *
+ * Connections are modeled like Esp32HttpTransport keeps them: one per host in a pool of
+ * ESP32_OTA_UPDATER_HTTP_CONNECTIONS, a connection is closed if more than ESP32_OTA_UPDATER_HTTP_DRAIN_LIMIT body
+ * bytes are left unread. Assets below "/assets/" and release download URLs (".../releases/download/<tag>/<name>")
+ * are redirected to a second host, like GitHub redirects asset downloads to its download server, so
+ * getHandshakeCount() reports the handshakes a device would perform.
+ *
+ * POST requests to "/graphql" are answered like the GitHub GraphQL API answers the query of the BatchReleaseChecker:
+ * every aliased repository gets the tag of "<root>/repos/<owner>/<repo>/releases/latest" and the size and release
+ * download URL of the requested asset. Other queries are not understood.
+ *
+ * With a LoopbackNetwork, requests and responses are delayed by its latency, bandwidth and stalls and download
+ * responses can lose their connection midway. The connect and TTFB times of getTiming() then report the emulated
+ * latency.
+ *
+ * With a LoopbackLan, URLs of hosts offering an image on it are served like Esp32PeerNetwork serves them: plain
+ * HTTP without TLS handshake, a new connection per request and "/ota/<digest>" answered from the offered source.
+ */
+class LoopbackHttpTransport : public HttpTransport
+{
+public:
+    /**
+     * @brief Constructs the transport.
+     * @param root The directory files are served from.
+     */
+    explicit LoopbackHttpTransport(const char *root);
+    ~LoopbackHttpTransport();
+
+    bool begin(const char *url) override;
+    void addHeader(const char *name, const char *value) override;
+    void setAuthorization(const char *token) override;
+    void collectHeaders(const char *names[], size_t count) override;
+    int GET() override;
+    int POST(const uint8_t *body, size_t length) override;
+    int getSize() override;
+    void getHeader(const char *name, char *value, size_t capacity) override;
+    int available() override;
+    bool connected() override;
+    size_t read(uint8_t *buffer, size_t size) override;
+    void end() override;
+
+    uint32_t getHandshakeCount() const override
+    {
+        return handshake_count;
+    }
+
+    void getTiming(HttpRequestTiming *timing) const override
+    {
+        *timing = this->timing; // The latency of a LoopbackNetwork, without one only the connection reuse
+    }
+
+    /**
+     * @brief Enables or disables keep-alive, without it every request and redirect opens a new connection.
+     * @param enabled True to keep connections open (default), false to behave like HTTP/1.0.
+     */
+    void setKeepAlive(bool enabled)
+    {
+        keep_alive = enabled;
+    }
+
+    /**
+     * @brief Answers with chunked transfer encoding, the response length is then unknown to the client.
+     * @param enabled True for chunked responses, false to send the length (default).
+     */
+    void setChunked(bool enabled)
+    {
+        chunked = enabled;
+    }
+
+    /**
+     * @brief Applies a rate limit to the API requests, e.g. one shared by many transports to simulate a fleet.
+     * @param rate_limit The rate limit and clock, NULL for no limit (default).
+     */
+    void setRateLimit(LoopbackRateLimit *rate_limit)
+    {
+        this->rate_limit = rate_limit;
+    }
+
+    /**
+     * @brief Emulates network conditions for the following requests.
+     * @param network The conditions, NULL for an ideal network (default).
+     */
+    void setNetwork(LoopbackNetwork *network)
+    {
+        this->network = network;
+    }
+
+    /**
+     * @brief Connects the transport to a simulated local network, its devices are then reachable by their name.
+     * @param lan The network, NULL for none (default).
+     */
+    void setLan(const LoopbackLan *lan)
+    {
+        this->lan = lan;
+    }
+
+    /**
+     * @brief Gets the number of requests answered.
+     * @return The number of requests.
+     */
+    uint32_t getRequestCount() const
+    {
+        return request_count;
+    }
+
+    /**
+     * @brief Gets the number of response body bytes read by the client from the API and download servers.
+     * @return The number of bytes.
+     */
+    uint64_t getBytesSent() const
+    {
+        return bytes_sent;
+    }
+
+    /**
+     * @brief Gets the number of response body bytes read by the client from devices on the LoopbackLan.
+     * @return The number of bytes.
+     */
+    uint64_t getLanBytesSent() const
+    {
+        return lan_bytes_sent;
+    }
+
+private:
+    typedef std::pair<std::string, std::string> Header;
+
+    std::string root;
+    std::string host;
+    std::string path;
+    std::vector<Header> request_headers;
+    std::vector<Header> response_headers;
+    FILE *file = nullptr;
+    long remaining = 0;
+    long size = -1;
+    uint32_t request_count = 0;
+    uint64_t bytes_sent = 0;
+    uint64_t lan_bytes_sent = 0;
+    const LoopbackLan *lan = nullptr;
+    ByteSource *lan_source = nullptr; /**< The offered image the response is read from, NULL for files. */
+    uint32_t lan_offset = 0;
+    bool keep_alive = true;
+    bool chunked = false;
+    std::vector<std::string> open_hosts; /**< Hosts with an open connection, the least recently used first. */
+    uint32_t handshake_count = 0;
+    HttpRequestTiming timing = {};
+    LoopbackRateLimit *rate_limit = nullptr;
+    LoopbackNetwork *network = nullptr;
+    std::chrono::steady_clock::time_point response_start; /**< When the response headers arrived. */
+    uint64_t response_bytes = 0;                          /**< Body bytes of the response read so far. */
+
+    const char *requestHeader(const char *name) const;
+    bool countRequest();
+    void setResponseHeader(const char *name, const std::string &value);
+    bool useConnection(const std::string &host);
+    void emulateRequest(bool reused);
+    size_t emulateTransfer(size_t size);
+    int servePeer(const LoopbackLan::Offer &offer);
+    std::string answerQuery(const std::string &query) const;
+};
+
+#endif // LOOPBACK_HTTP_TRANSPORT_H_
@@ -0,0 +1,69 @@
+#ifndef LOOPBACK_PEER_NETWORK_H_
+#define LOOPBACK_PEER_NETWORK_H_
+
+#include <string>
+#include <vector>
+
+#include "PeerNetwork.h"
+
+/**
+ * @file LoopbackPeerNetwork.h
+ * @brief Contains the declaration of the host stand-ins LoopbackLan and LoopbackPeerNetwork.
+ */
+
+/**
+ * @brief A simulated local network, the offers of all devices on it.
+ *
+ * The LoopbackHttpTransport of a device serves "http://<host>/ota/<digest>" from the source <host> offered, see
+ * LoopbackHttpTransport::setLan().
+ */
+struct LoopbackLan
+{
+    /**
+     * @brief The image a device offers.
+     */
+    struct Offer
+    {
+        std::string host;   /**< The name of the device. */
+        PeerImage image;    /**< The offered image. */
+        ByteSource *source; /**< The image data. */
+    };
+
+    std::vector<Offer> offers;
+
+    /**
+     * @brief Finds the offer of a host.
+     * @param host The name of the device.
+     * @return The offer, NULL if the host offers nothing.
+     */
+    const Offer *find(const std::string &host) const;
+};
+
+/**
+ * @class LoopbackPeerNetwork
+ * @brief Host stand-in for Esp32PeerNetwork, discovery looks up the offers of the other devices on a LoopbackLan.
+ */
+class LoopbackPeerNetwork : public PeerNetwork
+{
+public:
+    /**
+     * @brief Constructs the peer network of a device.
+     * @param lan The network, shared by all devices.
+     * @param host The name of the device, the host of the URLs it serves under.
+     */
+    LoopbackPeerNetwork(LoopbackLan *lan, const char *host);
+
+    void offer(const PeerImage &image, ByteSource *source) override;
+    bool find(PeerImage *image, char *url, size_t capacity) override;
+
+    bool handle() override
+    {
+        return false; // The transport of the downloading device reads the source directly
+    }
+
+private:
+    LoopbackLan *lan;
+    std::string host;
+};
+
+#endif // LOOPBACK_PEER_NETWORK_H_
@@ -0,0 +1,26 @@
+#ifndef MANIFEST_BENCHMARK_H_
+#define MANIFEST_BENCHMARK_H_
+
+#include <stdint.h>
+
+/**
+ * @file ManifestBenchmark.h
+ * @brief Contains the declaration of the release manifest benchmark of the native runner.
+ */
+
+/**
+ * @brief Compares the check through the binary manifest with the check through the release JSON of the API.
+ *
+ * The release published in <root> is parsed `iterations` times from memory by the ReleaseParser and by the
+ * ManifestParser, fed in chunks of ESP32_OTA_UPDATER_PARSE_BUFFER_SIZE like the updater receives them, and both have
+ * to find the same tag, sizes and digests of the assets the updater looks up. Then one check through each path runs
+ * against the loopback transport. The bytes parsed, the parse time and the bytes transferred by the check are printed.
+ *
+ * @param root The directory the release was published to, see LoopbackHttpTransport.
+ * @param asset The firmware asset, e.g. "firmware.bin".
+ * @param iterations Number of parses of each format.
+ * @return 0 if both formats describe the same release, 1 otherwise.
+ */
+int runManifestBenchmark(const char *root, const char *asset, uint32_t iterations);
+
+#endif // MANIFEST_BENCHMARK_H_
@@ -0,0 +1,202 @@
+#ifndef MEMORY_STAND_INS_H_
+#define MEMORY_STAND_INS_H_
+
+#include "FirmwareSink.h"
+#include "HttpTransport.h"
+
+/**
+ * @file MemoryStandIns.h
+ * @brief Contains the declaration of the allocation free host stand-ins MemoryHttpTransport, MemoryFirmwareSink and
+ *        MemoryByteSource.
+ */
+
+#define MEMORY_HTTP_TRANSPORT_MAX_ROUTES 4 /**< Number of responses a MemoryHttpTransport serves. */
+#define MEMORY_HTTP_TRANSPORT_ETAG_SIZE 64 /**< Capacity of the If-None-Match value of a request. */
+
+/**
+ * @class MemoryHttpTransport
+ * @brief Host stand-in for the HTTP transport, answers requests with responses held in memory.
+ *
+ * Each route maps an exact URL to a body which is answered with 200, other URLs are answered with 404. A route added
+ * later for the same URL replaces the earlier one, e.g. to publish another release. A route with an ETag reports it and
+ * answers a request whose If-None-Match matches it with an empty 304, other headers are ignored. Nothing is allocated,
+ * so the transport does not hide the allocations of the update logic (see runAllocationCheck()).
+ */
+class MemoryHttpTransport : public HttpTransport
+{
+public:
+    /**
+     * @brief Adds a response.
+     * @param url The URL, it has to stay valid while the transport is used.
+     * @param body The body, it has to stay valid while the transport is used.
+     * @param length The length of the body.
+     * @param etag The ETag of the body, it has to stay valid while the transport is used. NULL for none.
+     * @return True if the route was added, false if MEMORY_HTTP_TRANSPORT_MAX_ROUTES is reached.
+     */
+    bool addRoute(const char *url, const uint8_t *body, size_t length, const char *etag = NULL);
+
+    bool begin(const char *url) override;
+    void addHeader(const char *name, const char *value) override;
+    void setAuthorization(const char *token) override;
+    void collectHeaders(const char *names[], size_t count) override;
+    int GET() override;
+    int getSize() override;
+    void getHeader(const char *name, char *value, size_t capacity) override;
+    int available() override;
+    bool connected() override;
+    size_t read(uint8_t *buffer, size_t size) override;
+    void end() override;
+
+    /**
+     * @brief Gets the number of body bytes read from all responses.
+     * @return The number of bytes.
+     */
+    uint64_t getBytesRead() const
+    {
+        return bytes_read;
+    }
+
+    /**
+     * @brief Gets the number of requests sent, answered or not.
+     * @return The number of requests.
+     */
+    uint32_t getRequestCount() const
+    {
+        return request_count;
+    }
+
+    /**
+     * @brief Gets the size of all bodies answered with 200, which a server sends whether they are read or not.
+     * @return The number of bytes.
+     */
+    uint64_t getBytesServed() const
+    {
+        return bytes_served;
+    }
+
+    /**
+     * @brief Gets the number of requests answered with 304.
+     * @return The number of requests.
+     */
+    uint32_t getNotModifiedCount() const
+    {
+        return not_modified_count;
+    }
+
+private:
+    struct Route
+    {
+        const char *url;
+        const uint8_t *body;
+        size_t length;
+        const char *etag;
+    };
+
+    Route routes[MEMORY_HTTP_TRANSPORT_MAX_ROUTES];
+    uint8_t route_count = 0;
+    const Route *active = nullptr; /**< The route of the current request, NULL if the URL is unknown. */
+    char if_none_match[MEMORY_HTTP_TRANSPORT_ETAG_SIZE] = {};
+    bool not_modified = false;     /**< True if the current request was answered with 304. */
+    size_t position = 0;
+    uint64_t bytes_read = 0;
+    uint64_t bytes_served = 0;
+    uint32_t request_count = 0;
+    uint32_t not_modified_count = 0;
+};
+
+/**
+ * @class MemoryFirmwareSink
+ * @brief Host stand-in for the OTA partition, writes the image into memory of the caller.
+ *
+ * Data is committed in whole sectors like the partition writer, finish() checks the ESP32 image magic byte.
+ */
+class MemoryFirmwareSink : public FirmwareSink
+{
+public:
+    /**
+     * @brief Sets the memory of the simulated partition.
+     * @param memory The memory, it has to stay valid while the sink is used.
+     * @param capacity The size of memory.
+     */
+    void setMemory(uint8_t *memory, uint32_t capacity);
+
+    uint32_t getCapacity() override;
+    bool begin(uint32_t offset = 0, uint32_t crc = 0, const uint8_t *head = NULL) override;
+    bool write(const uint8_t *data, size_t length) override;
+    bool finish() override;
+    void abort() override;
+    bool verify(uint32_t offset, uint32_t crc, const uint8_t *head) override;
+    bool read(uint32_t offset, uint8_t *data, size_t length) override;
+
+    uint32_t getCommitted() const override
+    {
+        return committed;
+    }
+
+    uint32_t getCommittedCrc() const override
+    {
+        return committed_crc;
+    }
+
+    const uint8_t *getHead() const override
+    {
+        return memory;
+    }
+
+    /**
+     * @brief Gets the number of bytes written since begin().
+     * @return The bytes written, including those which are not committed yet.
+     */
+    uint32_t getWritten() const
+    {
+        return written;
+    }
+
+    /**
+     * @brief Checks if finish() accepted the image.
+     * @return True if an image was installed, false otherwise.
+     */
+    bool isFinished() const
+    {
+        return finished;
+    }
+
+private:
+    uint8_t *memory = nullptr;
+    uint32_t capacity = 0;
+    uint32_t written = 0;   /**< Bytes written, the last sector is committed in finish(). */
+    uint32_t committed = 0;
+    uint32_t committed_crc = 0;
+    bool writing = false;
+    bool finished = false;
+
+    void commit(uint32_t end);
+};
+
+/**
+ * @class MemoryByteSource
+ * @brief Host stand-in for the running partition, reads the running image from memory of the caller.
+ */
+class MemoryByteSource : public ByteSource
+{
+public:
+    /**
+     * @brief Creates a source over memory.
+     * @param memory The memory, it has to stay valid while the source is used.
+     * @param size The size of memory.
+     */
+    MemoryByteSource(const uint8_t *memory, uint32_t size) : memory(memory), size(size) {}
+
+    bool read(uint32_t offset, uint8_t *data, size_t length) override;
+
+    uint32_t getSize() override
+    {
+        return size;
+    }
+
+private:
+    const uint8_t *memory;
+    uint32_t size;
+};
+
+#endif // MEMORY_STAND_INS_H_
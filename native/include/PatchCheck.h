@@ -0,0 +1,36 @@
+#ifndef PATCH_CHECK_H_
+#define PATCH_CHECK_H_
+
+#include <stdint.h>
+#include <vector>
+
+/**
+ * @file PatchCheck.h
+ * @brief Contains the declaration of the delta patch check of the native runner.
+ */
+
+/**
+ * @brief Creates a delta patch which moves, inserts, changes and drops parts of an image.
+ * @param running The running image, at least 8192 bytes.
+ * @param image Out: the image the patch produces.
+ * @return The patch in the format of DeltaPatcher.
+ */
+std::vector<uint8_t> createPatch(const std::vector<uint8_t> &running, std::vector<uint8_t> *image);
+
+/**
+ * @brief Applies delta patches from memory and compares the reconstructed image byte for byte.
+ *
+ * A running image of `image_size` bytes is edited into a new one: a moved block, inserted data, a range with changed
+ * bytes and a range which is dropped. The patch of these edits (COPY, INSERT and ADD operations, see DeltaPatcher.h)
+ * is applied at once, in slices of ESP32_OTA_UPDATER_POLL_SLICE_SIZE with DeltaPatcher::step() in between like the
+ * updater does, and gzip compressed through a StreamDecompressor. For the sliced patch, neither the source bytes
+ * read nor the bytes written by any write() or step() may exceed one slice. A patch applied to a different running
+ * image has to fail with SOURCE_MISMATCH before any output. The result, the number of calls and the largest call are
+ * printed.
+ *
+ * @param image_size Size of the running image.
+ * @return 0 if every patch reconstructed the image within the bound and the mismatch was detected, 1 otherwise.
+ */
+int runPatchCheck(uint32_t image_size);
+
+#endif // PATCH_CHECK_H_
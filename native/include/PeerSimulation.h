@@ -0,0 +1,35 @@
+#ifndef PEER_SIMULATION_H_
+#define PEER_SIMULATION_H_
+
+#include <stdint.h>
+
+/**
+ * @file PeerSimulation.h
+ * @brief Contains the declaration of the peer distribution simulation of the native runner.
+ */
+
+/**
+ * @brief Parameters of a peer distribution simulation.
+ */
+struct PeerSimulationConfig
+{
+    const char *root;    /**< The directory the release is served from, see LoopbackHttpTransport. */
+    const char *tag;     /**< The tag of the release. */
+    const char *asset;   /**< The firmware asset, its digest has to be known (see setPeerNetwork()). */
+    uint32_t devices;    /**< Number of devices on the local network. */
+};
+
+/**
+ * @brief Simulates devices on one local network installing a release one after the other.
+ *
+ * Every device has its own transport, flash file (next to <root>) and NVS. It installs the release from version
+ * 1.0.0, then reboots into it: a new updater with the flash file as running image offers the image on a
+ * LoopbackLan. The site is simulated twice, without and with peers, and the bytes downloaded from GitHub (WAN) and
+ * from peers (LAN) are printed after every device.
+ *
+ * @param config The parameters.
+ * @return 0 if every device installed the release and every device after the first got it from a peer, 1 otherwise.
+ */
+int runPeerSimulation(const PeerSimulationConfig &config);
+
+#endif // PEER_SIMULATION_H_
@@ -0,0 +1,30 @@
+#ifndef PIPELINE_BENCHMARK_H_
+#define PIPELINE_BENCHMARK_H_
+
+#include <stdint.h>
+
+/**
+ * @file PipelineBenchmark.h
+ * @brief Contains the declaration of the flash pipeline benchmark of the native runner.
+ */
+
+/**
+ * @brief Compares synchronous and pipelined installs over an emulated link and flash and checks the stall handling.
+ *
+ * An image of `image_size` bytes is published in memory and installed with downloadAndInstall() through a transport
+ * which delivers it at the rate of a WiFi link with TLS and a sink which takes the time of ESP32 flash for sector
+ * erases and page writes. It is installed once with synchronous writes and once through a FlashPipeline with 4 buffers
+ * on the FreeRTOS shim, and the install times, the speedup and the stall counters are printed. With a slow link the
+ * flash writer has to wait for data and erase ahead, with a slow flash the download has to wait for buffers.
+ *
+ * Then the flash hangs in the middle of the image for longer than ESP32_OTA_UPDATER_PIPELINE_WRITE_TIMEOUT: the
+ * blocking install and an install driven by poll() have to fail with OTA_INSTALL_FAILED after about the timeout, and
+ * every poll() step before the failure has to return without waiting for the flash.
+ *
+ * @param image_size Size of the image.
+ * @return 0 if the pipeline was faster, the stalls were counted on the right side and the hangs failed in time,
+ *         1 otherwise.
+ */
+int runPipelineBenchmark(uint32_t image_size);
+
+#endif // PIPELINE_BENCHMARK_H_
@@ -0,0 +1,26 @@
+#ifndef POLL_CHECK_H_
+#define POLL_CHECK_H_
+
+#include <stdint.h>
+
+/**
+ * @file PollCheck.h
+ * @brief Contains the declaration of the poll() step check of the native runner.
+ */
+
+/**
+ * @brief Checks that every poll() step stays within one slice while an update is checked for and installed.
+ *
+ * An image of `image_size` bytes is published in memory as release v1.1.0, once uncompressed, once gzip compressed
+ * and once as a delta patch from the running image, and a StaticOtaUpdater with auto install checks for and installs
+ * it by calls of poll() from a loop. For every step the bytes downloaded, read from the running image and written to
+ * the partition are counted: none may exceed ESP32_OTA_UPDATER_POLL_SLICE_SIZE, except the decoded bytes of the gzip
+ * image which are only printed. The worst and the 99th percentile step duration, the state of the worst step and the
+ * longest interval between two loop iterations are printed as well.
+ *
+ * @param image_size Size of the running image.
+ * @return 0 if every image was installed within the bound, 1 otherwise.
+ */
+int runPollCheck(uint32_t image_size);
+
+#endif // POLL_CHECK_H_
@@ -0,0 +1,49 @@
+#ifndef NATIVE_PREFERENCES_H_
+#define NATIVE_PREFERENCES_H_
+/**
+ * @file Preferences.h
+ * @brief Host stand-in for the NVS Preferences library, the values are kept in memory for the process lifetime.
+ *
+ * Simulated devices of one process get their own storage with useStorage().
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+
+class Preferences
+{
+public:
+    bool begin(const char *name, bool read_only = false, const char *partition_label = NULL);
+    void end();
+    bool clear();
+    bool remove(const char *key);
+    bool isKey(const char *key);
+
+    size_t putString(const char *key, const char *value);
+    size_t getString(const char *key, char *value, size_t max_length);
+    size_t putInt(const char *key, int32_t value);
+    int32_t getInt(const char *key, int32_t default_value = 0);
+    size_t putUInt(const char *key, uint32_t value);
+    uint32_t getUInt(const char *key, uint32_t default_value = 0);
+    size_t putBytes(const char *key, const void *value, size_t length);
+    size_t getBytes(const char *key, void *buffer, size_t max_length);
+
+    /**
+     * @brief Selects the NVS of a simulated device, later begin() calls open namespaces in it.
+     * @param name The name of the device, "" is the storage used by default.
+     */
+    static void useStorage(const char *name);
+
+private:
+    typedef std::map<std::string, std::vector<uint8_t>> Namespace;
+    Namespace *values = nullptr;
+    bool read_only = false;
+
+    size_t put(const char *key, const void *value, size_t length);
+    const std::vector<uint8_t> *get(const char *key);
+};
+
+#endif // NATIVE_PREFERENCES_H_
@@ -0,0 +1,26 @@
+#ifndef RELEASE_PARSER_BENCHMARK_H_
+#define RELEASE_PARSER_BENCHMARK_H_
+
+#include <stdint.h>
+
+/**
+ * @file ReleaseParserBenchmark.h
+ * @brief Contains the declaration of the release JSON parser benchmark of the native runner.
+ */
+
+/**
+ * @brief Measures the parse time and heap of the ReleaseParser for release payloads of increasing size.
+ *
+ * A release with the firmware, its signature and a delta patch (with digests) is padded with assets and release
+ * notes shaped like the responses of the GitHub API (see padRelease()) to 2, 16, 64 and 256 KB, with the requested
+ * assets last. Each payload is fed `iterations` times in chunks of ESP32_OTA_UPDATER_PARSE_BUFFER_SIZE, like the
+ * updater reads the response, until the parser is done. The bytes fed, the time per parse and the throughput are
+ * printed, together with the heap allocations and peak heap of a parse (see beginHeapCount()), while the parser
+ * itself has a fixed size.
+ *
+ * @param iterations Number of parses of each payload.
+ * @return 0 if every payload was parsed to the expected tag and assets without a heap allocation, 1 otherwise.
+ */
+int runReleaseParserBenchmark(uint32_t iterations);
+
+#endif // RELEASE_PARSER_BENCHMARK_H_
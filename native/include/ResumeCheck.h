@@ -0,0 +1,31 @@
+#ifndef RESUME_CHECK_H_
+#define RESUME_CHECK_H_
+
+#include <stdint.h>
+
+/**
+ * @file ResumeCheck.h
+ * @brief Contains the declaration of the interrupted download check of the native runner.
+ */
+
+/**
+ * @brief Installs a release over a connection which is cut at random points and checks that every attempt resumes.
+ *
+ * A device with its own NVS and flash file (next to <root>) installs `asset` from version 1.0.0. The first `cuts`
+ * attempts lose the download connection after a random number of bytes (at least 4 KB, at most an equal share of the
+ * image, drawn from `seed`), each attempt is a new updater like after a reboot. The last attempt is not cut. For every
+ * attempt the cut, the offset the download was resumed at and the bytes downloaded are printed.
+ *
+ * An attempt has to resume at a sector boundary no further back than the bytes received before the cut minus one
+ * checkpoint (ESP32_OTA_UPDATER_RESUME_CHECKPOINT_SIZE), the pipeline buffers and a sector, and the installed image
+ * has to match the asset byte for byte. If <root>/signing_key.pub.pem exists, the release has to be signed.
+ *
+ * @param root The directory the release is served from, see LoopbackHttpTransport.
+ * @param asset The firmware asset, uncompressed and not encrypted so it can be resumed.
+ * @param cuts Number of attempts which lose their connection.
+ * @param seed Seed of the cut points.
+ * @return 0 if every attempt resumed within the bound and the image was installed, 1 otherwise.
+ */
+int runResumeCheck(const char *root, const char *asset, uint32_t cuts, uint32_t seed);
+
+#endif // RESUME_CHECK_H_
@@ -0,0 +1,52 @@
+#ifndef UPDATE_BENCHMARK_H_
+#define UPDATE_BENCHMARK_H_
+
+#include <stdint.h>
+#include <string>
+
+/**
+ * @file UpdateBenchmark.h
+ * @brief Contains the declaration of the update path benchmark of the native runner.
+ */
+
+/**
+ * @brief Parameters of an update path benchmark.
+ */
+struct UpdateBenchmarkConfig
+{
+    const char *root;           /**< The directory the release was published to, see LoopbackHttpTransport. */
+    const char *asset;          /**< The firmware asset, e.g. "firmware.bin". */
+    const char *report;         /**< Path the JSON report is written to, NULL to only print the results. */
+    const char *baseline;       /**< Path of an earlier report the results are compared with, NULL for none. */
+    uint32_t tolerance_percent; /**< How much slower than the baseline the timings may be. */
+};
+
+/**
+ * @brief Pads a release JSON with assets and release notes like GitHub returns them, the real assets stay last.
+ * @param release The release JSON, it has to end with the release notes ("body") and have an "assets" array.
+ * @param target The size of the padded release, nothing is added if the release is not smaller.
+ * @return The padded release JSON.
+ */
+std::string padRelease(const std::string &release, size_t target);
+
+/**
+ * @brief Runs the check and install of the release in <root> in a series of network scenarios.
+ *
+ * Every scenario replays the published release JSON, padded with assets and release notes shaped like the
+ * responses of the GitHub API to 2, 16 or 64 KB, over a LoopbackNetwork: without delays, with the latency and
+ * bandwidth of WiFi and of a cellular link, with stalls and with download connections which are lost midway (the
+ * install is then repeated and resumes). Each scenario starts with an empty NVS and flash file and measures the check
+ * (available()) and the install (downloadAndInstall(), including repeated attempts): the time, the throughput of
+ * the install, the peak heap use, the response bytes, the requests and the TLS handshakes.
+ *
+ * The results are printed and written as JSON ({"asset":..,"scenarios":[{"name":..,"check_ms":..,..},..]}). With a
+ * baseline, every metric is compared with the same scenario of the earlier report: the timings may be worse by
+ * `tolerance_percent` plus a few milliseconds of scheduling noise, the heap by 10 %, the bytes by 2 % and the
+ * requests and handshakes not at all.
+ *
+ * @param config The parameters.
+ * @return 0 if every scenario installed the release without a regression, 1 otherwise.
+ */
+int runUpdateBenchmark(const UpdateBenchmarkConfig &config);
+
+#endif // UPDATE_BENCHMARK_H_
@@ -0,0 +1,24 @@
+#ifndef VERSION_BENCHMARK_H_
+#define VERSION_BENCHMARK_H_
+
+#include <stdint.h>
+
+/**
+ * @file VersionBenchmark.h
+ * @brief Contains the declaration of the Version benchmark and fuzzer of the native runner.
+ */
+
+/**
+ * @brief Checks the Version parser against SemVer 2.0.0 and compares its speed with the former sscanf parser.
+ *
+ * First the precedence example of the specification and a list of invalid versions are checked. Then `iterations`
+ * random mutations of valid versions are parsed: for every string `Version::validate()` has to agree with the
+ * constructor, valid versions have to format back to their input and the ordering of consecutive samples has to be
+ * antisymmetric. Finally the parse and compare throughput of Version and of the former class is printed.
+ *
+ * @param iterations Number of fuzzed strings.
+ * @return 0 if every check passed, 1 otherwise.
+ */
+int runVersionBenchmark(uint32_t iterations);
+
+#endif // VERSION_BENCHMARK_H_
@@ -0,0 +1,34 @@
+#ifndef NATIVE_WSTRING_H_
+#define NATIVE_WSTRING_H_
+/**
+ * @file WString.h
+ * @brief Minimal host stand-in for the Arduino String class.
+ */
+
+#include <string>
+
+class String
+{
+public:
+    String(const char *text = "") : text(text != NULL ? text : "") {}
+
+    const char *c_str() const
+    {
+        return text.c_str();
+    }
+
+    unsigned int length() const
+    {
+        return text.length();
+    }
+
+    bool operator==(const char *other) const
+    {
+        return text == other;
+    }
+
+private:
+    std::string text;
+};
+
+#endif // NATIVE_WSTRING_H_
@@ -0,0 +1,29 @@
+#ifndef NATIVE_MBEDTLS_AES_H_
+#define NATIVE_MBEDTLS_AES_H_
+/**
+ * @file aes.h
+ * @brief Host stand-in for the AES of mbedtls, implemented with the OpenSSL libcrypto of the host.
+ *
+ * Only CTR mode is provided and a context decrypts a single continuous stream, which is all the updater uses.
+ * Set OPENSSL_ia32cap="~0x200000200000000" to measure without the AES instructions of the host CPU.
+ */
+
+#include <stddef.h>
+
+typedef struct evp_cipher_ctx_st EVP_CIPHER_CTX;
+
+typedef struct
+{
+    EVP_CIPHER_CTX *cipher;
+    unsigned char key[32];
+    unsigned int keybits;
+    int started;
+} mbedtls_aes_context;
+
+void mbedtls_aes_init(mbedtls_aes_context *ctx);
+void mbedtls_aes_free(mbedtls_aes_context *ctx);
+int mbedtls_aes_setkey_enc(mbedtls_aes_context *ctx, const unsigned char *key, unsigned int keybits);
+int mbedtls_aes_crypt_ctr(mbedtls_aes_context *ctx, size_t length, size_t *nc_off, unsigned char nonce_counter[16],
+                          unsigned char stream_block[16], const unsigned char *input, unsigned char *output);
+
+#endif // NATIVE_MBEDTLS_AES_H_
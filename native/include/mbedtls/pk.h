@@ -0,0 +1,29 @@
+#ifndef NATIVE_MBEDTLS_PK_H_
+#define NATIVE_MBEDTLS_PK_H_
+/**
+ * @file pk.h
+ * @brief Host stand-in for the public key verification of mbedtls, implemented with the OpenSSL libcrypto of the host.
+ */
+
+#include <stddef.h>
+
+typedef struct evp_pkey_st EVP_PKEY;
+
+typedef enum
+{
+    MBEDTLS_MD_NONE = 0,
+    MBEDTLS_MD_SHA256 = 9
+} mbedtls_md_type_t;
+
+typedef struct
+{
+    EVP_PKEY *key;
+} mbedtls_pk_context;
+
+void mbedtls_pk_init(mbedtls_pk_context *ctx);
+void mbedtls_pk_free(mbedtls_pk_context *ctx);
+int mbedtls_pk_parse_public_key(mbedtls_pk_context *ctx, const unsigned char *key, size_t keylen);
+int mbedtls_pk_verify(mbedtls_pk_context *ctx, mbedtls_md_type_t md_alg, const unsigned char *hash, size_t hash_len,
+                      const unsigned char *sig, size_t sig_len);
+
+#endif // NATIVE_MBEDTLS_PK_H_
@@ -0,0 +1,30 @@
+#ifndef NATIVE_MBEDTLS_SHA256_H_
+#define NATIVE_MBEDTLS_SHA256_H_
+/**
+ * @file sha256.h
+ * @brief Host stand-in for the SHA-256 of mbedtls, implemented with the OpenSSL libcrypto of the host.
+ *
+ * Like the mbedtls context, the context is a plain structure which does not allocate, so it uses the low level
+ * SHA-256 functions of OpenSSL instead of the EVP interface.
+ */
+
+#include <stddef.h>
+
+#ifndef OPENSSL_SUPPRESS_DEPRECATED
+#define OPENSSL_SUPPRESS_DEPRECATED
+#endif
+#include <openssl/sha.h>
+
+typedef struct
+{
+    SHA256_CTX sha;
+    int is224;
+} mbedtls_sha256_context;
+
+void mbedtls_sha256_init(mbedtls_sha256_context *ctx);
+void mbedtls_sha256_free(mbedtls_sha256_context *ctx);
+int mbedtls_sha256_starts(mbedtls_sha256_context *ctx, int is224);
+int mbedtls_sha256_update(mbedtls_sha256_context *ctx, const unsigned char *input, size_t ilen);
+int mbedtls_sha256_finish(mbedtls_sha256_context *ctx, unsigned char *output);
+
+#endif // NATIVE_MBEDTLS_SHA256_H_
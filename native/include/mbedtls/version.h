@@ -0,0 +1,10 @@
+#ifndef NATIVE_MBEDTLS_VERSION_H_
+#define NATIVE_MBEDTLS_VERSION_H_
+/**
+ * @file version.h
+ * @brief Host stand-in for the mbedtls version, the stand-ins follow the mbedtls 3 API.
+ */
+
+#define MBEDTLS_VERSION_NUMBER 0x03000000
+
+#endif // NATIVE_MBEDTLS_VERSION_H_
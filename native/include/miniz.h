@@ -0,0 +1,57 @@
+#ifndef NATIVE_MINIZ_H_
+#define NATIVE_MINIZ_H_
+/**
+ * @file miniz.h
+ * @brief Host stand-in for the tinfl inflater of the ESP32 ROM, implemented with the zlib of the host.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <zlib.h>
+
+typedef uint8_t mz_uint8;
+typedef uint32_t mz_uint32;
+
+#define TINFL_LZ_DICT_SIZE 32768
+
+enum
+{
+    TINFL_FLAG_PARSE_ZLIB_HEADER = 1,
+    TINFL_FLAG_HAS_MORE_INPUT = 2,
+    TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF = 4,
+    TINFL_FLAG_COMPUTE_ADLER32 = 8
+};
+
+typedef enum
+{
+    TINFL_STATUS_FAILED = -1,
+    TINFL_STATUS_DONE = 0,
+    TINFL_STATUS_NEEDS_MORE_INPUT = 1,
+    TINFL_STATUS_HAS_MORE_OUTPUT = 2
+} tinfl_status;
+
+#define TINFL_ZLIB_ARENA_SIZE 45056 /**< Memory of the zlib inflate state and window, zlib needs about 40 KB. */
+
+/*
+ * Like the ROM decompressor the structure holds all memory of the inflater: zlib allocates its state and window
+ * from the arena, so the stand-in does not use the heap. The decoder state is accordingly larger than on the ESP32.
+ */
+typedef struct
+{
+    int m_state; /**< 0 before the first call, 1 while inflating, 2 when the stream ended, 3 on errors. */
+    z_stream stream;
+    size_t arena_used;
+    alignas(8) unsigned char arena[TINFL_ZLIB_ARENA_SIZE];
+} tinfl_decompressor;
+
+#define tinfl_init(r)      \
+    do                     \
+    {                      \
+        (r)->m_state = 0;  \
+    } while (0)
+
+tinfl_status tinfl_decompress(tinfl_decompressor *r, const mz_uint8 *pIn_buf_next, size_t *pIn_buf_size,
+                              mz_uint8 *pOut_buf_start, mz_uint8 *pOut_buf_next, size_t *pOut_buf_size,
+                              const mz_uint32 decomp_flags);
+
+#endif // NATIVE_MINIZ_H_
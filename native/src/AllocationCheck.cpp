@@ -0,0 +1,202 @@
+#include "AllocationCheck.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+#include <atomic>
+#include <malloc.h>
+#include <mbedtls/sha256.h>
+#include <vector>
+
+#include "ImageHeaderBenchmark.h"
+#include "MemoryStandIns.h"
+#include "StaticOtaUpdater.h"
+
+#define ALLOCATION_CHECK_PARTITION_SIZE 0x1E0000 /**< Size of the simulated OTA partition. */
+
+#ifdef __GLIBC__
+/*
+ * glibc lets the program replace malloc, the replacements count while enabled and forward to the glibc allocator.
+ * operator new allocates through malloc, so C++ allocations are counted as well.
+ */
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t count, size_t size);
+extern "C" void *__libc_realloc(void *pointer, size_t size);
+extern "C" void __libc_free(void *pointer);
+
+static std::atomic<bool> counting(false);
+static std::atomic<uint32_t> allocations(0);
+static std::atomic<uint64_t> allocated_bytes(0);
+static std::atomic<int64_t> used_bytes(0); /**< Heap in use relative to the start of the count. */
+static std::atomic<int64_t> peak_bytes(0);
+
+static void countAllocation(size_t size)
+{
+    if (counting.load(std::memory_order_relaxed))
+    {
+        allocations++;
+        allocated_bytes += size;
+    }
+}
+
+/** Tracks the heap in use by the usable size of the blocks, which includes the rounding of the allocator. */
+static void countUsage(size_t allocated, size_t released)
+{
+    if (counting.load(std::memory_order_relaxed))
+    {
+        const int64_t used = used_bytes += (int64_t)allocated - (int64_t)released;
+        int64_t peak = peak_bytes.load();
+        while (used > peak && !peak_bytes.compare_exchange_weak(peak, used))
+        {
+        }
+    }
+}
+
+extern "C" void *malloc(size_t size)
+{
+    countAllocation(size);
+    void *allocated = __libc_malloc(size);
+    countUsage(malloc_usable_size(allocated), 0);
+    return allocated;
+}
+
+extern "C" void *calloc(size_t count, size_t size)
+{
+    countAllocation(count * size);
+    void *allocated = __libc_calloc(count, size);
+    countUsage(malloc_usable_size(allocated), 0);
+    return allocated;
+}
+
+extern "C" void *realloc(void *pointer, size_t size)
+{
+    countAllocation(size);
+    const size_t released = malloc_usable_size(pointer);
+    void *allocated = __libc_realloc(pointer, size);
+    countUsage(malloc_usable_size(allocated), allocated != NULL || size == 0 ? released : 0); // A failed realloc keeps the block
+    return allocated;
+}
+
+extern "C" void free(void *pointer)
+{
+    countUsage(0, malloc_usable_size(pointer));
+    __libc_free(pointer);
+}
+#endif
+
+bool beginHeapCount()
+{
+#ifndef __GLIBC__
+    return false;
+#else
+    allocations = 0;
+    allocated_bytes = 0;
+    used_bytes = 0;
+    peak_bytes = 0;
+    counting = true;
+    return true;
+#endif
+}
+
+void endHeapCount(HeapCount *count)
+{
+#ifdef __GLIBC__
+    counting = false;
+    count->allocations = allocations;
+    count->allocated_bytes = allocated_bytes;
+    count->peak_bytes = peak_bytes;
+#else
+    *count = {};
+#endif
+}
+
+static StaticOtaUpdater<MemoryHttpTransport, MemoryFirmwareSink> *updater;
+
+static std::vector<uint8_t> gzip(const std::vector<uint8_t> &data)
+{
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    std::vector<uint8_t> compressed(compressBound(data.size()) + 32);
+    deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 9, Z_DEFAULT_STRATEGY);
+    stream.next_in = (Bytef *)data.data();
+    stream.avail_in = data.size();
+    stream.next_out = compressed.data();
+    stream.avail_out = compressed.size();
+    deflate(&stream, Z_FINISH);
+    compressed.resize(stream.total_out);
+    deflateEnd(&stream);
+    return compressed;
+}
+
+int runAllocationCheck(uint32_t image_size)
+{
+#ifndef __GLIBC__
+    printf("Counting allocations needs the malloc of glibc.\n");
+    return 1;
+#else
+    // An app image with some structure, so it compresses like firmware does
+    std::vector<uint8_t> image(image_size < FIRMWARE_SINK_HEAD_SIZE ? FIRMWARE_SINK_HEAD_SIZE : image_size);
+    uint32_t seed = 0x2545F491;
+    for (size_t i = 0; i < image.size(); i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        image[i] = (seed >> 16) % 4 == 0 ? (uint8_t)(seed >> 24) : (uint8_t)(i / 64);
+    }
+    writeAppImageHeader(image.data(), 0, 2, "1.1.0", "firmware");
+    const std::vector<uint8_t> asset = gzip(image);
+
+    uint8_t digest[32];
+    mbedtls_sha256_context context;
+    mbedtls_sha256_init(&context);
+    mbedtls_sha256_starts(&context, 0);
+    mbedtls_sha256_update(&context, asset.data(), asset.size());
+    mbedtls_sha256_finish(&context, digest);
+    mbedtls_sha256_free(&context);
+    char hex[65];
+    for (size_t i = 0; i < sizeof(digest); i++)
+    {
+        snprintf(hex + 2 * i, 3, "%02x", digest[i]);
+    }
+    char release[512];
+    const int release_length = snprintf(release, sizeof(release),
+                                        "{\"url\":\"https://api.github.com/repos/local/firmware/releases/1\",\"tag_name\":\"v1.1.0\","
+                                        "\"draft\":false,\"prerelease\":false,\"assets\":[{\"url\":\"https://api.github.com/assets/"
+                                        "firmware.bin.gz\",\"name\":\"firmware.bin.gz\",\"size\":%u,\"digest\":\"sha256:%s\"}],"
+                                        "\"body\":\"Release served from memory.\"}",
+                                        (unsigned)asset.size(), hex);
+    std::vector<uint8_t> partition(ALLOCATION_CHECK_PARTITION_SIZE);
+
+    // Usually a global, the buffers of the update path are part of the updater
+    updater = new StaticOtaUpdater<MemoryHttpTransport, MemoryFirmwareSink>("1.0.0");
+    StaticOtaUpdater<MemoryHttpTransport, MemoryFirmwareSink> &ota = *updater;
+    ota.getTransport().addRoute("https://api.github.com/repos/local/firmware/releases/latest", (const uint8_t *)release, release_length);
+    ota.getTransport().addRoute("https://api.github.com/assets/firmware.bin.gz", asset.data(), asset.size());
+    ota.getSink().setMemory(partition.data(), partition.size());
+    ota.setCheckInterval(0);
+    ota.setCheckCachePersistent(false);
+    ota.setResumableDownloads(false);
+    if (!ota.begin("local", "firmware", "firmware.bin.gz"))
+    {
+        printf("begin() failed: %s\n", ota.getErrorMessage());
+        return 1;
+    }
+
+    counting = true;
+    const bool available = ota.available();
+    const uint32_t check_allocations = allocations;
+    const bool installed = available && ota.downloadAndInstall();
+    counting = false;
+
+    const bool image_matches = installed && ota.getSink().getCommitted() == image.size() &&
+                               memcmp(partition.data(), image.data(), image.size()) == 0;
+    printf("Installed %u bytes from a %u byte gzip asset: %s, %s.\n", (unsigned)image.size(), (unsigned)asset.size(),
+           installed ? "ok" : ota.getErrorMessage(), image_matches ? "image matches" : "IMAGE DIFFERS");
+    printf("Heap allocations: check %u, install %u, %llu bytes.\n", check_allocations, allocations - check_allocations,
+           (unsigned long long)allocated_bytes);
+    printf("Updater object: %u bytes, of them %u bytes inflate workspace.\n", (unsigned)sizeof(ota),
+           (unsigned)INFLATE_DECODER_WORKSPACE_SIZE);
+    const bool passed = image_matches && allocations == 0;
+    delete updater;
+    return passed ? 0 : 1;
+#endif
+}
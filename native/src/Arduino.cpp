@@ -0,0 +1,287 @@
+#include <Arduino.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+static const std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+
+EspClass ESP;
+
+unsigned long millis()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start_time).count();
+}
+
+unsigned long micros()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_time).count();
+}
+
+void delay(unsigned long ms)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+size_t Print::write(const uint8_t *buffer, size_t size)
+{
+    size_t written = 0;
+    while (written < size && write(buffer[written]) == 1)
+    {
+        written++;
+    }
+    return written;
+}
+
+size_t Print::print(const char *text)
+{
+    return write((const uint8_t *)text, strlen(text));
+}
+
+size_t Print::println(const char *text)
+{
+    return print(text) + print("\n");
+}
+
+size_t Print::printf(const char *format, ...)
+{
+    char buffer[256];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    return print(buffer);
+}
+
+size_t StdoutPrint::write(uint8_t value)
+{
+    return fputc(value, stdout) == EOF ? 0 : 1;
+}
+
+size_t StdoutPrint::write(const uint8_t *buffer, size_t size)
+{
+    return fwrite(buffer, 1, size, stdout);
+}
+
+void EspClass::restart()
+{
+    printf("ESP.restart() called, exiting.\n");
+    exit(0);
+}
+
+uint32_t EspClass::getFreeHeap()
+{
+    return 0;
+}
+
+/*
+ * FreeRTOS
+ */
+
+/** A task, owned by its thread and by a vTaskDelete() which waits for it to stop. */
+struct NativeTask : std::enable_shared_from_this<NativeTask>
+{
+    void (*function)(void *);
+    void *parameter;
+    BaseType_t core;
+    std::mutex mutex;
+    std::condition_variable ended_condition;
+    std::atomic<bool> deleted{false};
+    bool ended = false;
+};
+
+/** A queue of fixed size items, a binary semaphore is a queue of one item without data. */
+struct NativeQueue
+{
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::vector<uint8_t> items;
+    size_t item_size;
+    size_t length;
+    size_t head = 0;
+    size_t count = 0;
+};
+
+/** Thrown at the next delay or wait of a deleted task, unwinds it to the start of its thread. */
+struct NativeTaskDeleted
+{
+};
+
+static thread_local NativeTask *current_task = nullptr;
+
+static void stopIfDeleted()
+{
+    if (current_task != nullptr && current_task->deleted)
+    {
+        throw NativeTaskDeleted();
+    }
+}
+
+/** Waits until `ready` returns true or the ticks elapsed, in steps of a tick so a deleted task stops. */
+template <typename Ready>
+static bool waitFor(NativeQueue *queue, std::unique_lock<std::mutex> &lock, TickType_t ticks, Ready ready)
+{
+    const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(ticks);
+    stopIfDeleted();
+    while (!ready())
+    {
+        if (ticks != portMAX_DELAY && std::chrono::steady_clock::now() >= deadline)
+        {
+            return false;
+        }
+        queue->changed.wait_for(lock, std::chrono::milliseconds(1));
+        stopIfDeleted();
+    }
+    return true;
+}
+
+void vPortEnterCritical(portMUX_TYPE *mux)
+{
+    while (__atomic_exchange_n(&mux->owner, 1, __ATOMIC_ACQUIRE) != 0)
+    {
+        std::this_thread::yield();
+    }
+}
+
+void vPortExitCritical(portMUX_TYPE *mux)
+{
+    __atomic_store_n(&mux->owner, 0, __ATOMIC_RELEASE);
+}
+
+BaseType_t xTaskCreatePinnedToCore(void (*task)(void *), const char *name, uint32_t stack_size, void *parameter,
+                                   UBaseType_t priority, TaskHandle_t *handle, BaseType_t core)
+{
+    std::shared_ptr<NativeTask> native_task = std::make_shared<NativeTask>();
+    native_task->function = task;
+    native_task->parameter = parameter;
+    native_task->core = core;
+    if (handle != NULL)
+    {
+        *handle = native_task.get();
+    }
+    std::thread([native_task]() {
+        current_task = native_task.get();
+        try
+        {
+            native_task->function(native_task->parameter);
+        }
+        catch (const NativeTaskDeleted &)
+        {
+        }
+        std::lock_guard<std::mutex> lock(native_task->mutex);
+        native_task->ended = true;
+        native_task->ended_condition.notify_all();
+    }).detach();
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t handle)
+{
+    NativeTask *native_task = static_cast<NativeTask *>(handle);
+    if (native_task == NULL || native_task == current_task)
+    {
+        throw NativeTaskDeleted(); // Like on FreeRTOS a task which deletes itself does not return
+    }
+    const std::shared_ptr<NativeTask> keep = native_task->shared_from_this();
+    std::unique_lock<std::mutex> lock(native_task->mutex);
+    native_task->deleted = true;
+    native_task->ended_condition.wait(lock, [native_task]() { return native_task->ended; });
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    // In steps of a tick, so a deleted task stops
+    const std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now() + std::chrono::milliseconds(ticks);
+    do
+    {
+        stopIfDeleted();
+        std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(end - std::chrono::steady_clock::now(), std::chrono::milliseconds(1)));
+    } while (std::chrono::steady_clock::now() < end);
+    stopIfDeleted();
+}
+
+BaseType_t xPortGetCoreID()
+{
+    return current_task != nullptr ? current_task->core : 0;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    NativeQueue *queue = new NativeQueue();
+    queue->items.resize(length * item_size);
+    queue->item_size = item_size;
+    queue->length = length;
+    return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue)
+{
+    delete static_cast<NativeQueue *>(queue);
+}
+
+BaseType_t xQueueSend(QueueHandle_t handle, const void *item, TickType_t ticks)
+{
+    NativeQueue *queue = static_cast<NativeQueue *>(handle);
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    if (!waitFor(queue, lock, ticks, [queue]() { return queue->count < queue->length; }))
+    {
+        return pdFALSE;
+    }
+    if (queue->item_size > 0)
+    {
+        memcpy(queue->items.data() + (queue->head + queue->count) % queue->length * queue->item_size, item, queue->item_size);
+    }
+    queue->count++;
+    queue->changed.notify_all();
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t handle, void *item, TickType_t ticks)
+{
+    NativeQueue *queue = static_cast<NativeQueue *>(handle);
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    if (!waitFor(queue, lock, ticks, [queue]() { return queue->count > 0; }))
+    {
+        return pdFALSE;
+    }
+    if (queue->item_size > 0)
+    {
+        memcpy(item, queue->items.data() + queue->head * queue->item_size, queue->item_size);
+    }
+    queue->head = (queue->head + 1) % queue->length;
+    queue->count--;
+    queue->changed.notify_all();
+    return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t handle)
+{
+    NativeQueue *queue = static_cast<NativeQueue *>(handle);
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    return queue->count;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary()
+{
+    return xQueueCreate(1, 0);
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t semaphore)
+{
+    vQueueDelete(semaphore);
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore)
+{
+    return xQueueSend(semaphore, NULL, 0);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks)
+{
+    uint8_t item;
+    return xQueueReceive(semaphore, &item, ticks);
+}
@@ -0,0 +1,142 @@
+#include "BatchCheckBenchmark.h"
+#include <Preferences.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <string>
+
+#include "BatchReleaseChecker.h"
+#include "ESP32_OTA_Updater.h"
+#include "FileFirmwareSink.h"
+#include "LoopbackHttpTransport.h"
+
+#define BATCH_CHECK_BENCHMARK_PARTITION_SIZE 0x1E0000 /**< Size of the simulated OTA partitions. */
+#define BATCH_CHECK_BENCHMARK_TOKEN "native-token"    /**< The GraphQL API requires a token, the loopback accepts any. */
+#define BATCH_CHECK_BENCHMARK_STORAGE "batch-device"  /**< The NVS of the device, shared by the updaters of all components. */
+
+struct BatchCycle
+{
+    uint32_t requests;   /**< Requests of the cycle, the batched check included. */
+    uint32_t handshakes; /**< TLS handshakes of the cycle. */
+    uint64_t bytes;      /**< Response body bytes of the cycle. */
+    uint32_t updates;    /**< Components which found an update. */
+    bool available[ESP32_OTA_UPDATER_BATCH_MAX_COMPONENTS];
+};
+
+static std::string repositoryName(uint32_t component)
+{
+    return component == 0 ? "firmware" : "firmware-" + std::to_string(component);
+}
+
+/** Runs the updater of a component, the batch result is applied first if there is one. `cached` keeps its check cache. */
+static bool checkComponent(const char *root, const char *asset, uint32_t component, const BatchComponent *batch, bool cached,
+                           BatchCycle *cycle)
+{
+    const std::string repo = repositoryName(component);
+    Preferences::useStorage(BATCH_CHECK_BENCHMARK_STORAGE);
+    LoopbackHttpTransport transport(root);
+    FileFirmwareSink firmware_sink((std::string(root) + "/batch-" + repo + ".bin").c_str(), BATCH_CHECK_BENCHMARK_PARTITION_SIZE);
+    ESP32_OTA_Updater ota(&transport, &firmware_sink, NULL, component == 0 ? "1.0.0" : "1.1.0");
+    ota.setCheckJitter(0);
+    ota.begin("local", repo.c_str(), asset, BATCH_CHECK_BENCHMARK_TOKEN);
+    if (!cached)
+    {
+        ota.clearCheckCache(); // A cycle in which the check of every component is due
+    }
+    if (batch != NULL)
+    {
+        ota.setBatchResult(*batch);
+    }
+    const bool available = ota.available();
+    cycle->requests += transport.getRequestCount();
+    cycle->handshakes += transport.getHandshakeCount();
+    cycle->bytes += transport.getBytesSent();
+    cycle->updates += available;
+    Preferences::useStorage("");
+    return available;
+}
+
+static void printCycle(const char *label, const BatchCycle &cycle)
+{
+    printf("  %-16s %3u requests, %3u TLS handshakes, %7llu bytes, %u updates found\n", label, cycle.requests, cycle.handshakes,
+           (unsigned long long)cycle.bytes, cycle.updates);
+}
+
+int runBatchCheckBenchmark(const char *root, const char *asset, uint32_t components)
+{
+    if (components == 0 || components > ESP32_OTA_UPDATER_BATCH_MAX_COMPONENTS)
+    {
+        printf("Between 1 and %u components can be checked in one batch.\n", ESP32_OTA_UPDATER_BATCH_MAX_COMPONENTS);
+        return 2;
+    }
+    // Every component is released from its own repository, they all serve the published release
+    for (uint32_t i = 1; i < components; i++)
+    {
+        const std::string link = std::string(root) + "/repos/local/" + repositoryName(i);
+        unlink(link.c_str());
+        if (symlink("firmware", link.c_str()) != 0)
+        {
+            printf("Could not create the repository %s.\n", link.c_str());
+            return 2;
+        }
+    }
+    printf("%u components with their own repository, the first one has an update.\n", components);
+
+    BatchCycle separate = {};
+    for (uint32_t i = 0; i < components; i++)
+    {
+        separate.available[i] = checkComponent(root, asset, i, NULL, false, &separate);
+    }
+    printCycle("Separate checks:", separate);
+
+    // Every updater keeps its own check cache in the NVS of the device, so none of them has to check again
+    BatchCycle cached = {};
+    for (uint32_t i = 0; i < components; i++)
+    {
+        cached.available[i] = checkComponent(root, asset, i, NULL, true, &cached);
+    }
+    printCycle("Cached checks:", cached);
+
+    LoopbackHttpTransport batch_transport(root);
+    BatchReleaseChecker checker;
+    BatchComponent batch[ESP32_OTA_UPDATER_BATCH_MAX_COMPONENTS] = {};
+    std::string repos[ESP32_OTA_UPDATER_BATCH_MAX_COMPONENTS];
+    for (uint32_t i = 0; i < components; i++)
+    {
+        repos[i] = repositoryName(i);
+        batch[i].owner = "local";
+        batch[i].repo = repos[i].c_str();
+        batch[i].asset = asset;
+        batch[i].current_version = i == 0 ? "1.0.0" : "1.1.0";
+        checker.addComponent(&batch[i]);
+    }
+    if (!checker.check(&batch_transport, BATCH_CHECK_BENCHMARK_TOKEN))
+    {
+        printf("The batched check failed with status %d%s.\n", checker.getStatusCode(), checker.isValueTooLong() ? ", a value exceeds its buffer" : "");
+        return 1;
+    }
+    BatchCycle batched = {};
+    batched.requests = batch_transport.getRequestCount();
+    batched.handshakes = batch_transport.getHandshakeCount();
+    batched.bytes = batch_transport.getBytesSent();
+    printCycle("Batched check:", batched);
+    for (uint32_t i = 0; i < components; i++)
+    {
+        batched.available[i] = checkComponent(root, asset, i, &batch[i], false, &batched);
+        printf("    %-12s %s (%d bytes)%s\n", repos[i].c_str(), batch[i].tag, batch[i].size, batch[i].newer ? ", newer" : "");
+    }
+    printCycle("With follow-ups:", batched);
+
+
+    bool same = true;
+    for (uint32_t i = 0; i < components; i++)
+    {
+        same = same && separate.available[i] == batched.available[i] && separate.available[i] == cached.available[i];
+    }
+    const uint32_t follow_ups = batched.requests - batch_transport.getRequestCount();
+    const bool passed = same && batch_transport.getRequestCount() == 1 && batch_transport.getHandshakeCount() == 1 &&
+                        follow_ups == separate.updates && cached.requests == 0;
+    printf("%s: %u requests per cycle without updates instead of %u.\n", passed ? "Passed" : "FAILED", batch_transport.getRequestCount(),
+           separate.requests);
+    return passed ? 0 : 1;
+}
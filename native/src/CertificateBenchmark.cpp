@@ -0,0 +1,339 @@
+#include "CertificateBenchmark.h"
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/sha.h>
+#include <openssl/x509.h>
+#include <Preferences.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "AllocationCheck.h"
+#include "CertificateStore.h"
+#include "ImageHeaderCheck.h"
+#include "MemoryStandIns.h"
+#include "StaticOtaUpdater.h"
+
+#define CERTIFICATE_BENCHMARK_PARTITION_SIZE 0x1E0000 /**< Size of the simulated OTA partition. */
+#define CERTIFICATE_BENCHMARK_IMAGE_SIZE 16384        /**< Size of the published app image. */
+#define CERTIFICATE_BENCHMARK_STORAGE "certificate-benchmark" /**< NVS of the simulated device. */
+
+/** A root certificate with the DER encoded subject and public key of its bundle entry. */
+struct Root
+{
+    std::string pem;
+    std::vector<uint8_t> subject;
+    std::vector<uint8_t> key;
+};
+
+/** Time and heap of the lookups of one kind of anchors. */
+struct LookupResult
+{
+    double total_us = 0;
+    int64_t peak_bytes = 0;
+    uint32_t found = 0;
+};
+
+static std::vector<uint8_t> toDer(const uint8_t *der, size_t length)
+{
+    return std::vector<uint8_t>(der, der + length);
+}
+
+static bool createRoot(uint32_t index, Root *root)
+{
+    EVP_PKEY *key = EVP_RSA_gen(2048);
+    X509 *certificate = X509_new();
+    bool created = key != NULL && certificate != NULL;
+    if (created)
+    {
+        char common_name[32];
+        snprintf(common_name, sizeof(common_name), "Native Root CA %03u", (unsigned)index);
+        X509_set_version(certificate, 2);
+        ASN1_INTEGER_set(X509_get_serialNumber(certificate), (long)index + 1);
+        X509_gmtime_adj(X509_getm_notBefore(certificate), 0);
+        X509_gmtime_adj(X509_getm_notAfter(certificate), 365L * 24 * 3600);
+        X509_NAME *name = X509_get_subject_name(certificate);
+        X509_NAME_add_entry_by_txt(name, "C", MBSTRING_ASC, (const unsigned char *)"DE", -1, -1, 0);
+        X509_NAME_add_entry_by_txt(name, "O", MBSTRING_ASC, (const unsigned char *)"Native Trust Services", -1, -1, 0);
+        X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, (const unsigned char *)common_name, -1, -1, 0);
+        X509_set_issuer_name(certificate, name);
+        X509_set_pubkey(certificate, key);
+        created = X509_sign(certificate, key, EVP_sha256()) > 0;
+    }
+    const unsigned char *subject = NULL;
+    size_t subject_length = 0;
+    unsigned char *public_key = NULL;
+    const int key_length = created ? i2d_PUBKEY(key, &public_key) : 0;
+    BIO *pem = BIO_new(BIO_s_mem());
+    created = created && key_length > 0 && pem != NULL && PEM_write_bio_X509(pem, certificate) == 1 &&
+              X509_NAME_get0_der(X509_get_subject_name(certificate), &subject, &subject_length) == 1;
+    if (created)
+    {
+        char *text = NULL;
+        const long text_length = BIO_get_mem_data(pem, &text);
+        root->pem.assign(text, text_length);
+        root->subject = toDer(subject, subject_length);
+        root->key = toDer(public_key, key_length);
+    }
+    OPENSSL_free(public_key);
+    BIO_free(pem);
+    X509_free(certificate);
+    EVP_PKEY_free(key);
+    return created;
+}
+
+/** Writes the entries of the roots as a bundle sorted by subject, see CertificateStore. */
+static std::vector<uint8_t> createBundle(std::vector<const Root *> roots)
+{
+    std::sort(roots.begin(), roots.end(), [](const Root *a, const Root *b) { return a->subject < b->subject; });
+    std::vector<uint8_t> bundle = {(uint8_t)(roots.size() >> 8), (uint8_t)roots.size()};
+    for (const Root *root : roots)
+    {
+        const uint8_t lengths[] = {(uint8_t)(root->subject.size() >> 8), (uint8_t)root->subject.size(),
+                                   (uint8_t)(root->key.size() >> 8), (uint8_t)root->key.size()};
+        bundle.insert(bundle.end(), lengths, lengths + sizeof(lengths));
+        bundle.insert(bundle.end(), root->subject.begin(), root->subject.end());
+        bundle.insert(bundle.end(), root->key.begin(), root->key.end());
+    }
+    return bundle;
+}
+
+/** Parses every certificate of the PEM string and searches the anchor, like a handshake with setCACert(). */
+static bool findInPem(const std::string &pem, const Root &root)
+{
+    BIO *bio = BIO_new_mem_buf(pem.data(), (int)pem.size());
+    std::vector<X509 *> chain;
+    for (X509 *certificate; bio != NULL && (certificate = PEM_read_bio_X509(bio, NULL, NULL, NULL)) != NULL;)
+    {
+        chain.push_back(certificate);
+    }
+    ERR_clear_error(); // The end of the string
+    bool found = false;
+    for (X509 *certificate : chain)
+    {
+        const unsigned char *subject = NULL;
+        size_t subject_length = 0;
+        if (!found && X509_NAME_get0_der(X509_get_subject_name(certificate), &subject, &subject_length) == 1 &&
+            subject_length == root.subject.size() && memcmp(subject, root.subject.data(), subject_length) == 0)
+        {
+            unsigned char *key = NULL;
+            const int key_length = i2d_PUBKEY(X509_get0_pubkey(certificate), &key);
+            found = key_length > 0 && toDer(key, key_length) == root.key;
+            OPENSSL_free(key);
+        }
+    }
+    for (X509 *certificate : chain)
+    {
+        X509_free(certificate);
+    }
+    BIO_free(bio);
+    return found;
+}
+
+/** Looks up the anchor in the store and only parses its key, like the verify callback of the bundle. */
+static bool findInStore(const CertificateStore &store, const Root &root)
+{
+    const uint8_t *key = NULL;
+    size_t key_length = 0;
+    if (!store.findAnchor(root.subject.data(), root.subject.size(), &key, &key_length))
+    {
+        return false;
+    }
+    const unsigned char *der = key;
+    EVP_PKEY *parsed = d2i_PUBKEY(NULL, &der, (long)key_length);
+    const bool found = parsed != NULL && toDer(key, key_length) == root.key;
+    EVP_PKEY_free(parsed);
+    return found;
+}
+
+template <typename Lookup>
+static LookupResult measureLookups(const std::vector<Root> &roots, uint32_t handshakes, Lookup lookup)
+{
+    LookupResult result;
+    for (uint32_t i = 0; i < handshakes; i++)
+    {
+        // Every handshake is with a server of another certificate authority
+        const Root &root = roots[(i * 7) % roots.size()];
+        beginHeapCount();
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        const bool found = lookup(root);
+        result.total_us += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        HeapCount count;
+        endHeapCount(&count);
+        result.peak_bytes = std::max(result.peak_bytes, count.peak_bytes);
+        result.found += found ? 1 : 0;
+    }
+    return result;
+}
+
+/** Signs the bundle like tools/ota_certs.py, the asset is the bundle, its SHA-256 and the signature. */
+static std::vector<uint8_t> signBundle(const std::vector<uint8_t> &bundle, EVP_PKEY *key)
+{
+    uint8_t digest[SHA256_DIGEST_LENGTH];
+    SHA256(bundle.data(), bundle.size(), digest);
+    std::vector<uint8_t> signature(EVP_PKEY_get_size(key));
+    size_t signature_length = signature.size();
+    EVP_PKEY_CTX *context = EVP_PKEY_CTX_new(key, NULL);
+    const bool signed_bundle = context != NULL && EVP_PKEY_sign_init(context) == 1 &&
+                               EVP_PKEY_CTX_set_signature_md(context, EVP_sha256()) == 1 &&
+                               EVP_PKEY_sign(context, signature.data(), &signature_length, digest, sizeof(digest)) == 1;
+    EVP_PKEY_CTX_free(context);
+    if (!signed_bundle)
+    {
+        return std::vector<uint8_t>();
+    }
+    std::vector<uint8_t> asset(bundle);
+    asset.insert(asset.end(), digest, digest + sizeof(digest));
+    asset.insert(asset.end(), signature.begin(), signature.begin() + signature_length);
+    return asset;
+}
+
+/** Installs the app and the bundle asset, returns true if the store only switched to the bundle with the app. */
+static bool installBundle(const char *name, bool valid_app, const std::vector<uint8_t> &firmware_bundle,
+                          const std::vector<uint8_t> &asset, uint16_t asset_count, const char *public_key)
+{
+    std::vector<uint8_t> image(CERTIFICATE_BENCHMARK_IMAGE_SIZE);
+    for (size_t i = 0; i < image.size(); i++)
+    {
+        image[i] = (uint8_t)(i * 31 + i / 256);
+    }
+    image[0] = valid_app ? IMAGE_HEADER_MAGIC : 0; // The sink only accepts an image with the magic byte
+    char release[640];
+    const int release_length = snprintf(release, sizeof(release),
+                                        "{\"url\":\"https://api.github.com/repos/local/firmware/releases/1\",\"tag_name\":\"v1.1.0\","
+                                        "\"draft\":false,\"prerelease\":false,\"assets\":[{\"url\":\"https://api.github.com/assets/"
+                                        "firmware.bin\",\"name\":\"firmware.bin\",\"size\":%u},{\"url\":\"https://api.github.com/"
+                                        "assets/cacerts.bin\",\"name\":\"cacerts.bin\",\"size\":%u}],\"body\":\"Release served from memory.\"}",
+                                        (unsigned)image.size(), (unsigned)asset.size());
+    std::vector<uint8_t> partition(CERTIFICATE_BENCHMARK_PARTITION_SIZE, 0xFF);
+    MemoryByteSource running_image(image.data(), image.size());
+
+    Preferences::useStorage(CERTIFICATE_BENCHMARK_STORAGE);
+    CertificateStore *store = new CertificateStore();
+    store->clear();
+    store->load(firmware_bundle.data(), firmware_bundle.size());
+    store->setSigningKey(public_key);
+    StaticOtaUpdater<MemoryHttpTransport, MemoryFirmwareSink> *updater =
+        new StaticOtaUpdater<MemoryHttpTransport, MemoryFirmwareSink>("1.0.0", &running_image);
+    StaticOtaUpdater<MemoryHttpTransport, MemoryFirmwareSink> &ota = *updater;
+    ota.getTransport().addRoute("https://api.github.com/repos/local/firmware/releases/latest", (const uint8_t *)release, release_length);
+    ota.getTransport().addRoute("https://api.github.com/assets/firmware.bin", image.data(), image.size());
+    ota.getTransport().addRoute("https://api.github.com/assets/cacerts.bin", asset.data(), asset.size());
+    ota.getSink().setMemory(partition.data(), partition.size());
+    ota.setCheckInterval(0);
+    ota.setCheckCachePersistent(false);
+    ota.setResumableDownloads(false);
+    ota.setImageHeaderCheck(false);
+    ota.addComponent("cacerts.bin", store);
+    const bool installed = ota.begin("local", "firmware", "firmware.bin") && ota.available() && ota.downloadAndInstall();
+
+    // The next boot restores an installed bundle, otherwise it keeps using the one of the firmware
+    CertificateStore *rebooted = new CertificateStore();
+    rebooted->load(firmware_bundle.data(), firmware_bundle.size());
+    const bool switched = store->isInstalled() && store->getCertificateCount() == asset_count;
+    const bool kept = !store->isInstalled() && store->getBundle() == firmware_bundle.data();
+    const bool restored = rebooted->isInstalled() && rebooted->getCertificateCount() == asset_count;
+    const bool passed = valid_app ? installed && switched && restored : !installed && kept && !rebooted->isInstalled();
+    printf("  %-12s app %-9s store uses the %s bundle (%u anchors), after a reboot the %s one: %s\n", name,
+           installed ? "installed" : "rejected", store->isInstalled() ? "installed" : "firmware", store->getCertificateCount(),
+           rebooted->isInstalled() ? "installed" : "firmware", passed ? "ok" : "WRONG BUNDLE");
+    delete updater;
+    delete rebooted;
+    store->clear();
+    delete store;
+    Preferences::useStorage("");
+    return passed;
+}
+
+int runCertificateBenchmark(uint32_t certificates, uint32_t handshakes)
+{
+    std::vector<Root> roots(certificates > 0 ? certificates : 1);
+    std::string pem;
+    for (size_t i = 0; i < roots.size(); i++)
+    {
+        if (!createRoot(i, &roots[i]))
+        {
+            printf("Creating the root certificates failed.\n");
+            return 1;
+        }
+        pem += roots[i].pem;
+    }
+    std::vector<const Root *> all;
+    for (const Root &root : roots)
+    {
+        all.push_back(&root);
+    }
+    const std::vector<uint8_t> bundle = createBundle(all);
+
+    Preferences::useStorage(CERTIFICATE_BENCHMARK_STORAGE);
+    CertificateStore *store = new CertificateStore();
+    store->clear();
+    bool passed = store->load(bundle.data(), bundle.size());
+    const bool counting = beginHeapCount();
+    HeapCount ignored;
+    endHeapCount(&ignored);
+    printf("Looking up the anchor of %u handshakes among %u root certificates (PEM %u bytes, bundle %u bytes):\n",
+           handshakes, (unsigned)roots.size(), (unsigned)pem.size(), (unsigned)bundle.size());
+    const LookupResult with_pem = measureLookups(roots, handshakes, [&pem](const Root &root) { return findInPem(pem, root); });
+    const LookupResult with_store = measureLookups(roots, handshakes, [store](const Root &root) { return findInStore(*store, root); });
+    const LookupResult *results[] = {&with_pem, &with_store};
+    const char *labels[] = {"PEM string", "store"};
+    for (uint8_t i = 0; i < 2; i++)
+    {
+        printf("  %-12s %9.1f us per handshake, %7lld bytes peak heap, %u of %u anchors found\n", labels[i],
+               handshakes > 0 ? results[i]->total_us / handshakes : 0.0, (long long)results[i]->peak_bytes, results[i]->found, handshakes);
+        passed = passed && results[i]->found == handshakes;
+    }
+    if (!counting)
+    {
+        printf("  The heap is only counted with the malloc of glibc.\n");
+    }
+    store->clear();
+    delete store;
+    Preferences::useStorage("");
+
+    // The installed bundle has to fit the buffer of the store together with its digest and signature
+    EVP_PKEY *signing_key = EVP_RSA_gen(2048);
+    BIO *public_key = BIO_new(BIO_s_mem());
+    std::vector<const Root *> installed_roots;
+    std::vector<uint8_t> installed_bundle = createBundle(installed_roots);
+    for (const Root &root : roots)
+    {
+        installed_roots.push_back(&root);
+        std::vector<uint8_t> larger = createBundle(installed_roots);
+        if (larger.size() > ESP32_OTA_UPDATER_CERT_BUNDLE_SIZE)
+        {
+            installed_roots.pop_back();
+            break;
+        }
+        installed_bundle.swap(larger);
+    }
+    char *public_key_pem = NULL;
+    std::string key_text;
+    if (signing_key != NULL && public_key != NULL && PEM_write_bio_PUBKEY(public_key, signing_key) == 1)
+    {
+        const long key_length = BIO_get_mem_data(public_key, &public_key_pem);
+        key_text.assign(public_key_pem, key_length);
+    }
+    const std::vector<uint8_t> asset = signing_key != NULL ? signBundle(installed_bundle, signing_key) : std::vector<uint8_t>();
+    const std::vector<uint8_t> firmware_bundle = createBundle(std::vector<const Root *>(1, &roots[0]));
+    if (installed_roots.empty() || asset.empty() || key_text.empty())
+    {
+        printf("Creating the signed bundle failed.\n");
+        passed = false;
+    }
+    else
+    {
+        printf("Installing a signed bundle of %u anchors with the app:\n", (unsigned)installed_roots.size());
+        passed = installBundle("invalid app", false, firmware_bundle, asset, installed_roots.size(), key_text.c_str()) && passed;
+        passed = installBundle("valid app", true, firmware_bundle, asset, installed_roots.size(), key_text.c_str()) && passed;
+    }
+    BIO_free(public_key);
+    EVP_PKEY_free(signing_key);
+    printf("%s\n", passed ? "Passed." : "FAILED.");
+    return passed ? 0 : 1;
+}
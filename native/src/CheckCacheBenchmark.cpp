@@ -0,0 +1,164 @@
+#include "CheckCacheBenchmark.h"
+#include <Arduino.h>
+#include <Preferences.h>
+#include <stdio.h>
+#include <string>
+
+#include "MemoryStandIns.h"
+#include "StaticOtaUpdater.h"
+
+#define CHECK_CACHE_BENCHMARK_STORAGE "check-cache" /**< NVS of the simulated device. */
+#define CHECK_CACHE_BENCHMARK_NOTES_SIZE 8192        /**< Size of the release notes of the padded release JSON. */
+#define CHECK_CACHE_BENCHMARK_INTERVAL_MS 200        /**< Check interval of the interval case. */
+#define CHECK_CACHE_BENCHMARK_POLL_MS 10             /**< Time between two polls of the interval case. */
+
+/** A release published in memory. */
+struct PublishedRelease
+{
+    std::string json;
+    const char *etag;
+};
+
+/** A case of repeated checks. */
+struct CheckCase
+{
+    const char *name;
+    const char *repo;        /**< Every case has its own repository, so its check cache and schedule start over. */
+    bool etags;              /**< True if the server sends ETags. */
+    bool reboot;             /**< True to keep the check cache of the previous case of the repository. */
+    unsigned long interval_ms;
+    uint32_t poll_ms;        /**< Time between two polls. */
+    bool async;              /**< True to check with startCheck() and poll() instead of available(). */
+    bool new_release;        /**< True to publish v1.2.0 after half of the polls. */
+};
+
+/** Requests and bytes of the polls of a case. */
+struct CheckCount
+{
+    uint32_t requests;
+    uint32_t not_modified;
+    uint64_t served; /**< Body bytes of the 200 responses. */
+    uint64_t read;   /**< Body bytes the updater read, it stops once the release is parsed. */
+    uint32_t found;
+};
+
+static PublishedRelease createRelease(const char *repo, const char *tag, const char *etag)
+{
+    std::string notes;
+    while (notes.size() < CHECK_CACHE_BENCHMARK_NOTES_SIZE)
+    {
+        notes += "* Fixed a bug in the handling of the sensor configuration.\\n";
+    }
+    char head[512];
+    snprintf(head, sizeof(head),
+             "{\"url\":\"https://api.github.com/repos/local/%s/releases/1\",\"tag_name\":\"%s\",\"draft\":false,"
+             "\"prerelease\":false,\"assets\":[{\"url\":\"https://api.github.com/assets/firmware.bin\",\"name\":\"firmware.bin\","
+             "\"size\":1048576}],\"body\":\"",
+             repo, tag);
+    return PublishedRelease{head + notes + "\"}", etag};
+}
+
+/** Checks for the release of a case `polls` times. */
+static CheckCount runCase(const CheckCase &check_case, uint32_t polls)
+{
+    const PublishedRelease first = createRelease(check_case.repo, "v1.1.0", check_case.etags ? "\"release-1\"" : NULL);
+    const PublishedRelease second = createRelease(check_case.repo, "v1.2.0", check_case.etags ? "\"release-2\"" : NULL);
+    const std::string url = std::string("https://api.github.com/repos/local/") + check_case.repo + "/releases/latest";
+
+    StaticOtaUpdater<MemoryHttpTransport, MemoryFirmwareSink> *updater = new StaticOtaUpdater<MemoryHttpTransport, MemoryFirmwareSink>("1.0.0");
+    StaticOtaUpdater<MemoryHttpTransport, MemoryFirmwareSink> &ota = *updater;
+    MemoryHttpTransport &transport = ota.getTransport();
+    transport.addRoute(url.c_str(), (const uint8_t *)first.json.data(), first.json.size(), first.etag);
+    ota.setCheckInterval(check_case.interval_ms);
+    ota.setCheckJitter(0);
+    ota.begin("local", check_case.repo, "firmware.bin");
+    if (!check_case.reboot)
+    {
+        ota.clearCheckCache();
+    }
+
+    CheckCount count = {};
+    const unsigned long start = millis();
+    for (uint32_t i = 0; i < polls; i++)
+    {
+        if (check_case.new_release && i == polls / 2)
+        {
+            transport.addRoute(url.c_str(), (const uint8_t *)second.json.data(), second.json.size(), second.etag);
+        }
+        bool available = false;
+        if (check_case.async)
+        {
+            ESP32_OTA_Updater_State state = ota.startCheck() ? ota.poll() : ota.getState();
+            while (state == ESP32_OTA_Updater_State::OTA_CHECKING)
+            {
+                state = ota.poll();
+            }
+            available = state == ESP32_OTA_Updater_State::OTA_UPDATE_AVAILABLE;
+        }
+        else
+        {
+            available = ota.available();
+        }
+        count.found += available ? 1 : 0;
+        // The polls follow a fixed clock, so the time the checks take does not add up to another interval
+        const unsigned long next = start + (i + 1) * check_case.poll_ms;
+        const unsigned long now = millis();
+        delay(next > now ? next - now : 0);
+    }
+    count.requests = transport.getRequestCount();
+    count.not_modified = transport.getNotModifiedCount();
+    count.served = transport.getBytesServed();
+    count.read = transport.getBytesRead();
+    delete updater;
+    return count;
+}
+
+int runCheckCacheBenchmark(uint32_t polls)
+{
+    polls = polls < 2 ? 2 : polls;
+    const CheckCase cases[] = {
+        {"no ETag", "no-etag", false, false, 0, 0, false, false},
+        {"ETag", "etag", true, false, 0, 0, false, false},
+        {"reboot", "etag", true, true, 0, 0, false, false},
+        {"interval", "interval", true, false, CHECK_CACHE_BENCHMARK_INTERVAL_MS, CHECK_CACHE_BENCHMARK_POLL_MS, false, false},
+        {"poll()", "poll", true, false, 0, 0, true, false},
+        {"new release", "new-release", true, false, 0, 0, false, true},
+    };
+    const size_t release_size = createRelease("firmware", "v1.1.0", NULL).json.size();
+
+    Preferences::useStorage(CHECK_CACHE_BENCHMARK_STORAGE);
+    bool passed = true;
+    printf("Checking %u times for a release of about %u bytes:\n", polls, (unsigned)release_size);
+    for (const CheckCase &check_case : cases)
+    {
+        const CheckCount count = runCase(check_case, polls);
+        const size_t first_size = createRelease(check_case.repo, "v1.1.0", NULL).json.size();
+        uint32_t max_requests = polls;
+        uint64_t max_bytes = first_size;
+        if (!check_case.etags)
+        {
+            max_bytes = (uint64_t)polls * first_size;
+        }
+        else if (check_case.reboot)
+        {
+            max_bytes = 0;
+        }
+        else if (check_case.new_release)
+        {
+            max_bytes = first_size + createRelease(check_case.repo, "v1.2.0", NULL).json.size();
+        }
+        if (check_case.interval_ms > 0)
+        {
+            // One check at the start and one per interval which begins before the last poll
+            max_requests = (polls * check_case.poll_ms - 1) / check_case.interval_ms + 1;
+        }
+        const bool bounded = count.requests <= max_requests && count.served <= max_bytes && count.found == polls;
+        printf("  %-12s %5u requests, %5u answered 304, %9llu bytes served, %7llu read, %u of %u polls found the update%s\n",
+               check_case.name, count.requests, count.not_modified, (unsigned long long)count.served, (unsigned long long)count.read,
+               count.found, polls, bounded ? "" : ", MORE THAN EXPECTED");
+        passed = passed && bounded;
+    }
+    Preferences::useStorage("");
+    printf("%s\n", passed ? "Passed." : "FAILED.");
+    return passed ? 0 : 1;
+}
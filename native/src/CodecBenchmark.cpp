@@ -0,0 +1,211 @@
+#include "CodecBenchmark.h"
+#include <stdio.h>
+#include <string.h>
+#include <zlib.h>
+#include <chrono>
+#include <vector>
+
+#include "ESP32_OTA_Updater_Config.h"
+#include "StreamDecompressor.h"
+
+/** Compares the decoded data with the image. */
+class CompareSink : public ByteSink
+{
+public:
+    explicit CompareSink(const std::vector<uint8_t> &expected) : expected(expected) {}
+
+    bool write(const uint8_t *data, size_t length) override
+    {
+        matches = matches && offset + length <= expected.size() && memcmp(expected.data() + offset, data, length) == 0;
+        offset += length;
+        return true;
+    }
+
+    const std::vector<uint8_t> &expected;
+    size_t offset = 0;
+    bool matches = true;
+};
+
+/** Packs values most significant bit first, like the heatshrink encoder. */
+class BitWriter
+{
+public:
+    std::vector<uint8_t> bytes;
+
+    void put(uint32_t value, uint8_t bits)
+    {
+        for (int8_t bit = bits - 1; bit >= 0; bit--)
+        {
+            current = (uint8_t)(current << 1 | ((value >> bit) & 1));
+            if (++used == 8)
+            {
+                bytes.push_back(current);
+                used = 0;
+            }
+        }
+    }
+
+    /** Pads the last byte with zero bits. */
+    void finish()
+    {
+        if (used > 0)
+        {
+            bytes.push_back((uint8_t)(current << (8 - used)));
+            used = 0;
+        }
+    }
+
+private:
+    uint8_t current = 0;
+    uint8_t used = 0;
+};
+
+static std::vector<uint8_t> deflateImage(const std::vector<uint8_t> &data, bool zlib)
+{
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    std::vector<uint8_t> compressed(compressBound(data.size()) + 32);
+    deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, zlib ? 15 : 15 + 16, 9, Z_DEFAULT_STRATEGY);
+    stream.next_in = (Bytef *)data.data();
+    stream.avail_in = data.size();
+    stream.next_out = compressed.data();
+    stream.avail_out = compressed.size();
+    deflate(&stream, Z_FINISH);
+    compressed.resize(stream.total_out);
+    deflateEnd(&stream);
+    return compressed;
+}
+
+/** Greedy LZSS in the heatshrink format, the last byte is always a literal. */
+static std::vector<uint8_t> heatshrinkImage(const std::vector<uint8_t> &data)
+{
+    const size_t window = 1 << ESP32_OTA_UPDATER_HEATSHRINK_WINDOW_BITS;
+    const size_t lookahead = 1 << ESP32_OTA_UPDATER_HEATSHRINK_LOOKAHEAD_BITS;
+    std::vector<int32_t> head(1 << 16, -1);
+    std::vector<int32_t> previous(data.size(), -1);
+    BitWriter out;
+    size_t i = 0;
+    while (i < data.size())
+    {
+        const size_t longest = data.size() - 1 - i < lookahead ? data.size() - 1 - i : lookahead;
+        size_t best_length = 0;
+        size_t best_offset = 0;
+        if (longest >= 2)
+        {
+            int32_t candidate = head[data[i] << 8 | data[i + 1]];
+            for (uint8_t tries = 0; candidate >= 0 && i - candidate <= window && tries < 64; tries++)
+            {
+                size_t length = 0;
+                while (length < longest && data[candidate + length] == data[i + length])
+                {
+                    length++;
+                }
+                if (length > best_length)
+                {
+                    best_length = length;
+                    best_offset = i - candidate;
+                }
+                candidate = previous[candidate];
+            }
+        }
+        // A back-reference takes 16 bits with the default parameters, two literals 18
+        const size_t step = best_length >= 2 ? best_length : 1;
+        if (step > 1)
+        {
+            out.put(0, 1);
+            out.put(best_offset - 1, ESP32_OTA_UPDATER_HEATSHRINK_WINDOW_BITS);
+            out.put(best_length - 1, ESP32_OTA_UPDATER_HEATSHRINK_LOOKAHEAD_BITS);
+        }
+        else
+        {
+            out.put(1, 1);
+            out.put(data[i], 8);
+        }
+        for (size_t end = i + step; i < end; i++)
+        {
+            if (i + 1 < data.size())
+            {
+                const uint16_t key = data[i] << 8 | data[i + 1];
+                previous[i] = head[key];
+                head[key] = (int32_t)i;
+            }
+        }
+    }
+    out.finish();
+    return out.bytes;
+}
+
+/** Decodes a stream in poll() slices, returns true if it was complete and decoded to the image. */
+static bool decode(StreamDecompressor &decompressor, StreamDecompressor::Codec codec, const uint8_t *stream, size_t length,
+                   const std::vector<uint8_t> &image)
+{
+    CompareSink sink(image);
+    bool ok = decompressor.begin(codec, &sink);
+    for (size_t offset = 0; offset < length && ok; offset += ESP32_OTA_UPDATER_POLL_SLICE_SIZE)
+    {
+        const size_t slice = length - offset < ESP32_OTA_UPDATER_POLL_SLICE_SIZE ? length - offset : ESP32_OTA_UPDATER_POLL_SLICE_SIZE;
+        ok = decompressor.write(stream + offset, slice);
+    }
+    ok = ok && decompressor.finish();
+    decompressor.end();
+    return ok && sink.matches && sink.offset == image.size();
+}
+
+int runCodecBenchmark(uint32_t image_size, uint32_t rounds)
+{
+    // An image with some structure, so it compresses like firmware does
+    std::vector<uint8_t> image(image_size > 2 ? image_size : 2);
+    uint32_t seed = 0x2545F491;
+    for (size_t i = 0; i < image.size(); i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        image[i] = (seed >> 16) % 4 == 0 ? (uint8_t)(seed >> 24) : (uint8_t)(i / 64);
+    }
+    struct CodecCase
+    {
+        const char *asset;
+        std::vector<uint8_t> stream;
+    };
+    const CodecCase cases[] = {
+        {"firmware.bin", image},
+        {"firmware.bin.gz", deflateImage(image, false)},
+        {"firmware.bin.zz", deflateImage(image, true)},
+        {"firmware.bin.hs", heatshrinkImage(image)},
+    };
+
+    StreamDecompressor decompressor;
+    bool passed = true;
+    printf("Decoding a %u byte image %u times in slices of %u bytes:\n", (unsigned)image.size(), rounds,
+           (unsigned)ESP32_OTA_UPDATER_POLL_SLICE_SIZE);
+    for (const CodecCase &codec_case : cases)
+    {
+        const StreamDecompressor::Codec codec = StreamDecompressor::codecFromName(codec_case.asset);
+        bool decoded = true;
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (uint32_t round = 0; round < rounds && decoded; round++)
+        {
+            decoded = decode(decompressor, codec, codec_case.stream.data(), codec_case.stream.size(), image);
+        }
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        // Uncompressed streams have no end marker, the size check of the updater catches them
+        const bool cut_detected = codec == StreamDecompressor::CODEC_NONE ||
+                                  !decode(decompressor, codec, codec_case.stream.data(), codec_case.stream.size() - 1, image);
+        printf("  %-16s %9u bytes %6.1f %% %8.1f MB/s, cut off stream %s\n", codec_case.asset, (unsigned)codec_case.stream.size(),
+               100.0 * codec_case.stream.size() / image.size(), decoded ? image.size() * (double)rounds / seconds / 1e6 : 0.0,
+               codec == StreamDecompressor::CODEC_NONE ? "not checked" : cut_detected ? "fails" : "ACCEPTED");
+        passed = passed && decoded && cut_detected;
+    }
+
+    // Only the name decides, an uncompressed image is never taken for a gzip or zlib stream
+    std::vector<uint8_t> gzip_like(image);
+    gzip_like[0] = 0x1F;
+    gzip_like[1] = 0x8B;
+    const bool passed_through = StreamDecompressor::codecFromName("firmware") == StreamDecompressor::CODEC_NONE &&
+                                StreamDecompressor::codecFromName("firmware.bin.gz.enc") == StreamDecompressor::CODEC_GZIP &&
+                                decode(decompressor, StreamDecompressor::codecFromName("firmware.bin"), gzip_like.data(),
+                                       gzip_like.size(), gzip_like);
+    printf("Uncompressed image starting like gzip: %s.\n", passed_through ? "passed through" : "MISTAKEN FOR GZIP");
+    passed = passed && passed_through;
+    printf("%s\n", passed ? "Passed." : "FAILED.");
+    return passed ? 0 : 1;
+}
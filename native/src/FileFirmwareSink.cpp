@@ -0,0 +1,166 @@
+#include <FileFirmwareSink.h>
+#include <string.h>
+#include <unistd.h>
+
+#define ESP_IMAGE_MAGIC 0xE9
+
+FileFirmwareSink::FileFirmwareSink(const char *path, uint32_t capacity, bool app_image)
+    : path(path), capacity(capacity), app_image(app_image)
+{
+}
+
+FileFirmwareSink::~FileFirmwareSink()
+{
+    abort();
+}
+
+uint32_t FileFirmwareSink::getCapacity()
+{
+    return capacity;
+}
+
+bool FileFirmwareSink::begin(uint32_t offset, uint32_t crc, const uint8_t *head)
+{
+    abort();
+    if (offset % FIRMWARE_SINK_SECTOR_SIZE != 0 || offset >= capacity || (offset > 0 && head == NULL))
+    {
+        return false;
+    }
+    file = fopen(path.c_str(), offset > 0 ? "r+b" : "w+b");
+    if (file == NULL || ftruncate(fileno(file), offset) != 0 || fseek(file, offset, SEEK_SET) != 0)
+    {
+        abort();
+        return false;
+    }
+    buffer_length = 0;
+    committed = offset;
+    committed_crc = crc;
+    if (head != NULL)
+    {
+        memcpy(this->head, head, FIRMWARE_SINK_HEAD_SIZE);
+    }
+    return true;
+}
+
+bool FileFirmwareSink::write(const uint8_t *data, size_t length)
+{
+    if (file == NULL)
+    {
+        return false;
+    }
+    while (length > 0)
+    {
+        size_t chunk = FIRMWARE_SINK_SECTOR_SIZE - buffer_length;
+        chunk = chunk < length ? chunk : length;
+        memcpy(buffer + buffer_length, data, chunk);
+        buffer_length += chunk;
+        data += chunk;
+        length -= chunk;
+        if (buffer_length == FIRMWARE_SINK_SECTOR_SIZE && !flush())
+        {
+            abort();
+            return false;
+        }
+    }
+    return true;
+}
+
+bool FileFirmwareSink::flush()
+{
+    if (committed + buffer_length > capacity || fwrite(buffer, 1, buffer_length, file) != buffer_length || fflush(file) != 0)
+    {
+        return false;
+    }
+    if (committed == 0)
+    {
+        memcpy(head, buffer, buffer_length < FIRMWARE_SINK_HEAD_SIZE ? buffer_length : FIRMWARE_SINK_HEAD_SIZE);
+    }
+    committed_crc = Crc32::update(committed_crc, buffer, buffer_length);
+    committed += buffer_length;
+    buffer_length = 0;
+    return true;
+}
+
+bool FileFirmwareSink::finish()
+{
+    if (file == NULL)
+    {
+        return false;
+    }
+    const bool success = (buffer_length == 0 || flush()) && committed >= FIRMWARE_SINK_HEAD_SIZE &&
+                         (!app_image || head[0] == ESP_IMAGE_MAGIC);
+    abort();
+    return success;
+}
+
+void FileFirmwareSink::abort()
+{
+    if (file != NULL)
+    {
+        fclose(file);
+        file = nullptr;
+    }
+    buffer_length = 0;
+}
+
+bool FileFirmwareSink::read(uint32_t offset, uint8_t *data, size_t length)
+{
+    // Committed sectors are flushed to the file, so they can be read without moving the write position
+    return file != NULL && offset + length <= committed && pread(fileno(file), data, length, offset) == (ssize_t)length;
+}
+
+bool FileFirmwareSink::verify(uint32_t offset, uint32_t crc, const uint8_t *head)
+{
+    FILE *stored = fopen(path.c_str(), "rb");
+    if (stored == NULL)
+    {
+        return false;
+    }
+    uint32_t stored_crc = 0;
+    uint8_t chunk[256];
+    uint32_t position = 0;
+    bool head_matches = true;
+    while (position < offset)
+    {
+        const size_t length = offset - position < sizeof(chunk) ? offset - position : sizeof(chunk);
+        if (fread(chunk, 1, length, stored) != length)
+        {
+            break;
+        }
+        if (position == 0)
+        {
+            head_matches = length >= FIRMWARE_SINK_HEAD_SIZE && memcmp(chunk, head, FIRMWARE_SINK_HEAD_SIZE) == 0;
+        }
+        stored_crc = Crc32::update(stored_crc, chunk, length);
+        position += length;
+    }
+    fclose(stored);
+    return position == offset && head_matches && stored_crc == crc;
+}
+
+FileByteSource::FileByteSource(const char *path)
+{
+    file = fopen(path, "rb");
+}
+
+FileByteSource::~FileByteSource()
+{
+    if (file != NULL)
+    {
+        fclose(file);
+    }
+}
+
+bool FileByteSource::read(uint32_t offset, uint8_t *data, size_t length)
+{
+    return file != NULL && fseek(file, offset, SEEK_SET) == 0 && fread(data, 1, length, file) == length;
+}
+
+uint32_t FileByteSource::getSize()
+{
+    if (file == NULL || fseek(file, 0, SEEK_END) != 0)
+    {
+        return 0;
+    }
+    return ftell(file);
+}
@@ -0,0 +1,190 @@
+#include "FleetSimulation.h"
+#include <stdio.h>
+#include <functional>
+#include <queue>
+#include <string>
+#include <vector>
+
+#include "CheckScheduler.h"
+#include "LoopbackHttpTransport.h"
+
+#define FLEET_SIMULATION_START_MS 1700000000000LL /**< Simulated time of the power up, Unix time in ms. */
+#define FLEET_SIMULATION_NAIVE_RETRY_MS 10000     /**< Retry delay of the naive devices after any failure. */
+
+struct SimulatedDevice
+{
+    char id[24];
+    char etag[64];
+    CheckSchedule schedule;
+    CheckScheduler scheduler;
+    bool checked; /**< True once a check succeeded. */
+};
+
+struct FleetResult
+{
+    std::vector<uint32_t> requests; /**< API requests per hour. */
+    std::vector<uint32_t> rejected; /**< Requests per hour answered with 403. */
+    int64_t converged_ms;           /**< Time until every device completed a check, -1 if some never did. */
+};
+
+typedef std::pair<int64_t, uint32_t> FleetEvent; /**< Time a device checks next, and its index. */
+
+static FleetResult simulate(const FleetSimulationConfig &config, bool scheduled)
+{
+    LoopbackRateLimit rate_limit = {config.limit, 3600, FLEET_SIMULATION_START_MS, 0, 0, 0};
+    LoopbackHttpTransport transport(config.root);
+    transport.setRateLimit(&rate_limit);
+    const char *url = "https://api.github.com/repos/local/firmware/releases/latest";
+    const char *response_headers[] = {"ETag", "X-RateLimit-Remaining", "X-RateLimit-Reset", "Retry-After", "Date"};
+
+    FleetResult result;
+    result.requests.assign(config.hours, 0);
+    result.rejected.assign(config.hours, 0);
+    result.converged_ms = -1;
+
+    // The devices are not moved after begin(), each scheduler points to the schedule next to it
+    std::vector<SimulatedDevice> devices(config.devices);
+    std::priority_queue<FleetEvent, std::vector<FleetEvent>, std::greater<FleetEvent>> events;
+    for (uint32_t i = 0; i < config.devices; i++)
+    {
+        SimulatedDevice &device = devices[i];
+        snprintf(device.id, sizeof(device.id), "device-%05u", i);
+        device.etag[0] = '\0';
+        device.schedule = {};
+        device.checked = false;
+        device.scheduler.setInterval(config.interval_s * 1000);
+        device.scheduler.setJitter(scheduled ? config.jitter_s * 1000 : 0);
+        device.scheduler.begin(&device.schedule, FLEET_SIMULATION_START_MS, device.id);
+        events.push(FleetEvent(FLEET_SIMULATION_START_MS + device.scheduler.getTimeUntilDue(FLEET_SIMULATION_START_MS), i));
+    }
+
+    const int64_t end_ms = FLEET_SIMULATION_START_MS + (int64_t)config.hours * 3600000LL;
+    uint32_t unchecked = config.devices;
+    while (!events.empty() && events.top().first < end_ms)
+    {
+        const int64_t now = events.top().first;
+        const uint32_t index = events.top().second;
+        SimulatedDevice &device = devices[index];
+        events.pop();
+
+        // The same request and header handling as ESP32_OTA_Updater::beginCheck()
+        rate_limit.now_ms = now;
+        transport.begin(url);
+        transport.addHeader("Accept", "application/vnd.github+json");
+        if (device.etag[0] != '\0')
+        {
+            transport.addHeader("If-None-Match", device.etag);
+        }
+        transport.collectHeaders(response_headers, 5);
+        const int code = transport.GET();
+        char remaining[12];
+        char reset[16];
+        char retry_after[12];
+        char date[32];
+        transport.getHeader("X-RateLimit-Remaining", remaining, sizeof(remaining));
+        transport.getHeader("X-RateLimit-Reset", reset, sizeof(reset));
+        transport.getHeader("Retry-After", retry_after, sizeof(retry_after));
+        transport.getHeader("Date", date, sizeof(date));
+        if (code == 200)
+        {
+            transport.getHeader("ETag", device.etag, sizeof(device.etag));
+        }
+        transport.end();
+
+        const uint32_t hour = (uint32_t)((now - FLEET_SIMULATION_START_MS) / 3600000LL);
+        result.requests[hour]++;
+        const bool success = code == 200 || code == 304;
+        if (!success)
+        {
+            result.rejected[hour]++;
+        }
+        else if (!device.checked)
+        {
+            device.checked = true;
+            if (--unchecked == 0)
+            {
+                result.converged_ms = now - FLEET_SIMULATION_START_MS;
+            }
+        }
+
+        int64_t next;
+        if (scheduled)
+        {
+            device.scheduler.onRateLimit(remaining, reset, retry_after, date);
+            if (success)
+            {
+                device.scheduler.onSuccess(now);
+            }
+            else
+            {
+                device.scheduler.onFailure(now, CheckScheduler::FAILURE_SERVER);
+            }
+            next = now + device.scheduler.getTimeUntilDue(now);
+        }
+        else
+        {
+            next = now + (success ? (int64_t)config.interval_s * 1000 : FLEET_SIMULATION_NAIVE_RETRY_MS);
+        }
+        events.push(FleetEvent(next, index));
+    }
+    return result;
+}
+
+static void printResult(const char *name, const FleetSimulationConfig &config, const FleetResult &result)
+{
+    printf("%s:\n", name);
+    uint64_t requests = 0;
+    uint64_t rejected = 0;
+    for (uint32_t hour = 0; hour < config.hours; hour++)
+    {
+        printf("  hour %3u: %8u requests %8u rejected%s\n", hour, result.requests[hour], result.rejected[hour],
+               result.requests[hour] > config.limit ? "  over the limit" : "");
+        requests += result.requests[hour];
+        rejected += result.rejected[hour];
+    }
+    printf("  total: %llu requests, %llu rejected, ", (unsigned long long)requests, (unsigned long long)rejected);
+    if (result.converged_ms >= 0)
+    {
+        printf("every device checked after %lld s\n", (long long)(result.converged_ms / 1000));
+    }
+    else
+    {
+        printf("some devices never checked\n");
+    }
+}
+
+int runFleetSimulation(const FleetSimulationConfig &config)
+{
+    printf("%u devices, %u requests per hour, check interval %u s, jitter %u s, %u hours.\n", config.devices,
+           config.limit, config.interval_s, config.jitter_s, config.hours);
+    const FleetResult naive = simulate(config, false);
+    printResult("Naive (no jitter, retry after 10 s, rate limit headers ignored)", config, naive);
+    const FleetResult scheduled = simulate(config, true);
+    printResult("CheckScheduler", config, scheduled);
+
+    // Raising the percentage of a staged rollout only adds devices
+    uint32_t included_10 = 0;
+    uint32_t included_50 = 0;
+    uint32_t included_both = 0;
+    for (uint32_t i = 0; i < config.devices; i++)
+    {
+        char id[24];
+        snprintf(id, sizeof(id), "device-%05u", i);
+        const bool in_10 = CheckScheduler::inRollout(id, "v1.1.0", 10);
+        const bool in_50 = CheckScheduler::inRollout(id, "v1.1.0", 50);
+        included_10 += in_10;
+        included_50 += in_50;
+        included_both += in_10 && in_50;
+    }
+    printf("Staged rollout of v1.1.0: %u devices at 10%%, %u at 50%%, %u of the first stay included.\n", included_10,
+           included_50, included_both);
+
+    for (uint32_t hour = 0; hour < config.hours; hour++)
+    {
+        if (scheduled.requests[hour] > config.limit)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,146 @@
+#include "ImageHeaderBenchmark.h"
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "ImageHeaderCheck.h"
+#include "MemoryStandIns.h"
+#include "StaticOtaUpdater.h"
+
+#define IMAGE_HEADER_BENCHMARK_PARTITION_SIZE 0x1E0000 /**< Size of the simulated OTA partition. */
+#define IMAGE_HEADER_BENCHMARK_CHIP_ESP32 0             /**< esp_chip_id_t of the ESP32. */
+#define IMAGE_HEADER_BENCHMARK_CHIP_ESP32S3 9           /**< esp_chip_id_t of the ESP32-S3. */
+#define IMAGE_HEADER_BENCHMARK_FLASH_4MB 2              /**< esp_image_flash_size_t of 4 MB. */
+#define IMAGE_HEADER_BENCHMARK_FLASH_16MB 4             /**< esp_image_flash_size_t of 16 MB. */
+#define IMAGE_HEADER_BENCHMARK_PROJECT "firmware"       /**< Project name of the running image. */
+
+struct HeaderCase
+{
+    const char *name;
+    uint16_t chip_id;
+    uint8_t flash_size;
+    const char *version;
+    const char *project_name;
+    bool app_image;     /**< False to publish data without an app header. */
+    bool version_check; /**< True to require a newer embedded version. */
+    bool truncated;     /**< True to publish only the first half of the header. */
+    bool valid;         /**< True if the image has to be installed. */
+};
+
+static void writeLittleEndian(uint8_t *data, uint32_t value, uint8_t bytes)
+{
+    for (uint8_t i = 0; i < bytes; i++)
+    {
+        data[i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+void writeAppImageHeader(uint8_t *image, uint16_t chip_id, uint8_t flash_size, const char *version, const char *project_name)
+{
+    memset(image, 0, IMAGE_HEADER_CHECK_SIZE);
+    // esp_image_header_t: 6 segments, DIO, 40 MHz, the entry point in IRAM, no WP pin
+    image[0] = IMAGE_HEADER_MAGIC;
+    image[1] = 6;
+    image[2] = 2;
+    image[3] = (uint8_t)(flash_size << 4);
+    writeLittleEndian(image + 4, 0x40081000, 4);
+    image[8] = 0xEE;
+    writeLittleEndian(image + 12, chip_id, 2);
+    // The first segment is the DROM segment which starts with esp_app_desc_t
+    writeLittleEndian(image + IMAGE_HEADER_SIZE, 0x3F400020, 4);
+    writeLittleEndian(image + IMAGE_HEADER_SIZE + 4, 0x1000, 4);
+    writeLittleEndian(image + IMAGE_APP_DESC_OFFSET, IMAGE_APP_DESC_MAGIC, 4);
+    strncpy((char *)image + IMAGE_APP_DESC_OFFSET + 16, version, IMAGE_APP_DESC_STRING_SIZE);
+    strncpy((char *)image + IMAGE_APP_DESC_OFFSET + 16 + IMAGE_APP_DESC_STRING_SIZE, project_name, IMAGE_APP_DESC_STRING_SIZE);
+}
+
+/** Installs the image of a case, returns true if the outcome is the expected one. */
+static bool runCase(const HeaderCase &header_case, const std::vector<uint8_t> &running, std::vector<uint8_t> image)
+{
+    if (header_case.app_image)
+    {
+        writeAppImageHeader(image.data(), header_case.chip_id, header_case.flash_size, header_case.version, header_case.project_name);
+    }
+    else
+    {
+        memset(image.data(), 0, IMAGE_HEADER_CHECK_SIZE); // E.g. a file system image published under the wrong name
+    }
+    if (header_case.truncated)
+    {
+        image.resize(IMAGE_HEADER_CHECK_SIZE / 2);
+    }
+    char release[512];
+    const int release_length = snprintf(release, sizeof(release),
+                                        "{\"url\":\"https://api.github.com/repos/local/firmware/releases/1\",\"tag_name\":\"v1.1.0\","
+                                        "\"draft\":false,\"prerelease\":false,\"assets\":[{\"url\":\"https://api.github.com/assets/"
+                                        "firmware.bin\",\"name\":\"firmware.bin\",\"size\":%u}],\"body\":\"Release served from memory.\"}",
+                                        (unsigned)image.size());
+    std::vector<uint8_t> partition(IMAGE_HEADER_BENCHMARK_PARTITION_SIZE, 0xFF);
+    MemoryByteSource running_image(running.data(), running.size());
+
+    StaticOtaUpdater<MemoryHttpTransport, MemoryFirmwareSink> *updater =
+        new StaticOtaUpdater<MemoryHttpTransport, MemoryFirmwareSink>("1.0.0", &running_image);
+    StaticOtaUpdater<MemoryHttpTransport, MemoryFirmwareSink> &ota = *updater;
+    ota.getTransport().addRoute("https://api.github.com/repos/local/firmware/releases/latest", (const uint8_t *)release, release_length);
+    ota.getTransport().addRoute("https://api.github.com/assets/firmware.bin", image.data(), image.size());
+    ota.getSink().setMemory(partition.data(), partition.size());
+    ota.setCheckInterval(0);
+    ota.setCheckCachePersistent(false);
+    ota.setResumableDownloads(false);
+    ota.setImageHeaderCheck(true, header_case.version_check);
+    bool installed = false;
+    uint64_t downloaded = 0;
+    if (ota.begin("local", "firmware", "firmware.bin") && ota.available())
+    {
+        const uint64_t checked = ota.getTransport().getBytesRead();
+        installed = ota.downloadAndInstall();
+        downloaded = ota.getTransport().getBytesRead() - checked;
+    }
+
+    bool untouched = true;
+    for (size_t i = 0; i < partition.size() && untouched; i++)
+    {
+        untouched = partition[i] == 0xFF;
+    }
+    const bool passed = header_case.valid ? installed && memcmp(partition.data(), image.data(), image.size()) == 0
+                                          : !installed && untouched && (downloaded < image.size() || header_case.truncated);
+    printf("%-16s %-9s %8llu of %u bytes downloaded, partition %s: %s\n", header_case.name,
+           installed ? "installed" : "rejected", (unsigned long long)downloaded, (unsigned)image.size(),
+           untouched ? "untouched" : "written", installed ? "ok" : ota.getErrorMessage());
+    delete updater;
+    return passed;
+}
+
+int runImageHeaderBenchmark(uint32_t image_size)
+{
+    const HeaderCase cases[] = {
+        {"valid image", IMAGE_HEADER_BENCHMARK_CHIP_ESP32, IMAGE_HEADER_BENCHMARK_FLASH_4MB, "1.1.0", IMAGE_HEADER_BENCHMARK_PROJECT, true, true, false, true},
+        {"no app header", IMAGE_HEADER_BENCHMARK_CHIP_ESP32, IMAGE_HEADER_BENCHMARK_FLASH_4MB, "1.1.0", IMAGE_HEADER_BENCHMARK_PROJECT, false, false, false, false},
+        {"another chip", IMAGE_HEADER_BENCHMARK_CHIP_ESP32S3, IMAGE_HEADER_BENCHMARK_FLASH_4MB, "1.1.0", IMAGE_HEADER_BENCHMARK_PROJECT, true, false, false, false},
+        {"larger flash", IMAGE_HEADER_BENCHMARK_CHIP_ESP32, IMAGE_HEADER_BENCHMARK_FLASH_16MB, "1.1.0", IMAGE_HEADER_BENCHMARK_PROJECT, true, false, false, false},
+        {"another project", IMAGE_HEADER_BENCHMARK_CHIP_ESP32, IMAGE_HEADER_BENCHMARK_FLASH_4MB, "1.1.0", "gateway", true, false, false, false},
+        {"older version", IMAGE_HEADER_BENCHMARK_CHIP_ESP32, IMAGE_HEADER_BENCHMARK_FLASH_4MB, "0.9.0", IMAGE_HEADER_BENCHMARK_PROJECT, true, true, false, false},
+        {"truncated", IMAGE_HEADER_BENCHMARK_CHIP_ESP32, IMAGE_HEADER_BENCHMARK_FLASH_4MB, "1.1.0", IMAGE_HEADER_BENCHMARK_PROJECT, true, false, true, false},
+    };
+
+    // Images with some structure, the running one differs from the published one
+    std::vector<uint8_t> image(image_size < FIRMWARE_SINK_HEAD_SIZE ? FIRMWARE_SINK_HEAD_SIZE : image_size);
+    std::vector<uint8_t> running(image.size());
+    uint32_t seed = 0x2545F491;
+    for (size_t i = 0; i < image.size(); i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        image[i] = (seed >> 16) % 4 == 0 ? (uint8_t)(seed >> 24) : (uint8_t)(i / 64);
+        running[i] = (uint8_t)(image[i] ^ (i % 512 == 0 ? 0x5A : 0));
+    }
+    writeAppImageHeader(running.data(), IMAGE_HEADER_BENCHMARK_CHIP_ESP32, IMAGE_HEADER_BENCHMARK_FLASH_4MB, "1.0.0",
+                        IMAGE_HEADER_BENCHMARK_PROJECT);
+
+    bool passed = true;
+    for (const HeaderCase &header_case : cases)
+    {
+        passed = runCase(header_case, running, image) && passed;
+    }
+    printf("%s\n", passed ? "Passed." : "FAILED.");
+    return passed ? 0 : 1;
+}
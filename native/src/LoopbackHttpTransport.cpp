@@ -0,0 +1,477 @@
+#include <LoopbackHttpTransport.h>
+#include <stdlib.h>
+#include <fstream>
+#include <sstream>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <thread>
+
+#include "ReleaseParser.h"
+
+LoopbackHttpTransport::LoopbackHttpTransport(const char *root) : root(root)
+{
+}
+
+LoopbackHttpTransport::~LoopbackHttpTransport()
+{
+    end();
+}
+
+bool LoopbackHttpTransport::begin(const char *url)
+{
+    end();
+    const char *scheme_end = strstr(url, "://");
+    if (scheme_end == NULL)
+    {
+        return false;
+    }
+    const char *path_start = strchr(scheme_end + 3, '/');
+    if (path_start == NULL)
+    {
+        return false;
+    }
+    host = std::string(scheme_end + 3, path_start);
+    const size_t path_length = strcspn(path_start, "?#");
+    path = root + std::string(path_start, path_length);
+    struct stat info;
+    if (stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode))
+    {
+        const char *page = path_start[path_length] == '?' ? strstr(path_start + path_length, "page=") : NULL;
+        while (page != NULL && page[-1] != '?' && page[-1] != '&')
+        {
+            page = strstr(page + 1, "page="); // Skips "per_page="
+        }
+        path += "/page-" + std::to_string(page != NULL ? atoi(page + 5) : 1);
+    }
+    request_headers.clear();
+    for (Header &header : response_headers)
+    {
+        header.second.clear();
+    }
+    return true;
+}
+
+void LoopbackHttpTransport::addHeader(const char *name, const char *value)
+{
+    request_headers.push_back(Header(name, value));
+}
+
+void LoopbackHttpTransport::setAuthorization(const char *token)
+{
+    addHeader("Authorization", (std::string("Bearer ") + token).c_str());
+}
+
+void LoopbackHttpTransport::collectHeaders(const char *names[], size_t count)
+{
+    response_headers.clear();
+    for (size_t i = 0; i < count; i++)
+    {
+        response_headers.push_back(Header(names[i], ""));
+    }
+}
+
+int LoopbackHttpTransport::GET()
+{
+    request_count++;
+    memset(&timing, 0, sizeof(timing));
+    const LoopbackLan::Offer *offer = lan != NULL ? lan->find(host) : NULL;
+    if (offer != NULL)
+    {
+        return servePeer(*offer);
+    }
+    timing.reused = useConnection(host);
+    emulateRequest(timing.reused);
+    if (path.compare(root.length(), 8, "/assets/") == 0 || path.find("/releases/download/", root.length()) != std::string::npos ||
+        path.find("/releases/latest/download/", root.length()) != std::string::npos)
+    {
+        timing.reused = useConnection("objects.loopback"); // The redirect to the download server
+        timing.redirects = 1;
+        host = "objects.loopback";
+        emulateRequest(timing.reused);
+    }
+    if (rate_limit != NULL && host == "api.github.com" && !countRequest())
+    {
+        size = 0;
+        return 403;
+    }
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0 || !S_ISREG(info.st_mode))
+    {
+        size = 0;
+        return 404;
+    }
+
+    char etag[64];
+    snprintf(etag, sizeof(etag), "\"%lx-%lx\"", (unsigned long)info.st_size, (unsigned long)info.st_mtime);
+    char content_range[80] = "";
+    long start = 0;
+    const char *if_none_match = requestHeader("If-None-Match");
+    const char *range = requestHeader("Range");
+    int code = 200;
+    if (if_none_match != NULL && strcmp(if_none_match, etag) == 0)
+    {
+        code = 304;
+    }
+    else if (range != NULL && sscanf(range, "bytes=%ld-", &start) == 1 && start > 0)
+    {
+        if (start >= info.st_size)
+        {
+            size = 0;
+            return 416;
+        }
+        code = 206;
+        snprintf(content_range, sizeof(content_range), "bytes %ld-%ld/%ld", start, (long)info.st_size - 1, (long)info.st_size);
+    }
+
+    setResponseHeader("ETag", etag);
+    setResponseHeader("Content-Range", content_range);
+    if (code == 304)
+    {
+        size = 0;
+        return code;
+    }
+
+    file = fopen(path.c_str(), "rb");
+    if (file == NULL || fseek(file, start, SEEK_SET) != 0)
+    {
+        end();
+        return -1;
+    }
+    size = info.st_size - start;
+    remaining = size;
+    return code;
+}
+
+int LoopbackHttpTransport::POST(const uint8_t *body, size_t length)
+{
+    request_count++;
+    memset(&timing, 0, sizeof(timing));
+    timing.reused = useConnection(host);
+    emulateRequest(timing.reused);
+    if (rate_limit != NULL && host == "api.github.com" && !countRequest())
+    {
+        size = 0;
+        return 403;
+    }
+    if (path.compare(root.length(), std::string::npos, "/graphql") != 0)
+    {
+        size = 0;
+        return 404;
+    }
+    if (requestHeader("Authorization") == NULL)
+    {
+        size = 0;
+        return 401; // Like GitHub, the GraphQL API is not available without a token
+    }
+
+    // The answer is served from a temporary file like every other response
+    const std::string response = answerQuery(std::string((const char *)body, length));
+    file = tmpfile();
+    if (file == NULL || fwrite(response.data(), 1, response.size(), file) != response.size() || fseek(file, 0, SEEK_SET) != 0)
+    {
+        end();
+        return -1;
+    }
+    size = response.size();
+    remaining = size;
+    return 200;
+}
+
+/** Gets the value of a string argument, e.g. owner:\"name\" of the query in a JSON string. */
+static std::string queryArgument(const std::string &query, size_t from, const char *name)
+{
+    const std::string start = std::string(name) + ":\\\"";
+    const size_t value_start = query.find(start, from);
+    if (value_start == std::string::npos)
+    {
+        return "";
+    }
+    const size_t value_end = query.find("\\\"", value_start + start.size());
+    return value_end == std::string::npos ? "" : query.substr(value_start + start.size(), value_end - value_start - start.size());
+}
+
+std::string LoopbackHttpTransport::answerQuery(const std::string &query) const
+{
+    std::string data;
+    std::string errors;
+    for (size_t field = query.find(":repository("); field != std::string::npos; field = query.find(":repository(", field + 1))
+    {
+        const size_t alias_start = query.find_last_of("{ ", field) + 1;
+        const std::string alias = query.substr(alias_start, field - alias_start);
+        const std::string owner = queryArgument(query, field, "owner");
+        const std::string repo = queryArgument(query, field, "name");
+        const size_t assets = query.find("releaseAssets(", field);
+        const std::string asset_name = assets != std::string::npos ? queryArgument(query, assets, "name") : "";
+        data += (data.empty() ? "\"" : ",\"") + alias + "\":";
+
+        struct stat info;
+        if (stat((root + "/repos/" + owner + "/" + repo).c_str(), &info) != 0)
+        {
+            data += "null";
+            errors += std::string(errors.empty() ? "" : ",") + "{\"type\":\"NOT_FOUND\",\"path\":[\"" + alias +
+                      "\"],\"message\":\"Could not resolve to a Repository with the name '" + owner + "/" + repo + "'.\"}";
+            continue;
+        }
+        std::ifstream latest((root + "/repos/" + owner + "/" + repo + "/releases/latest").c_str(), std::ios::binary);
+        std::stringstream release;
+        release << latest.rdbuf();
+        const std::string json = release.str();
+        ReleaseParser parser;
+        ReleaseAsset asset = {};
+        asset.name = asset_name.c_str();
+        parser.begin();
+        parser.addAsset(&asset);
+        parser.feed((const uint8_t *)json.data(), json.size());
+        if (!parser.hasTag())
+        {
+            data += "{\"latestRelease\":null}";
+            continue;
+        }
+        data += std::string("{\"latestRelease\":{\"tagName\":\"") + parser.getTag() + "\",\"releaseAssets\":{\"nodes\":[";
+        if (asset.found)
+        {
+            data += "{\"size\":" + std::to_string(asset.size) + ",\"downloadUrl\":\"https://github.com/" + owner + "/" + repo +
+                    "/releases/download/" + parser.getTag() + "/" + asset_name + "\"}";
+        }
+        data += "]}}}";
+    }
+    return "{\"data\":{" + data + "}" + (errors.empty() ? "" : ",\"errors\":[" + errors + "]") + "}";
+}
+
+int LoopbackHttpTransport::servePeer(const LoopbackLan::Offer &offer)
+{
+    // A peer answers one request per connection and without TLS, so there is no handshake to count
+    char expected[2 * PEER_IMAGE_DIGEST_SIZE + 6] = "/ota/";
+    offer.image.formatDigest(expected + 5);
+    if (path.compare(root.length(), std::string::npos, expected) != 0)
+    {
+        size = 0;
+        return 404;
+    }
+    lan_source = offer.source;
+    lan_offset = 0;
+    size = offer.image.size;
+    remaining = size;
+    return 200;
+}
+
+int LoopbackHttpTransport::getSize()
+{
+    return chunked && size > 0 ? -1 : size;
+}
+
+void LoopbackHttpTransport::getHeader(const char *name, char *value, size_t capacity)
+{
+    value[0] = '\0';
+    for (const Header &header : response_headers)
+    {
+        if (strcasecmp(header.first.c_str(), name) == 0 && header.second.size() < capacity)
+        {
+            memcpy(value, header.second.c_str(), header.second.size() + 1);
+        }
+    }
+}
+
+int LoopbackHttpTransport::available()
+{
+    return file != NULL || lan_source != NULL ? (int)remaining : 0;
+}
+
+bool LoopbackHttpTransport::connected()
+{
+    return (file != NULL || lan_source != NULL) && remaining > 0;
+}
+
+size_t LoopbackHttpTransport::read(uint8_t *buffer, size_t size)
+{
+    if (lan_source != NULL)
+    {
+        const size_t length = size < (size_t)remaining ? size : (size_t)remaining;
+        if (!lan_source->read(lan_offset, buffer, length))
+        {
+            return 0;
+        }
+        lan_offset += length;
+        remaining -= length;
+        lan_bytes_sent += length;
+        return length;
+    }
+    if (file == NULL)
+    {
+        return 0;
+    }
+    size = emulateTransfer(size < (size_t)remaining ? size : (size_t)remaining);
+    if (file == NULL)
+    {
+        return 0; // The connection was lost
+    }
+    const size_t received = fread(buffer, 1, size, file);
+    remaining -= received;
+    bytes_sent += received;
+    response_bytes += received;
+    return received;
+}
+
+void LoopbackHttpTransport::end()
+{
+    if (lan_source != NULL)
+    {
+        lan_source = nullptr; // The peer closes the connection after the response
+        remaining = 0;
+        return;
+    }
+    if (file != NULL)
+    {
+        fclose(file);
+        file = nullptr;
+    }
+    // A short rest of the body is received to keep the connection, otherwise it is closed
+    if (remaining > ESP32_OTA_UPDATER_HTTP_DRAIN_LIMIT || !keep_alive)
+    {
+        for (size_t i = 0; i < open_hosts.size(); i++)
+        {
+            if (open_hosts[i] == host)
+            {
+                open_hosts.erase(open_hosts.begin() + i);
+                break;
+            }
+        }
+    }
+    else
+    {
+        bytes_sent += remaining;
+    }
+    remaining = 0;
+}
+
+bool LoopbackHttpTransport::useConnection(const std::string &host)
+{
+    for (size_t i = 0; i < open_hosts.size(); i++)
+    {
+        if (open_hosts[i] == host)
+        {
+            open_hosts.erase(open_hosts.begin() + i);
+            open_hosts.push_back(host);
+            return true;
+        }
+    }
+    handshake_count++;
+    if (!keep_alive)
+    {
+        return false;
+    }
+    if (open_hosts.size() == ESP32_OTA_UPDATER_HTTP_CONNECTIONS)
+    {
+        open_hosts.erase(open_hosts.begin());
+    }
+    open_hosts.push_back(host);
+    return false;
+}
+
+void LoopbackHttpTransport::emulateRequest(bool reused)
+{
+    response_bytes = 0;
+    if (network != nullptr)
+    {
+        const uint32_t connect_ms = reused ? 0 : 2 * network->latency_ms; // TCP and TLS handshake
+        timing.connect_ms += connect_ms;
+        timing.ttfb_ms += network->latency_ms;
+        std::this_thread::sleep_for(std::chrono::milliseconds(connect_ms + network->latency_ms));
+    }
+    response_start = std::chrono::steady_clock::now();
+}
+
+size_t LoopbackHttpTransport::emulateTransfer(size_t size)
+{
+    if (network == nullptr || size == 0)
+    {
+        return size;
+    }
+    if (network->disconnect_after > 0 && network->disconnects > 0 && host == "objects.loopback")
+    {
+        if (response_bytes >= network->disconnect_after)
+        {
+            network->disconnects--;
+            fclose(file);
+            file = nullptr;
+            remaining = 0;
+            for (size_t i = 0; i < open_hosts.size(); i++)
+            {
+                if (open_hosts[i] == host)
+                {
+                    open_hosts.erase(open_hosts.begin() + i);
+                    break;
+                }
+            }
+            return 0;
+        }
+        size = size < network->disconnect_after - response_bytes ? size : network->disconnect_after - response_bytes;
+    }
+    if (network->stall_interval > 0 && (response_bytes + size) / network->stall_interval > response_bytes / network->stall_interval)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(network->stall_ms));
+        response_start += std::chrono::milliseconds(network->stall_ms); // The stall does not count as transfer time
+    }
+    if (network->bytes_per_second > 0)
+    {
+        // The bytes arrive when the bandwidth allows it since the start of the response
+        const uint64_t arrival_us = (response_bytes + size) * 1000000 / network->bytes_per_second;
+        std::this_thread::sleep_until(response_start + std::chrono::microseconds(arrival_us));
+    }
+    return size;
+}
+
+bool LoopbackHttpTransport::countRequest()
+{
+    const int64_t now_s = rate_limit->now_ms / 1000;
+    if (now_s >= rate_limit->reset_s)
+    {
+        rate_limit->reset_s = now_s + rate_limit->window_s;
+        rate_limit->used = 0;
+    }
+    const bool accepted = rate_limit->used < rate_limit->limit;
+    if (accepted)
+    {
+        rate_limit->used++;
+    }
+    else
+    {
+        rate_limit->rejected++;
+    }
+
+    char date[32];
+    const time_t now = (time_t)now_s;
+    struct tm utc;
+    gmtime_r(&now, &utc);
+    strftime(date, sizeof(date), "%a, %d %b %Y %H:%M:%S GMT", &utc);
+    setResponseHeader("Date", date);
+    setResponseHeader("X-RateLimit-Limit", std::to_string(rate_limit->limit));
+    setResponseHeader("X-RateLimit-Remaining", std::to_string(rate_limit->limit - rate_limit->used));
+    setResponseHeader("X-RateLimit-Reset", std::to_string(rate_limit->reset_s));
+    return accepted;
+}
+
+void LoopbackHttpTransport::setResponseHeader(const char *name, const std::string &value)
+{
+    for (Header &header : response_headers)
+    {
+        if (strcasecmp(header.first.c_str(), name) == 0)
+        {
+            header.second = value;
+        }
+    }
+}
+
+const char *LoopbackHttpTransport::requestHeader(const char *name) const
+{
+    for (const Header &header : request_headers)
+    {
+        if (strcasecmp(header.first.c_str(), name) == 0)
+        {
+            return header.second.c_str();
+        }
+    }
+    return NULL;
+}
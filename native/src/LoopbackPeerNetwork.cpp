@@ -0,0 +1,48 @@
+#include "LoopbackPeerNetwork.h"
+#include <stdio.h>
+
+const LoopbackLan::Offer *LoopbackLan::find(const std::string &host) const
+{
+    for (const Offer &offer : offers)
+    {
+        if (offer.host == host)
+        {
+            return &offer;
+        }
+    }
+    return NULL;
+}
+
+LoopbackPeerNetwork::LoopbackPeerNetwork(LoopbackLan *lan, const char *host) : lan(lan), host(host)
+{
+}
+
+void LoopbackPeerNetwork::offer(const PeerImage &image, ByteSource *source)
+{
+    for (LoopbackLan::Offer &offer : lan->offers)
+    {
+        if (offer.host == host)
+        {
+            offer.image = image;
+            offer.source = source;
+            return;
+        }
+    }
+    lan->offers.push_back({host, image, source});
+}
+
+bool LoopbackPeerNetwork::find(PeerImage *image, char *url, size_t capacity)
+{
+    for (const LoopbackLan::Offer &offer : lan->offers)
+    {
+        if (offer.host != host && offer.image.matches(*image))
+        {
+            char hex[2 * PEER_IMAGE_DIGEST_SIZE + 1];
+            image->formatDigest(hex);
+            image->size = offer.image.size;
+            snprintf(url, capacity, "http://%s/ota/%s", offer.host.c_str(), hex);
+            return true;
+        }
+    }
+    return false;
+}
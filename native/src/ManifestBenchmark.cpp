@@ -0,0 +1,161 @@
+#include "ManifestBenchmark.h"
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "ESP32_OTA_Updater.h"
+#include "FileFirmwareSink.h"
+#include "LoopbackHttpTransport.h"
+#include "ManifestParser.h"
+#include "ReleaseParser.h"
+
+#define MANIFEST_BENCHMARK_ASSETS 3 /**< The firmware, the delta patch and the signature, like the updater requests. */
+
+struct ParsedRelease
+{
+    ReleaseAsset assets[MANIFEST_BENCHMARK_ASSETS];
+    char tag[ESP32_OTA_UPDATER_SHORTSTRING_LENGTH];
+    size_t bytes;   /**< Bytes fed until the parser was done. */
+    bool valid;     /**< True if the parse succeeded. */
+};
+
+static std::string readFile(const std::string &path)
+{
+    std::ifstream file(path.c_str(), std::ios::binary);
+    std::stringstream content;
+    content << file.rdbuf();
+    return content.str();
+}
+
+static void prepareAssets(ParsedRelease *release, const char *patterns[])
+{
+    for (uint8_t i = 0; i < MANIFEST_BENCHMARK_ASSETS; i++)
+    {
+        release->assets[i].name = patterns[i];
+    }
+    release->bytes = 0;
+}
+
+static void parseJson(ReleaseParser &parser, const std::string &json, const char *patterns[], ParsedRelease *release)
+{
+    prepareAssets(release, patterns);
+    parser.begin();
+    for (uint8_t i = 0; i < MANIFEST_BENCHMARK_ASSETS; i++)
+    {
+        parser.addAsset(&release->assets[i]);
+    }
+    while (release->bytes < json.size() && parser.getStatus() == JsonStreamScanner::SCANNING)
+    {
+        const size_t length = json.size() - release->bytes < ESP32_OTA_UPDATER_PARSE_BUFFER_SIZE ? json.size() - release->bytes
+                                                                                                  : ESP32_OTA_UPDATER_PARSE_BUFFER_SIZE;
+        parser.feed((const uint8_t *)json.data() + release->bytes, length);
+        release->bytes += length;
+    }
+    release->valid = parser.getStatus() != JsonStreamScanner::FAILED && parser.hasTag();
+    strncpy(release->tag, parser.getTag(), sizeof(release->tag));
+}
+
+static void parseManifest(ManifestParser &parser, const std::string &manifest, const char *patterns[], ParsedRelease *release)
+{
+    prepareAssets(release, patterns);
+    parser.begin("https://github.com/local/firmware/releases/download");
+    for (uint8_t i = 0; i < MANIFEST_BENCHMARK_ASSETS; i++)
+    {
+        parser.addAsset(&release->assets[i]);
+    }
+    while (release->bytes < manifest.size() && parser.getStatus() == ManifestParser::SCANNING)
+    {
+        const size_t length = manifest.size() - release->bytes < ESP32_OTA_UPDATER_PARSE_BUFFER_SIZE ? manifest.size() - release->bytes
+                                                                                                      : ESP32_OTA_UPDATER_PARSE_BUFFER_SIZE;
+        parser.feed((const uint8_t *)manifest.data() + release->bytes, length);
+        release->bytes += length;
+    }
+    release->valid = parser.getStatus() == ManifestParser::FINISHED;
+    strncpy(release->tag, parser.getTag(), sizeof(release->tag));
+}
+
+static bool sameRelease(const ParsedRelease &json, const ParsedRelease &manifest)
+{
+    if (!json.valid || !manifest.valid || strcmp(json.tag, manifest.tag) != 0)
+    {
+        return false;
+    }
+    for (uint8_t i = 0; i < MANIFEST_BENCHMARK_ASSETS; i++)
+    {
+        const ReleaseAsset &a = json.assets[i];
+        const ReleaseAsset &b = manifest.assets[i];
+        if (a.found != b.found || (a.found && (a.size != b.size || a.has_digest != b.has_digest ||
+                                               (a.has_digest && memcmp(a.digest, b.digest, RELEASE_ASSET_DIGEST_SIZE) != 0))))
+        {
+            printf("Asset %s differs.\n", a.name);
+            return false;
+        }
+    }
+    return true;
+}
+
+static uint64_t checkBytes(const char *root, const char *asset, bool manifest, uint32_t *requests)
+{
+    LoopbackHttpTransport transport(root);
+    FileFirmwareSink firmware_sink("/dev/null", 0);
+    ESP32_OTA_Updater ota(&transport, &firmware_sink, NULL, "1.0.0");
+    ota.setCheckInterval(0);
+    ota.setCheckCachePersistent(false);
+    if (manifest)
+    {
+        ota.setManifest("manifest.bin");
+    }
+    ota.begin("local", "firmware", asset);
+    ota.available();
+    *requests = transport.getRequestCount();
+    return transport.getBytesSent();
+}
+
+int runManifestBenchmark(const char *root, const char *asset, uint32_t iterations)
+{
+    const std::string json = readFile(std::string(root) + "/repos/local/firmware/releases/latest");
+    const std::string manifest = readFile(std::string(root) + "/local/firmware/releases/latest/download/manifest.bin");
+
+    // The patterns the updater builds in begin() for a device running 1.0.0
+    char patch_pattern[ESP32_OTA_UPDATER_SHORTSTRING_LENGTH];
+    char signature_name[ESP32_OTA_UPDATER_SHORTSTRING_LENGTH];
+    const int stem_length = strchr(asset, '.') != NULL ? strchr(asset, '.') - asset : strlen(asset);
+    snprintf(patch_pattern, sizeof(patch_pattern), "%.*s-1.0.0-*.patch*", stem_length, asset);
+    snprintf(signature_name, sizeof(signature_name), "%.*s.sig", stem_length, asset);
+    const char *patterns[MANIFEST_BENCHMARK_ASSETS] = {asset, patch_pattern, signature_name};
+
+    ReleaseParser release_parser;
+    ManifestParser manifest_parser;
+    ParsedRelease from_json;
+    ParsedRelease from_manifest;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < iterations; i++)
+    {
+        parseJson(release_parser, json, patterns, &from_json);
+    }
+    const double json_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / iterations;
+    start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < iterations; i++)
+    {
+        parseManifest(manifest_parser, manifest, patterns, &from_manifest);
+    }
+    const double manifest_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / iterations;
+
+    uint32_t json_requests = 0;
+    uint32_t manifest_requests = 0;
+    const uint64_t json_check = checkBytes(root, asset, false, &json_requests);
+    const uint64_t manifest_check = checkBytes(root, asset, true, &manifest_requests);
+
+    printf("Release %s, %u parses of each format in chunks of %u bytes:\n", from_json.tag, iterations, ESP32_OTA_UPDATER_PARSE_BUFFER_SIZE);
+    printf("  %-8s %6zu bytes (%6zu parsed) %8.2f us per parse, check %6llu bytes in %u requests, parser %3zu bytes\n", "JSON",
+           json.size(), from_json.bytes, json_us, (unsigned long long)json_check, json_requests, sizeof(ReleaseParser));
+    printf("  %-8s %6zu bytes (%6zu parsed) %8.2f us per parse, check %6llu bytes in %u requests, parser %3zu bytes\n", "manifest",
+           manifest.size(), from_manifest.bytes, manifest_us, (unsigned long long)manifest_check, manifest_requests,
+           sizeof(ManifestParser));
+    const bool same = sameRelease(from_json, from_manifest);
+    printf(same ? "Both formats describe the same release.\n" : "The formats DIFFER.\n");
+    return same ? 0 : 1;
+}
@@ -0,0 +1,205 @@
+#include "MemoryStandIns.h"
+#include <string.h>
+
+#define ESP_IMAGE_MAGIC 0xE9
+
+/*
+ * MemoryHttpTransport
+ */
+
+bool MemoryHttpTransport::addRoute(const char *url, const uint8_t *body, size_t length, const char *etag)
+{
+    if (route_count == MEMORY_HTTP_TRANSPORT_MAX_ROUTES)
+    {
+        return false;
+    }
+    routes[route_count++] = {url, body, length, etag};
+    return true;
+}
+
+bool MemoryHttpTransport::begin(const char *url)
+{
+    active = nullptr;
+    if_none_match[0] = '\0';
+    not_modified = false;
+    position = 0;
+    for (uint8_t i = 0; i < route_count; i++)
+    {
+        if (strcmp(routes[i].url, url) == 0)
+        {
+            active = &routes[i];
+        }
+    }
+    return true;
+}
+
+void MemoryHttpTransport::addHeader(const char *name, const char *value)
+{
+    if (strcmp(name, "If-None-Match") == 0)
+    {
+        strncpy(if_none_match, value, sizeof(if_none_match) - 1);
+        if_none_match[sizeof(if_none_match) - 1] = '\0';
+    }
+}
+
+void MemoryHttpTransport::setAuthorization(const char *token)
+{
+}
+
+void MemoryHttpTransport::collectHeaders(const char *names[], size_t count)
+{
+}
+
+int MemoryHttpTransport::GET()
+{
+    request_count++;
+    if (active == nullptr)
+    {
+        return HTTP_STATUS_NOT_FOUND;
+    }
+    not_modified = active->etag != NULL && strcmp(if_none_match, active->etag) == 0;
+    not_modified_count += not_modified ? 1 : 0;
+    bytes_served += not_modified ? 0 : active->length;
+    return not_modified ? HTTP_STATUS_NOT_MODIFIED : HTTP_STATUS_OK;
+}
+
+int MemoryHttpTransport::getSize()
+{
+    return active != nullptr && !not_modified ? (int)active->length : 0;
+}
+
+void MemoryHttpTransport::getHeader(const char *name, char *value, size_t capacity)
+{
+    if (capacity == 0)
+    {
+        return;
+    }
+    const char *etag = active != nullptr && strcmp(name, "ETag") == 0 ? active->etag : NULL;
+    strncpy(value, etag != NULL ? etag : "", capacity - 1);
+    value[capacity - 1] = '\0';
+}
+
+int MemoryHttpTransport::available()
+{
+    return active != nullptr && !not_modified ? (int)(active->length - position) : 0;
+}
+
+bool MemoryHttpTransport::connected()
+{
+    return available() > 0;
+}
+
+size_t MemoryHttpTransport::read(uint8_t *buffer, size_t size)
+{
+    const size_t length = (size_t)available() < size ? (size_t)available() : size;
+    memcpy(buffer, active->body + position, length);
+    position += length;
+    bytes_read += length;
+    return length;
+}
+
+void MemoryHttpTransport::end()
+{
+    active = nullptr;
+    not_modified = false;
+    position = 0;
+}
+
+/*
+ * MemoryFirmwareSink
+ */
+
+void MemoryFirmwareSink::setMemory(uint8_t *memory, uint32_t capacity)
+{
+    this->memory = memory;
+    this->capacity = capacity;
+}
+
+uint32_t MemoryFirmwareSink::getCapacity()
+{
+    return memory != nullptr ? capacity : 0;
+}
+
+bool MemoryFirmwareSink::begin(uint32_t offset, uint32_t crc, const uint8_t *head)
+{
+    if (memory == nullptr || offset % FIRMWARE_SINK_SECTOR_SIZE != 0 || offset >= capacity || (offset > 0 && !verify(offset, crc, head)))
+    {
+        return false;
+    }
+    written = offset;
+    committed = offset;
+    committed_crc = crc;
+    writing = true;
+    finished = false;
+    return true;
+}
+
+bool MemoryFirmwareSink::write(const uint8_t *data, size_t length)
+{
+    if (!writing || written + length > capacity)
+    {
+        abort();
+        return false;
+    }
+    memcpy(memory + written, data, length);
+    written += length;
+    commit(written - written % FIRMWARE_SINK_SECTOR_SIZE);
+    return true;
+}
+
+bool MemoryFirmwareSink::finish()
+{
+    if (!writing)
+    {
+        return false;
+    }
+    commit(written);
+    writing = false;
+    finished = committed >= FIRMWARE_SINK_HEAD_SIZE && memory[0] == ESP_IMAGE_MAGIC;
+    return finished;
+}
+
+void MemoryFirmwareSink::abort()
+{
+    writing = false;
+    written = committed;
+}
+
+bool MemoryFirmwareSink::verify(uint32_t offset, uint32_t crc, const uint8_t *head)
+{
+    return memory != nullptr && offset <= capacity && head != NULL && offset >= FIRMWARE_SINK_HEAD_SIZE &&
+           memcmp(memory, head, FIRMWARE_SINK_HEAD_SIZE) == 0 && Crc32::update(0, memory, offset) == crc;
+}
+
+bool MemoryFirmwareSink::read(uint32_t offset, uint8_t *data, size_t length)
+{
+    if (offset + length > committed)
+    {
+        return false;
+    }
+    memcpy(data, memory + offset, length);
+    return true;
+}
+
+void MemoryFirmwareSink::commit(uint32_t end)
+{
+    if (end > committed)
+    {
+        committed_crc = Crc32::update(committed_crc, memory + committed, end - committed);
+        committed = end;
+    }
+}
+
+/*
+ * MemoryByteSource
+ */
+
+bool MemoryByteSource::read(uint32_t offset, uint8_t *data, size_t length)
+{
+    if (offset > size || length > size - offset)
+    {
+        return false;
+    }
+    memcpy(data, memory + offset, length);
+    return true;
+}
@@ -0,0 +1,276 @@
+#include "PatchCheck.h"
+#include <stdio.h>
+#include <string.h>
+#include <zlib.h>
+#include <vector>
+
+#include "DeltaPatcher.h"
+#include "ESP32_OTA_Updater_Config.h"
+#include "MemoryStandIns.h"
+#include "StreamDecompressor.h"
+
+/** Counts the bytes read from the running image. */
+class CountingSource : public ByteSource
+{
+public:
+    explicit CountingSource(ByteSource *source) : source(source) {}
+
+    bool read(uint32_t offset, uint8_t *data, size_t length) override
+    {
+        bytes += length;
+        return source->read(offset, data, length);
+    }
+
+    uint32_t getSize() override
+    {
+        return source->getSize();
+    }
+
+    ByteSource *source;
+    uint64_t bytes = 0;
+};
+
+/** Compares the reconstructed image with the expected one. */
+class CompareSink : public ByteSink
+{
+public:
+    explicit CompareSink(const std::vector<uint8_t> &expected) : expected(expected) {}
+
+    bool write(const uint8_t *data, size_t length) override
+    {
+        matches = matches && offset + length <= expected.size() && memcmp(expected.data() + offset, data, length) == 0;
+        offset += length;
+        return true;
+    }
+
+    const std::vector<uint8_t> &expected;
+    size_t offset = 0;
+    bool matches = true;
+};
+
+/** Records the operations of a patch in the format of DeltaPatcher and builds the image they produce. */
+class PatchBuilder
+{
+public:
+    explicit PatchBuilder(const std::vector<uint8_t> &source) : source(source) {}
+
+    void copy(uint32_t offset, uint32_t length)
+    {
+        operation(0x01, offset, length);
+        image.insert(image.end(), source.begin() + offset, source.begin() + offset + length);
+    }
+
+    void insert(const std::vector<uint8_t> &data)
+    {
+        ops.push_back(0x02);
+        appendLittleEndian(data.size());
+        ops.insert(ops.end(), data.begin(), data.end());
+        image.insert(image.end(), data.begin(), data.end());
+    }
+
+    /** Outputs the source range with every `stride`th byte incremented. */
+    void add(uint32_t offset, uint32_t length, uint32_t stride)
+    {
+        operation(0x03, offset, length);
+        for (uint32_t i = 0; i < length; i++)
+        {
+            const uint8_t difference = i % stride == 0 ? 1 : 0;
+            ops.push_back(difference);
+            image.push_back((uint8_t)(source[offset + i] + difference));
+        }
+    }
+
+    std::vector<uint8_t> build() const
+    {
+        std::vector<uint8_t> patch(DELTA_PATCHER_MAGIC, DELTA_PATCHER_MAGIC + 4);
+        patch.push_back(DELTA_PATCHER_VERSION);
+        patch.insert(patch.end(), 3, 0);
+        const uint32_t fields[3] = {(uint32_t)source.size(), Crc32::update(0, source.data(), source.size()), (uint32_t)image.size()};
+        for (uint32_t field : fields)
+        {
+            for (int i = 0; i < 4; i++)
+            {
+                patch.push_back((uint8_t)(field >> (8 * i)));
+            }
+        }
+        patch.insert(patch.end(), ops.begin(), ops.end());
+        return patch;
+    }
+
+    std::vector<uint8_t> image; /**< The image the patch produces. */
+
+private:
+    const std::vector<uint8_t> &source;
+    std::vector<uint8_t> ops;
+
+    void appendLittleEndian(uint32_t value)
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            ops.push_back((uint8_t)(value >> (8 * i)));
+        }
+    }
+
+    void operation(uint8_t opcode, uint32_t offset, uint32_t length)
+    {
+        ops.push_back(opcode);
+        appendLittleEndian(offset);
+        appendLittleEndian(length);
+    }
+};
+
+/** Largest work of a single write() or step() of the patcher. */
+struct PatchSteps
+{
+    uint32_t calls = 0;
+    uint64_t max_read = 0;
+    uint64_t max_written = 0;
+};
+
+/** Measures one write() or step() of the patcher. */
+template <typename Call>
+static bool measureCall(CountingSource &source, CompareSink &sink, PatchSteps *steps, Call call)
+{
+    const uint64_t read_before = source.bytes;
+    const size_t written_before = sink.offset;
+    const bool ok = call();
+    steps->calls++;
+    steps->max_read = source.bytes - read_before > steps->max_read ? source.bytes - read_before : steps->max_read;
+    steps->max_written = sink.offset - written_before > steps->max_written ? sink.offset - written_before : steps->max_written;
+    return ok;
+}
+
+/** Feeds the patch in slices and lets the patcher step in between, like downloadStep() does. */
+static bool applySliced(DeltaPatcher &patcher, ByteSink &input, const std::vector<uint8_t> &patch, CountingSource &source,
+                        CompareSink &sink, PatchSteps *steps)
+{
+    bool ok = true;
+    size_t offset = 0;
+    while (ok && (offset < patch.size() || patcher.isBusy()))
+    {
+        if (patcher.isBusy())
+        {
+            ok = measureCall(source, sink, steps, [&]() { return patcher.step(ESP32_OTA_UPDATER_POLL_SLICE_SIZE); });
+            continue;
+        }
+        const size_t slice = patch.size() - offset < ESP32_OTA_UPDATER_POLL_SLICE_SIZE ? patch.size() - offset : ESP32_OTA_UPDATER_POLL_SLICE_SIZE;
+        ok = measureCall(source, sink, steps, [&]() { return input.write(patch.data() + offset, slice); });
+        offset += slice;
+    }
+    return ok;
+}
+
+static std::vector<uint8_t> gzip(const std::vector<uint8_t> &data)
+{
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    std::vector<uint8_t> compressed(compressBound(data.size()) + 32);
+    deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 9, Z_DEFAULT_STRATEGY);
+    stream.next_in = (Bytef *)data.data();
+    stream.avail_in = data.size();
+    stream.next_out = compressed.data();
+    stream.avail_out = compressed.size();
+    deflate(&stream, Z_FINISH);
+    compressed.resize(stream.total_out);
+    deflateEnd(&stream);
+    return compressed;
+}
+
+enum PatchMode
+{
+    PATCH_AT_ONCE,
+    PATCH_SLICED,
+    PATCH_GZIP
+};
+
+static bool runCase(const char *name, PatchMode mode, const std::vector<uint8_t> &running, const std::vector<uint8_t> &patch,
+                    const std::vector<uint8_t> &image)
+{
+    MemoryByteSource memory(running.data(), running.size());
+    CountingSource source(&memory);
+    CompareSink sink(image);
+    DeltaPatcher patcher;
+    PatchSteps steps;
+    patcher.begin(&source, running.size(), &sink);
+    bool ok;
+    if (mode == PATCH_AT_ONCE)
+    {
+        ok = measureCall(source, sink, &steps, [&]() { return patcher.write(patch.data(), patch.size()); });
+    }
+    else if (mode == PATCH_SLICED)
+    {
+        ok = applySliced(patcher, patcher, patch, source, sink, &steps);
+    }
+    else
+    {
+        StreamDecompressor decompressor;
+        ok = decompressor.begin(StreamDecompressor::CODEC_AUTO, &patcher) && applySliced(patcher, decompressor, patch, source, sink, &steps) &&
+             decompressor.finish();
+        decompressor.end();
+    }
+    ok = patcher.finish() && ok;
+    const bool matches = ok && sink.matches && sink.offset == image.size();
+    const bool bounded = mode != PATCH_SLICED ||
+                         (steps.max_read <= ESP32_OTA_UPDATER_POLL_SLICE_SIZE && steps.max_written <= ESP32_OTA_UPDATER_POLL_SLICE_SIZE);
+    printf("  %-10s %8u byte patch: %s, %6u calls, largest %7llu bytes read %7llu written%s\n", name, (unsigned)patch.size(),
+           matches ? "image matches" : "IMAGE DIFFERS", steps.calls, (unsigned long long)steps.max_read,
+           (unsigned long long)steps.max_written, bounded ? "" : ", EXCEEDS THE SLICE");
+    return matches && bounded;
+}
+
+std::vector<uint8_t> createPatch(const std::vector<uint8_t> &running, std::vector<uint8_t> *image)
+{
+    std::vector<uint8_t> inserted(3000);
+    uint32_t seed = 0x9E3779B9;
+    for (size_t i = 0; i < inserted.size(); i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        inserted[i] = (uint8_t)(seed >> 24);
+    }
+    const uint32_t quarter = running.size() / 4;
+    PatchBuilder builder(running);
+    builder.copy(0, quarter);
+    builder.insert(inserted);
+    builder.add(quarter, quarter, 97);
+    builder.copy(3 * quarter, running.size() - 3 * quarter); // The third quarter is dropped
+    builder.copy(4096, 4096);                                // A block which moved
+    builder.insert(std::vector<uint8_t>(inserted.begin(), inserted.begin() + 100));
+    *image = builder.image;
+    return builder.build();
+}
+
+int runPatchCheck(uint32_t image_size)
+{
+    // A running image with some structure, the new one is made of its parts and some new data
+    image_size = image_size < 65536 ? 65536 : image_size;
+    std::vector<uint8_t> running(image_size);
+    uint32_t seed = 0x2545F491;
+    for (size_t i = 0; i < running.size(); i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        running[i] = (seed >> 16) % 4 == 0 ? (uint8_t)(seed >> 24) : (uint8_t)(i / 64);
+    }
+    std::vector<uint8_t> image;
+    const std::vector<uint8_t> patch = createPatch(running, &image);
+
+    printf("Patching a %u byte image into a %u byte image:\n", image_size, (unsigned)image.size());
+    bool passed = runCase("at once", PATCH_AT_ONCE, running, patch, image);
+    passed = runCase("sliced", PATCH_SLICED, running, patch, image) && passed;
+    passed = runCase("gzip", PATCH_GZIP, running, gzip(patch), image) && passed;
+
+    // A patch for another build is rejected by the CRC32 of the source, before anything is written
+    std::vector<uint8_t> other(running);
+    other[image_size / 2] ^= 0x01;
+    MemoryByteSource memory(other.data(), other.size());
+    CountingSource source(&memory);
+    CompareSink sink(image);
+    DeltaPatcher patcher;
+    PatchSteps steps;
+    patcher.begin(&source, other.size(), &sink);
+    applySliced(patcher, patcher, patch, source, sink, &steps);
+    const bool rejected = !patcher.finish() && patcher.getError() == DeltaPatcher::SOURCE_MISMATCH && sink.offset == 0;
+    printf("  other source: %s after %u bytes of output\n", rejected ? "rejected" : "NOT REJECTED", (unsigned)sink.offset);
+    passed = passed && rejected;
+    printf("%s\n", passed ? "Passed." : "FAILED.");
+    return passed ? 0 : 1;
+}
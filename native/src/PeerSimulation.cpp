@@ -0,0 +1,89 @@
+#include "PeerSimulation.h"
+#include <Preferences.h>
+#include <stdio.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ESP32_OTA_Updater.h"
+#include "FileFirmwareSink.h"
+#include "LoopbackHttpTransport.h"
+#include "LoopbackPeerNetwork.h"
+
+#define PEER_SIMULATION_PARTITION_SIZE 0x1E0000 /**< Size of the simulated OTA partition. */
+
+struct PeerResult
+{
+    uint64_t wan_bytes; /**< Bytes downloaded from GitHub by all devices. */
+    uint64_t lan_bytes; /**< Bytes downloaded from peers by all devices. */
+    uint32_t installed; /**< Devices which installed the release. */
+    uint32_t from_peer; /**< Devices which got the image from a peer. */
+};
+
+static PeerResult simulate(const PeerSimulationConfig &config, bool peers)
+{
+    PeerResult result = {};
+    LoopbackLan lan;
+    // The running images stay offered until the end, like the partitions of the devices which booted the release
+    std::vector<std::unique_ptr<FileByteSource>> running_images;
+    for (uint32_t i = 0; i < config.devices; i++)
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "%s-device-%03u", peers ? "peers" : "wan", i);
+        Preferences::useStorage(name);
+        const std::string flash_path = std::string(config.root) + "/" + name + ".bin";
+        LoopbackHttpTransport transport(config.root);
+        transport.setLan(&lan);
+        LoopbackPeerNetwork network(&lan, name);
+        bool installed;
+        {
+            FileFirmwareSink firmware_sink(flash_path.c_str(), PEER_SIMULATION_PARTITION_SIZE);
+            ESP32_OTA_Updater ota(&transport, &firmware_sink, NULL, "1.0.0");
+            ota.setCheckInterval(0);
+            if (peers)
+            {
+                ota.setPeerNetwork(&network);
+            }
+            ota.begin("local", "firmware", config.asset);
+            installed = ota.available() && ota.downloadAndInstall();
+            result.from_peer += ota.getMetrics().peer_bytes > 0;
+        }
+        result.installed += installed;
+        result.wan_bytes += transport.getBytesSent();
+        result.lan_bytes += transport.getLanBytesSent();
+        printf("  %s: %-9s WAN %10llu bytes, LAN %10llu bytes in total\n", name,
+               !installed ? "failed," : transport.getLanBytesSent() > 0 ? "peer," : "GitHub,",
+               (unsigned long long)result.wan_bytes, (unsigned long long)result.lan_bytes);
+
+        // The reboot into the release, begin() offers the image which is now running
+        if (installed)
+        {
+            running_images.emplace_back(new FileByteSource(flash_path.c_str()));
+            FileFirmwareSink next_sink(flash_path.c_str(), PEER_SIMULATION_PARTITION_SIZE);
+            ESP32_OTA_Updater rebooted(&transport, &next_sink, running_images.back().get(), config.tag);
+            rebooted.setCheckInterval(0);
+            if (peers)
+            {
+                rebooted.setPeerNetwork(&network);
+            }
+            rebooted.begin("local", "firmware", config.asset);
+        }
+    }
+    Preferences::useStorage("");
+    return result;
+}
+
+int runPeerSimulation(const PeerSimulationConfig &config)
+{
+    printf("%u devices on one network install %s (%s).\n", config.devices, config.tag, config.asset);
+    printf("GitHub only:\n");
+    const PeerResult wan = simulate(config, false);
+    printf("With peers:\n");
+    const PeerResult peers = simulate(config, true);
+    printf("WAN bytes: %llu without peers, %llu with peers (%u of %u devices installed from a peer).\n",
+           (unsigned long long)wan.wan_bytes, (unsigned long long)peers.wan_bytes, peers.from_peer, config.devices);
+    return wan.installed == config.devices && peers.installed == config.devices &&
+                   peers.from_peer + 1 == config.devices
+               ? 0
+               : 1;
+}
@@ -0,0 +1,216 @@
+#include "PipelineBenchmark.h"
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "ImageHeaderBenchmark.h"
+#include "MemoryStandIns.h"
+#include "StaticOtaUpdater.h"
+
+#define PIPELINE_BENCHMARK_PARTITION_SIZE 0x1E0000 /**< Size of the simulated OTA partition. */
+#define PIPELINE_BENCHMARK_LINK_RATE 200000        /**< Bytes per second of WiFi with TLS decryption. */
+#define PIPELINE_BENCHMARK_SLOW_LINK_RATE 50000    /**< Bytes per second of a weak link. */
+#define PIPELINE_BENCHMARK_ERASE_US 20000          /**< Time to erase a 4 KB sector. */
+#define PIPELINE_BENCHMARK_WRITE_US_PER_KB 1000    /**< Time to write 1 KB of pages. */
+#define PIPELINE_BENCHMARK_SLOW_WRITE_US_PER_KB 4000
+#define PIPELINE_BENCHMARK_STEP_LIMIT_US 50000 /**< A poll() step which takes longer waited for the flash. */
+
+/** Delivers the routes at the rate of a link. */
+class EmulatedLinkTransport : public MemoryHttpTransport
+{
+public:
+    size_t read(uint8_t *buffer, size_t size) override
+    {
+        const size_t length = MemoryHttpTransport::read(buffer, size);
+        std::this_thread::sleep_for(std::chrono::microseconds((uint64_t)length * 1000000 / rate));
+        return length;
+    }
+
+    uint32_t rate = PIPELINE_BENCHMARK_LINK_RATE;
+};
+
+/** Takes the time of flash for erases and writes, a write at `hang_at` hangs for `hang_ms` once. */
+class EmulatedFlashSink : public MemoryFirmwareSink
+{
+public:
+    bool begin(uint32_t offset, uint32_t crc, const uint8_t *head) override
+    {
+        erased = offset;
+        return MemoryFirmwareSink::begin(offset, crc, head);
+    }
+
+    bool eraseAhead(uint32_t distance) override
+    {
+        if (erased >= getWritten() + distance || erased >= getCapacity())
+        {
+            return false;
+        }
+        eraseSector();
+        return true;
+    }
+
+    bool write(const uint8_t *data, size_t length) override
+    {
+        while (erased < getWritten() + length)
+        {
+            eraseSector();
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds((uint64_t)length * write_us_per_kb / 1024));
+        if (hang_ms > 0 && getWritten() + length > hang_at)
+        {
+            hang_start = std::chrono::steady_clock::now();
+            std::this_thread::sleep_for(std::chrono::milliseconds(hang_ms));
+            hang_ms = 0;
+        }
+        return MemoryFirmwareSink::write(data, length);
+    }
+
+    uint32_t write_us_per_kb = PIPELINE_BENCHMARK_WRITE_US_PER_KB;
+    uint32_t hang_at = 0;
+    std::atomic<uint32_t> hang_ms{0};
+    std::chrono::steady_clock::time_point hang_start;
+
+private:
+    uint32_t erased = 0;
+
+    void eraseSector()
+    {
+        std::this_thread::sleep_for(std::chrono::microseconds(PIPELINE_BENCHMARK_ERASE_US));
+        erased += FIRMWARE_SINK_SECTOR_SIZE;
+    }
+};
+
+/** Outcome of an install. */
+struct PipelineRun
+{
+    bool installed;
+    ESP32_OTA_Updater_Error error;
+    double seconds;
+    double hang_to_failure_ms; /**< Time from the start of the hang until the install failed. */
+    double max_step_ms;        /**< Longest poll() step before the failure. */
+    FlashPipelineStats stats;
+};
+
+/** Publishes the image and installs it, blocking or by calls of poll(). */
+template <uint8_t PipelineBuffers>
+static PipelineRun install(const std::vector<uint8_t> &running, const std::vector<uint8_t> &image, uint32_t link_rate,
+                           uint32_t write_us_per_kb, uint32_t hang_ms, bool polled)
+{
+    char release[512];
+    const int release_length = snprintf(release, sizeof(release),
+                                        "{\"url\":\"https://api.github.com/repos/local/firmware/releases/1\",\"tag_name\":\"v1.1.0\","
+                                        "\"draft\":false,\"prerelease\":false,\"assets\":[{\"url\":\"https://api.github.com/assets/"
+                                        "firmware.bin\",\"name\":\"firmware.bin\",\"size\":%u}],\"body\":\"Release served from memory.\"}",
+                                        (unsigned)image.size());
+    std::vector<uint8_t> partition(PIPELINE_BENCHMARK_PARTITION_SIZE, 0xFF);
+    MemoryByteSource running_image(running.data(), running.size());
+    StaticOtaUpdater<EmulatedLinkTransport, EmulatedFlashSink, PipelineBuffers> *updater =
+        new StaticOtaUpdater<EmulatedLinkTransport, EmulatedFlashSink, PipelineBuffers>("1.0.0", &running_image);
+    StaticOtaUpdater<EmulatedLinkTransport, EmulatedFlashSink, PipelineBuffers> &ota = *updater;
+    ota.getTransport().addRoute("https://api.github.com/repos/local/firmware/releases/latest", (const uint8_t *)release, release_length);
+    ota.getTransport().addRoute("https://api.github.com/assets/firmware.bin", image.data(), image.size());
+    ota.getTransport().rate = link_rate;
+    ota.getSink().setMemory(partition.data(), partition.size());
+    ota.getSink().write_us_per_kb = write_us_per_kb;
+    ota.getSink().hang_at = image.size() / 2;
+    ota.getSink().hang_ms = hang_ms;
+    ota.setCheckInterval(0);
+    ota.setCheckCachePersistent(false);
+    ota.setResumableDownloads(false);
+
+    PipelineRun run = {};
+    const bool available = ota.begin("local", "firmware", "firmware.bin") && ota.available();
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (available && !polled)
+    {
+        run.installed = ota.downloadAndInstall();
+    }
+    else if (available && ota.startInstall())
+    {
+        ESP32_OTA_Updater_State state = ota.getState();
+        while (state != ESP32_OTA_Updater_State::OTA_READY_TO_REBOOT && state != ESP32_OTA_Updater_State::OTA_FAILED)
+        {
+            const std::chrono::steady_clock::time_point step_start = std::chrono::steady_clock::now();
+            state = ota.poll();
+            const double step_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - step_start).count();
+            // The failing step stops the hanging writer task, which on the host waits for the sink
+            if (state != ESP32_OTA_Updater_State::OTA_FAILED && step_ms > run.max_step_ms)
+            {
+                run.max_step_ms = step_ms;
+            }
+        }
+        run.installed = state == ESP32_OTA_Updater_State::OTA_READY_TO_REBOOT;
+    }
+    const std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+    run.seconds = std::chrono::duration<double>(end - start).count();
+    run.installed = run.installed && memcmp(partition.data(), image.data(), image.size()) == 0;
+    run.error = ota.getErrorCode();
+    if (hang_ms > 0)
+    {
+        run.hang_to_failure_ms = std::chrono::duration<double, std::milli>(end - ota.getSink().hang_start).count();
+    }
+    run.stats = ota.getPipelineStats();
+    delete updater;
+    return run;
+}
+
+static void printRun(const char *name, const PipelineRun &run)
+{
+    printf("  %-22s %-9s %6.2f s, download stalls %4u (%5u ms), flash stalls %4u (%5u ms), %3u sectors erased ahead\n", name,
+           run.installed ? "installed" : "FAILED", run.seconds, run.stats.reader_stalls, run.stats.reader_stall_ms,
+           run.stats.writer_stalls, run.stats.writer_stall_ms, run.stats.sectors_erased_ahead);
+}
+
+int runPipelineBenchmark(uint32_t image_size)
+{
+    std::vector<uint8_t> image(image_size < 2 * FIRMWARE_SINK_SECTOR_SIZE ? 2 * FIRMWARE_SINK_SECTOR_SIZE : image_size);
+    uint32_t seed = 0x2545F491;
+    for (size_t i = 0; i < image.size(); i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        image[i] = (uint8_t)(seed >> 24);
+    }
+    std::vector<uint8_t> running(image);
+    writeAppImageHeader(running.data(), 0, 2, "1.0.0", "firmware");
+    writeAppImageHeader(image.data(), 0, 2, "1.1.0", "firmware");
+
+    printf("Installing a %u byte image at %u KB/s, erasing sectors in %u ms and writing %u us per KB:\n", (unsigned)image.size(),
+           PIPELINE_BENCHMARK_LINK_RATE / 1000, PIPELINE_BENCHMARK_ERASE_US / 1000, PIPELINE_BENCHMARK_WRITE_US_PER_KB);
+    const PipelineRun sync = install<0>(running, image, PIPELINE_BENCHMARK_LINK_RATE, PIPELINE_BENCHMARK_WRITE_US_PER_KB, 0, false);
+    const PipelineRun pipelined = install<4>(running, image, PIPELINE_BENCHMARK_LINK_RATE, PIPELINE_BENCHMARK_WRITE_US_PER_KB, 0, false);
+    printRun("synchronous", sync);
+    printRun("pipelined", pipelined);
+    const bool faster = sync.installed && pipelined.installed && pipelined.seconds < sync.seconds;
+    printf("  pipelined install %s, %.2f times as fast\n", faster ? "is faster" : "IS NOT FASTER", sync.seconds / pipelined.seconds);
+
+    // The stall counters show which side limits the install
+    const PipelineRun slow_link = install<4>(running, image, PIPELINE_BENCHMARK_SLOW_LINK_RATE, PIPELINE_BENCHMARK_WRITE_US_PER_KB, 0, false);
+    const PipelineRun slow_flash = install<4>(running, image, PIPELINE_BENCHMARK_LINK_RATE, PIPELINE_BENCHMARK_SLOW_WRITE_US_PER_KB, 0, false);
+    printRun("slow link, pipelined", slow_link);
+    printRun("slow flash, pipelined", slow_flash);
+    const bool stalls = slow_link.installed && slow_flash.installed && slow_link.stats.writer_stalls > 0 &&
+                        slow_link.stats.sectors_erased_ahead > 0 && slow_flash.stats.reader_stalls > 0 &&
+                        slow_flash.stats.reader_stall_ms > slow_link.stats.reader_stall_ms;
+    printf("  stalls %s\n", stalls ? "counted on the limiting side" : "NOT COUNTED ON THE LIMITING SIDE");
+
+    // A hanging flash fails the install after the timeout instead of blocking it
+    const uint32_t hang_ms = ESP32_OTA_UPDATER_PIPELINE_WRITE_TIMEOUT + 500;
+    const PipelineRun blocking_hang = install<4>(running, image, PIPELINE_BENCHMARK_LINK_RATE, PIPELINE_BENCHMARK_WRITE_US_PER_KB, hang_ms, false);
+    const PipelineRun polled_hang = install<4>(running, image, PIPELINE_BENCHMARK_LINK_RATE, PIPELINE_BENCHMARK_WRITE_US_PER_KB, hang_ms, true);
+    const double limit_ms = hang_ms + 1000.0; // On the host, deleting the writer task waits until the sink returns
+    const bool blocking_failed = !blocking_hang.installed && blocking_hang.error == ESP32_OTA_Updater_Error::OTA_INSTALL_FAILED &&
+                                 blocking_hang.hang_to_failure_ms < limit_ms;
+    const bool polled_failed = !polled_hang.installed && polled_hang.error == ESP32_OTA_Updater_Error::OTA_INSTALL_FAILED &&
+                               polled_hang.hang_to_failure_ms < limit_ms && polled_hang.max_step_ms < PIPELINE_BENCHMARK_STEP_LIMIT_US / 1000.0;
+    printf("  flash hanging %u ms, blocking: %s %.0f ms after the hang began\n", hang_ms, blocking_failed ? "failed" : "NOT FAILED IN TIME",
+           blocking_hang.hang_to_failure_ms);
+    printf("  flash hanging %u ms, poll(): %s %.0f ms after the hang began, longest step before %.1f ms\n", hang_ms,
+           polled_failed ? "failed" : "NOT FAILED IN TIME", polled_hang.hang_to_failure_ms, polled_hang.max_step_ms);
+
+    const bool passed = faster && stalls && blocking_failed && polled_failed;
+    printf("%s\n", passed ? "Passed." : "FAILED.");
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,191 @@
+#include "PollCheck.h"
+#include <stdio.h>
+#include <string.h>
+#include <zlib.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "ImageHeaderBenchmark.h"
+#include "MemoryStandIns.h"
+#include "PatchCheck.h"
+#include "StaticOtaUpdater.h"
+
+#define POLL_CHECK_PARTITION_SIZE 0x1E0000 /**< Size of the simulated OTA partition. */
+#define POLL_CHECK_MAX_STEPS 10000000      /**< Steps after which an install counts as stuck. */
+
+/** Counts the bytes read from the running image. */
+class CountingSource : public ByteSource
+{
+public:
+    explicit CountingSource(ByteSource *source) : source(source) {}
+
+    bool read(uint32_t offset, uint8_t *data, size_t length) override
+    {
+        bytes += length;
+        return source->read(offset, data, length);
+    }
+
+    uint32_t getSize() override
+    {
+        return source->getSize();
+    }
+
+    ByteSource *source;
+    uint64_t bytes = 0;
+};
+
+enum PollAsset
+{
+    POLL_IMAGE,
+    POLL_GZIP,
+    POLL_PATCH
+};
+
+/** Largest work of a single poll() step. */
+struct PollSteps
+{
+    std::vector<double> durations_us;
+    double max_loop_us = 0;
+    ESP32_OTA_Updater_State slowest_state = ESP32_OTA_Updater_State::OTA_IDLE;
+    uint64_t max_downloaded = 0;
+    uint64_t max_read = 0;
+    uint64_t max_written = 0;
+};
+
+static const char *stateName(ESP32_OTA_Updater_State state)
+{
+    static const char *const names[] = {"idle", "checking", "update available", "downloading",
+                                        "verifying", "staged", "ready to reboot", "failed"};
+    return state < sizeof(names) / sizeof(names[0]) ? names[state] : "unknown";
+}
+
+static std::vector<uint8_t> gzip(const std::vector<uint8_t> &data)
+{
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    std::vector<uint8_t> compressed(compressBound(data.size()) + 32);
+    deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 9, Z_DEFAULT_STRATEGY);
+    stream.next_in = (Bytef *)data.data();
+    stream.avail_in = data.size();
+    stream.next_out = compressed.data();
+    stream.avail_out = compressed.size();
+    deflate(&stream, Z_FINISH);
+    compressed.resize(stream.total_out);
+    deflateEnd(&stream);
+    return compressed;
+}
+
+/** Installs the release of a case by calls of poll(), returns true if it was installed within the bound. */
+static bool runCase(const char *name, PollAsset asset, const std::vector<uint8_t> &running, const std::vector<uint8_t> &image,
+                    const std::vector<uint8_t> &published)
+{
+    const char *asset_name = asset == POLL_GZIP ? "firmware.bin.gz" : "firmware.bin";
+    char release[768];
+    int release_length = snprintf(release, sizeof(release),
+                                  "{\"url\":\"https://api.github.com/repos/local/firmware/releases/1\",\"tag_name\":\"v1.1.0\","
+                                  "\"draft\":false,\"prerelease\":false,\"assets\":[{\"url\":\"https://api.github.com/assets/"
+                                  "%s\",\"name\":\"%s\",\"size\":%u}",
+                                  asset_name, asset_name, (unsigned)(asset == POLL_PATCH ? image.size() : published.size()));
+    if (asset == POLL_PATCH)
+    {
+        release_length += snprintf(release + release_length, sizeof(release) - release_length,
+                                   ",{\"url\":\"https://api.github.com/assets/firmware-1.0.0-1.1.0.patch\","
+                                   "\"name\":\"firmware-1.0.0-1.1.0.patch\",\"size\":%u}",
+                                   (unsigned)published.size());
+    }
+    release_length += snprintf(release + release_length, sizeof(release) - release_length, "],\"body\":\"Release served from memory.\"}");
+    std::vector<uint8_t> partition(POLL_CHECK_PARTITION_SIZE, 0xFF);
+    MemoryByteSource memory(running.data(), running.size());
+    CountingSource running_image(&memory);
+
+    StaticOtaUpdater<MemoryHttpTransport, MemoryFirmwareSink> *updater =
+        new StaticOtaUpdater<MemoryHttpTransport, MemoryFirmwareSink>("1.0.0", &running_image);
+    StaticOtaUpdater<MemoryHttpTransport, MemoryFirmwareSink> &ota = *updater;
+    MemoryHttpTransport &transport = ota.getTransport();
+    MemoryFirmwareSink &sink = ota.getSink();
+    transport.addRoute("https://api.github.com/repos/local/firmware/releases/latest", (const uint8_t *)release, release_length);
+    transport.addRoute(asset == POLL_PATCH ? "https://api.github.com/assets/firmware-1.0.0-1.1.0.patch" : asset == POLL_GZIP
+                                                                                                        ? "https://api.github.com/assets/firmware.bin.gz"
+                                                                                                        : "https://api.github.com/assets/firmware.bin",
+                       published.data(), published.size());
+    sink.setMemory(partition.data(), partition.size());
+    ota.setCheckInterval(0);
+    ota.setCheckCachePersistent(false);
+    ota.setResumableDownloads(false);
+    ota.setAutoInstall(true);
+
+    PollSteps steps;
+    bool started = ota.begin("local", "firmware", asset_name) && ota.startCheck();
+    ESP32_OTA_Updater_State state = ota.getState();
+    std::chrono::steady_clock::time_point last_loop = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; started && i < POLL_CHECK_MAX_STEPS && state != ESP32_OTA_Updater_State::OTA_READY_TO_REBOOT &&
+                         state != ESP32_OTA_Updater_State::OTA_FAILED;
+         i++)
+    {
+        const uint64_t downloaded = transport.getBytesRead();
+        const uint64_t read = running_image.bytes;
+        const uint32_t written = sink.getWritten();
+        const ESP32_OTA_Updater_State polled_state = state;
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        state = ota.poll();
+        const std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+        const double duration_us = std::chrono::duration<double, std::micro>(end - start).count();
+        const double loop_us = std::chrono::duration<double, std::micro>(end - last_loop).count();
+        last_loop = end;
+
+        if (steps.durations_us.empty() || duration_us > *std::max_element(steps.durations_us.begin(), steps.durations_us.end()))
+        {
+            steps.slowest_state = polled_state;
+        }
+        steps.durations_us.push_back(duration_us);
+        steps.max_loop_us = std::max(steps.max_loop_us, loop_us);
+        steps.max_downloaded = std::max(steps.max_downloaded, transport.getBytesRead() - downloaded);
+        steps.max_read = std::max(steps.max_read, running_image.bytes - read);
+        // begin() of the sink starts over at 0
+        steps.max_written = std::max<uint64_t>(steps.max_written, sink.getWritten() >= written ? sink.getWritten() - written : sink.getWritten());
+    }
+
+    const bool installed = state == ESP32_OTA_Updater_State::OTA_READY_TO_REBOOT && memcmp(partition.data(), image.data(), image.size()) == 0;
+    const bool bounded = steps.max_downloaded <= ESP32_OTA_UPDATER_POLL_SLICE_SIZE && steps.max_read <= ESP32_OTA_UPDATER_POLL_SLICE_SIZE &&
+                         (asset == POLL_GZIP || steps.max_written <= ESP32_OTA_UPDATER_POLL_SLICE_SIZE);
+    std::vector<double> sorted(steps.durations_us);
+    std::sort(sorted.begin(), sorted.end());
+    printf("  %-11s %-9s %7u steps, largest %5llu bytes downloaded %5llu read %6llu written%s\n", name,
+           installed ? "installed" : "FAILED", (unsigned)sorted.size(), (unsigned long long)steps.max_downloaded,
+           (unsigned long long)steps.max_read, (unsigned long long)steps.max_written, bounded ? "" : ", EXCEEDS THE SLICE");
+    if (!sorted.empty())
+    {
+        printf("  %-11s step p99 %7.1f us, worst %8.1f us (%s), worst loop interval %8.1f us\n", "",
+               sorted[sorted.size() * 99 / 100], sorted.back(), stateName(steps.slowest_state), steps.max_loop_us);
+    }
+    if (!installed)
+    {
+        printf("  %-11s %s\n", "", ota.getErrorMessage());
+    }
+    delete updater;
+    return installed && bounded;
+}
+
+int runPollCheck(uint32_t image_size)
+{
+    // Images with some structure, the running one is patched into the published one
+    std::vector<uint8_t> running(image_size < 65536 ? 65536 : image_size);
+    uint32_t seed = 0x2545F491;
+    for (size_t i = 0; i < running.size(); i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        running[i] = (seed >> 16) % 4 == 0 ? (uint8_t)(seed >> 24) : (uint8_t)(i / 64);
+    }
+    writeAppImageHeader(running.data(), 0, 2, "1.0.0", "firmware");
+    std::vector<uint8_t> image;
+    const std::vector<uint8_t> patch = createPatch(running, &image);
+
+    printf("Installing a %u byte image with poll() steps of at most %u bytes:\n", (unsigned)image.size(),
+           (unsigned)ESP32_OTA_UPDATER_POLL_SLICE_SIZE);
+    bool passed = runCase("image", POLL_IMAGE, running, image, image);
+    passed = runCase("gzip image", POLL_GZIP, running, image, gzip(image)) && passed;
+    passed = runCase("delta patch", POLL_PATCH, running, image, patch) && passed;
+    printf("%s\n", passed ? "Passed." : "FAILED.");
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,121 @@
+#include <Preferences.h>
+#include <string.h>
+
+typedef std::map<std::string, std::map<std::string, std::vector<uint8_t>>> Storage;
+static std::map<std::string, Storage> devices;
+static Storage *storage = &devices[""];
+
+void Preferences::useStorage(const char *name)
+{
+    storage = &devices[name];
+}
+
+bool Preferences::begin(const char *name, bool read_only, const char *partition_label)
+{
+    if (read_only && storage->find(name) == storage->end())
+    {
+        return false; // Like NVS, a namespace which was never written can not be opened read only
+    }
+    values = &(*storage)[name];
+    this->read_only = read_only;
+    return true;
+}
+
+void Preferences::end()
+{
+    values = nullptr;
+}
+
+bool Preferences::clear()
+{
+    if (values == nullptr || read_only)
+    {
+        return false;
+    }
+    values->clear();
+    return true;
+}
+
+bool Preferences::remove(const char *key)
+{
+    return values != nullptr && !read_only && values->erase(key) > 0;
+}
+
+bool Preferences::isKey(const char *key)
+{
+    return get(key) != nullptr;
+}
+
+size_t Preferences::put(const char *key, const void *value, size_t length)
+{
+    if (values == nullptr || read_only)
+    {
+        return 0;
+    }
+    (*values)[key].assign((const uint8_t *)value, (const uint8_t *)value + length);
+    return length;
+}
+
+const std::vector<uint8_t> *Preferences::get(const char *key)
+{
+    if (values == nullptr)
+    {
+        return nullptr;
+    }
+    Namespace::const_iterator entry = values->find(key);
+    return entry != values->end() ? &entry->second : nullptr;
+}
+
+size_t Preferences::putString(const char *key, const char *value)
+{
+    return put(key, value, strlen(value) + 1);
+}
+
+size_t Preferences::getString(const char *key, char *value, size_t max_length)
+{
+    const std::vector<uint8_t> *stored = get(key);
+    if (stored == nullptr || stored->size() > max_length)
+    {
+        return 0;
+    }
+    memcpy(value, stored->data(), stored->size());
+    return stored->size();
+}
+
+size_t Preferences::putInt(const char *key, int32_t value)
+{
+    return put(key, &value, sizeof(value));
+}
+
+int32_t Preferences::getInt(const char *key, int32_t default_value)
+{
+    int32_t value = default_value;
+    return getBytes(key, &value, sizeof(value)) == sizeof(value) ? value : default_value;
+}
+
+size_t Preferences::putUInt(const char *key, uint32_t value)
+{
+    return put(key, &value, sizeof(value));
+}
+
+uint32_t Preferences::getUInt(const char *key, uint32_t default_value)
+{
+    uint32_t value = default_value;
+    return getBytes(key, &value, sizeof(value)) == sizeof(value) ? value : default_value;
+}
+
+size_t Preferences::putBytes(const char *key, const void *value, size_t length)
+{
+    return put(key, value, length);
+}
+
+size_t Preferences::getBytes(const char *key, void *buffer, size_t max_length)
+{
+    const std::vector<uint8_t> *stored = get(key);
+    if (stored == nullptr || stored->size() > max_length)
+    {
+        return 0;
+    }
+    memcpy(buffer, stored->data(), stored->size());
+    return stored->size();
+}
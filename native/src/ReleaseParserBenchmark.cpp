@@ -0,0 +1,83 @@
+#include "ReleaseParserBenchmark.h"
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+
+#include "AllocationCheck.h"
+#include "ReleaseParser.h"
+#include "UpdateBenchmark.h"
+
+#define RELEASE_PARSER_BENCHMARK_ASSETS 3 /**< The firmware, the delta patch and the signature, like the updater requests. */
+#define RELEASE_PARSER_BENCHMARK_FIRMWARE_SIZE 1230001 /**< Size of the firmware asset of the release. */
+
+/** The release the payloads are built from, the digests are the SHA-256 of "firmware". */
+static const char *const RELEASE_JSON =
+    "{\"url\":\"https://api.github.com/repos/local/firmware/releases/7\",\"id\":7,\"tag_name\":\"v1.1.0\","
+    "\"target_commitish\":\"main\",\"name\":\"v1.1.0\",\"draft\":false,\"prerelease\":false,"
+    "\"created_at\":\"2024-01-01T00:00:00Z\",\"published_at\":\"2024-01-01T00:00:00Z\",\"assets\":["
+    "{\"url\":\"https://api.github.com/repos/local/firmware/releases/assets/1\",\"id\":1,\"name\":\"firmware.bin\","
+    "\"size\":1230001,\"digest\":\"sha256:f70a4f1a8b8e83f7d0c6d1e1cf9b3c4b0e1e09fa7e8bd4e2e5a0a4c1bd1a6f10\"},"
+    "{\"url\":\"https://api.github.com/repos/local/firmware/releases/assets/2\",\"id\":2,\"name\":\"firmware-1.0.0-1.1.0.patch\","
+    "\"size\":48213,\"digest\":\"sha256:0c1d2e3f405162738495a6b7c8d9eafb0c1d2e3f405162738495a6b7c8d9eafb\"},"
+    "{\"url\":\"https://api.github.com/repos/local/firmware/releases/assets/3\",\"id\":3,\"name\":\"firmware.sig\","
+    "\"size\":288,\"digest\":\"sha256:a0b1c2d3e4f5061728394a5b6c7d8e9fa0b1c2d3e4f5061728394a5b6c7d8e9f\"}],"
+    "\"body\":\"Release notes of v1.1.0.\"}";
+
+/** Feeds the payload like the updater reads the response, returns the number of bytes fed until the parser was done. */
+static size_t parse(ReleaseParser &parser, const std::string &payload, ReleaseAsset *assets)
+{
+    static const char *const names[RELEASE_PARSER_BENCHMARK_ASSETS] = {"firmware.bin", "firmware-1.0.0-*.patch*", "firmware.sig"};
+    parser.begin();
+    for (uint8_t i = 0; i < RELEASE_PARSER_BENCHMARK_ASSETS; i++)
+    {
+        assets[i].name = names[i];
+        parser.addAsset(&assets[i]);
+    }
+    size_t fed = 0;
+    while (fed < payload.size() && parser.getStatus() == JsonStreamScanner::SCANNING)
+    {
+        const size_t length = payload.size() - fed < ESP32_OTA_UPDATER_PARSE_BUFFER_SIZE ? payload.size() - fed : ESP32_OTA_UPDATER_PARSE_BUFFER_SIZE;
+        parser.feed((const uint8_t *)payload.data() + fed, length);
+        fed += length;
+    }
+    return fed;
+}
+
+int runReleaseParserBenchmark(uint32_t iterations)
+{
+    const size_t targets[] = {2048, 16384, 65536, 262144};
+    iterations = iterations > 0 ? iterations : 1;
+    ReleaseParser parser;
+    ReleaseAsset assets[RELEASE_PARSER_BENCHMARK_ASSETS];
+    bool passed = true;
+    printf("Parsing release payloads %u times in chunks of %u bytes, the parser takes %u bytes:\n", iterations,
+           (unsigned)ESP32_OTA_UPDATER_PARSE_BUFFER_SIZE, (unsigned)sizeof(ReleaseParser));
+    for (size_t target : targets)
+    {
+        const std::string payload = padRelease(RELEASE_JSON, target);
+
+        // One parse with the heap counted, so the timed ones are not slowed down by the counting
+        const bool counting = beginHeapCount();
+        const size_t fed = parse(parser, payload, assets);
+        HeapCount heap;
+        endHeapCount(&heap);
+        const bool parsed = parser.getStatus() != JsonStreamScanner::FAILED && strcmp(parser.getTag(), "v1.1.0") == 0 &&
+                            assets[0].found && assets[0].size == RELEASE_PARSER_BENCHMARK_FIRMWARE_SIZE && assets[0].has_digest &&
+                            assets[1].found && assets[2].found;
+
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < iterations; i++)
+        {
+            parse(parser, payload, assets);
+        }
+        const double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / iterations;
+        const bool bounded = !counting || heap.allocations == 0;
+        printf("  %7u bytes (%7u fed) %9.1f us per parse %7.1f MB/s, %u heap allocations, %lld bytes peak heap: %s\n",
+               (unsigned)payload.size(), (unsigned)fed, us, us > 0 ? fed / us : 0.0, heap.allocations, (long long)heap.peak_bytes,
+               !parsed ? "WRONG RELEASE" : bounded ? "ok" : "ALLOCATES");
+        passed = passed && parsed && bounded;
+    }
+    printf("%s\n", passed ? "Passed." : "FAILED.");
+    return passed ? 0 : 1;
+}
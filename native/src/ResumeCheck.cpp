@@ -0,0 +1,97 @@
+#include "ResumeCheck.h"
+#include <Preferences.h>
+#include <stdio.h>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "ESP32_OTA_Updater.h"
+#include "FileFirmwareSink.h"
+#include "LoopbackHttpTransport.h"
+
+#define RESUME_CHECK_PARTITION_SIZE 0x1E0000 /**< Size of the simulated OTA partition. */
+#define RESUME_CHECK_MIN_CUT 4096            /**< Bytes received before the earliest cut, past the signature asset. */
+
+/** Bytes an interrupted download may lose: the data after the last checkpoint, in the pipeline and in the open sector. */
+#define RESUME_CHECK_MAX_LOSS                                                                                      \
+    (ESP32_OTA_UPDATER_RESUME_CHECKPOINT_SIZE + ESP32_OTA_UPDATER_PIPELINE_BUFFERS * ESP32_OTA_UPDATER_PIPELINE_BUFFER_SIZE + \
+     FIRMWARE_SINK_SECTOR_SIZE)
+
+static std::vector<uint8_t> readFile(const std::string &path)
+{
+    std::ifstream file(path, std::ios::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+int runResumeCheck(const char *root, const char *asset, uint32_t cuts, uint32_t seed)
+{
+    const std::vector<uint8_t> image = readFile(std::string(root) + "/assets/" + asset);
+    const std::vector<uint8_t> key = readFile(std::string(root) + "/signing_key.pub.pem");
+    const std::string signing_key(key.begin(), key.end());
+    const uint32_t share = image.size() / (cuts + 1);
+    if (share <= RESUME_CHECK_MIN_CUT)
+    {
+        printf("%s is too small for %u cuts.\n", asset, cuts);
+        return 1;
+    }
+
+    // A device of its own, the NVS and the partition start empty
+    Preferences::useStorage("resume-device");
+    Preferences nvs;
+    const std::string flash_path = std::string(root) + "/resume-device.bin";
+    remove(flash_path.c_str());
+
+    printf("Installing %s (%u bytes) with %u connection cuts:\n", asset, (unsigned)image.size(), cuts);
+    bool passed = true;
+    bool installed = false;
+    uint64_t downloaded = 0;
+    uint64_t lost = 0;
+    uint32_t received_before = 0; // Image bytes received before the last cut
+    for (uint32_t attempt = 0; attempt <= cuts; attempt++)
+    {
+        seed = seed * 1103515245 + 12345;
+        const uint32_t cut = attempt < cuts ? RESUME_CHECK_MIN_CUT + (seed >> 8) % (share - RESUME_CHECK_MIN_CUT) : 0;
+        LoopbackNetwork network = {};
+        network.disconnect_after = cut;
+        network.disconnects = cut > 0 ? 1 : 0;
+        LoopbackHttpTransport transport(root);
+        transport.setNetwork(&network);
+        FileFirmwareSink firmware_sink(flash_path.c_str(), RESUME_CHECK_PARTITION_SIZE);
+        ESP32_OTA_Updater ota(&transport, &firmware_sink, NULL, "1.0.0");
+        ota.setCheckInterval(0);
+        if (!signing_key.empty())
+        {
+            ota.setSigningKey(signing_key.c_str());
+        }
+        ota.begin("local", "firmware", asset);
+        installed = ota.available() && ota.downloadAndInstall();
+        const UpdateMetrics &metrics = ota.getMetrics();
+        const uint32_t bytes = metrics.phases[UPDATE_PHASE_DOWNLOAD].bytes;
+
+        // The first attempt starts at 0, every later one where the previous one was cut, minus what was not committed
+        const uint32_t resumed_at = metrics.resumed_at;
+        const uint32_t loss = received_before - (resumed_at < received_before ? resumed_at : received_before);
+        const bool resumed = resumed_at % FIRMWARE_SINK_SECTOR_SIZE == 0 && resumed_at <= received_before &&
+                             loss <= (attempt == 0 ? 0 : RESUME_CHECK_MAX_LOSS);
+        const bool expected = attempt < cuts ? !installed : installed;
+        char cut_text[32];
+        snprintf(cut_text, sizeof(cut_text), cut > 0 ? "cut after %7u bytes," : "not cut,", cut);
+        printf("  attempt %u: %-9s %-24s resumed at %7u (%6u bytes lost), %7u bytes downloaded%s\n", attempt,
+               installed ? "installed" : "failed", cut_text, resumed_at, loss, bytes, resumed && expected ? "" : ", UNEXPECTED");
+        passed = passed && resumed && expected;
+        downloaded += bytes;
+        lost += loss;
+        received_before = resumed_at + cut;
+    }
+    Preferences::useStorage("");
+
+    const std::vector<uint8_t> flash = readFile(flash_path);
+    const bool matches = flash.size() >= image.size() && std::equal(image.begin(), image.end(), flash.begin());
+    printf("%llu bytes downloaded for a %u byte image (%llu bytes lost to the cuts), image %s.\n", (unsigned long long)downloaded,
+           (unsigned)image.size(), (unsigned long long)lost, matches ? "matches" : "DIFFERS");
+    passed = passed && installed && matches;
+    printf("%s\n", passed ? "Passed." : "FAILED.");
+    return passed ? 0 : 1;
+}
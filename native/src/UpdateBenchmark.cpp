@@ -0,0 +1,324 @@
+#include "UpdateBenchmark.h"
+#include <Preferences.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+
+#include "AllocationCheck.h"
+#include "ESP32_OTA_Updater.h"
+#include "FileFirmwareSink.h"
+#include "JsonStreamScanner.h"
+#include "LoopbackHttpTransport.h"
+
+#define UPDATE_BENCHMARK_PARTITION_SIZE 0x1E0000 /**< Size of the simulated OTA partition. */
+
+struct BenchmarkScenario
+{
+    const char *name;
+    size_t payload_bytes;    /**< Size the release JSON is padded to, 0 to serve it as published. */
+    LoopbackNetwork network; /**< The emulated network, all 0 for none. */
+};
+
+/** The metrics of a scenario, in the order of the report. */
+struct BenchmarkResult
+{
+    bool installed;
+    uint32_t attempts;
+    double check_ms;
+    double install_ms;
+    double throughput_bps;    /**< Image bytes per second of the install. */
+    int64_t check_heap_peak;   /**< Largest heap increase during the check. */
+    int64_t install_heap_peak; /**< Largest heap increase during the install. */
+    uint64_t check_bytes;
+    uint64_t install_bytes;
+    uint32_t requests;
+    uint32_t handshakes;
+};
+
+/** How much worse than the baseline a metric may be: by `percent` (0 for the configured tolerance) plus `slack`. */
+struct BenchmarkThreshold
+{
+    const char *metric;
+    bool lower_is_worse;
+    uint32_t percent;
+    double slack;
+};
+
+static const BenchmarkThreshold thresholds[] = {
+    {"check_ms", false, 0, 2},           {"install_ms", false, 0, 20},        {"throughput_bps", true, 0, 0},
+    {"check_heap_peak", false, 10, 1024}, {"install_heap_peak", false, 10, 1024}, {"check_bytes", false, 2, 0},
+    {"install_bytes", false, 2, 0},      {"requests", false, 0, 0},            {"handshakes", false, 0, 0},
+};
+
+typedef std::map<std::string, double> BenchmarkMetrics;
+
+/** Reads the scenarios of a report, every scalar member of a scenario object is kept as number. */
+class BaselineReader : public JsonStreamScanner
+{
+public:
+    std::map<std::string, BenchmarkMetrics> scenarios;
+
+protected:
+    void onContainerBegin(bool is_array) override
+    {
+        if (getDepth() == 3)
+        {
+            name.clear();
+            metrics.clear();
+        }
+    }
+
+    void onContainerEnd(bool is_array) override
+    {
+        if (getDepth() == 3 && !name.empty())
+        {
+            scenarios[name] = metrics;
+        }
+    }
+
+    char *onValueBegin(ValueType type, size_t *capacity) override
+    {
+        if (getDepth() != 3)
+        {
+            return NULL;
+        }
+        *capacity = sizeof(value);
+        return value;
+    }
+
+    void onValueEnd(ValueType type, const char *value, size_t length, bool truncated) override
+    {
+        if (type == STRING && keyIs("name"))
+        {
+            name = value;
+        }
+        else if (type == NUMBER)
+        {
+            metrics[getKey()] = atof(value);
+        }
+    }
+
+private:
+    char value[64];
+    std::string name;
+    BenchmarkMetrics metrics;
+};
+
+static BenchmarkMetrics toMetrics(const BenchmarkResult &result)
+{
+    BenchmarkMetrics metrics;
+    metrics["attempts"] = result.attempts;
+    metrics["check_ms"] = result.check_ms;
+    metrics["install_ms"] = result.install_ms;
+    metrics["throughput_bps"] = result.throughput_bps;
+    metrics["check_heap_peak"] = result.check_heap_peak;
+    metrics["install_heap_peak"] = result.install_heap_peak;
+    metrics["check_bytes"] = result.check_bytes;
+    metrics["install_bytes"] = result.install_bytes;
+    metrics["requests"] = result.requests;
+    metrics["handshakes"] = result.handshakes;
+    return metrics;
+}
+
+std::string padRelease(const std::string &release, size_t target)
+{
+    const size_t assets_start = release.find("\"assets\":[");
+    if (target <= release.size() || assets_start == std::string::npos || release.compare(release.size() - 2, 2, "\"}") != 0)
+    {
+        return release;
+    }
+    std::string assets;
+    std::string notes;
+    for (uint32_t i = 0; release.size() + assets.size() + notes.size() < target; i++)
+    {
+        char asset[1024];
+        snprintf(asset, sizeof(asset),
+                 "{\"url\":\"https://api.github.com/repos/local/firmware/releases/assets/%u\",\"id\":%u,\"node_id\":\"RA_kwDOLoop%06u\","
+                 "\"name\":\"extra-%u.bin\",\"label\":\"\",\"uploader\":{\"login\":\"github-actions[bot]\",\"id\":41898282,"
+                 "\"node_id\":\"MDM6Qm90NDE4OTgyODI=\",\"avatar_url\":\"https://avatars.githubusercontent.com/in/15368?v=4\","
+                 "\"gravatar_id\":\"\",\"url\":\"https://api.github.com/users/github-actions%%5Bbot%%5D\",\"html_url\":"
+                 "\"https://github.com/apps/github-actions\",\"type\":\"Bot\",\"site_admin\":false},\"content_type\":"
+                 "\"application/octet-stream\",\"state\":\"uploaded\",\"size\":%u,\"download_count\":%u,\"created_at\":"
+                 "\"2024-01-01T00:00:00Z\",\"updated_at\":\"2024-01-01T00:00:00Z\",\"browser_download_url\":"
+                 "\"https://github.com/local/firmware/releases/download/extra/extra-%u.bin\"},",
+                 1000 + i, 1000 + i, i, i, 65536 + i, 3 * i, i);
+        assets += asset;
+        char note[128];
+        snprintf(note, sizeof(note), "\\r\\n- Fixed issue #%u in the update path, see the pull request for the details.", 100 + i);
+        notes += note;
+    }
+    std::string padded = release;
+    padded.insert(padded.size() - 2, notes);
+    padded.insert(assets_start + 10, assets);
+    return padded;
+}
+
+static double elapsedMs(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static BenchmarkResult runScenario(const UpdateBenchmarkConfig &config, const BenchmarkScenario &scenario, uint32_t image_size)
+{
+    BenchmarkResult result = {};
+    const std::string name = std::string("bench-") + scenario.name;
+    const std::string flash_path = std::string(config.root) + "/" + name + ".bin";
+    unlink(flash_path.c_str());
+    Preferences::useStorage(name.c_str());
+    LoopbackNetwork network = scenario.network; // The disconnects are counted down
+    LoopbackHttpTransport transport(config.root);
+    transport.setNetwork(&network);
+    FileFirmwareSink firmware_sink(flash_path.c_str(), UPDATE_BENCHMARK_PARTITION_SIZE);
+    ESP32_OTA_Updater ota(&transport, &firmware_sink, NULL, "1.0.0");
+    ota.setCheckInterval(0);
+    ota.setCheckJitter(0);
+    ota.begin("local", "firmware", config.asset);
+    ota.clearCheckCache();
+
+    HeapCount heap;
+    beginHeapCount();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    const bool available = ota.available();
+    result.check_ms = elapsedMs(start);
+    endHeapCount(&heap);
+    result.check_heap_peak = heap.peak_bytes;
+    result.check_bytes = transport.getBytesSent();
+
+    // A lost connection fails the install, the device checks again and resumes where the download stopped
+    beginHeapCount();
+    start = std::chrono::steady_clock::now();
+    const uint32_t max_attempts = scenario.network.disconnects + 2;
+    while (available && !result.installed && result.attempts < max_attempts)
+    {
+        result.installed = (result.attempts == 0 || ota.available()) && ota.downloadAndInstall();
+        result.attempts++;
+    }
+    result.install_ms = elapsedMs(start);
+    endHeapCount(&heap);
+    result.install_heap_peak = heap.peak_bytes;
+    result.install_bytes = transport.getBytesSent() - result.check_bytes;
+    result.throughput_bps = result.installed && result.install_ms > 0 ? image_size * 1000.0 / result.install_ms : 0;
+    result.requests = transport.getRequestCount();
+    result.handshakes = transport.getHandshakeCount();
+    unlink(flash_path.c_str());
+    return result;
+}
+
+static bool readBaseline(const char *path, std::map<std::string, BenchmarkMetrics> *scenarios)
+{
+    std::ifstream file(path, std::ios::binary);
+    std::stringstream content;
+    content << file.rdbuf();
+    const std::string report = content.str();
+    BaselineReader reader;
+    reader.reset();
+    reader.feed((const uint8_t *)report.data(), report.size());
+    *scenarios = reader.scenarios;
+    return file.good() && reader.getStatus() == JsonStreamScanner::FINISHED;
+}
+
+/** Compares the metrics of a scenario with its baseline, prints every regression and returns false if there is one. */
+static bool compareWithBaseline(const char *scenario, const BenchmarkMetrics &metrics, const BenchmarkMetrics &baseline,
+                                uint32_t tolerance_percent)
+{
+    bool passed = true;
+    for (const BenchmarkThreshold &threshold : thresholds)
+    {
+        const BenchmarkMetrics::const_iterator base = baseline.find(threshold.metric);
+        if (base == baseline.end())
+        {
+            continue; // Added after the baseline was recorded
+        }
+        const double value = metrics.at(threshold.metric);
+        const double tolerance = (threshold.percent > 0 ? threshold.percent : tolerance_percent) / 100.0;
+        const bool regressed = threshold.lower_is_worse ? value < base->second * (1 - tolerance) - threshold.slack
+                                                        : value > base->second * (1 + tolerance) + threshold.slack;
+        if (regressed)
+        {
+            printf("Regression in %s: %s is %.1f, the baseline %.1f.\n", scenario, threshold.metric, value, base->second);
+            passed = false;
+        }
+    }
+    return passed;
+}
+
+int runUpdateBenchmark(const UpdateBenchmarkConfig &config)
+{
+    // Latency in ms, bandwidth in B/s, stall interval in bytes and stall in ms, disconnect position in bytes and count
+    const BenchmarkScenario scenarios[] = {
+        {"ideal", 0, {0, 0, 0, 0, 0, 0}},
+        {"payload-16k", 16384, {0, 0, 0, 0, 0, 0}},
+        {"payload-64k", 65536, {0, 0, 0, 0, 0, 0}},
+        {"wifi", 16384, {20, 2000000, 0, 0, 0, 0}},
+        {"cellular", 16384, {150, 500000, 0, 0, 0, 0}},
+        {"stalls", 16384, {20, 2000000, 262144, 500, 0, 0}},
+        {"disconnects", 16384, {20, 2000000, 0, 0, 409600, 2}},
+    };
+
+    const std::string release_path = std::string(config.root) + "/repos/local/firmware/releases/latest";
+    std::stringstream content;
+    content << std::ifstream(release_path.c_str(), std::ios::binary).rdbuf();
+    const std::string release = content.str();
+    std::ifstream image((std::string(config.root) + "/assets/" + config.asset).c_str(), std::ios::binary | std::ios::ate);
+    const uint32_t image_size = image.good() ? (uint32_t)image.tellg() : 0;
+    if (release.empty() || image_size == 0)
+    {
+        printf("No release with %s in %s.\n", config.asset, config.root);
+        return 1;
+    }
+    std::map<std::string, BenchmarkMetrics> baseline;
+    if (config.baseline != NULL && !readBaseline(config.baseline, &baseline))
+    {
+        printf("Could not read the baseline %s.\n", config.baseline);
+        return 1;
+    }
+
+    printf("%-12s %8s %9s %10s %9s %10s %10s %10s %10s %8s %8s\n", "scenario", "payload", "check ms", "install ms", "MB/s",
+           "check heap", "inst. heap", "check B", "install B", "req/hs", "attempts");
+    std::string report = std::string("{\"asset\":\"") + config.asset + "\",\"image_bytes\":" + std::to_string(image_size) + ",\"scenarios\":[";
+    bool passed = true;
+    for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++)
+    {
+        const BenchmarkScenario &scenario = scenarios[i];
+        const std::string payload = padRelease(release, scenario.payload_bytes);
+        std::ofstream(release_path.c_str(), std::ios::binary) << payload;
+        const BenchmarkResult result = runScenario(config, scenario, image_size);
+        char requests[24];
+        snprintf(requests, sizeof(requests), "%u/%u", result.requests, result.handshakes);
+        printf("%-12s %8u %9.2f %10.1f %9.2f %10lld %10lld %10llu %10llu %8s %8u%s\n", scenario.name, (unsigned)payload.size(),
+               result.check_ms, result.install_ms, result.throughput_bps / 1e6, (long long)result.check_heap_peak,
+               (long long)result.install_heap_peak, (unsigned long long)result.check_bytes,
+               (unsigned long long)result.install_bytes, requests, result.attempts, result.installed ? "" : " FAILED");
+
+        const BenchmarkMetrics metrics = toMetrics(result);
+        report += std::string(i == 0 ? "" : ",") + "{\"name\":\"" + scenario.name + "\",\"payload_bytes\":" +
+                  std::to_string(payload.size()) + ",\"installed\":" + (result.installed ? "true" : "false");
+        for (const BenchmarkMetrics::value_type &metric : metrics)
+        {
+            char value[32];
+            snprintf(value, sizeof(value), metric.second == (int64_t)metric.second ? "%.0f" : "%.3f", metric.second);
+            report += ",\"" + metric.first + "\":" + value;
+        }
+        report += "}";
+        passed = result.installed && passed;
+        if (baseline.count(scenario.name) > 0)
+        {
+            passed = compareWithBaseline(scenario.name, metrics, baseline[scenario.name], config.tolerance_percent) && passed;
+        }
+    }
+    report += "]}\n";
+    std::ofstream(release_path.c_str(), std::ios::binary) << release;
+
+    if (config.report != NULL && !(std::ofstream(config.report, std::ios::binary) << report))
+    {
+        printf("Could not write the report %s.\n", config.report);
+        return 1;
+    }
+    printf("%s%s\n", passed ? "Passed" : "FAILED", config.baseline != NULL ? " against the baseline." : ".");
+    return passed ? 0 : 1;
+}
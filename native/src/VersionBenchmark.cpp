@@ -0,0 +1,209 @@
+#include "VersionBenchmark.h"
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "SemanticVersion.h"
+
+/**
+ * @brief The Version class before SemVer 2.0 support, only parses major, minor and patch with sscanf.
+ */
+class SscanfVersion
+{
+public:
+    int major = 0;
+    int minor = 0;
+    int patch = 0;
+
+    SscanfVersion(const char *version)
+    {
+        if (version != NULL && strlen(version) > 0)
+        {
+            if (version[0] == 'v')
+            {
+                version++;
+            }
+            sscanf(version, "%d.%d.%d", &major, &minor, &patch);
+        }
+    }
+
+    bool operator<(const SscanfVersion &other) const
+    {
+        if (major != other.major)
+            return major < other.major;
+        if (minor != other.minor)
+            return minor < other.minor;
+        return patch < other.patch;
+    }
+};
+
+static const char *const PRECEDENCE[] = {"1.0.0-alpha", "1.0.0-alpha.1", "1.0.0-alpha.beta", "1.0.0-beta", "1.0.0-beta.2",
+                                         "1.0.0-beta.11", "1.0.0-rc.1", "1.0.0", "1.0.1", "1.1.0-0", "1.1.0", "2.0.0"};
+// Identifiers which only differ after the part the pre-release key holds
+static const char *const LONG_PRECEDENCE[] = {"1.0.0-9", "1.0.0-4294967295", "1.0.0-4294967296", "1.0.0-99999999999",
+                                              "1.0.0-alphabet", "1.0.0-alphabet.1", "1.0.0-alphabetical", "1.0.0-alphabets"};
+static const char *const INVALID[] = {"", "1", "1.2", "1.2.3.4", "01.2.3", "1.2.3-", "1.2.3-01", "1.2.3-a..b", "1.2.3+",
+                                      "1.2.3+a+b", "1.2.3-a_b", " 1.2.3", "1.2.3 ", "v", "1.2.3-\xff", "9999999999.0.0"};
+static const char *const SAMPLES[] = {"v1.2.3", "1.0.0-rc.1+build.5", "2.10.0-beta.2", "0.0.1-alpha.1.x-y", "1.0.0+sha.5114f85"};
+
+static bool checkOrder(const char *const versions[], size_t count)
+{
+    bool passed = true;
+    for (size_t i = 0; i < count; i++)
+    {
+        for (size_t j = 0; j < count; j++)
+        {
+            const Version a(versions[i]);
+            const Version b(versions[j]);
+            if (!a.isValid() || (a < b) != (i < j) || (a == b) != (i == j))
+            {
+                printf("Precedence of %s and %s is wrong.\n", versions[i], versions[j]);
+                passed = false;
+            }
+        }
+    }
+    return passed;
+}
+
+static bool checkPrecedence()
+{
+    bool passed = checkOrder(PRECEDENCE, sizeof(PRECEDENCE) / sizeof(PRECEDENCE[0]));
+    passed = checkOrder(LONG_PRECEDENCE, sizeof(LONG_PRECEDENCE) / sizeof(LONG_PRECEDENCE[0])) && passed;
+    for (const char *text : INVALID)
+    {
+        if (Version(text).isValid())
+        {
+            printf("\"%s\" is accepted.\n", text);
+            passed = false;
+        }
+    }
+    const Version with_build("1.0.0-rc.1+build.5");
+    if (with_build != Version("1.0.0-rc.1+build.6") || strcmp(with_build.getBuild(), "build.5") != 0 ||
+        strcmp(with_build.getPreRelease(), "rc.1") != 0)
+    {
+        printf("Build metadata is not separated from the pre-release.\n");
+        passed = false;
+    }
+    const Version build_only("1.0.0+sha.5114f85");
+    if (build_only.getPreRelease()[0] != '\0' || strcmp(build_only.getBuild(), "sha.5114f85") != 0 || build_only != Version(1, 0, 0))
+    {
+        printf("Build metadata without a pre-release is not separated.\n");
+        passed = false;
+    }
+    return passed;
+}
+
+static std::string mutate(std::mt19937 &random, std::string text)
+{
+    static const char ALPHABET[] = "0123456789.-+vaZ\x01\xff";
+    const uint32_t edits = 1 + random() % 3;
+    for (uint32_t i = 0; i < edits; i++)
+    {
+        const size_t position = text.empty() ? 0 : random() % (text.size() + 1);
+        const char c = ALPHABET[random() % (sizeof(ALPHABET) - 1)];
+        switch (random() % 4)
+        {
+        case 0:
+            text.insert(position, 1, c);
+            break;
+        case 1:
+            if (position < text.size())
+            {
+                text.erase(position, 1);
+            }
+            break;
+        case 2:
+            if (position < text.size())
+            {
+                text[position] = c;
+            }
+            break;
+        default:
+            text.insert(position, std::string(random() % 40, c)); // Long numbers and labels
+            break;
+        }
+    }
+    return text;
+}
+
+static bool fuzz(uint32_t iterations, uint32_t *valid)
+{
+    std::mt19937 random(12345);
+    Version previous;
+    *valid = 0;
+    for (uint32_t i = 0; i < iterations; i++)
+    {
+        const std::string text = mutate(random, SAMPLES[random() % (sizeof(SAMPLES) / sizeof(SAMPLES[0]))]);
+        const Version version(text.c_str());
+        if (Version::validate(text.c_str()) != version.getError())
+        {
+            printf("validate() and the constructor disagree on \"%s\".\n", text.c_str());
+            return false;
+        }
+        if (!version.isValid())
+        {
+            continue;
+        }
+        (*valid)++;
+        char formatted[2 * SEMANTIC_VERSION_LABEL_LENGTH + 32];
+        version.toString(formatted, sizeof(formatted));
+        const size_t start = text[0] == 'v' || text[0] == 'V' ? 1 : 0;
+        if (text.compare(start, strcspn(text.c_str() + start, "+"), formatted) != 0 || Version(formatted) != version)
+        {
+            printf("\"%s\" is formatted as \"%s\".\n", text.c_str(), formatted);
+            return false;
+        }
+        if ((previous < version) + (version < previous) + (previous == version) != 1)
+        {
+            printf("\"%s\" is not ordered consistently.\n", text.c_str());
+            return false;
+        }
+        previous = version;
+    }
+    return true;
+}
+
+template <typename T>
+static void measure(const char *name, uint32_t rounds)
+{
+    const size_t count = sizeof(PRECEDENCE) / sizeof(PRECEDENCE[0]);
+    volatile uint32_t sink = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (uint32_t round = 0; round < rounds; round++)
+    {
+        const T version(PRECEDENCE[round % count]);
+        sink = sink + (version < version ? 1 : 0);
+    }
+    const double parse_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / rounds;
+
+    std::vector<T> versions;
+    for (const char *text : PRECEDENCE)
+    {
+        versions.push_back(T(text));
+    }
+    start = std::chrono::steady_clock::now();
+    for (uint32_t round = 0; round < rounds; round++)
+    {
+        sink = sink + (versions[round % count] < versions[(round * 7 + 3) % count] ? 1 : 0);
+    }
+    const double compare_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / rounds;
+    printf("  %-8s parse %7.1f ns, compare %5.1f ns, %2u bytes\n", name, parse_ns, compare_ns, (unsigned int)sizeof(T));
+}
+
+int runVersionBenchmark(uint32_t iterations)
+{
+    bool passed = checkPrecedence();
+    uint32_t valid = 0;
+    passed = fuzz(iterations, &valid) && passed;
+    printf("Fuzzed %u strings, %u of them valid versions.\n", iterations, valid);
+
+    // The former class ranks "1.0.0-rc.1" equal to "1.0.0", its ordering is only measured
+    printf("Throughput over the precedence example of SemVer 2.0.0:\n");
+    measure<Version>("Version", 2000000);
+    measure<SscanfVersion>("sscanf", 2000000);
+    printf(passed ? "All checks passed.\n" : "Checks FAILED.\n");
+    return passed ? 0 : 1;
+}
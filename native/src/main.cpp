@@ -0,0 +1,566 @@
+/*
+ * Host runner for the native environment: performs the complete check and install flow against a release served
+ * from a local directory and reports the timing.
+ *
+ * Usage: ota_native <root> <tag> <asset> <current_version> <flash_file> [running_image]
+ *
+ * Every file in <root>/assets/ is published as an asset of the release <tag>, the release information is written
+ * to <root>/repos/local/firmware/releases/latest and the binary manifest (see ManifestParser.h) to
+ * <root>/local/firmware/releases/latest/download/manifest.bin, OTA_NATIVE_MANIFEST=1 checks with it (see
+ * setManifest()). The asset named <asset> is installed into <flash_file>, delta
+ * patches from <current_version> are applied to [running_image] if it is given. If <root>/signing_key.pub.pem exists,
+ * the release has to be signed with the matching private key (see setSigningKey()). If <root>/encryption_key.bin
+ * exists, its 32 bytes are used to decrypt the assets (see setDecryptionKey()). With OTA_NATIVE_ROLLOUT=<percent> the
+ * release notes start with a rollout line and the update is only installed if the device OTA_NATIVE_DEVICE_ID is
+ * included (see setStagedRollout()). With OTA_NATIVE_DATA=<asset> that asset is installed into <flash_file>.data as
+ * a second component of the update (see addComponent()), OTA_NATIVE_CERTS=<asset> installs that signed certificate
+ * bundle into a CertificateStore (see setCertificateStore()). OTA_NATIVE_HISTORY="<tag> ..." lists older releases after
+ * <tag> in the releases list, OTA_NATIVE_CHANNEL=<spec> selects the release from that list (see setReleaseChannel()).
+ * OTA_NATIVE_RATE=<bytes_per_second> caps the download rate (see setDownloadRateLimit()) and fails if more than the
+ * cap plus one burst was received in any second, OTA_NATIVE_PREFETCH=1 stages the update, checks that a check of a
+ * broken release keeps it staged and times commitStaged().
+ *
+ * Usage: ota_native --simulate <root> [devices] [hours] [limit] [interval_s] [jitter_s]
+ *
+ * Simulates a fleet of devices checking the release in <root> against a shared rate limit, see FleetSimulation.h.
+ *
+ * Usage: ota_native --peers <root> [devices] [asset]
+ *
+ * Simulates devices on one local network installing v1.1.0 from <root> with and without sharing the image between
+ * them (see setPeerNetwork()), see PeerSimulation.h.
+ *
+ * Usage: ota_native --manifest <root> [asset] [iterations]
+ *
+ * Publishes <root>/assets/ as release v1.1.0 and compares the check through the manifest with the check through the
+ * release JSON, see ManifestBenchmark.h.
+ *
+ * Usage: ota_native --batch <root> [asset] [components]
+ *
+ * Publishes <root>/assets/ as release v1.1.0 of several repositories and compares one release check per repository
+ * with one batched check of all of them, see BatchCheckBenchmark.h.
+ *
+ * Usage: ota_native --bench <root> [asset] [report] [baseline]
+ *
+ * Publishes <root>/assets/ as release v1.1.0 and measures the check and install of <asset> in emulated network
+ * scenarios, writes the results as JSON to [report] and fails on regressions against the report [baseline], see
+ * UpdateBenchmark.h. OTA_NATIVE_TOLERANCE=<percent> sets how much slower the timings may be (25 by default).
+ *
+ * Usage: ota_native --headers [image_size]
+ *
+ * Installs images built for another chip, flash size, project or version from memory and prints how many bytes were
+ * downloaded before each was rejected, see ImageHeaderBenchmark.h.
+ *
+ * Usage: ota_native --allocations [image_size]
+ *
+ * Installs an image from memory with a StaticOtaUpdater and fails if the check or the install allocates from the heap,
+ * see AllocationCheck.h.
+ *
+ * Usage: ota_native --versions [iterations]
+ *
+ * Fuzzes the semantic version parser and measures its throughput, see VersionBenchmark.h.
+ *
+ * Usage: ota_native --codecs [image_size] [rounds]
+ *
+ * Decodes an image stored uncompressed, as gzip, zlib and heatshrink and prints the throughput of each codec, see
+ * CodecBenchmark.h.
+ *
+ * Usage: ota_native --patch [image_size]
+ *
+ * Applies delta patches in poll() slices and compares the reconstructed image byte for byte, see PatchCheck.h.
+ *
+ * Usage: ota_native --poll [image_size]
+ *
+ * Installs images by calls of poll() and checks that no step downloads, reads or writes more than one slice, see
+ * PollCheck.h.
+ *
+ * Usage: ota_native --pipeline [image_size]
+ *
+ * Compares synchronous and pipelined installs over an emulated link and flash and checks that a hanging flash fails
+ * the install in time, see PipelineBenchmark.h.
+ *
+ * Usage: ota_native --resume <root> [asset] [cuts] [seed]
+ *
+ * Installs the release over a connection which is cut at random points and checks that every attempt resumes, see
+ * ResumeCheck.h.
+ *
+ * Usage: ota_native --parse [iterations]
+ *
+ * Parses release payloads of 2 to 256 KB and prints the parse time and heap of each, see ReleaseParserBenchmark.h.
+ *
+ * Usage: ota_native --checks [polls]
+ *
+ * Checks for a release from memory repeatedly and counts the requests and bytes with and without the check cache,
+ * see CheckCacheBenchmark.h.
+ *
+ * Usage: ota_native --certs [certificates] [handshakes]
+ *
+ * Compares the anchor lookup of TLS handshakes with a PEM string and with a CertificateStore and checks that an
+ * installed bundle is only used once the app is activated, see CertificateBenchmark.h.
+ */
+#include <Arduino.h>
+#include <dirent.h>
+#include <stdlib.h>
+#include <mbedtls/sha256.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "AllocationCheck.h"
+#include "BatchCheckBenchmark.h"
+#include "CertificateBenchmark.h"
+#include "CheckCacheBenchmark.h"
+#include "CodecBenchmark.h"
+#include "ESP32_OTA_Updater.h"
+#include "FileFirmwareSink.h"
+#include "FleetSimulation.h"
+#include "ImageHeaderBenchmark.h"
+#include "LoopbackHttpTransport.h"
+#include "ManifestBenchmark.h"
+#include "PatchCheck.h"
+#include "PeerSimulation.h"
+#include "PipelineBenchmark.h"
+#include "PollCheck.h"
+#include "ReleaseParserBenchmark.h"
+#include "ResumeCheck.h"
+#include "UpdateBenchmark.h"
+#include "VersionBenchmark.h"
+
+#define NATIVE_PARTITION_SIZE 0x1E0000 /**< Size of the simulated OTA partition, like the default partition table. */
+#define NATIVE_DATA_PARTITION_SIZE 0x160000 /**< Size of the simulated data partition, like the default "spiffs". */
+
+static bool digestFile(const std::string &path, char *hex, uint8_t *digest)
+{
+    FILE *file = fopen(path.c_str(), "rb");
+    if (file == NULL)
+    {
+        return false;
+    }
+    mbedtls_sha256_context context;
+    mbedtls_sha256_init(&context);
+    mbedtls_sha256_starts(&context, 0);
+    uint8_t buffer[4096];
+    size_t length;
+    while ((length = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    {
+        mbedtls_sha256_update(&context, buffer, length);
+    }
+    fclose(file);
+    mbedtls_sha256_finish(&context, digest);
+    mbedtls_sha256_free(&context);
+    for (size_t i = 0; i < 32; i++)
+    {
+        snprintf(hex + 2 * i, 3, "%02x", digest[i]);
+    }
+    return true;
+}
+
+static void appendLittleEndian(std::string &out, uint32_t value)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        out += (char)(value >> (8 * i));
+    }
+}
+
+static bool writeRelease(const std::string &root, const char *tag)
+{
+    const std::string release_dir = root + "/repos/local/firmware/releases";
+    mkdir((root + "/repos").c_str(), 0755);
+    mkdir((root + "/repos/local").c_str(), 0755);
+    mkdir((root + "/repos/local/firmware").c_str(), 0755);
+    mkdir(release_dir.c_str(), 0755);
+    // The release download URLs of github.com, "latest/download/<manifest>" and "download/<tag>/<asset>"
+    const std::string download_dir = root + "/local/firmware/releases";
+    mkdir((root + "/local").c_str(), 0755);
+    mkdir((root + "/local/firmware").c_str(), 0755);
+    mkdir(download_dir.c_str(), 0755);
+    mkdir((download_dir + "/download").c_str(), 0755);
+    mkdir((download_dir + "/latest").c_str(), 0755);
+    mkdir((download_dir + "/latest/download").c_str(), 0755);
+
+    DIR *assets = opendir((root + "/assets").c_str());
+    if (assets == NULL)
+    {
+        return false;
+    }
+    std::string asset_list;
+    std::string manifest_assets;
+    uint8_t manifest_asset_count = 0;
+    for (struct dirent *entry = readdir(assets); entry != NULL; entry = readdir(assets))
+    {
+        struct stat info;
+        const std::string path = root + "/assets/" + entry->d_name;
+        if (stat(path.c_str(), &info) != 0 || !S_ISREG(info.st_mode))
+        {
+            continue;
+        }
+        char digest[65];
+        uint8_t raw_digest[32];
+        if (!digestFile(path, digest, raw_digest))
+        {
+            continue;
+        }
+        manifest_assets += (char)strlen(entry->d_name) + std::string(entry->d_name);
+        appendLittleEndian(manifest_assets, info.st_size);
+        manifest_assets += (char)MANIFEST_FLAG_DIGEST + std::string((const char *)raw_digest, 32);
+        manifest_asset_count++;
+        mkdir((root + "/local/firmware/releases/download/" + tag).c_str(), 0755);
+        const std::string download_path = root + "/local/firmware/releases/download/" + tag + "/" + entry->d_name;
+        unlink(download_path.c_str());
+        if (symlink((std::string("../../../../../assets/") + entry->d_name).c_str(), download_path.c_str()) != 0)
+        {
+            continue;
+        }
+        char asset[512];
+        snprintf(asset, sizeof(asset), "%s{\"url\":\"https://api.github.com/assets/%s\",\"name\":\"%s\",\"size\":%ld,\"digest\":\"sha256:%s\"}",
+                 asset_list.empty() ? "" : ",", entry->d_name, entry->d_name, (long)info.st_size, digest);
+        asset_list += asset;
+    }
+    closedir(assets);
+    const char *rollout = getenv("OTA_NATIVE_ROLLOUT");
+
+    // The binary manifest of the release, see ManifestParser.h for the format
+    std::string manifest = MANIFEST_MAGIC;
+    manifest += (char)MANIFEST_VERSION;
+    manifest += (char)(rollout != NULL ? atoi(rollout) : 100);
+    manifest += (char)manifest_asset_count;
+    manifest += '\0';
+    manifest += (char)strlen(tag) + std::string(tag) + manifest_assets;
+    const uint32_t manifest_crc = Crc32::update(0, (const uint8_t *)manifest.data(), manifest.size());
+    appendLittleEndian(manifest, manifest_crc);
+    std::ofstream((download_dir + "/latest/download/manifest.bin").c_str(), std::ios::binary) << manifest;
+
+    const std::string body = rollout != NULL ? std::string("Rollout: ") + rollout + "%\\r\\nRelease served by the native loopback transport."
+                                             : "Release served by the native loopback transport.";
+
+    // Every release of the list (newest first) offers the same assets, GitHub lists the flags before the assets
+    std::vector<std::string> tags(1, tag);
+    std::istringstream history(getenv("OTA_NATIVE_HISTORY") != NULL ? getenv("OTA_NATIVE_HISTORY") : "");
+    for (std::string older; history >> older;)
+    {
+        tags.push_back(older);
+    }
+    std::vector<std::string> releases;
+    for (size_t i = 0; i < tags.size(); i++)
+    {
+        const bool prerelease = tags[i].find('-') != std::string::npos;
+        releases.push_back("{\"url\":\"https://api.github.com/repos/local/firmware/releases/" + std::to_string(tags.size() - i) +
+                           "\",\"tag_name\":\"" + tags[i] + "\",\"draft\":false,\"prerelease\":" + (prerelease ? "true" : "false") +
+                           ",\"assets\":[" + asset_list + "],\"body\":\"" + body + "\"}");
+    }
+    std::ofstream((release_dir + "/latest").c_str()) << releases[0];
+    for (size_t page = 0; page * ESP32_OTA_UPDATER_RELEASES_PER_PAGE < releases.size() || page == 0; page++)
+    {
+        std::ofstream list((release_dir + "/page-" + std::to_string(page + 1)).c_str());
+        list << "[";
+        for (size_t i = page * ESP32_OTA_UPDATER_RELEASES_PER_PAGE; i < releases.size() && i < (page + 1) * ESP32_OTA_UPDATER_RELEASES_PER_PAGE; i++)
+        {
+            list << (i % ESP32_OTA_UPDATER_RELEASES_PER_PAGE == 0 ? "" : ",") << releases[i];
+        }
+        list << "]";
+    }
+    return true;
+}
+
+/** Replaces the published release JSON, releases list and manifest with a broken response, writeRelease() restores them. */
+static void breakRelease(const std::string &root)
+{
+    std::ofstream((root + "/repos/local/firmware/releases/latest").c_str()) << "{\"tag_name\":]";
+    std::ofstream((root + "/repos/local/firmware/releases/page-1").c_str()) << "[{\"tag_name\":]";
+    std::ofstream((root + "/local/firmware/releases/latest/download/manifest.bin").c_str(), std::ios::binary) << "broken";
+}
+
+static void printMetrics(const UpdateMetrics &metrics)
+{
+    static const char *phase_names[UPDATE_PHASE_COUNT] = {"check", "signature", "download", "flash", "verify", "finish"};
+    for (uint8_t phase = 0; phase < UPDATE_PHASE_COUNT; phase++)
+    {
+        const UpdatePhaseMetrics &metric = metrics.getPhase((UpdatePhase)phase);
+        printf("  %-9s %6u ms %9u bytes %10u B/s\n", phase_names[phase], metric.duration_ms, metric.bytes, metric.getThroughput());
+    }
+    for (uint8_t i = 0; i < metrics.request_count && i < ESP32_OTA_UPDATER_METRICS_MAX_REQUESTS; i++)
+    {
+        const UpdateRequestMetrics &request = metrics.requests[i];
+        printf("  request %u: %s, status %d, %s connection, %u redirects\n", i, phase_names[request.phase], request.status,
+               request.timing.reused ? "reused" : "new", request.timing.redirects);
+    }
+    printf("  %u handshakes, %u retries, %u patch fallbacks, resumed at %u, error %u\n", metrics.handshakes, metrics.retries,
+           metrics.patch_fallbacks, metrics.resumed_at, metrics.error);
+}
+
+static double elapsedMs(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+struct ProgressSample
+{
+    double time_ms;
+    size_t bytes;
+};
+
+/** Returns the largest number of bytes received within any window of window_ms. */
+static size_t peakWindowBytes(const std::vector<ProgressSample> &samples, double window_ms)
+{
+    size_t peak = 0;
+    for (size_t first = 0; first < samples.size(); first++)
+    {
+        for (size_t last = first + 1; last < samples.size() && samples[last].time_ms - samples[first].time_ms <= window_ms; last++)
+        {
+            peak = samples[last].bytes - samples[first].bytes > peak ? samples[last].bytes - samples[first].bytes : peak;
+        }
+    }
+    return peak;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc >= 2 && strcmp(argv[1], "--versions") == 0)
+    {
+        return runVersionBenchmark(argc > 2 ? strtoul(argv[2], NULL, 10) : 1000000);
+    }
+    if (argc >= 2 && strcmp(argv[1], "--codecs") == 0)
+    {
+        return runCodecBenchmark(argc > 2 ? strtoul(argv[2], NULL, 10) : 1048576, argc > 3 ? strtoul(argv[3], NULL, 10) : 20);
+    }
+    if (argc >= 2 && strcmp(argv[1], "--patch") == 0)
+    {
+        return runPatchCheck(argc > 2 ? strtoul(argv[2], NULL, 10) : 1048576);
+    }
+    if (argc >= 2 && strcmp(argv[1], "--poll") == 0)
+    {
+        return runPollCheck(argc > 2 ? strtoul(argv[2], NULL, 10) : 1048576);
+    }
+    if (argc >= 2 && strcmp(argv[1], "--pipeline") == 0)
+    {
+        return runPipelineBenchmark(argc > 2 ? strtoul(argv[2], NULL, 10) : 262144);
+    }
+    if (argc >= 2 && strcmp(argv[1], "--parse") == 0)
+    {
+        return runReleaseParserBenchmark(argc > 2 ? strtoul(argv[2], NULL, 10) : 1000);
+    }
+    if (argc >= 2 && strcmp(argv[1], "--checks") == 0)
+    {
+        return runCheckCacheBenchmark(argc > 2 ? strtoul(argv[2], NULL, 10) : 100);
+    }
+    if (argc >= 2 && strcmp(argv[1], "--certs") == 0)
+    {
+        return runCertificateBenchmark(argc > 2 ? strtoul(argv[2], NULL, 10) : 10, argc > 3 ? strtoul(argv[3], NULL, 10) : 100);
+    }
+    if (argc >= 3 && strcmp(argv[1], "--bench") == 0)
+    {
+        if (!writeRelease(argv[2], "v1.1.0"))
+        {
+            printf("Could not publish %s/assets/ as release.\n", argv[2]);
+            return 2;
+        }
+        UpdateBenchmarkConfig config;
+        config.root = argv[2];
+        config.asset = argc > 3 ? argv[3] : "firmware.bin";
+        config.report = argc > 4 && argv[4][0] != '\0' ? argv[4] : NULL; // "" to only compare
+        config.baseline = argc > 5 ? argv[5] : NULL;
+        config.tolerance_percent = getenv("OTA_NATIVE_TOLERANCE") != NULL ? strtoul(getenv("OTA_NATIVE_TOLERANCE"), NULL, 10) : 25;
+        return runUpdateBenchmark(config);
+    }
+    if (argc >= 2 && strcmp(argv[1], "--headers") == 0)
+    {
+        return runImageHeaderBenchmark(argc > 2 ? strtoul(argv[2], NULL, 10) : 1048576);
+    }
+    if (argc >= 2 && strcmp(argv[1], "--allocations") == 0)
+    {
+        return runAllocationCheck(argc > 2 ? strtoul(argv[2], NULL, 10) : 1048576);
+    }
+    if (argc >= 3 && strcmp(argv[1], "--simulate") == 0)
+    {
+        FleetSimulationConfig config;
+        config.root = argv[2];
+        config.devices = argc > 3 ? strtoul(argv[3], NULL, 10) : 8000;
+        config.hours = argc > 4 ? strtoul(argv[4], NULL, 10) : 12;
+        config.limit = argc > 5 ? strtoul(argv[5], NULL, 10) : 5000;
+        config.interval_s = argc > 6 ? strtoul(argv[6], NULL, 10) : 21600;
+        config.jitter_s = argc > 7 ? strtoul(argv[7], NULL, 10) : 7200;
+        if (!writeRelease(config.root, "v1.1.0"))
+        {
+            printf("Could not publish %s/assets/ as release.\n", config.root);
+            return 2;
+        }
+        return runFleetSimulation(config);
+    }
+    if (argc >= 3 && strcmp(argv[1], "--manifest") == 0)
+    {
+        if (!writeRelease(argv[2], "v1.1.0"))
+        {
+            printf("Could not publish %s/assets/ as release.\n", argv[2]);
+            return 2;
+        }
+        return runManifestBenchmark(argv[2], argc > 3 ? argv[3] : "firmware.bin", argc > 4 ? strtoul(argv[4], NULL, 10) : 10000);
+    }
+    if (argc >= 3 && strcmp(argv[1], "--batch") == 0)
+    {
+        if (!writeRelease(argv[2], "v1.1.0"))
+        {
+            printf("Could not publish %s/assets/ as release.\n", argv[2]);
+            return 2;
+        }
+        return runBatchCheckBenchmark(argv[2], argc > 3 ? argv[3] : "firmware.bin", argc > 4 ? strtoul(argv[4], NULL, 10) : 3);
+    }
+    if (argc >= 3 && strcmp(argv[1], "--resume") == 0)
+    {
+        if (!writeRelease(argv[2], "v1.1.0"))
+        {
+            printf("Could not publish %s/assets/ as release.\n", argv[2]);
+            return 2;
+        }
+        return runResumeCheck(argv[2], argc > 3 ? argv[3] : "firmware.bin", argc > 4 ? strtoul(argv[4], NULL, 10) : 5,
+                              argc > 5 ? strtoul(argv[5], NULL, 10) : 1);
+    }
+    if (argc >= 3 && strcmp(argv[1], "--peers") == 0)
+    {
+        PeerSimulationConfig config;
+        config.root = argv[2];
+        config.tag = "v1.1.0";
+        config.devices = argc > 3 ? strtoul(argv[3], NULL, 10) : 8;
+        config.asset = argc > 4 ? argv[4] : "firmware.bin";
+        if (!writeRelease(config.root, config.tag))
+        {
+            printf("Could not publish %s/assets/ as release.\n", config.root);
+            return 2;
+        }
+        return runPeerSimulation(config);
+    }
+    if (argc < 6)
+    {
+        printf("Usage: %s <root> <tag> <asset> <current_version> <flash_file> [running_image]\n", argv[0]);
+        return 2;
+    }
+    if (!writeRelease(argv[1], argv[2]))
+    {
+        printf("Could not publish %s/assets/ as release.\n", argv[1]);
+        return 2;
+    }
+
+    StdoutPrint debug;
+    LoopbackHttpTransport transport(argv[1]);
+    transport.setKeepAlive(getenv("OTA_NATIVE_HTTP10") == NULL);
+    transport.setChunked(getenv("OTA_NATIVE_CHUNKED") != NULL);
+    FileFirmwareSink firmware_sink(argv[5], NATIVE_PARTITION_SIZE);
+    FileFirmwareSink data_sink((std::string(argv[5]) + ".data").c_str(), NATIVE_DATA_PARTITION_SIZE, false);
+    FileByteSource running_image(argc > 6 ? argv[6] : "");
+    ESP32_OTA_Updater ota(&transport, &firmware_sink, argc > 6 ? &running_image : NULL, argv[4]);
+    ota.setDebug(&debug);
+    ota.setCheckInterval(0);
+    if (getenv("OTA_NATIVE_CHANNEL") != NULL && !ota.setReleaseChannel(getenv("OTA_NATIVE_CHANNEL")))
+    {
+        return 1;
+    }
+    if (getenv("OTA_NATIVE_MANIFEST") != NULL)
+    {
+        ota.setManifest("manifest.bin");
+    }
+    if (getenv("OTA_NATIVE_DATA") != NULL)
+    {
+        ota.addComponent(getenv("OTA_NATIVE_DATA"), &data_sink);
+    }
+    CertificateStore certificate_store;
+    if (getenv("OTA_NATIVE_CERTS") != NULL)
+    {
+        certificate_store.clear();
+        ota.addComponent(getenv("OTA_NATIVE_CERTS"), &certificate_store);
+    }
+    if (getenv("OTA_NATIVE_ROLLOUT") != NULL)
+    {
+        ota.setStagedRollout(true);
+        ota.setDeviceId(getenv("OTA_NATIVE_DEVICE_ID") != NULL ? getenv("OTA_NATIVE_DEVICE_ID") : "native");
+    }
+    ota.begin("local", "firmware", argv[3]);
+
+    std::ifstream key_file(std::string(argv[1]) + "/signing_key.pub.pem");
+    std::stringstream key_content;
+    const std::string signing_key = key_file ? (key_content << key_file.rdbuf(), key_content.str()) : "";
+    if (!signing_key.empty())
+    {
+        ota.setSigningKey(signing_key.c_str()); // Has to stay valid until the install is done
+        certificate_store.setSigningKey(signing_key.c_str());
+    }
+    std::ifstream encryption_key_file(std::string(argv[1]) + "/encryption_key.bin", std::ios::binary);
+    uint8_t encryption_key[STREAM_DECRYPTOR_KEY_SIZE];
+    if (encryption_key_file.read((char *)encryption_key, sizeof(encryption_key)))
+    {
+        ota.setDecryptionKey(encryption_key);
+    }
+
+    const uint32_t rate = getenv("OTA_NATIVE_RATE") != NULL ? strtoul(getenv("OTA_NATIVE_RATE"), NULL, 10) : 0;
+    const uint32_t burst = rate / 10 > 2 * ESP32_OTA_UPDATER_POLL_SLICE_SIZE ? rate / 10 : 2 * ESP32_OTA_UPDATER_POLL_SLICE_SIZE;
+    ota.setDownloadRateLimit(rate, burst);
+    ota.setPrefetch(getenv("OTA_NATIVE_PREFETCH") != NULL);
+    std::vector<ProgressSample> samples;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    const bool available = ota.available();
+    const double check_ms = elapsedMs(start);
+    if (!available)
+    {
+        printf("No update available (%s), check took %.2f ms.\n", ota.getErrorDescription().c_str(), check_ms);
+        return ota.getErrorCode() == ESP32_OTA_Updater_Error::NO_ERROR ? 0 : 1;
+    }
+
+    start = std::chrono::steady_clock::now();
+    samples.push_back({0, 0});
+    ota.onProgress([&](size_t progress, size_t size)
+                   { samples.push_back({elapsedMs(start), progress}); });
+    const bool installed = ota.downloadAndInstall();
+    const double install_ms = elapsedMs(start);
+
+    printf("Check: %.2f ms, install: %.2f ms, %u requests, %u handshakes, %llu bytes transferred.\n", check_ms,
+           install_ms, transport.getRequestCount(), transport.getHandshakeCount(),
+           (unsigned long long)transport.getBytesSent());
+    printMetrics(ota.getMetrics());
+    if (!installed)
+    {
+        printf("Install failed: %s\n", ota.getErrorDescription().c_str());
+        return 1;
+    }
+    if (rate > 0)
+    {
+        // A second may carry the rate plus one burst of tokens saved up before it
+        const size_t peak = peakWindowBytes(samples, 1000);
+        const bool held = peak <= rate + burst;
+        printf("Rate cap %u B/s: %.0f B/s on average, at most %zu bytes in one second, %s.\n", rate,
+               samples.back().bytes * 1000.0 / samples.back().time_ms, peak, held ? "held" : "EXCEEDED");
+        if (!held)
+        {
+            return 1;
+        }
+    }
+    if (ota.isStaged())
+    {
+        // A check which fails in between must leave the staged update intact
+        breakRelease(argv[1]);
+        const bool found = ota.available();
+        const bool kept = !found && ota.getErrorCode() != ESP32_OTA_Updater_Error::NO_ERROR && ota.isStaged();
+        printf("Check of a broken release failed (%s), the update is %s.\n", ota.getErrorMessage(), ota.isStaged() ? "still staged" : "DISCARDED");
+        writeRelease(argv[1], argv[2]);
+        if (!kept)
+        {
+            return 1;
+        }
+        start = std::chrono::steady_clock::now();
+        const bool committed = ota.commitStaged();
+        printf("Committed the staged update in %.3f ms after a prefetch of %.0f ms.\n", elapsedMs(start), install_ms);
+        if (!committed)
+        {
+            printf("Commit failed: %s\n", ota.getErrorMessage());
+            return 1;
+        }
+    }
+    printf("Installed %s into %s.\n", argv[2], argv[5]);
+    if (certificate_store.isInstalled())
+    {
+        printf("Installed %u trust anchors (%u bytes).\n", certificate_store.getCertificateCount(), (unsigned int)certificate_store.getBundleSize());
+    }
+    return 0;
+}
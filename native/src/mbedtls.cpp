@@ -0,0 +1,113 @@
+#include <mbedtls/aes.h>
+#include <mbedtls/pk.h>
+#include <mbedtls/sha256.h>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <string.h>
+
+void mbedtls_sha256_init(mbedtls_sha256_context *ctx)
+{
+    memset(&ctx->sha, 0, sizeof(ctx->sha));
+    ctx->is224 = 0;
+}
+
+void mbedtls_sha256_free(mbedtls_sha256_context *ctx)
+{
+    OPENSSL_cleanse(&ctx->sha, sizeof(ctx->sha));
+}
+
+int mbedtls_sha256_starts(mbedtls_sha256_context *ctx, int is224)
+{
+    ctx->is224 = is224;
+    return (is224 ? SHA224_Init(&ctx->sha) : SHA256_Init(&ctx->sha)) == 1 ? 0 : -1;
+}
+
+int mbedtls_sha256_update(mbedtls_sha256_context *ctx, const unsigned char *input, size_t ilen)
+{
+    return SHA256_Update(&ctx->sha, input, ilen) == 1 ? 0 : -1;
+}
+
+int mbedtls_sha256_finish(mbedtls_sha256_context *ctx, unsigned char *output)
+{
+    return (ctx->is224 ? SHA224_Final(output, &ctx->sha) : SHA256_Final(output, &ctx->sha)) == 1 ? 0 : -1;
+}
+
+void mbedtls_pk_init(mbedtls_pk_context *ctx)
+{
+    ctx->key = NULL;
+}
+
+void mbedtls_pk_free(mbedtls_pk_context *ctx)
+{
+    EVP_PKEY_free(ctx->key);
+    ctx->key = NULL;
+}
+
+int mbedtls_pk_parse_public_key(mbedtls_pk_context *ctx, const unsigned char *key, size_t keylen)
+{
+    // Like mbedtls, a PEM key is passed including its zero terminator
+    BIO *bio = BIO_new_mem_buf(key, keylen > 0 && key[keylen - 1] == '\0' ? (int)keylen - 1 : (int)keylen);
+    ctx->key = bio != NULL ? PEM_read_bio_PUBKEY(bio, NULL, NULL, NULL) : NULL;
+    BIO_free(bio);
+    return ctx->key != NULL ? 0 : -1;
+}
+
+int mbedtls_pk_verify(mbedtls_pk_context *ctx, mbedtls_md_type_t md_alg, const unsigned char *hash, size_t hash_len,
+                      const unsigned char *sig, size_t sig_len)
+{
+    if (ctx->key == NULL || md_alg != MBEDTLS_MD_SHA256)
+    {
+        return -1;
+    }
+    EVP_PKEY_CTX *verify = EVP_PKEY_CTX_new(ctx->key, NULL);
+    const bool valid = verify != NULL && EVP_PKEY_verify_init(verify) == 1 &&
+                       EVP_PKEY_CTX_set_signature_md(verify, EVP_sha256()) == 1 &&
+                       EVP_PKEY_verify(verify, sig, sig_len, hash, hash_len) == 1;
+    EVP_PKEY_CTX_free(verify);
+    return valid ? 0 : -1;
+}
+
+void mbedtls_aes_init(mbedtls_aes_context *ctx)
+{
+    ctx->cipher = NULL; // Created by the first mbedtls_aes_crypt_ctr(), contexts of the mbedtls AES do not allocate
+    ctx->keybits = 0;
+    ctx->started = 0;
+}
+
+void mbedtls_aes_free(mbedtls_aes_context *ctx)
+{
+    EVP_CIPHER_CTX_free(ctx->cipher);
+    ctx->cipher = NULL;
+}
+
+int mbedtls_aes_setkey_enc(mbedtls_aes_context *ctx, const unsigned char *key, unsigned int keybits)
+{
+    if (keybits != 256)
+    {
+        return -1;
+    }
+    memcpy(ctx->key, key, keybits / 8);
+    ctx->keybits = keybits;
+    ctx->started = 0;
+    return 0;
+}
+
+int mbedtls_aes_crypt_ctr(mbedtls_aes_context *ctx, size_t length, size_t *nc_off, unsigned char nonce_counter[16],
+                          unsigned char stream_block[16], const unsigned char *input, unsigned char *output)
+{
+    // The counter block of the first call starts the stream, later calls continue it
+    if (!ctx->started)
+    {
+        if (ctx->cipher == NULL)
+        {
+            ctx->cipher = EVP_CIPHER_CTX_new();
+        }
+        if (ctx->keybits != 256 || ctx->cipher == NULL || EVP_EncryptInit_ex(ctx->cipher, EVP_aes_256_ctr(), NULL, ctx->key, nonce_counter) != 1)
+        {
+            return -1;
+        }
+        ctx->started = 1;
+    }
+    int written = 0;
+    return EVP_EncryptUpdate(ctx->cipher, output, &written, input, (int)length) == 1 && (size_t)written == length ? 0 : -1;
+}
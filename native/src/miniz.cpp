@@ -0,0 +1,61 @@
+#include <miniz.h>
+#include <string.h>
+
+static voidpf arenaAlloc(voidpf opaque, uInt items, uInt size)
+{
+    tinfl_decompressor *r = (tinfl_decompressor *)opaque;
+    const size_t length = ((size_t)items * size + 7) & ~(size_t)7;
+    if (r->arena_used + length > sizeof(r->arena))
+    {
+        return Z_NULL;
+    }
+    voidpf memory = r->arena + r->arena_used;
+    r->arena_used += length;
+    return memory;
+}
+
+static void arenaFree(voidpf opaque, voidpf address)
+{
+    // The arena is reset for the next stream
+}
+
+tinfl_status tinfl_decompress(tinfl_decompressor *r, const mz_uint8 *pIn_buf_next, size_t *pIn_buf_size,
+                              mz_uint8 *pOut_buf_start, mz_uint8 *pOut_buf_next, size_t *pOut_buf_size,
+                              const mz_uint32 decomp_flags)
+{
+    z_stream *stream = &r->stream;
+    if (r->m_state >= 2)
+    {
+        return r->m_state == 2 ? TINFL_STATUS_DONE : TINFL_STATUS_FAILED;
+    }
+    if (r->m_state == 0)
+    {
+        memset(stream, 0, sizeof(*stream));
+        stream->zalloc = arenaAlloc;
+        stream->zfree = arenaFree;
+        stream->opaque = r;
+        r->arena_used = 0;
+        // Raw deflate unless the zlib header is parsed, like tinfl
+        if (inflateInit2(stream, (decomp_flags & TINFL_FLAG_PARSE_ZLIB_HEADER) ? 15 : -15) != Z_OK)
+        {
+            return TINFL_STATUS_FAILED;
+        }
+        r->m_state = 1;
+    }
+
+    stream->next_in = (Bytef *)pIn_buf_next;
+    stream->avail_in = *pIn_buf_size;
+    stream->next_out = pOut_buf_next;
+    stream->avail_out = *pOut_buf_size;
+    const int result = inflate(stream, Z_NO_FLUSH);
+    *pIn_buf_size -= stream->avail_in;
+    *pOut_buf_size -= stream->avail_out;
+
+    if (result == Z_STREAM_END || (result != Z_OK && result != Z_BUF_ERROR))
+    {
+        inflateEnd(stream);
+        r->m_state = result == Z_STREAM_END ? 2 : 3;
+        return result == Z_STREAM_END ? TINFL_STATUS_DONE : TINFL_STATUS_FAILED;
+    }
+    return stream->avail_in == 0 ? TINFL_STATUS_NEEDS_MORE_INPUT : TINFL_STATUS_HAS_MORE_OUTPUT;
+}
@@ -0,0 +1,196 @@
+#include "BatchReleaseChecker.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "SemanticVersion.h"
+
+/** Names are inserted into a GraphQL string inside of a JSON string, so only names which need no escaping are used. */
+static bool isPlainName(const char *name)
+{
+    if (name == NULL || name[0] == '\0')
+    {
+        return false;
+    }
+    for (const char *c = name; *c != '\0'; c++)
+    {
+        if (*c == '"' || *c == '\\' || (unsigned char)*c < 0x20)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool BatchReleaseChecker::addComponent(BatchComponent *component)
+{
+    if (component_count >= ESP32_OTA_UPDATER_BATCH_MAX_COMPONENTS || !isPlainName(component->owner) ||
+        !isPlainName(component->repo) || !isPlainName(component->asset))
+    {
+        return false;
+    }
+    component->has_release = false;
+    component->found = false;
+    component->newer = false;
+    components[component_count++] = component;
+    return true;
+}
+
+size_t BatchReleaseChecker::buildQuery()
+{
+    size_t length = snprintf(query, sizeof(query), "{\"query\":\"{");
+    for (uint8_t i = 0; i < component_count; i++)
+    {
+        const BatchComponent *component = components[i];
+        const int written = snprintf(query + length, sizeof(query) - length,
+                                     "%sc%u:repository(owner:\\\"%s\\\",name:\\\"%s\\\"){latestRelease{tagName "
+                                     "releaseAssets(first:1,name:\\\"%s\\\"){nodes{size downloadUrl}}}}",
+                                     i == 0 ? "" : " ", i, component->owner, component->repo, component->asset);
+        if (written < 0 || (size_t)written >= sizeof(query) - length)
+        {
+            return 0;
+        }
+        length += written;
+    }
+    const int written = snprintf(query + length, sizeof(query) - length, "}\"}");
+    if (written < 0 || (size_t)written >= sizeof(query) - length)
+    {
+        return 0;
+    }
+    return length + written;
+}
+
+bool BatchReleaseChecker::check(HttpTransport *transport, const char *api_key, const char *endpoint)
+{
+    value_too_long = false;
+    for (uint8_t i = 0; i < component_count; i++)
+    {
+        components[i]->has_release = false;
+        components[i]->found = false;
+        components[i]->newer = false;
+        components[i]->tag[0] = '\0';
+        components[i]->url[0] = '\0';
+        components[i]->size = 0;
+    }
+    const size_t query_length = buildQuery();
+    if (component_count == 0 || api_key == NULL || query_length == 0 || !transport->begin(endpoint))
+    {
+        status_code = -1;
+        return false;
+    }
+    transport->setAuthorization(api_key);
+    transport->addHeader("Content-Type", "application/json");
+    status_code = transport->POST((const uint8_t *)query, query_length);
+    if (status_code != HTTP_STATUS_OK)
+    {
+        transport->end();
+        return false;
+    }
+
+    reset();
+    in_data = false;
+    current = nullptr;
+    int remaining = transport->getSize(); // -1 for a chunked response, which ends when the transport is not connected
+    uint8_t buffer[ESP32_OTA_UPDATER_PARSE_BUFFER_SIZE];
+    while (getStatus() == SCANNING && remaining != 0 && transport->connected())
+    {
+        const size_t wanted = remaining > 0 && (size_t)remaining < sizeof(buffer) ? remaining : sizeof(buffer);
+        const size_t received = transport->read(buffer, wanted);
+        if (received == 0)
+        {
+            break;
+        }
+        feed(buffer, received);
+        remaining -= remaining > 0 ? received : 0;
+    }
+    transport->end();
+    if (getStatus() != FINISHED)
+    {
+        return false;
+    }
+
+    for (uint8_t i = 0; i < component_count; i++)
+    {
+        BatchComponent *component = components[i];
+        if (component->has_release && component->current_version != NULL)
+        {
+            const Version latest(component->tag);
+            const Version running(component->current_version);
+            component->newer = latest.isValid() && running.isValid() && latest > running;
+        }
+    }
+    return true;
+}
+
+void BatchReleaseChecker::onContainerBegin(bool is_array)
+{
+    // {"data":{"c0":{"latestRelease":{"tagName":..,"releaseAssets":{"nodes":[{"size":..,"downloadUrl":..}]}}},..}}
+    if (getDepth() == 2 && !is_array && keyIs("data"))
+    {
+        in_data = true;
+    }
+    else if (getDepth() == 3 && in_data && !is_array && getKey()[0] == 'c')
+    {
+        char *end;
+        const unsigned long index = strtoul(getKey() + 1, &end, 10);
+        current = end != getKey() + 1 && *end == '\0' && index < component_count ? components[index] : nullptr;
+    }
+}
+
+void BatchReleaseChecker::onContainerEnd(bool is_array)
+{
+    if (getDepth() == 3)
+    {
+        current = nullptr;
+    }
+    else if (getDepth() == 2)
+    {
+        in_data = false;
+    }
+}
+
+char *BatchReleaseChecker::onValueBegin(ValueType type, size_t *capacity)
+{
+    if (current == nullptr)
+    {
+        return NULL;
+    }
+    if (getDepth() == 4 && type == STRING && keyIs("tagName"))
+    {
+        *capacity = sizeof(current->tag);
+        return current->tag;
+    }
+    if (getDepth() == 7 && type == STRING && keyIs("downloadUrl"))
+    {
+        *capacity = sizeof(current->url);
+        return current->url;
+    }
+    if (getDepth() == 7 && type == NUMBER && keyIs("size"))
+    {
+        *capacity = sizeof(size_value);
+        return size_value;
+    }
+    return NULL;
+}
+
+void BatchReleaseChecker::onValueEnd(ValueType type, const char *value, size_t length, bool truncated)
+{
+    if (truncated)
+    {
+        value_too_long = true;
+        fail();
+        return;
+    }
+    if (value == current->tag)
+    {
+        current->has_release = true;
+    }
+    else if (value == current->url)
+    {
+        current->found = true;
+    }
+    else
+    {
+        current->size = atol(value);
+    }
+}
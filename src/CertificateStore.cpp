@@ -0,0 +1,359 @@
+#include "CertificateStore.h"
+
+#include <Preferences.h>
+#include <string.h>
+
+#ifdef ARDUINO
+#include <mbedtls/x509_crt.h>
+#endif
+
+static uint16_t bigEndian16(const uint8_t *data)
+{
+    return (uint16_t)(data[0] << 8 | data[1]);
+}
+
+/** Orders subjects like the sorted bundle, byte by byte and a prefix before the longer subject. */
+static int compareSubjects(const uint8_t *a, size_t a_length, const uint8_t *b, size_t b_length)
+{
+    const int order = memcmp(a, b, a_length < b_length ? a_length : b_length);
+    if (order != 0 || a_length == b_length)
+    {
+        return order;
+    }
+    return a_length < b_length ? -1 : 1;
+}
+
+bool CertificateStore::validate(const uint8_t *bundle, size_t size, size_t *length, uint16_t *count, bool *sorted)
+{
+    if (bundle == NULL || size < CERTIFICATE_STORE_HEADER_SIZE)
+    {
+        return false;
+    }
+    *count = bigEndian16(bundle);
+    size_t position = CERTIFICATE_STORE_HEADER_SIZE;
+    const uint8_t *previous = NULL;
+    size_t previous_length = 0;
+    bool in_order = true;
+    for (uint16_t i = 0; i < *count; i++)
+    {
+        if (size - position < CERTIFICATE_STORE_ENTRY_HEADER_SIZE)
+        {
+            return false;
+        }
+        const size_t subject_length = bigEndian16(bundle + position);
+        const size_t key_length = bigEndian16(bundle + position + 2);
+        if (subject_length == 0 || key_length == 0 || size - position - CERTIFICATE_STORE_ENTRY_HEADER_SIZE < subject_length + key_length)
+        {
+            return false;
+        }
+        const uint8_t *subject = bundle + position + CERTIFICATE_STORE_ENTRY_HEADER_SIZE;
+        if (previous != NULL && compareSubjects(previous, previous_length, subject, subject_length) >= 0)
+        {
+            in_order = false;
+        }
+        previous = subject;
+        previous_length = subject_length;
+        position += CERTIFICATE_STORE_ENTRY_HEADER_SIZE + subject_length + key_length;
+    }
+    *length = position;
+    if (sorted != NULL)
+    {
+        *sorted = in_order;
+    }
+    return *count > 0;
+}
+
+bool CertificateStore::findAnchor(const uint8_t *subject, size_t subject_length, const uint8_t **key, size_t *key_length) const
+{
+    if (bundle == NULL)
+    {
+        return false;
+    }
+    // Entries have different sizes, so the binary search collects their offsets on the way instead of indexing them
+    size_t position = CERTIFICATE_STORE_HEADER_SIZE;
+    uint16_t low = 0;
+    uint16_t high = certificate_count;
+    size_t low_position = position;
+    while (low < high)
+    {
+        uint16_t middle = sorted ? low + (high - low) / 2 : low;
+        position = low_position;
+        for (uint16_t i = low; i < middle; i++)
+        {
+            position += CERTIFICATE_STORE_ENTRY_HEADER_SIZE + bigEndian16(bundle + position) + bigEndian16(bundle + position + 2);
+        }
+        const size_t entry_subject_length = bigEndian16(bundle + position);
+        const size_t entry_key_length = bigEndian16(bundle + position + 2);
+        const uint8_t *entry_subject = bundle + position + CERTIFICATE_STORE_ENTRY_HEADER_SIZE;
+        const int order = compareSubjects(subject, subject_length, entry_subject, entry_subject_length);
+        if (order == 0)
+        {
+            *key = entry_subject + entry_subject_length;
+            *key_length = entry_key_length;
+            return true;
+        }
+        if (order < 0 && sorted)
+        {
+            high = middle;
+        }
+        else
+        {
+            low = middle + 1;
+            low_position = position + CERTIFICATE_STORE_ENTRY_HEADER_SIZE + entry_subject_length + entry_key_length;
+        }
+    }
+    return false;
+}
+
+bool CertificateStore::load(const char *pem)
+{
+    if (pem == NULL)
+    {
+        return restore(true, 0);
+    }
+    const uint32_t pem_crc = Crc32::update(0, (const uint8_t *)pem, strlen(pem));
+    if (restore(false, pem_crc))
+    {
+        return true;
+    }
+#ifdef ARDUINO
+    uint8_t *parsed = buffers[active_buffer ^ 1];
+    size_t size = 0;
+    uint16_t count = 0;
+    bool in_order = false;
+    if (!parse(pem, parsed, ESP32_OTA_UPDATER_CERT_BUNDLE_SIZE, &size) || !validate(parsed, size, &size, &count, &in_order))
+    {
+        return false;
+    }
+    activate(parsed, size, count, in_order, false);
+    store(pem_crc);
+    return true;
+#else
+    return false; // Certificates are only parsed by the mbedtls of the ESP32, the host uses bundles
+#endif
+}
+
+bool CertificateStore::load(const uint8_t *bundle, size_t size)
+{
+    if (restore(true, 0))
+    {
+        return true;
+    }
+    size_t length = 0;
+    uint16_t count = 0;
+    bool in_order = false;
+    if (!validate(bundle, size, &length, &count, &in_order) || length != size)
+    {
+        return false;
+    }
+    activate(bundle, size, count, in_order, false);
+    return true;
+}
+
+void CertificateStore::clear()
+{
+    Preferences preferences;
+    if (preferences.begin(ESP32_OTA_UPDATER_CERTS_NAMESPACE, false))
+    {
+        preferences.clear();
+        preferences.end();
+    }
+    bundle = NULL;
+    bundle_size = 0;
+    certificate_count = 0;
+    installed = false;
+    pending = false;
+}
+
+bool CertificateStore::restore(bool require_installed, uint32_t pem_crc)
+{
+    pending = false; // The bundle is read into the buffer of a pending one
+    Preferences preferences;
+    if (!preferences.begin(ESP32_OTA_UPDATER_CERTS_NAMESPACE, true))
+    {
+        return false; // Nothing stored yet
+    }
+    const bool stored_installed = preferences.getUInt("installed", 0) != 0;
+    const bool usable = stored_installed || (!require_installed && preferences.getUInt("pem", 0) == pem_crc);
+    uint8_t *stored = buffers[active_buffer ^ 1];
+    const size_t stored_size = usable ? preferences.getBytes("bundle", stored, ESP32_OTA_UPDATER_CERT_BUNDLE_SIZE) : 0;
+    preferences.end();
+
+    size_t length = 0;
+    uint16_t count = 0;
+    bool in_order = false;
+    if (stored_size == 0 || !validate(stored, stored_size, &length, &count, &in_order) || length != stored_size)
+    {
+        return false;
+    }
+    activate(stored, length, count, in_order, stored_installed);
+    return true;
+}
+
+void CertificateStore::store(uint32_t pem_crc)
+{
+    Preferences preferences;
+    if (!preferences.begin(ESP32_OTA_UPDATER_CERTS_NAMESPACE, false))
+    {
+        return; // The anchors are used until the next boot, which parses them again
+    }
+    preferences.putBytes("bundle", bundle, bundle_size);
+    preferences.putUInt("installed", installed ? 1 : 0);
+    preferences.putUInt("pem", pem_crc);
+    preferences.end();
+}
+
+void CertificateStore::activate(const uint8_t *bundle, size_t size, uint16_t count, bool sorted, bool installed)
+{
+    if (bundle == buffers[active_buffer ^ 1])
+    {
+        active_buffer ^= 1;
+    }
+    this->bundle = bundle;
+    bundle_size = size;
+    certificate_count = count;
+    this->sorted = sorted;
+    this->installed = installed;
+}
+
+bool CertificateStore::begin(uint32_t offset, uint32_t crc, const uint8_t *head)
+{
+    abort();
+    // The received bundle is not kept, so there is nothing to continue
+    if (offset != 0 || crc != 0 || head != NULL)
+    {
+        return false;
+    }
+    receiving = true;
+    received = 0;
+    received_crc = 0;
+    return true;
+}
+
+bool CertificateStore::write(const uint8_t *data, size_t length)
+{
+    if (!receiving || length > CERTIFICATE_STORE_BUFFER_SIZE - received)
+    {
+        abort();
+        return false;
+    }
+    memcpy(buffers[active_buffer ^ 1] + received, data, length);
+    received += length;
+    received_crc = Crc32::update(received_crc, data, length);
+    return true;
+}
+
+bool CertificateStore::finish()
+{
+    if (!receiving)
+    {
+        return false;
+    }
+    receiving = false;
+    uint8_t *received_bundle = buffers[active_buffer ^ 1];
+    size_t length = 0;
+    uint16_t count = 0;
+    bool in_order = false;
+    if (signing_key == NULL || !validate(received_bundle, received, &length, &count, &in_order) ||
+        length > ESP32_OTA_UPDATER_CERT_BUNDLE_SIZE)
+    {
+        return false;
+    }
+    // The anchors decide which servers are trusted, so unlike other components they are only accepted when signed
+    verifier.begin(NULL);
+    verifier.hash(received_bundle, length);
+    if (!verifier.setExpected(received_bundle + length, received - length) || !verifier.verify(signing_key))
+    {
+        return false;
+    }
+    // The anchors are used once the app is activated as well, see commitInstall()
+    pending = true;
+    pending_size = length;
+    pending_count = count;
+    pending_sorted = in_order;
+    return true;
+}
+
+void CertificateStore::abort()
+{
+    receiving = false;
+    pending = false;
+}
+
+void CertificateStore::commitInstall()
+{
+    if (!pending)
+    {
+        return;
+    }
+    pending = false;
+    activate(buffers[active_buffer ^ 1], pending_size, pending_count, pending_sorted, true);
+    store(0);
+}
+
+bool CertificateStore::read(uint32_t offset, uint8_t *data, size_t length)
+{
+    if (offset > received || length > received - offset)
+    {
+        return false;
+    }
+    memcpy(data, buffers[active_buffer ^ 1] + offset, length);
+    return true;
+}
+
+#ifdef ARDUINO
+bool CertificateStore::parse(const char *pem, uint8_t *bundle, size_t capacity, size_t *size)
+{
+    mbedtls_x509_crt chain;
+    mbedtls_x509_crt_init(&chain);
+    // A positive result is the number of certificates which could not be parsed, the others are still used
+    bool valid = mbedtls_x509_crt_parse(&chain, (const unsigned char *)pem, strlen(pem) + 1) >= 0;
+    uint16_t count = 0;
+    size_t end = CERTIFICATE_STORE_HEADER_SIZE;
+    uint8_t key_buffer[ESP32_OTA_UPDATER_MAX_SIGNATURE_SIZE + 64]; // SubjectPublicKeyInfo of up to RSA-4096
+    for (mbedtls_x509_crt *certificate = &chain; valid && certificate != NULL && certificate->raw.p != NULL; certificate = certificate->next)
+    {
+        // The key is written to the end of the buffer
+        const int key_length = mbedtls_pk_write_pubkey_der(&certificate->pk, key_buffer, sizeof(key_buffer));
+        const size_t subject_length = certificate->subject_raw.len;
+        const size_t entry_length = CERTIFICATE_STORE_ENTRY_HEADER_SIZE + subject_length + key_length;
+        if (key_length <= 0 || subject_length > 0xFFFF || entry_length > capacity - end)
+        {
+            valid = false;
+            break;
+        }
+        // Insertion keeps the entries sorted by subject, a certificate with the subject of an earlier one is skipped
+        size_t position = CERTIFICATE_STORE_HEADER_SIZE;
+        int order = 1;
+        while (position < end)
+        {
+            const size_t entry_subject_length = bigEndian16(bundle + position);
+            order = compareSubjects(certificate->subject_raw.p, subject_length, bundle + position + CERTIFICATE_STORE_ENTRY_HEADER_SIZE,
+                                    entry_subject_length);
+            if (order <= 0)
+            {
+                break;
+            }
+            position += CERTIFICATE_STORE_ENTRY_HEADER_SIZE + entry_subject_length + bigEndian16(bundle + position + 2);
+        }
+        if (order == 0)
+        {
+            continue;
+        }
+        memmove(bundle + position + entry_length, bundle + position, end - position);
+        bundle[position] = (uint8_t)(subject_length >> 8);
+        bundle[position + 1] = (uint8_t)subject_length;
+        bundle[position + 2] = (uint8_t)(key_length >> 8);
+        bundle[position + 3] = (uint8_t)key_length;
+        memcpy(bundle + position + CERTIFICATE_STORE_ENTRY_HEADER_SIZE, certificate->subject_raw.p, subject_length);
+        memcpy(bundle + position + CERTIFICATE_STORE_ENTRY_HEADER_SIZE + subject_length, key_buffer + sizeof(key_buffer) - key_length, key_length);
+        end += entry_length;
+        count++;
+    }
+    mbedtls_x509_crt_free(&chain);
+    bundle[0] = (uint8_t)(count >> 8);
+    bundle[1] = (uint8_t)count;
+    *size = end;
+    return valid && count > 0;
+}
+#endif
@@ -0,0 +1,172 @@
+#include "CheckScheduler.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void CheckScheduler::begin(CheckSchedule *schedule, int64_t now_ms, const char *device_id)
+{
+    this->schedule = schedule;
+    random_state = hash(2166136261UL, device_id);
+    random_state = random_state != 0 ? random_state : 1;
+    limit_delay_ms = 0;
+    if (!schedule->valid)
+    {
+        memset(schedule, 0, sizeof(*schedule));
+        scheduleIn(now_ms, random(jitter)); // Devices which boot together do not check together
+    }
+}
+
+void CheckScheduler::setBackoff(Failure failure, uint32_t base_ms, uint32_t max_ms)
+{
+    backoff_base[failure] = base_ms;
+    backoff_max[failure] = max_ms;
+}
+
+bool CheckScheduler::isDue(int64_t now_ms) const
+{
+    return getTimeUntilDue(now_ms) == 0;
+}
+
+uint32_t CheckScheduler::getTimeUntilDue(int64_t now_ms) const
+{
+    // A clock which was set back (e.g. by SNTP) makes the check due rather than postponing it indefinitely
+    if (!schedule->valid || now_ms < schedule->scheduled_at_ms || now_ms - schedule->scheduled_at_ms >= schedule->delay_ms)
+    {
+        return 0;
+    }
+    return schedule->delay_ms - (uint32_t)(now_ms - schedule->scheduled_at_ms);
+}
+
+bool CheckScheduler::onRateLimit(const char *remaining, const char *reset, const char *retry_after, const char *date)
+{
+    uint32_t delay_s = 0;
+    if (isdigit((unsigned char)retry_after[0]))
+    {
+        delay_s = strtoul(retry_after, NULL, 10); // The HTTP date form is not used by GitHub
+    }
+    if (remaining[0] != '\0' && strtol(remaining, NULL, 10) <= ESP32_OTA_UPDATER_RATELIMIT_RESERVE)
+    {
+        // The reset is a server timestamp, the local clock may not be set at all
+        const int64_t reset_s = strtoll(reset, NULL, 10);
+        const int64_t server_s = parseHttpDate(date);
+        uint32_t reset_delay_s = ESP32_OTA_UPDATER_RATELIMIT_FALLBACK;
+        if (reset_s > 0 && server_s > 0)
+        {
+            reset_delay_s = reset_s > server_s ? (uint32_t)(reset_s - server_s) : 0;
+        }
+        delay_s = reset_delay_s > delay_s ? reset_delay_s : delay_s;
+    }
+    limit_delay_ms = delay_s * 1000;
+    return limit_delay_ms > 0;
+}
+
+void CheckScheduler::onSuccess(int64_t now_ms)
+{
+    schedule->network_failures = 0;
+    schedule->server_failures = 0;
+    const uint32_t limit_delay = limit_delay_ms;
+    scheduleIn(now_ms, interval + random(jitter));
+    if (limit_delay > 0 && limit_delay + jitter > schedule->delay_ms)
+    {
+        // Spread the devices over the jitter after the reset instead of letting them all return at once
+        scheduleIn(now_ms, limit_delay + random(jitter));
+        schedule->rate_limited = true;
+    }
+}
+
+void CheckScheduler::onFailure(int64_t now_ms, Failure failure)
+{
+    uint8_t &failures = failure == FAILURE_NETWORK ? schedule->network_failures : schedule->server_failures;
+    if (failures < 31)
+    {
+        failures++;
+    }
+    // Exponential backoff with equal jitter: half of the delay is fixed, the other half random
+    uint64_t backoff = (uint64_t)backoff_base[failure] << (failures - 1);
+    backoff = backoff < backoff_max[failure] ? backoff : backoff_max[failure];
+    const uint32_t delay = (uint32_t)backoff / 2 + random((uint32_t)backoff / 2 + 1);
+
+    const uint32_t limit_delay = limit_delay_ms;
+    scheduleIn(now_ms, delay);
+    if (limit_delay > delay)
+    {
+        scheduleIn(now_ms, limit_delay + random(jitter));
+        schedule->rate_limited = true;
+    }
+}
+
+void CheckScheduler::expedite(int64_t now_ms)
+{
+    if (schedule->network_failures == 0 && schedule->server_failures == 0 && !schedule->rate_limited)
+    {
+        scheduleIn(now_ms, 0);
+    }
+}
+
+void CheckScheduler::scheduleIn(int64_t now_ms, uint32_t delay_ms)
+{
+    schedule->scheduled_at_ms = now_ms;
+    schedule->delay_ms = delay_ms;
+    schedule->rate_limited = false;
+    schedule->valid = true;
+    limit_delay_ms = 0;
+}
+
+uint32_t CheckScheduler::random(uint32_t bound)
+{
+    if (bound == 0)
+    {
+        return 0;
+    }
+    // xorshift32, the jitter only has to differ between devices
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    return random_state % bound;
+}
+
+bool CheckScheduler::inRollout(const char *device_id, const char *release, uint8_t percent)
+{
+    if (percent >= 100)
+    {
+        return true;
+    }
+    return hash(hash(hash(2166136261UL, device_id), "/"), release) % 100 < percent;
+}
+
+uint32_t CheckScheduler::hash(uint32_t value, const char *text)
+{
+    // FNV-1a
+    for (; *text != '\0'; text++)
+    {
+        value = (value ^ (uint8_t)*text) * 16777619UL;
+    }
+    return value;
+}
+
+int64_t CheckScheduler::parseHttpDate(const char *date)
+{
+    static const char *MONTHS = "JanFebMarAprMayJunJulAugSepOctNovDec";
+    char month_name[4];
+    int day, year, hour, minute, second;
+    if (sscanf(date, "%*3s, %d %3s %d %d:%d:%d", &day, month_name, &year, &hour, &minute, &second) != 6)
+    {
+        return 0;
+    }
+    const char *month_position = strstr(MONTHS, month_name);
+    if (strlen(month_name) != 3 || month_position == NULL || (month_position - MONTHS) % 3 != 0)
+    {
+        return 0;
+    }
+    int month = (int)(month_position - MONTHS) / 3 + 1;
+
+    // Days since 1970-01-01 of the proleptic Gregorian calendar (H. Hinnant's days_from_civil)
+    year -= month <= 2;
+    const int64_t era = (year >= 0 ? year : year - 399) / 400;
+    const int64_t year_of_era = year - era * 400;
+    const int64_t day_of_year = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    const int64_t day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+    const int64_t days = era * 146097 + day_of_era - 719468;
+    return days * 86400 + hour * 3600 + minute * 60 + second;
+}
@@ -0,0 +1,270 @@
+#include "DeltaPatcher.h"
+#include <stdint.h>
+#include <string.h>
+
+void DeltaPatcher::begin(ByteSource *source, uint32_t source_capacity, ByteSink *output)
+{
+    this->source = source;
+    this->source_capacity = source_capacity;
+    this->output = output;
+
+    state = HEADER;
+    error = NONE;
+    header_length = 0;
+    arguments_length = 0;
+    arguments_needed = 0;
+    source_size = 0;
+    source_crc = 0;
+    source_crc_read = 0;
+    target_size = 0;
+    produced = 0;
+    operation_offset = 0;
+    operation_remaining = 0;
+    stash_length = 0;
+}
+
+bool DeltaPatcher::write(const uint8_t *data, size_t length)
+{
+    while (length > 0 && state != STOPPED)
+    {
+        if (!isBusy())
+        {
+            const size_t consumed = apply(data, length);
+            data += consumed;
+            length -= consumed;
+        }
+        else if (length <= sizeof(stash) - stash_length)
+        {
+            memcpy(stash + stash_length, data, length);
+            stash_length += length;
+            length = 0;
+        }
+        else
+        {
+            step(UINT32_MAX); // More than the stash holds arrived within one step
+        }
+    }
+    return state != STOPPED;
+}
+
+bool DeltaPatcher::step(uint32_t budget)
+{
+    while (budget > 0 && (state == SOURCE_CRC || state == COPY_DATA) && operation_remaining > 0)
+    {
+        uint32_t chunk = operation_remaining < budget ? operation_remaining : budget;
+        chunk = chunk < sizeof(buffer) ? chunk : sizeof(buffer);
+        if (!source->read(operation_offset, buffer, chunk))
+        {
+            return stop(SOURCE_READ_FAILED);
+        }
+        if (state == SOURCE_CRC)
+        {
+            source_crc_read = Crc32::update(source_crc_read, buffer, chunk);
+        }
+        else if (!emit(buffer, chunk))
+        {
+            return false;
+        }
+        operation_offset += chunk;
+        operation_remaining -= chunk;
+        budget -= chunk;
+    }
+    if ((state == SOURCE_CRC || state == COPY_DATA) && operation_remaining == 0)
+    {
+        // Make sure the patch was created from the image we are running
+        if (state == SOURCE_CRC && source_crc_read != source_crc)
+        {
+            return stop(SOURCE_MISMATCH);
+        }
+        state = OPCODE;
+    }
+    if (!isBusy() || state == SOURCE_CRC || state == COPY_DATA)
+    {
+        return state != STOPPED;
+    }
+    // Each stashed byte reads and writes at most one byte, so it counts against the budget like the source reads
+    const size_t consumed = apply(stash, stash_length < budget ? stash_length : budget);
+    memmove(stash, stash + consumed, stash_length - consumed);
+    stash_length -= consumed;
+    return state != STOPPED;
+}
+
+size_t DeltaPatcher::apply(const uint8_t *data, size_t length)
+{
+    // Stops before the bytes which follow an operation that reads the source, they wait for step()
+    size_t applied = 0;
+    while (applied < length && state != SOURCE_CRC && state != COPY_DATA)
+    {
+        size_t consumed = 0;
+        switch (state)
+        {
+        case HEADER:
+            consumed = DELTA_PATCHER_HEADER_SIZE - header_length;
+            consumed = consumed < length - applied ? consumed : length - applied;
+            memcpy(header + header_length, data, consumed);
+            header_length += consumed;
+            if (header_length == DELTA_PATCHER_HEADER_SIZE)
+            {
+                parseHeader();
+            }
+            break;
+
+        case OPCODE:
+            opcode = data[0];
+            consumed = 1;
+            if (opcode != OP_COPY && opcode != OP_INSERT && opcode != OP_ADD)
+            {
+                stop(INVALID_PATCH);
+                break;
+            }
+            arguments_length = 0;
+            arguments_needed = opcode == OP_INSERT ? 4 : 8;
+            state = ARGUMENTS;
+            break;
+
+        case ARGUMENTS:
+            consumed = arguments_needed - arguments_length;
+            consumed = consumed < length - applied ? consumed : length - applied;
+            memcpy(arguments + arguments_length, data, consumed);
+            arguments_length += consumed;
+            if (arguments_length == arguments_needed)
+            {
+                executeOperation();
+            }
+            break;
+
+        case INSERT_DATA:
+            consumed = operation_remaining < length - applied ? operation_remaining : length - applied;
+            if (!emit(data, consumed))
+            {
+                break;
+            }
+            operation_remaining -= consumed;
+            if (operation_remaining == 0)
+            {
+                state = OPCODE;
+            }
+            break;
+
+        case ADD_DATA:
+            consumed = operation_remaining < length - applied ? operation_remaining : length - applied;
+            consumed = consumed < sizeof(buffer) ? consumed : sizeof(buffer);
+            if (!source->read(operation_offset, buffer, consumed))
+            {
+                stop(SOURCE_READ_FAILED);
+                break;
+            }
+            for (size_t i = 0; i < consumed; i++)
+            {
+                buffer[i] += data[i];
+            }
+            if (!emit(buffer, consumed))
+            {
+                break;
+            }
+            operation_offset += consumed;
+            operation_remaining -= consumed;
+            if (operation_remaining == 0)
+            {
+                state = OPCODE;
+            }
+            break;
+
+        default:
+            return applied;
+        }
+        data += consumed;
+        applied += consumed;
+    }
+    return applied;
+}
+
+bool DeltaPatcher::finish()
+{
+    while (isBusy() && state != STOPPED)
+    {
+        step(UINT32_MAX);
+    }
+    if (state == STOPPED)
+    {
+        return false;
+    }
+    if (state != OPCODE || produced != target_size)
+    {
+        return stop(INVALID_PATCH);
+    }
+    return true;
+}
+
+bool DeltaPatcher::parseHeader()
+{
+    if (memcmp(header, DELTA_PATCHER_MAGIC, 4) != 0 || header[4] != DELTA_PATCHER_VERSION)
+    {
+        return stop(INVALID_PATCH);
+    }
+    source_size = readLE32(header + 8);
+    source_crc = readLE32(header + 12);
+    target_size = readLE32(header + 16);
+    if (source_size > source_capacity)
+    {
+        return stop(SOURCE_MISMATCH);
+    }
+    // The CRC32 of the source is computed by step(), the operations wait for it
+    source_crc_read = 0;
+    operation_offset = 0;
+    operation_remaining = source_size;
+    state = SOURCE_CRC;
+    return true;
+}
+
+bool DeltaPatcher::executeOperation()
+{
+    if (opcode == OP_INSERT)
+    {
+        operation_remaining = readLE32(arguments);
+        state = operation_remaining > 0 ? INSERT_DATA : OPCODE;
+        return true;
+    }
+
+    operation_offset = readLE32(arguments);
+    operation_remaining = readLE32(arguments + 4);
+    if (operation_offset > source_size || operation_remaining > source_size - operation_offset)
+    {
+        return stop(INVALID_PATCH);
+    }
+    if (operation_remaining == 0)
+    {
+        state = OPCODE;
+    }
+    else
+    {
+        state = opcode == OP_ADD ? ADD_DATA : COPY_DATA;
+    }
+    return true;
+}
+
+bool DeltaPatcher::emit(const uint8_t *data, size_t length)
+{
+    if (length > target_size - produced)
+    {
+        return stop(INVALID_PATCH);
+    }
+    if (!output->write(data, length))
+    {
+        return stop(OUTPUT_FAILED);
+    }
+    produced += length;
+    return true;
+}
+
+bool DeltaPatcher::stop(Error reason)
+{
+    error = reason;
+    state = STOPPED;
+    return false;
+}
+
+uint32_t DeltaPatcher::readLE32(const uint8_t *data)
+{
+    return (uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+}
@@ -1,18 +1,181 @@
 #include "ESP32_OTA_Updater.h"
-#include <ArduinoJson.h>
-#include <Update.h>
+#include "ReleaseParser.h"
+#include <Preferences.h>
+#include <sys/time.h>
 
-ESP32_OTA_Updater::ESP32_OTA_Updater(const char *rootCertificate, const char *current_version) : current_version(current_version)
+/*
+ * Log statements above ESP32_OTA_UPDATER_LOG_LEVEL are dead code, so neither the formatting nor the evaluation of
+ * their arguments is compiled in, while the arguments are still type checked.
+ */
+#define OTA_LOG_AT(level, ...)                          \
+    do                                                  \
+    {                                                   \
+        if (ESP32_OTA_UPDATER_LOG_LEVEL >= (level))     \
+        {                                               \
+            debugf(__VA_ARGS__);                        \
+        }                                               \
+    } while (0)
+#define OTA_LOGE(...) OTA_LOG_AT(ESP32_OTA_UPDATER_LOG_ERROR, __VA_ARGS__)
+#define OTA_LOGI(...) OTA_LOG_AT(ESP32_OTA_UPDATER_LOG_INFO, __VA_ARGS__)
+#define OTA_LOGD(...) OTA_LOG_AT(ESP32_OTA_UPDATER_LOG_DEBUG, __VA_ARGS__)
+
+/*
+ * URLs of the release check. Their longest expansion, with owner, repository and manifest name of
+ * ESP32_OTA_UPDATER_SHORTSTRING_LENGTH - 1 characters each, is checked against the buffers at compile time.
+ */
+#define RELEASE_MANIFEST_URL_FORMAT "https://github.com/%s/%s/releases/latest/download/%s"
+#define RELEASE_LATEST_URL_FORMAT "https://api.github.com/repos/%s/%s/releases/latest"
+#define RELEASE_LIST_URL_FORMAT "https://api.github.com/repos/%s/%s/releases?per_page=%u&page=%u"
+#define RELEASE_DOWNLOAD_BASE_FORMAT "https://github.com/%s/%s/releases/download"
+
+#define NVS_NAMESPACE_SIZE 16 /**< NVS namespaces have at most 15 characters. */
+static_assert(sizeof(ESP32_OTA_UPDATER_PREFERENCES_NAMESPACE) + 8 <= NVS_NAMESPACE_SIZE &&
+                  sizeof(ESP32_OTA_UPDATER_RESUME_NAMESPACE) + 8 <= NVS_NAMESPACE_SIZE &&
+                  sizeof(ESP32_OTA_UPDATER_COMPONENTS_NAMESPACE) + 8 <= NVS_NAMESPACE_SIZE &&
+                  sizeof(ESP32_OTA_UPDATER_PEER_NAMESPACE) + 8 <= NVS_NAMESPACE_SIZE,
+              "A namespace prefix and the CRC32 of the updater do not fit into an NVS namespace");
+
+static constexpr size_t expandedLength(const char *format)
+{
+    return format[0] == '\0'                       ? 1
+           : format[0] == '%' && format[1] == 's' ? ESP32_OTA_UPDATER_SHORTSTRING_LENGTH - 1 + expandedLength(format + 2)
+           : format[0] == '%' && format[1] == 'u' ? 10 + expandedLength(format + 2)
+                                                  : 1 + expandedLength(format + 1);
+}
+
+static constexpr size_t maxLength(size_t a, size_t b)
+{
+    return a > b ? a : b;
+}
+
+/** Copies a string between buffers whose capacities are checked at compile time, so it is never truncated. */
+template <size_t DestinationCapacity, size_t SourceCapacity>
+static void copyString(char (&destination)[DestinationCapacity], const char (&source)[SourceCapacity])
+{
+    static_assert(SourceCapacity <= DestinationCapacity, "The destination can not hold every string of the source");
+    strcpy(destination, source);
+}
+
+/** Copies a string of unknown length (a configuration value or a received tag), returns false instead of truncating it. */
+template <size_t N>
+static bool copyValue(char (&destination)[N], const char *value)
+{
+    const size_t length = strlen(value);
+    if (length >= N)
+    {
+        return false;
+    }
+    memcpy(destination, value, length + 1);
+    return true;
+}
+
+static constexpr size_t RELEASE_URL_LENGTH = maxLength(expandedLength(RELEASE_MANIFEST_URL_FORMAT),
+                                                       maxLength(expandedLength(RELEASE_LATEST_URL_FORMAT), expandedLength(RELEASE_LIST_URL_FORMAT)));
+static_assert(expandedLength(RELEASE_DOWNLOAD_BASE_FORMAT) <= ESP32_OTA_UPDATER_LONGSTRING_LENGTH,
+              "ESP32_OTA_UPDATER_LONGSTRING_LENGTH can not hold the release download URL");
+
+/*
+ * Descriptions of ESP32_OTA_Updater_Error, indexed by the error code. Constant data stays in flash on the ESP32.
+ */
+static constexpr const char *error_messages[] = {
+    "No error",
+    "Wifi not connected",
+    "Not initialized",
+    "OTA Update not available, please configure the git repo!",
+    "OTA download failed",
+    "OTA install failed",
+    "OTA failed to deserialize",
+    "OTA response invalid",
+    "OTA image digest or signature invalid",
+    "OTA image is built for another device",
+    "OTA image is truncated",
+};
+static_assert(sizeof(error_messages) / sizeof(error_messages[0]) == OTA_IMAGE_TRUNCATED + 1, "Every error needs a description");
+
+/*
+ * Schedule of the next release check. The system time keeps running in deep sleep and RTC memory is retained,
+ * so the schedule also holds for devices that wake up from deep sleep and immediately call available().
+ * Every repository and asset has its own schedule, so several updaters in one firmware do not share theirs.
+ */
+struct RtcCheckSchedule
+{
+    uint32_t source; /**< CRC32 of "<owner>/<repo>/<asset>". */
+    CheckSchedule schedule;
+};
+RTC_DATA_ATTR static RtcCheckSchedule rtc_check_schedules[ESP32_OTA_UPDATER_MAX_INSTANCES];
+
+static uint32_t sourceCrc(const char *owner, const char *repo, const char *asset)
+{
+    uint32_t source = Crc32::update(0, (const uint8_t *)owner, strlen(owner));
+    source = Crc32::update(source, (const uint8_t *)"/", 1);
+    source = Crc32::update(source, (const uint8_t *)repo, strlen(repo));
+    source = Crc32::update(source, (const uint8_t *)"/", 1);
+    return Crc32::update(source, (const uint8_t *)asset, strlen(asset));
+}
+
+static CheckSchedule *rtcCheckSchedule(uint32_t source)
+{
+    RtcCheckSchedule *free_slot = NULL;
+    for (RtcCheckSchedule &slot : rtc_check_schedules)
+    {
+        if (slot.schedule.valid && slot.source == source)
+        {
+            return &slot.schedule;
+        }
+        if (!slot.schedule.valid && free_slot == NULL)
+        {
+            free_slot = &slot;
+        }
+    }
+    if (free_slot == NULL)
+    {
+        free_slot = &rtc_check_schedules[source % ESP32_OTA_UPDATER_MAX_INSTANCES]; // More repositories than slots, one starts over
+        free_slot->schedule.valid = false;
+    }
+    free_slot->source = source;
+    return &free_slot->schedule;
+}
+
+static int64_t rtcTimeMillis()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (int64_t)tv.tv_sec * 1000LL + tv.tv_usec / 1000;
+}
+
+#ifdef ARDUINO
+ESP32_OTA_Updater::ESP32_OTA_Updater(const char *rootCertificate, const char *current_version)
+    : ESP32_OTA_Updater(&esp32_transport, &esp32_partition_writer, &esp32_running_partition, current_version)
+{
+    esp32_transport.setCACert(rootCertificate);
+}
+#endif
+
+ESP32_OTA_Updater::ESP32_OTA_Updater(HttpTransport *transport, FirmwareSink *firmware_sink, ByteSource *running_image, const char *current_version)
+    : current_version(current_version), http_transport(transport), firmware_sink(firmware_sink), running_image(running_image)
 {
     error = ESP32_OTA_Updater_Error::NOT_INITIALIZED;
-    rootCert = rootCertificate;
+    metrics.clear();
+    check_scheduler.setInterval(ESP32_OTA_UPDATER_DEFAULT_CHECK_INTERVAL);
+#ifdef ARDUINO
+    snprintf(device_id, sizeof(device_id), "%012llx", (unsigned long long)ESP.getEfuseMac());
+#else
+    device_id[0] = '\0';
+#endif
 }
 
 bool ESP32_OTA_Updater::begin(const char *owner, const char *repo, const char *firmware_path, const char *api_key)
 {
-    _begin(owner, repo, firmware_path);
+    if (!_begin(owner, repo, firmware_path))
+    {
+        return false;
+    }
 
-    strncpy(gh_api_key, api_key, ESP32_OTA_UPDATER_LONGSTRING_LENGTH);
+    if (!copyValue(gh_api_key, api_key))
+    {
+        OTA_LOGE("API key is longer than %u characters!\n", ESP32_OTA_UPDATER_LONGSTRING_LENGTH - 1);
+        return false;
+    }
     api_key_defined = true;
 
     error = ESP32_OTA_Updater_Error::NO_ERROR;
@@ -21,7 +184,10 @@ bool ESP32_OTA_Updater::begin(const char *owner, const char *repo, const char *f
 
 bool ESP32_OTA_Updater::begin(const char *owner, const char *repo, const char *firmware_path)
 {
-    _begin(owner, repo, firmware_path);
+    if (!_begin(owner, repo, firmware_path))
+    {
+        return false;
+    }
 
     api_key_defined = false;
 
@@ -29,277 +195,1992 @@ bool ESP32_OTA_Updater::begin(const char *owner, const char *repo, const char *f
     return true;
 }
 
-inline void ESP32_OTA_Updater::_begin(const char *owner, const char *repo, const char *firmware_path)
+inline bool ESP32_OTA_Updater::_begin(const char *owner, const char *repo, const char *firmware_path)
 {
-    strncpy(repositry_owner, owner, ESP32_OTA_UPDATER_SHORTSTRING_LENGTH);
-    strncpy(repositry_name, repo, ESP32_OTA_UPDATER_SHORTSTRING_LENGTH);
-    strncpy(firmware_asset_path, firmware_path, ESP32_OTA_UPDATER_SHORTSTRING_LENGTH);
+    if (!current_version.isValid())
+    {
+        OTA_LOGE("Current version is not a semantic version (%s)!\n", Version::describe(current_version.getError()));
+        return false;
+    }
+    if (!copyValue(repositry_owner, owner) || !copyValue(repositry_name, repo) || !copyValue(firmware_asset_path, firmware_path))
+    {
+        OTA_LOGE("Owner, repository or asset name is longer than %u characters!\n", ESP32_OTA_UPDATER_SHORTSTRING_LENGTH - 1);
+        return false;
+    }
+
+    // Patches from the running version are named after the firmware asset, e.g. "firmware-1.2.3-*.patch" or ".patch.gz",
+    // devices using encrypted assets only take encrypted patches
+    const char *extension = strchr(firmware_asset_path, '.');
+    const int stem_length = extension != NULL ? extension - firmware_asset_path : strlen(firmware_asset_path);
+    const size_t path_length = strlen(firmware_asset_path);
+    const bool encrypted = path_length >= 4 && strcmp(firmware_asset_path + path_length - 4, ".enc") == 0;
+    char running_version[ESP32_OTA_UPDATER_SHORTSTRING_LENGTH];
+    if (snprintf(patch_asset_pattern, sizeof(patch_asset_pattern), "%.*s-%s-*.patch*%s", stem_length, firmware_asset_path,
+                 current_version.toString(running_version, sizeof(running_version)), encrypted ? ".enc" : "") >= (int)sizeof(patch_asset_pattern) ||
+        snprintf(signature_asset_name, sizeof(signature_asset_name), "%.*s.sig", stem_length, firmware_asset_path) >= (int)sizeof(signature_asset_name))
+    {
+        OTA_LOGE("Asset name %s is too long for the patch and signature names!\n", firmware_asset_path);
+        return false;
+    }
 
-    wifi_client_secure.setCACert(rootCert);
+    latest_tag[0] = '\0';
+    release_etag[0] = '\0';
+    binary_download_url[0] = '\0';
+    patch_download_url[0] = '\0';
+    signature_download_url[0] = '\0';
+    source_crc = sourceCrc(repositry_owner, repositry_name, firmware_asset_path);
+    loadCheckCache();
+    if (!resumable_downloads)
+    {
+        clearResumeState(); // A checkpoint left by a firmware which resumed downloads is never used
+    }
 
-    Update.onProgress(std::bind(&ESP32_OTA_Updater::updateProgressCallback, this, std::placeholders::_1, std::placeholders::_2));
+    CheckSchedule *schedule = rtcCheckSchedule(source_crc);
+    const bool woke_up = schedule->valid;
+    check_scheduler.begin(schedule, rtcTimeMillis(), device_id);
+    if (woke_up && !check_cache_valid)
+    {
+        check_scheduler.expedite(rtcTimeMillis()); // The result of the last check was only kept in RAM
+    }
+    offerInstalledImage();
+    return true;
 }
 
 void ESP32_OTA_Updater::updateProgressCallback(size_t progress, size_t size)
 {
     // Update Progress
-    debugf("Installing %d of %d bytes.\n", progress, size);
+    OTA_LOGD("Installing %d of %d bytes.\n", progress, size);
+    if (progress_callback)
+    {
+        progress_callback(progress, size);
+    }
 }
 
-int ESP32_OTA_Updater::httpclientSendRequest(HTTPClient &http_client)
+int ESP32_OTA_Updater::sendRequest(UpdatePhase phase)
 {
-    debugf("Setting up HTTP Request Headers\n");
-    http_client.useHTTP10(true); // use HTTP/1.0 for update since the update handler not support any transfer Encoding
-    http_client.setTimeout(15000);
-    http_client.setFollowRedirects(HTTPC_STRICT_FOLLOW_REDIRECTS);
-    http_client.setUserAgent(http_useragent);
+    OTA_LOGD("Setting up HTTP Request Headers\n");
 
-    // Add Authorization Header for Github API if defined.
-    if (api_key_defined)
+    // Add Authorization Header for Github API if defined, peers never get the token.
+    if (api_key_defined && !peer_download)
     {
-        debugf("Setting Bearer Authentication\n");
-        http_client.setAuthorizationType("Bearer");
-        http_client.setAuthorization(gh_api_key);
+        OTA_LOGD("Setting Bearer Authentication\n");
+        http_transport->setAuthorization(gh_api_key);
     }
 
-    http_client.addHeader("X-GitHub-Api-Version", "2022-11-28"); // Set Github Api Version
+    http_transport->addHeader("X-GitHub-Api-Version", "2022-11-28"); // Set Github Api Version
+
+    OTA_LOGD("Sending HTTPS GET.\n");
+    int code = http_transport->GET();
+    int len = http_transport->getSize();
 
-    debugf("Sending HTTPS GET.\n");
-    int code = http_client.GET();
-    int len = http_client.getSize();
+    HttpRequestTiming timing;
+    http_transport->getTiming(&timing);
+    if (metrics.request_count < ESP32_OTA_UPDATER_METRICS_MAX_REQUESTS)
+    {
+        UpdateRequestMetrics &request = metrics.requests[metrics.request_count];
+        request.phase = phase;
+        request.status = code;
+        request.timing = timing;
+    }
+    metrics.request_count++;
+    metrics.retries += timing.retries;
+    OTA_LOGD("Status %d after %u ms (DNS %u ms, connect %u ms, %s connection).\n", code,
+             timing.dns_ms + timing.connect_ms + timing.ttfb_ms, timing.dns_ms, timing.connect_ms, timing.reused ? "reused" : "new");
 
-    if (code == HTTP_CODE_OK)
+    if (code == HTTP_STATUS_OK || code == HTTP_STATUS_PARTIAL_CONTENT) // Partial content answers a Range request
     {
+        if (len == -1)
+        {
+            return RESPONSE_LENGTH_UNKNOWN; // Chunked response, read until the body ends
+        }
         if (len <= 0)
         {
-            debugf("ERROR: Received invalid response length %d.\n", len);
+            OTA_LOGE("ERROR: Received invalid response length %d.\n", len);
             error = OTA_RESPONSE_INVALID;
             return 0;
         }
         return len; // return the length of the response
     }
+    else if (code == HTTP_STATUS_NOT_MODIFIED)
+    {
+        OTA_LOGD("Resource not modified since the last request.\n");
+        return -code; // Not an error, the caller has to use its cached copy of the resource
+    }
     else if (code < 0)
     {
         error = ESP32_OTA_Updater_Error::WIFI_NOT_CONNECTED;
-        debugf("ERROR: Could not connect to server %d\n", code);
+        OTA_LOGE("ERROR: Could not connect to server %d\n", code);
         return code; // Return a negative value to indicate failure
     }
     else
     {
         error = ESP32_OTA_Updater_Error::OTA_NOT_AVAILABLE;
-        debugf("ERROR: Invalid response code %d\n", code);
+        OTA_LOGE("ERROR: Invalid response code %d\n", code);
         return -code; // Return (minus) the response code to indicate failure although a successful request was made
     }
 }
 
-bool ESP32_OTA_Updater::available()
+bool ESP32_OTA_Updater::evaluateCachedRelease()
 {
-    /*
-     * TODO: Implement a millis nonblocking return false to not always perform an http request
-     */
-
-    if (error != ESP32_OTA_Updater_Error::NO_ERROR)
+    const Version latest_version(latest_tag);
+    if (!latest_version.isValid() || latest_version <= current_version)
+    {
+        new_version_available = false;
+        return false;
+    }
+    if (binary_download_url[0] == '\0')
     {
+        OTA_LOGI("No Firmware binary known for release %s.\n", latest_tag);
+        new_version_available = false;
         return false;
     }
+    new_version_available = CheckScheduler::inRollout(device_id, latest_tag, rollout_percent);
+    return new_version_available;
+}
 
-    // Check if a firmware update is available
-    const size_t urlLen = 50 + strlen(repositry_owner) + strlen(repositry_name);
-    char url[urlLen];
-    snprintf(url, urlLen, "https://api.github.com/repos/%s/%s/releases/latest", repositry_owner, repositry_name);
+bool ESP32_OTA_Updater::available()
+{
+    // An installed update only waits for the reboot, it must not be reported and installed again
+    if (error == ESP32_OTA_Updater_Error::NOT_INITIALIZED || isBusy() || state == ESP32_OTA_Updater_State::OTA_READY_TO_REBOOT)
+    {
+        return false;
+    }
 
-    debugf("Checking for new release on %s.\n", url);
+    if (!check_scheduler.isDue(rtcTimeMillis()))
+    {
+        return evaluateCachedRelease() && !staged; // Result of the last check is still recent enough
+    }
 
-    if (!http_client.begin(wifi_client_secure, url))
+    if (!beginCheck())
     {
-        debugf("HTTP Client begin failed!\n");
-        error = ESP32_OTA_Updater_Error::OTA_NOT_AVAILABLE;
         return false;
     }
-    http_client.addHeader("Accept", "application/vnd.github+json");
+    while (state == ESP32_OTA_Updater_State::OTA_CHECKING)
+    {
+        checkStep(true);
+    }
+    return new_version_available && !staged; // A changed release discards the staged one during the check
+}
 
-    if (httpclientSendRequest(http_client) <= 0)
+bool ESP32_OTA_Updater::setBatchResult(const BatchComponent &component)
+{
+    if (error == ESP32_OTA_Updater_Error::NOT_INITIALIZED || isBusy() || !release_channel.isLatest() || !component.has_release)
+    {
+        return false; // The updater keeps checking on its own schedule
+    }
+    const int64_t now = rtcTimeMillis();
+    const Version latest_version(component.tag);
+    const bool known = check_cache_valid && strcmp(component.tag, latest_tag) == 0;
+    if (!known && latest_version.isValid() && latest_version > current_version)
     {
-        debugf("HTTP GET Request failed!");
-        return false; // Error Codes are set in the method itself
+        OTA_LOGI("Batch check found release %s, requesting it.\n", component.tag);
+        check_scheduler.expedite(now);
+        return true;
     }
+    if (!known)
+    {
+        // The cached release is outdated, the new one is not newer than the running version
+        check_cache_valid = false;
+        release_etag[0] = '\0';
+        copyString(latest_tag, component.tag);
+        binary_download_url[0] = '\0';
+        binary_size = 0;
+    }
+    OTA_LOGD("Batch check found release %s, no request needed.\n", component.tag);
+    evaluateCachedRelease();
+    check_scheduler.onSuccess(now);
+    if (state == ESP32_OTA_Updater_State::OTA_IDLE || state == ESP32_OTA_Updater_State::OTA_UPDATE_AVAILABLE ||
+        state == ESP32_OTA_Updater_State::OTA_STAGED)
+    {
+        setState(releaseState());
+    }
+    return false;
+}
 
-    // ***** Response Decoding and Handling ******
-    JsonDocument doc;
+bool ESP32_OTA_Updater::beginCheck()
+{
+    error = ESP32_OTA_Updater_Error::NO_ERROR; // A failed check only delays the next one
+    setState(ESP32_OTA_Updater_State::OTA_CHECKING);
+    cycle_handshakes = http_transport->getHandshakeCount();
+    metrics.clear();
+    beginPhase(UPDATE_PHASE_CHECK);
+    release_page = release_channel.isLatest() ? 0 : 1;
+    // Release download URLs only work for public repositories and only point to the latest release
+    manifest_check = manifest_asset_name[0] != '\0' && !api_key_defined && release_page == 0;
+    return requestRelease();
+}
 
-    DeserializationError json_error = deserializeJson(doc, http_client.getStream());
-    http_client.end();
-    if (json_error)
+bool ESP32_OTA_Updater::requestRelease()
+{
+    // Check if a firmware update is available, other channels than the latest stable release scan the releases list
+    char url[RELEASE_URL_LENGTH];
+    if (manifest_check)
     {
-        debugf("Failed to deserialize release information %s.\n", json_error.c_str());
-        error = ESP32_OTA_Updater_Error::OTA_FAILED_TO_DESERIALIZE;
-        return false;
+        // The stable download URL of the latest release, it is served by the download server without rate limit
+        snprintf(download_base, sizeof(download_base), RELEASE_DOWNLOAD_BASE_FORMAT, repositry_owner, repositry_name);
+        snprintf(url, sizeof(url), RELEASE_MANIFEST_URL_FORMAT, repositry_owner, repositry_name, manifest_asset_name);
+    }
+    else if (release_page == 0)
+    {
+        snprintf(url, sizeof(url), RELEASE_LATEST_URL_FORMAT, repositry_owner, repositry_name);
+    }
+    else
+    {
+        snprintf(url, sizeof(url), RELEASE_LIST_URL_FORMAT, repositry_owner, repositry_name, ESP32_OTA_UPDATER_RELEASES_PER_PAGE,
+                 release_page);
     }
+    OTA_LOGI("Checking for new release on %s.\n", url);
 
-    // Check version from the JSON response
-    if (!doc.containsKey("tag_name"))
+    if (!http_transport->begin(url))
     {
-        debugf("Release information does not contain \"tag_name\"!\n");
-        error = ESP32_OTA_Updater_Error::OTA_RESPONSE_INVALID;
+        OTA_LOGE("HTTP Client begin failed!\n");
+        failUpdate(ESP32_OTA_Updater_Error::OTA_NOT_AVAILABLE);
         return false;
     }
-    const char *latest_version_c_str = doc["tag_name"].as<const char *>();
-    const Version latest_version(latest_version_c_str);
-    debugf("Latest version is: %s\n", latest_version_c_str);
+    http_transport->addHeader("Accept", manifest_check ? "application/octet-stream" : "application/vnd.github+json");
+    if (check_cache_valid && release_etag[0] != '\0' && release_page <= 1)
+    {
+        // GitHub answers with an empty 304 (which does not count against the rate limit) if the release is unchanged
+        http_transport->addHeader("If-None-Match", release_etag);
+    }
+    const char *response_headers[] = {"ETag", "X-RateLimit-Remaining", "X-RateLimit-Reset", "Retry-After", "Date"};
+    http_transport->collectHeaders(response_headers, 5);
+
+    const int response_length = sendRequest(UPDATE_PHASE_CHECK);
+    sampleHeap();
 
-    if (latest_version <= current_version)
+    // Applied to the schedule when the check ends, also if it failed (e.g. 403 or 429 from an exhausted limit)
+    char remaining[12];
+    char reset[16];
+    char retry_after[12];
+    char date[32];
+    http_transport->getHeader("X-RateLimit-Remaining", remaining, sizeof(remaining));
+    http_transport->getHeader("X-RateLimit-Reset", reset, sizeof(reset));
+    http_transport->getHeader("Retry-After", retry_after, sizeof(retry_after));
+    http_transport->getHeader("Date", date, sizeof(date));
+    if (check_scheduler.onRateLimit(remaining, reset, retry_after, date))
     {
-        debugf("The version found is not newer than the current version.\n");
-        return false;
+        OTA_LOGI("Rate limit exhausted (%s requests remaining), deferring the next check.\n", remaining[0] != '\0' ? remaining : "0");
+    }
+    if (response_length == -HTTP_STATUS_NOT_MODIFIED)
+    {
+        http_transport->end();
+        endPhase();
+        OTA_LOGI("Latest release %s is unchanged.\n", latest_tag);
+        evaluateCachedRelease();
+        setState(releaseState());
+        return true;
+    }
+    if (manifest_check && response_length == -HTTP_STATUS_NOT_FOUND)
+    {
+        // Releases published before the manifest was added to the workflow only have the API
+        OTA_LOGI("Latest release has no %s, checking with the API.\n", manifest_asset_name);
+        http_transport->end();
+        error = ESP32_OTA_Updater_Error::NO_ERROR;
+        manifest_check = false;
+        return requestRelease();
     }
-    // Find the asset with the binary:
-    if (!doc.containsKey("assets"))
+    if (response_length <= 0)
     {
-        debugf("Release information does not contain \"assets\"!\n");
-        error = ESP32_OTA_Updater_Error::OTA_RESPONSE_INVALID;
+        OTA_LOGE("HTTP GET Request failed!");
+        failUpdate(error); // Error Codes are set in the method itself
         return false;
     }
-    JsonArray assets = doc["assets"].as<JsonArray>();
-    bool assetFound = false;
-    for (JsonObject jsonAsset : assets)
+    if (release_page > 1)
     {
-        if (jsonAsset.containsKey("name") && strcmp(jsonAsset["name"].as<const char *>(), firmware_asset_path) == 0)
-        {
-            // Found the download URL
-            strncpy(binary_download_url, jsonAsset["url"].as<const char *>(), ESP32_OTA_UPDATER_LONGSTRING_LENGTH);
-            binary_size = jsonAsset["size"].as<int>();
+        // The next page of the releases list, the best release so far is kept by the parser
+        release_parser.nextPage();
+        response_length_total = response_length;
+        response_remaining = response_length;
+        step_start = millis();
+        last_data_received = step_start;
+        return true;
+    }
+    // A new release is always listed first, so the ETag of the first page tells whether the result changed
+    http_transport->getHeader("ETag", pending_etag, ESP32_OTA_UPDATER_LONGSTRING_LENGTH);
 
-            new_version_available = true;
-            assetFound = true;
-            debugf("Found firmware binary on %s.\n", binary_download_url);
-            break;
+    // The release is parsed while it is received, only the tag and the firmware asset are kept in memory.
+    if (manifest_check)
+    {
+        manifest_parser.begin(download_base);
+    }
+    else if (release_page == 0)
+    {
+        release_parser.begin();
+    }
+    else
+    {
+        release_parser.beginList(&release_channel, &current_version);
+    }
+    firmware_asset.name = firmware_asset_path;
+    patch_asset.name = patch_asset_pattern;
+    signature_asset.name = signature_asset_name;
+    ReleaseAsset *assets[ESP32_OTA_UPDATER_MAX_ASSETS];
+    uint8_t asset_count = 0;
+    assets[asset_count++] = &firmware_asset;
+    if (delta_updates && running_image != NULL)
+    {
+        assets[asset_count++] = &patch_asset;
+    }
+    assets[asset_count++] = &signature_asset;
+    for (uint8_t i = 0; i < component_count; i++)
+    {
+        assets[asset_count++] = &components[i].asset;
+    }
+    for (uint8_t i = 0; i < asset_count; i++)
+    {
+        if (manifest_check)
+        {
+            manifest_parser.addAsset(assets[i]);
+        }
+        else
+        {
+            release_parser.addAsset(assets[i]);
         }
     }
-    if (!assetFound)
+    if (staged_rollout && !manifest_check)
     {
-        debugf("No Firmware binary found on the release.\n");
-        error = ESP32_OTA_Updater_Error::OTA_RESPONSE_INVALID;
-        return false;
+        release_parser.readRollout(); // The manifest always carries the rollout percentage
     }
 
+    response_length_total = response_length;
+    response_remaining = response_length;
+    step_start = millis();
+    last_data_received = step_start;
     return true;
 }
 
-bool ESP32_OTA_Updater::downloadAndInstall()
+void ESP32_OTA_Updater::checkStep(bool blocking)
 {
-    if (error != ESP32_OTA_Updater_Error::NO_ERROR)
+    uint8_t buffer[ESP32_OTA_UPDATER_PARSE_BUFFER_SIZE];
+    const int received = readResponseChunk(buffer, sizeof(buffer), blocking);
+    if (received > 0 && manifest_check)
     {
-        return false;
+        manifest_parser.feed(buffer, received);
+    }
+    else if (received > 0)
+    {
+        release_parser.feed(buffer, received);
+    }
+    sampleHeap();
+    const bool parsing = manifest_check ? manifest_parser.getStatus() == ManifestParser::SCANNING
+                                        : release_parser.getStatus() == JsonStreamScanner::SCANNING;
+    if (received < 0 || response_remaining == 0 || !parsing)
+    {
+        finishCheck();
     }
+}
 
-    if (!new_version_available)
+void ESP32_OTA_Updater::finishCheck()
+{
+    http_transport->end(); // Closes the connection, the rest of the release is never received
+    if (release_page > 0 && release_parser.getStatus() == JsonStreamScanner::FINISHED &&
+        release_parser.getReleaseCount() == ESP32_OTA_UPDATER_RELEASES_PER_PAGE && release_page < ESP32_OTA_UPDATER_RELEASES_MAX_PAGES)
     {
-        return false;
+        // A full page which did not reach the running version, older releases of the channel may still be newer
+        release_page++;
+        requestRelease();
+        return;
     }
+    endPhase();
+    OTA_LOGI("Parsed release information in %lu ms, read %d bytes, %u TLS handshakes.\n", millis() - step_start,
+             response_length_total - response_remaining, http_transport->getHandshakeCount() - cycle_handshakes);
 
-    // Download the firmware from the URL
-    debugf("Starting HTTP Client on binary download url: %s.\n", binary_download_url);
-    if (!http_client.begin(wifi_client_secure, binary_download_url))
+    if (manifest_check && manifest_parser.getStatus() != ManifestParser::FINISHED)
     {
-        debugf("Failed to begin HTTP Client.\n");
-        error = ESP32_OTA_Updater_Error::OTA_DOWNLOAD_FAILED;
-        return false;
+        // Also an incomplete manifest, only the CRC at its end makes it valid
+        OTA_LOGE("Failed to read %s%s.\n", manifest_asset_name, manifest_parser.isValueTooLong() ? ", a value exceeds its buffer" : "");
+        failUpdate(ESP32_OTA_Updater_Error::OTA_FAILED_TO_DESERIALIZE);
+        return;
+    }
+    if (!manifest_check && release_parser.getStatus() == JsonStreamScanner::FAILED)
+    {
+        OTA_LOGE("Failed to deserialize release information%s.\n", release_parser.isValueTooLong() ? ", a value exceeds its buffer" : "");
+        failUpdate(ESP32_OTA_Updater_Error::OTA_FAILED_TO_DESERIALIZE);
+        return;
+    }
+    if (release_page > 0 && release_parser.getStatus() == JsonStreamScanner::SCANNING)
+    {
+        OTA_LOGE("Releases list is incomplete!\n");
+        failUpdate(ESP32_OTA_Updater_Error::OTA_FAILED_TO_DESERIALIZE);
+        return;
     }
-    http_client.addHeader("Accept", "application/octet-stream");
-    http_client.addHeader("Cache-Control", "no-cache");
 
-    int update_size = httpclientSendRequest(http_client);
-    if (update_size <= 0)
+    // The previous result is outdated from here on
+    check_cache_valid = false;
+    new_version_available = false;
+    binary_download_url[0] = '\0';
+    binary_size = 0;
+    binary_digest_known = false;
+    patch_download_url[0] = '\0';
+    patch_size = 0;
+    signature_download_url[0] = '\0';
+    signature_size = 0;
+
+    // Check version from the JSON response
+    if (release_page > 0 && !release_parser.hasTag())
+    {
+        OTA_LOGI("No release of channel \"%s\" is newer than the current version.\n", channel_spec);
+    }
+    else if (!manifest_check && !release_parser.hasTag())
+    {
+        OTA_LOGE("Release information does not contain \"tag_name\"!\n");
+        failUpdate(ESP32_OTA_Updater_Error::OTA_RESPONSE_INVALID);
+        return;
+    }
+    if (!copyValue(latest_tag, manifest_check ? manifest_parser.getTag() : release_parser.getTag()))
+    {
+        OTA_LOGE("Release tag is longer than %u characters!\n", ESP32_OTA_UPDATER_SHORTSTRING_LENGTH - 1);
+        failUpdate(ESP32_OTA_Updater_Error::OTA_RESPONSE_INVALID);
+        return;
+    }
+    rollout_percent = !staged_rollout ? 100 : manifest_check ? manifest_parser.getRolloutPercent() : release_parser.getRolloutPercent();
+    const Version latest_version(latest_tag);
+    if (latest_tag[0] != '\0')
     {
-        return false; // Error codes are set in the method itself!
+        OTA_LOGI("Latest version is: %s\n", latest_tag);
     }
 
-    // Check firmware size
-    if (update_size != binary_size)
+    if (latest_tag[0] == '\0')
     {
-        debugf("Firmware update sizes did not match, found %d, expected %d.", update_size, binary_size);
-        error = OTA_RESPONSE_INVALID;
-        return false;
+        // Nothing newer in the channel
+    }
+    else if (!latest_version.isValid())
+    {
+        OTA_LOGE("Tag %s is not a semantic version (%s), ignoring the release.\n", latest_tag, Version::describe(latest_version.getError()));
+    }
+    else if (latest_version <= current_version)
+    {
+        OTA_LOGI("The version found is not newer than the current version.\n");
     }
+    else
+    {
+        if (!firmware_asset.found)
+        {
+            OTA_LOGE("No Firmware binary found on the release.\n");
+            failUpdate(ESP32_OTA_Updater_Error::OTA_RESPONSE_INVALID);
+            return;
+        }
+        memcpy(binary_download_url, firmware_asset.url, ESP32_OTA_UPDATER_LONGSTRING_LENGTH);
+        binary_size = firmware_asset.size;
+        binary_digest_known = firmware_asset.has_digest;
+        memcpy(binary_digest, firmware_asset.digest, RELEASE_ASSET_DIGEST_SIZE);
+        new_version_available = true;
+        OTA_LOGI("Found firmware binary on %s.\n", binary_download_url);
 
-    // Update of size update_size is ready for download
-    debugf("Found an update firmware of size: %d bytes.\n", update_size);
+        if (delta_updates && running_image != NULL && patch_asset.found) // Only looked up with a running image
+        {
+            memcpy(patch_download_url, patch_asset.url, ESP32_OTA_UPDATER_LONGSTRING_LENGTH);
+            patch_size = patch_asset.size;
+            OTA_LOGI("Found delta patch of %d bytes on %s.\n", patch_size, patch_download_url);
+        }
+        if (signature_asset.found)
+        {
+            memcpy(signature_download_url, signature_asset.url, ESP32_OTA_UPDATER_LONGSTRING_LENGTH);
+            signature_size = signature_asset.size;
+        }
+        if (!CheckScheduler::inRollout(device_id, latest_tag, rollout_percent))
+        {
+            OTA_LOGI("Release %s is rolled out to %u%% of the devices, this device is not included yet.\n", latest_tag, rollout_percent);
+            new_version_available = false;
+        }
+    }
 
-    // Directly write the download stream to the file stream...
+    // Remember the result, the next check only has to ask whether the release changed since
+    memcpy(release_etag, pending_etag, ESP32_OTA_UPDATER_LONGSTRING_LENGTH);
+    check_cache_valid = true;
+    storeCheckCache();
 
-    if (!Update.begin(update_size, U_FLASH))
+    setState(releaseState());
+    if (new_version_available && auto_install && !staged)
     {
-        debugf("Failed to begin update, insufficient flash!\n");
-        error = ESP32_OTA_Updater_Error::OTA_INSTALL_FAILED;
-        http_client.end();
-        return false;
+        pending_request = REQUEST_INSTALL;
     }
+}
 
-    /*
-     * TODO: Implemente Crypto at this point, to allow for encrypted firmware binaries.
-     */
-
-    if (Update.writeStream(http_client.getStream()) != update_size)
+bool ESP32_OTA_Updater::downloadAndInstall()
+{
+    if (error != ESP32_OTA_Updater_Error::NO_ERROR || isBusy() || state == ESP32_OTA_Updater_State::OTA_READY_TO_REBOOT)
     {
-        debugf("Failed to write update stream to flash.\n");
-        error = ESP32_OTA_Updater_Error::OTA_INSTALL_FAILED;
-        http_client.end();
         return false;
     }
 
-    if (!Update.end())
+    if (!new_version_available)
     {
-        debugf("Update was not successfully written!\n");
-        error = ESP32_OTA_Updater_Error::OTA_INSTALL_FAILED;
-        http_client.end();
         return false;
     }
+    if (staged)
+    {
+        return true; // Already prefetched, commitStaged() activates it
+    }
 
-    http_client.end();
-
-    debugf("Successfully downloaded and wrote update, reboot now.\n");
-    return true;
+    // A download from a peer or a patch which fails continues with GitHub or the full image, the state tells the result
+    peer_failed = false;
+    beginDownload();
+    while (isBusy())
+    {
+        if (state == ESP32_OTA_Updater_State::OTA_DOWNLOADING)
+        {
+            downloadStep(true);
+        }
+        else
+        {
+            finishInstall();
+        }
+    }
+    return state == ESP32_OTA_Updater_State::OTA_READY_TO_REBOOT || state == ESP32_OTA_Updater_State::OTA_STAGED;
 }
 
-void ESP32_OTA_Updater::reboot()
+bool ESP32_OTA_Updater::beginDownload(bool signature_loaded)
 {
-    debugf("Rebooting.\n");
-    ESP.restart();
+    setState(ESP32_OTA_Updater_State::OTA_DOWNLOADING);
+    staged = false;
+    active_component = APP_COMPONENT;
+    active_sink = firmware_sink;
+    hashing_asset = false;
+
+    // Components which are already installed are skipped, the rest is downloaded after the app
+    for (uint8_t i = 0; i < component_count; i++)
+    {
+        Component &component = components[i];
+        component.pending = component.asset.found && !isComponentInstalled(component);
+        if (component.asset.found && !component.pending)
+        {
+            OTA_LOGI("%s is unchanged, skipping it.\n", component.asset.name);
+        }
+    }
+
+    installing_patch = delta_updates && running_image != NULL && patch_download_url[0] != '\0';
+    peer_download = false;
+    image_verified = false;
+
+    // The digest and signature are small, they are loaded before the image so they can be checked right at its end.
+    // A fallback to another source of the same image keeps the ones loaded for the first attempt.
+    verifying_image = signing_key != NULL || signature_download_url[0] != '\0';
+    if (verifying_image && !(signature_loaded && image_verifier.hasExpected()))
+    {
+        beginPhase(UPDATE_PHASE_SIGNATURE);
+        const bool fetched = fetchSignature();
+        endPhase();
+        if (!fetched)
+        {
+            failUpdate(ESP32_OTA_Updater_Error::OTA_VERIFICATION_FAILED);
+            return false;
+        }
+    }
+    else if (!verifying_image && peer_network != NULL && binary_digest_known && !decryption_key_set &&
+             StreamDecompressor::codecFromName(firmware_asset_path) == StreamDecompressor::CODEC_NONE)
+    {
+        // The digest GitHub lists for an uncompressed asset is the digest of the image, which identifies it for peers
+        verifying_image = image_verifier.setExpected(binary_digest, RELEASE_ASSET_DIGEST_SIZE);
+    }
+    beginPhase(UPDATE_PHASE_DOWNLOAD);
+    char peer_url[ESP32_OTA_UPDATER_LONGSTRING_LENGTH];
+    int peer_size = 0;
+    peer_download = findPeer(peer_url, sizeof(peer_url), &peer_size);
+    if (peer_download)
+    {
+        installing_patch = false; // The local network is cheaper than any patch
+    }
+    const char *download_url = peer_download ? peer_url : (installing_patch ? patch_download_url : binary_download_url);
+    const int expected_size = peer_download ? peer_size : (installing_patch ? patch_size : binary_size);
+
+    // The download stream is decompressed and patched on its way to the flash, so the size of the image written
+    // is only known at the end. The asset size is the number of bytes transferred.
+    const uint32_t capacity = firmware_sink->getCapacity();
+    if (capacity == 0 || (!installing_patch && (uint32_t)expected_size > capacity))
+    {
+        OTA_LOGE("Failed to begin update, insufficient flash!\n");
+        failUpdate(ESP32_OTA_Updater_Error::OTA_INSTALL_FAILED);
+        return false;
+    }
+
+    // Continue an image an earlier attempt did not finish, if the partition still contains what was recorded
+    uint32_t resume_offset = 0;
+    uint32_t resume_crc = 0;
+    uint8_t resume_head[FIRMWARE_SINK_HEAD_SIZE];
+    const bool resume_recorded = !peer_download && loadResumeState(download_url, expected_size, &resume_offset, &resume_crc, resume_head);
+    if (resume_recorded && (installing_patch || decryption_key_set || !firmware_sink->verify(resume_offset, resume_crc, resume_head)))
+    {
+        OTA_LOGI("Partially written image does not match the flash, starting over.\n");
+        resume_offset = 0;
+    }
+    return openDownload(download_url, expected_size, resume_recorded, resume_offset, resume_crc, resume_head);
 }
 
-ESP32_OTA_Updater_Error ESP32_OTA_Updater::getErrorCode()
+bool ESP32_OTA_Updater::beginNextComponent()
 {
-    return error;
+    const uint8_t first = active_component == APP_COMPONENT ? 0 : active_component + 1;
+    for (uint8_t i = first; i < component_count; i++)
+    {
+        Component &component = components[i];
+        if (!component.pending)
+        {
+            continue;
+        }
+        setState(ESP32_OTA_Updater_State::OTA_DOWNLOADING);
+        active_component = i;
+        active_sink = component.sink;
+        installing_patch = false;
+        peer_download = false;
+        verifying_image = false;
+        beginPhase(UPDATE_PHASE_DOWNLOAD);
+
+        const uint32_t capacity = active_sink->getCapacity();
+        if (capacity == 0 || (uint32_t)component.asset.size > capacity)
+        {
+            OTA_LOGE("%s does not fit into its partition!\n", component.asset.name);
+            failUpdate(ESP32_OTA_Updater_Error::OTA_INSTALL_FAILED);
+            return true;
+        }
+        // The release digest covers the asset as published, so it is hashed before decryption and decompression
+        hashing_asset = component.asset.has_digest;
+        if (hashing_asset)
+        {
+            asset_verifier.begin(NULL);
+            asset_verifier.setExpected(component.asset.digest, RELEASE_ASSET_DIGEST_SIZE);
+        }
+        OTA_LOGI("Installing %s.\n", component.asset.name);
+        openDownload(component.asset.url, component.asset.size, false, 0, 0, NULL);
+        return true;
+    }
+    return false;
 }
 
-String ESP32_OTA_Updater::getErrorDescription()
+bool ESP32_OTA_Updater::openDownload(const char *download_url, int expected_size, bool resume_recorded, uint32_t resume_offset,
+                                     uint32_t resume_crc, const uint8_t *resume_head)
 {
-    switch (error)
-    {
-    case ESP32_OTA_Updater_Error::NO_ERROR:
-        return F("No error");
-    case ESP32_OTA_Updater_Error::WIFI_NOT_CONNECTED:
-        return F("Wifi not connected");
-    case ESP32_OTA_Updater_Error::NOT_INITIALIZED:
-        return F("Not initialized");
-    case ESP32_OTA_Updater_Error::OTA_NOT_AVAILABLE:
-        return F("OTA Update not available, please configure the git repo!");
-    case ESP32_OTA_Updater_Error::OTA_DOWNLOAD_FAILED:
-        return F("OTA download failed");
-    case ESP32_OTA_Updater_Error::OTA_INSTALL_FAILED:
-        return F("OTA install failed");
-    case ESP32_OTA_Updater_Error::OTA_FAILED_TO_DESERIALIZE:
-        return F("OTA failed to deserialize");
-    case ESP32_OTA_Updater_Error::OTA_RESPONSE_INVALID:
-        return F("OTA response invalid");
-    default:
-        return F("Unknown error");
+    // Download the firmware from the URL
+    OTA_LOGD("Starting HTTP Client on %s download url: %s.\n", installing_patch ? "patch" : "binary", download_url);
+    if (!http_transport->begin(download_url))
+    {
+        OTA_LOGE("Failed to begin HTTP Client.\n");
+        failUpdate(ESP32_OTA_Updater_Error::OTA_DOWNLOAD_FAILED);
+        return false;
+    }
+    http_transport->addHeader("Accept", "application/octet-stream");
+    http_transport->addHeader("Cache-Control", "no-cache");
+    if (resume_offset > 0)
+    {
+        // The header is sent again when following the redirect to the download server
+        char range[24];
+        snprintf(range, sizeof(range), "bytes=%u-", resume_offset);
+        http_transport->addHeader("Range", range);
+    }
+    const char *response_headers[] = {"Content-Range"};
+    http_transport->collectHeaders(response_headers, 1);
+
+    int update_size = sendRequest(UPDATE_PHASE_DOWNLOAD);
+    if (update_size <= 0)
+    {
+        failUpdate(error); // Error codes are set in the method itself!
+        return false;
+    }
+
+    if (resume_offset > 0)
+    {
+        // A server which ignores the Range header answers with the whole asset
+        char content_range[48];
+        unsigned int range_start = 0, range_end = 0, range_total = 0;
+        http_transport->getHeader("Content-Range", content_range, sizeof(content_range));
+        if (sscanf(content_range, "bytes %u-%u/%u", &range_start, &range_end, &range_total) != 3 ||
+            range_start != resume_offset || range_total != (unsigned int)expected_size)
+        {
+            OTA_LOGI("Server does not support resuming the download, starting over.\n");
+            resume_offset = 0;
+        }
     }
+    if (resume_recorded && resume_offset == 0)
+    {
+        clearResumeState();
+    }
+
+    // Check firmware size, the size of a chunked response is checked while it is received
+    if (update_size != RESPONSE_LENGTH_UNKNOWN && update_size != expected_size - (int)resume_offset)
+    {
+        OTA_LOGE("Firmware update sizes did not match, found %d, expected %d.", update_size, expected_size - (int)resume_offset);
+        failUpdate(ESP32_OTA_Updater_Error::OTA_RESPONSE_INVALID);
+        return false;
+    }
+
+    // Update of size update_size is ready for download
+    if (resume_offset > 0)
+    {
+        OTA_LOGI("Resuming the download at %u of %d bytes.\n", resume_offset, expected_size);
+        metrics.resumed_at = resume_offset;
+    }
+    else
+    {
+        OTA_LOGI("Found an update firmware of size: %d bytes.\n", expected_size);
+    }
+
+    if (!active_sink->begin(resume_offset, resume_crc, resume_offset > 0 ? resume_head : NULL))
+    {
+        OTA_LOGE("Failed to begin update, insufficient memory!\n");
+        failUpdate(ESP32_OTA_Updater_Error::OTA_INSTALL_FAILED);
+        return false;
+    }
+    resume_checkpoint = resume_offset;
+    reported_committed = resume_offset;
+    image_verifier.begin(&flash_pipeline);
+    if (verifying_image && resume_offset > 0 && !image_verifier.hashStored(active_sink, resume_offset))
+    {
+        OTA_LOGE("Failed to read back the partially written image!\n");
+        failUpdate(ESP32_OTA_Updater_Error::OTA_INSTALL_FAILED);
+        return false;
+    }
+    flash_pipeline.begin(active_sink, pipeline_buffers, pipeline_buffer_size);
+
+    // Install chain: download -> decompression -> delta patch -> header check -> image verifier -> flash pipeline -> firmware sink
+    ByteSink *image_sink = verifying_image ? (ByteSink *)&image_verifier : &flash_pipeline;
+    checking_header = image_header_checks && active_component == APP_COMPONENT && resume_offset == 0;
+    if (checking_header)
+    {
+        // The running image tells what the device needs, without a readable one only the structure is checked
+        uint8_t running_head[IMAGE_HEADER_CHECK_SIZE];
+        ImageHeaderInfo running_header;
+        const bool reference = running_image != NULL && running_image->getSize() >= IMAGE_HEADER_CHECK_SIZE &&
+                               running_image->read(0, running_head, IMAGE_HEADER_CHECK_SIZE) &&
+                               ImageHeaderCheck::parse(running_head, IMAGE_HEADER_CHECK_SIZE, &running_header);
+        image_header_check.setReference(reference ? &running_header : NULL);
+        image_header_check.setMinimumVersion(image_version_check ? &current_version : NULL);
+        image_header_check.begin(image_sink);
+        image_sink = &image_header_check;
+    }
+    if (installing_patch)
+    {
+        delta_patcher.begin(running_image, running_image->getSize(), image_sink);
+        image_sink = &delta_patcher;
+    }
+    // A patch starts with DELTA_PATCHER_MAGIC or a gzip/zlib header, so it is detected from its first bytes. Other
+    // assets are decoded by the extension of their name, an uncompressed image is never taken for compressed data.
+    // Only uncompressed images are resumed, so the rest of the stream is never sniffed. Peers serve the image itself.
+    const char *asset_name = active_component == APP_COMPONENT ? firmware_asset_path : components[active_component].asset.name;
+    StreamDecompressor::Codec codec = installing_patch ? StreamDecompressor::CODEC_AUTO : StreamDecompressor::codecFromName(asset_name);
+    if (resume_offset > 0 || peer_download)
+    {
+        codec = StreamDecompressor::CODEC_NONE;
+    }
+    if (!download_decompressor.begin(codec, image_sink))
+    {
+        OTA_LOGE("Failed to allocate the decompression buffers!\n");
+        failUpdate(ESP32_OTA_Updater_Error::OTA_INSTALL_FAILED);
+        return false;
+    }
+
+    // Encrypted assets are decrypted in the download buffer, before any other stage sees them
+    download_decryptor.begin(decryption_key_set ? decryption_key : NULL);
+
+    response_length_total = expected_size;
+    response_remaining = expected_size - resume_offset;
+    step_start = millis();
+    last_data_received = step_start;
+    sampleHeap(); // The decoder and pipeline buffers are allocated now
+    return true;
+}
+
+bool ESP32_OTA_Updater::fetchSignature()
+{
+    if (signature_download_url[0] == '\0')
+    {
+        OTA_LOGE("Release is not signed, \"%s\" is missing!\n", signature_asset_name);
+        return false;
+    }
+    if (signature_size < IMAGE_VERIFIER_DIGEST_SIZE || signature_size > IMAGE_VERIFIER_DIGEST_SIZE + ESP32_OTA_UPDATER_MAX_SIGNATURE_SIZE)
+    {
+        OTA_LOGE("Invalid signature asset size %d.\n", signature_size);
+        return false;
+    }
+    if (!http_transport->begin(signature_download_url))
+    {
+        return false;
+    }
+    http_transport->addHeader("Accept", "application/octet-stream");
+    const int length = sendRequest(UPDATE_PHASE_SIGNATURE);
+    if (length != signature_size && length != RESPONSE_LENGTH_UNKNOWN)
+    {
+        OTA_LOGE("Failed to download the signature asset (%d).\n", length);
+        http_transport->end();
+        return false;
+    }
+
+    uint8_t content[IMAGE_VERIFIER_DIGEST_SIZE + ESP32_OTA_UPDATER_MAX_SIGNATURE_SIZE];
+    size_t received = 0;
+    while (received < (size_t)signature_size)
+    {
+        const size_t chunk = http_transport->read(content + received, signature_size - received);
+        if (chunk == 0)
+        {
+            break;
+        }
+        received += chunk;
+    }
+    http_transport->end();
+    phase_bytes += received;
+    if (received != (size_t)signature_size || !image_verifier.setExpected(content, received))
+    {
+        OTA_LOGE("Signature asset is incomplete.\n");
+        return false;
+    }
+    if (signing_key != NULL && received == IMAGE_VERIFIER_DIGEST_SIZE)
+    {
+        OTA_LOGE("Signature asset only contains a digest, but a signature is required!\n");
+        return false;
+    }
+    return true;
+}
+
+void ESP32_OTA_Updater::downloadStep(bool blocking)
+{
+    if (installing_patch && delta_patcher.isBusy())
+    {
+        // Reading the running image for a patch takes the step, the rest of the download waits in the TCP window
+        last_data_received = millis();
+        if (!delta_patcher.step(ESP32_OTA_UPDATER_POLL_SLICE_SIZE))
+        {
+            failImageWrite();
+        }
+        else if (response_remaining == 0 && !delta_patcher.isBusy())
+        {
+            setState(ESP32_OTA_Updater_State::OTA_VERIFYING);
+        }
+        return;
+    }
+    uint8_t buffer[ESP32_OTA_UPDATER_POLL_SLICE_SIZE];
+    size_t slice = sizeof(buffer);
+    if (download_limiter.getRate() > 0)
+    {
+        // Data which is not read stays in the TCP window, so the sender is slowed down to the rate the image is read
+        slice = slice < (size_t)response_remaining ? slice : (size_t)response_remaining;
+        unsigned long wait = download_limiter.getWait(millis(), slice);
+        throttle_wait = wait;
+        if (wait > 0 && !blocking)
+        {
+            last_data_received = millis(); // Waiting for the limiter is not a stalled server
+            return;
+        }
+        while (wait > 0)
+        {
+            // Waits in short steps, so a new rate applies right away
+            delay(wait < ESP32_OTA_UPDATER_TASK_IDLE_DELAY ? wait : ESP32_OTA_UPDATER_TASK_IDLE_DELAY);
+            wait = download_limiter.getWait(millis(), slice);
+        }
+        slice = download_limiter.getAvailable(millis(), slice);
+    }
+    if (!blocking && !flash_pipeline.canWrite(slice))
+    {
+        // The flash writer is behind, the data waits in the TCP window like with the rate limit
+        last_data_received = millis();
+        return;
+    }
+    const int received = readResponseChunk(buffer, slice, blocking);
+    if (received > 0)
+    {
+        download_limiter.consume(received);
+    }
+    if (received < 0)
+    {
+        OTA_LOGE("Failed to write update stream to flash, connection lost after %d bytes.\n", response_length_total - response_remaining);
+        failUpdate(ESP32_OTA_Updater_Error::OTA_INSTALL_FAILED);
+        return;
+    }
+    size_t plain_length = received > 0 ? received : 0;
+    if (hashing_asset)
+    {
+        asset_verifier.hash(buffer, plain_length);
+    }
+    const uint8_t *plaintext = download_decryptor.decrypt(buffer, &plain_length);
+    if (plaintext == NULL)
+    {
+        OTA_LOGE("Asset is not encrypted with the configured key format!\n");
+        failUpdate(ESP32_OTA_Updater_Error::OTA_INSTALL_FAILED);
+        return;
+    }
+    if (plain_length > 0 && !download_decompressor.write(plaintext, plain_length))
+    {
+        failImageWrite();
+        return;
+    }
+    uint32_t committed, committed_crc;
+    flash_pipeline.getCommitted(&committed, &committed_crc);
+    if (committed != reported_committed)
+    {
+        reported_committed = committed;
+        updateProgressCallback(response_length_total - response_remaining, response_length_total);
+
+        // Image and download offsets only match for uncompressed full images
+        if (resumable_downloads && active_component == APP_COMPONENT && !installing_patch && !peer_download && !download_decryptor.isDecrypting() &&
+            download_decompressor.getCodec() == StreamDecompressor::CODEC_NONE &&
+            committed - resume_checkpoint >= ESP32_OTA_UPDATER_RESUME_CHECKPOINT_SIZE)
+        {
+            resume_checkpoint = committed;
+            storeResumeState(committed, committed_crc);
+        }
+    }
+    sampleHeap();
+    if (response_remaining == 0)
+    {
+        http_transport->end();
+        endPhase();
+        const unsigned long duration = millis() - step_start;
+        const uint32_t transferred = download_decompressor.getBytesIn();
+        OTA_LOGI("Downloaded %u bytes in %lu ms (%lu B/s), %u bytes decoded (%lu B/s).\n", transferred, duration,
+                 duration > 0 ? transferred * 1000UL / duration : 0, download_decompressor.getBytesOut(),
+                 duration > 0 ? download_decompressor.getBytesOut() * 1000UL / duration : 0);
+        if (download_decryptor.isDecrypting())
+        {
+            OTA_LOGD("Decrypting took %u ms.\n", download_decryptor.getDecryptTime() / 1000);
+        }
+        if (peer_download)
+        {
+            metrics.peer_bytes += transferred;
+        }
+        if (!installing_patch || !delta_patcher.isBusy())
+        {
+            setState(ESP32_OTA_Updater_State::OTA_VERIFYING); // Otherwise once the patcher has read the running image
+        }
+    }
+}
+
+void ESP32_OTA_Updater::failImageWrite()
+{
+    if (checking_header && image_header_check.getResult() > ImageHeaderCheck::VALID)
+    {
+        const ImageHeaderInfo &header = image_header_check.getInfo();
+        OTA_LOGE("Rejected the image after %d bytes, it is %s (chip %u, project \"%s\", version \"%s\").\n",
+                 response_length_total - response_remaining, ImageHeaderCheck::describe(image_header_check.getResult()),
+                 header.chip_id, header.project_name, header.version);
+        failUpdate(ESP32_OTA_Updater_Error::OTA_IMAGE_MISMATCH);
+        return;
+    }
+    if (installing_patch && delta_patcher.getError() != DeltaPatcher::NONE)
+    {
+        fallbackToFullImage();
+        return;
+    }
+    OTA_LOGE("Failed to write update stream to flash.\n");
+    failUpdate(ESP32_OTA_Updater_Error::OTA_INSTALL_FAILED);
+}
+
+void ESP32_OTA_Updater::finishInstall()
+{
+    const bool decompressed = download_decompressor.finish();
+    download_decompressor.end();
+    if (installing_patch && (!decompressed || !delta_patcher.finish()))
+    {
+        fallbackToFullImage();
+        return;
+    }
+    if (!decompressed)
+    {
+        OTA_LOGE("Compressed firmware is incomplete or corrupt!\n");
+        failUpdate(ESP32_OTA_Updater_Error::OTA_INSTALL_FAILED);
+        return;
+    }
+    if (checking_header && !image_header_check.finish())
+    {
+        OTA_LOGE("Rejected the image, it is a %s.\n", ImageHeaderCheck::describe(image_header_check.getResult()));
+        failUpdate(ESP32_OTA_Updater_Error::OTA_IMAGE_TRUNCATED);
+        return;
+    }
+    const bool flushed = flash_pipeline.flush();
+    flash_pipeline.end();
+    const FlashPipelineStats &stats = flash_pipeline.getStats();
+    addPhase(UPDATE_PHASE_FLASH, stats.flash_us / 1000, stats.bytes_written); // Resumed bytes were written before
+    sampleHeap();
+    OTA_LOGD("Pipeline stalls: download %u (%u ms), flash %u (%u ms), %u sectors erased ahead.\n", stats.reader_stalls,
+             stats.reader_stall_ms, stats.writer_stalls, stats.writer_stall_ms, stats.sectors_erased_ahead);
+
+    // The image is only activated by finish(), so an image which does not match is never booted
+    if (flushed && verifying_image)
+    {
+        const unsigned long verify_start = millis();
+        const bool verified = image_verifier.verify(signing_key);
+        const uint32_t hash_ms = image_verifier.getHashTime() / 1000;
+        addPhase(UPDATE_PHASE_VERIFY, hash_ms + millis() - verify_start, image_verifier.getBytesHashed());
+        OTA_LOGI("SHA-256%s of %u bytes %s, hashing took %u ms (%u%% of the install).\n", signing_key != NULL ? " and signature" : "",
+                 image_verifier.getBytesHashed(), verified ? "verified" : "DO NOT MATCH", hash_ms,
+                 millis() - step_start > 0 ? hash_ms * 100 / (millis() - step_start) : 0);
+        if (!verified)
+        {
+            if (installing_patch)
+            {
+                fallbackToFullImage();
+                return;
+            }
+            if (resume_checkpoint > 0)
+            {
+                clearResumeState();
+            }
+            failUpdate(ESP32_OTA_Updater_Error::OTA_VERIFICATION_FAILED); // Aborts the firmware sink
+            return;
+        }
+        image_verified = true;
+    }
+    if (flushed && hashing_asset && !asset_verifier.verify(NULL))
+    {
+        OTA_LOGE("%s does not match the digest of the release!\n", components[active_component].asset.name);
+        failUpdate(ESP32_OTA_Updater_Error::OTA_VERIFICATION_FAILED);
+        return;
+    }
+    if (!flushed)
+    {
+        active_sink->abort();
+    }
+    if (resume_checkpoint > 0)
+    {
+        clearResumeState(); // A complete image is never resumed, even if it turned out to be invalid
+    }
+    if (!flushed)
+    {
+        OTA_LOGE("Update was not successfully written!\n");
+        failUpdate(ESP32_OTA_Updater_Error::OTA_INSTALL_FAILED);
+        return;
+    }
+
+    // Nothing is activated before every image of the release is written and verified
+    if (beginNextComponent())
+    {
+        return;
+    }
+    if (prefetch)
+    {
+        staged = true;
+        copyString(staged_tag, latest_tag);
+        OTA_LOGI("Prefetched release %s, it is activated by commitStaged().\n", staged_tag);
+        setState(ESP32_OTA_Updater_State::OTA_STAGED);
+        return;
+    }
+    commitInstall();
+}
+
+void ESP32_OTA_Updater::commitInstall()
+{
+    const unsigned long finish_start = millis();
+    bool written = true;
+    for (uint8_t i = 0; i < component_count && written; i++)
+    {
+        written = !components[i].pending || components[i].sink->finish();
+    }
+    // The app is activated last, a failed component keeps the running firmware booting
+    written = written && firmware_sink->finish();
+    // The last partial sector is only committed by finish(), so the image size is read afterwards
+    addPhase(UPDATE_PHASE_FINISH, millis() - finish_start, written ? firmware_sink->getCommitted() : 0);
+    if (!written)
+    {
+        OTA_LOGE("Update was not successfully written!\n");
+        failUpdate(ESP32_OTA_Updater_Error::OTA_INSTALL_FAILED);
+        return;
+    }
+    for (uint8_t i = 0; i < component_count; i++)
+    {
+        if (components[i].pending)
+        {
+            components[i].sink->commitInstall(); // Only now that the app is activated as well
+            storeInstalledComponent(components[i]);
+            components[i].pending = false;
+        }
+    }
+    if (peer_network != NULL && image_verified && !decryption_key_set)
+    {
+        storeInstalledImage(image_verifier.getBytesHashed()); // The committed size is only final after finish()
+    }
+
+    new_version_available = false;
+    OTA_LOGI("Update cycle: check %u ms, download %u ms (%u B/s), flash %u ms, verify %u ms, activate %u ms, %u TLS handshakes.\n",
+             metrics.phases[UPDATE_PHASE_CHECK].duration_ms, metrics.phases[UPDATE_PHASE_DOWNLOAD].duration_ms,
+             metrics.phases[UPDATE_PHASE_DOWNLOAD].getThroughput(), metrics.phases[UPDATE_PHASE_FLASH].duration_ms,
+             metrics.phases[UPDATE_PHASE_VERIFY].duration_ms, metrics.phases[UPDATE_PHASE_FINISH].duration_ms,
+             http_transport->getHandshakeCount() - cycle_handshakes);
+    OTA_LOGI("Successfully downloaded and wrote update, reboot now.\n");
+    setState(ESP32_OTA_Updater_State::OTA_READY_TO_REBOOT);
+}
+
+void ESP32_OTA_Updater::fallbackToFullImage()
+{
+    OTA_LOGI("Delta patch could not be applied (error %d), downloading the full firmware.\n", delta_patcher.getError());
+    http_transport->end();
+    endPhase();
+    metrics.patch_fallbacks++;
+    flash_pipeline.end(); // Stops the writer task before the partition writer is released
+    firmware_sink->abort();
+    download_decompressor.end();
+    patch_download_url[0] = '\0'; // Only the full binary is left for this release
+    beginDownload(true);
+}
+
+bool ESP32_OTA_Updater::findPeer(char *url, size_t capacity, int *size)
+{
+    // Only an image whose digest is known up front is taken from a peer, it is verified like one from GitHub
+    if (peer_network == NULL || peer_failed || !verifying_image || decryption_key_set)
+    {
+        return false;
+    }
+    PeerImage image;
+    copyString(image.tag, latest_tag);
+    memcpy(image.digest, image_verifier.getExpectedDigest(), PEER_IMAGE_DIGEST_SIZE);
+    image.size = 0;
+    if (!peer_network->find(&image, url, capacity))
+    {
+        OTA_LOGD("No peer offers release %s.\n", latest_tag);
+        return false;
+    }
+    OTA_LOGI("Downloading the image of %u bytes from a peer.\n", image.size);
+    OTA_LOGD("Peer URL: %s\n", url);
+    *size = image.size;
+    return true;
+}
+
+void ESP32_OTA_Updater::fallbackFromPeer()
+{
+    OTA_LOGI("Download from the peer failed, downloading the firmware from GitHub.\n");
+    http_transport->end();
+    endPhase();
+    metrics.peer_fallbacks++;
+    flash_pipeline.end(); // Stops the writer task before the partition writer is released
+    firmware_sink->abort();
+    download_decompressor.end();
+    error = ESP32_OTA_Updater_Error::NO_ERROR; // Set by the failed request
+    peer_download = false;
+    peer_failed = true; // Only one peer is tried per install
+    beginDownload(true);
+}
+
+int ESP32_OTA_Updater::readResponseChunk(uint8_t *buffer, size_t size, bool blocking)
+{
+    size_t to_read = size < (size_t)response_remaining ? size : (size_t)response_remaining;
+    if (!blocking)
+    {
+        // Only take what is already buffered, so a poll() never waits on the network
+        const int buffered = http_transport->available();
+        if (buffered <= 0)
+        {
+            if (!http_transport->connected() || millis() - last_data_received > ESP32_OTA_UPDATER_HTTP_TIMEOUT)
+            {
+                return -1;
+            }
+            return 0;
+        }
+        to_read = to_read < (size_t)buffered ? to_read : (size_t)buffered;
+    }
+
+    const size_t received = http_transport->read(buffer, to_read);
+    if (received == 0)
+    {
+        return blocking ? -1 : 0; // A blocking read only returns nothing on timeout or when the connection is closed
+    }
+    last_data_received = millis();
+    response_remaining -= received;
+    phase_bytes += received;
+    return received;
+}
+
+void ESP32_OTA_Updater::failUpdate(ESP32_OTA_Updater_Error reason)
+{
+    if (peer_download)
+    {
+        fallbackFromPeer(); // GitHub is the reference, a peer which can not deliver the release is only skipped
+        return;
+    }
+    error = reason;
+    http_transport->end();
+    endPhase(); // The time until the failure is still accounted to the phase
+    download_decompressor.end();
+    flash_pipeline.end();
+    // A failed check says nothing about the staged update, its sinks still hold it for commitStaged()
+    if (!staged || state != ESP32_OTA_Updater_State::OTA_CHECKING)
+    {
+        firmware_sink->abort(); // Committed sectors are kept for a resumed download
+        for (uint8_t i = 0; i < component_count; i++)
+        {
+            components[i].sink->abort();
+        }
+    }
+    hashing_asset = false;
+    setState(ESP32_OTA_Updater_State::OTA_FAILED);
+}
+
+void ESP32_OTA_Updater::setState(ESP32_OTA_Updater_State new_state)
+{
+    if (state == new_state)
+    {
+        return;
+    }
+    const bool was_checking = state == ESP32_OTA_Updater_State::OTA_CHECKING;
+    const bool was_busy = isBusy();
+    state = new_state;
+    if (was_checking && !isBusy())
+    {
+        scheduleNextCheck();
+    }
+    if (was_busy && !isBusy())
+    {
+        finishMetrics();
+    }
+    if (state_callback)
+    {
+        state_callback(new_state);
+    }
+}
+
+bool ESP32_OTA_Updater::isBusy() const
+{
+    return state == ESP32_OTA_Updater_State::OTA_CHECKING || state == ESP32_OTA_Updater_State::OTA_DOWNLOADING ||
+           state == ESP32_OTA_Updater_State::OTA_VERIFYING;
+}
+
+void ESP32_OTA_Updater::scheduleNextCheck()
+{
+    const int64_t now = rtcTimeMillis();
+    if (state != ESP32_OTA_Updater_State::OTA_FAILED)
+    {
+        check_scheduler.onSuccess(now);
+    }
+    else
+    {
+        check_scheduler.onFailure(now, error == ESP32_OTA_Updater_Error::WIFI_NOT_CONNECTED ? CheckScheduler::FAILURE_NETWORK
+                                                                                            : CheckScheduler::FAILURE_SERVER);
+    }
+    OTA_LOGD("Next release check in %u s.\n", check_scheduler.getTimeUntilDue(now) / 1000);
+}
+
+bool ESP32_OTA_Updater::startCheck()
+{
+    if (error == ESP32_OTA_Updater_Error::NOT_INITIALIZED || isBusy() || pending_request != REQUEST_NONE)
+    {
+        return false;
+    }
+    pending_request = REQUEST_CHECK;
+    return true;
+}
+
+bool ESP32_OTA_Updater::startInstall()
+{
+    if (error != ESP32_OTA_Updater_Error::NO_ERROR || isBusy() || pending_request != REQUEST_NONE || !new_version_available || staged)
+    {
+        return false;
+    }
+    pending_request = REQUEST_INSTALL;
+    return true;
+}
+
+void ESP32_OTA_Updater::setAutoInstall(bool enabled)
+{
+    auto_install = enabled;
+}
+
+void ESP32_OTA_Updater::setDownloadRateLimit(uint32_t bytes_per_second, uint32_t burst_bytes)
+{
+    if (burst_bytes == 0)
+    {
+        // Tokens above the burst are lost, so it covers a task delay which takes longer than the limiter asked for
+        burst_bytes = bytes_per_second / 10 > 2 * ESP32_OTA_UPDATER_POLL_SLICE_SIZE ? bytes_per_second / 10 : 2 * ESP32_OTA_UPDATER_POLL_SLICE_SIZE;
+    }
+    download_limiter.setRate(bytes_per_second, burst_bytes);
+    if (bytes_per_second == 0)
+    {
+        throttle_wait = 0;
+    }
+}
+
+void ESP32_OTA_Updater::setPrefetch(bool enabled)
+{
+    prefetch = enabled;
+}
+
+bool ESP32_OTA_Updater::commitStaged()
+{
+    if (!staged || isBusy())
+    {
+        return false;
+    }
+    staged = false;
+    error = ESP32_OTA_Updater_Error::NO_ERROR; // Left by a check which failed while the update was staged
+    const unsigned long start = millis();
+    commitInstall();
+    OTA_LOGI("Activating the prefetched update took %lu ms.\n", millis() - start);
+    return state == ESP32_OTA_Updater_State::OTA_READY_TO_REBOOT;
+}
+
+void ESP32_OTA_Updater::discardStaged()
+{
+    staged = false;
+    firmware_sink->abort(); // The held back first bytes were never written, so the image is not bootable
+    for (uint8_t i = 0; i < component_count; i++)
+    {
+        components[i].sink->abort();
+    }
+}
+
+ESP32_OTA_Updater_State ESP32_OTA_Updater::releaseState()
+{
+    if (staged && (!new_version_available || strcmp(staged_tag, latest_tag) != 0))
+    {
+        OTA_LOGI("Discarding the prefetched release %s, the release changed.\n", staged_tag);
+        discardStaged();
+    }
+    if (staged)
+    {
+        return ESP32_OTA_Updater_State::OTA_STAGED;
+    }
+    return new_version_available ? ESP32_OTA_Updater_State::OTA_UPDATE_AVAILABLE : ESP32_OTA_Updater_State::OTA_IDLE;
+}
+
+ESP32_OTA_Updater_State ESP32_OTA_Updater::poll()
+{
+    if (peer_network != NULL)
+    {
+        peer_serving = peer_network->handle();
+    }
+    switch (state)
+    {
+    case ESP32_OTA_Updater_State::OTA_CHECKING:
+        checkStep(false);
+        break;
+    case ESP32_OTA_Updater_State::OTA_DOWNLOADING:
+        downloadStep(false);
+        break;
+    case ESP32_OTA_Updater_State::OTA_VERIFYING:
+        finishInstall();
+        break;
+    case ESP32_OTA_Updater_State::OTA_READY_TO_REBOOT:
+        pending_request = REQUEST_NONE; // The installed update only waits for the reboot
+        break;
+    default:
+    {
+        const uint8_t request = pending_request;
+        pending_request = REQUEST_NONE;
+        if (request == REQUEST_CHECK)
+        {
+            if (!check_scheduler.isDue(rtcTimeMillis()))
+            {
+                evaluateCachedRelease();
+                setState(releaseState());
+                if (new_version_available && auto_install && !staged)
+                {
+                    pending_request = REQUEST_INSTALL;
+                }
+            }
+            else
+            {
+                beginCheck();
+            }
+        }
+        else if (request == REQUEST_INSTALL && new_version_available && !staged)
+        {
+            peer_failed = false;
+            beginDownload();
+        }
+        break;
+    }
+    }
+    return state;
+}
+
+ESP32_OTA_Updater_State ESP32_OTA_Updater::getState() const
+{
+    return state;
+}
+
+void ESP32_OTA_Updater::getProgress(size_t *progress, size_t *size) const
+{
+    if (state == ESP32_OTA_Updater_State::OTA_DOWNLOADING)
+    {
+        *progress = response_length_total - response_remaining;
+        *size = response_length_total;
+    }
+    else
+    {
+        *progress = 0;
+        *size = 0;
+    }
+}
+
+void ESP32_OTA_Updater::onStateChange(StateCallback callback)
+{
+    state_callback = callback;
+}
+
+void ESP32_OTA_Updater::onProgress(ProgressCallback callback)
+{
+    progress_callback = callback;
+}
+
+const UpdateMetrics &ESP32_OTA_Updater::getMetrics() const
+{
+    return metrics;
+}
+
+void ESP32_OTA_Updater::onMetrics(MetricsCallback callback)
+{
+    metrics_callback = callback;
+}
+
+void ESP32_OTA_Updater::beginPhase(UpdatePhase phase)
+{
+    active_phase = phase;
+    phase_start = millis();
+    phase_bytes = 0;
+}
+
+void ESP32_OTA_Updater::endPhase()
+{
+    if (active_phase != UPDATE_PHASE_COUNT)
+    {
+        addPhase(active_phase, millis() - phase_start, phase_bytes);
+        active_phase = UPDATE_PHASE_COUNT;
+    }
+}
+
+void ESP32_OTA_Updater::addPhase(UpdatePhase phase, uint32_t duration_ms, uint32_t bytes)
+{
+    // A phase is repeated if a delta patch fails and the full image is downloaded
+    metrics.phases[phase].duration_ms += duration_ms;
+    metrics.phases[phase].bytes += bytes;
+}
+
+void ESP32_OTA_Updater::sampleHeap()
+{
+    const uint32_t free_heap = ESP.getFreeHeap();
+    if (free_heap < metrics.heap_min_free)
+    {
+        metrics.heap_min_free = free_heap;
+    }
+}
+
+void ESP32_OTA_Updater::finishMetrics()
+{
+    metrics.handshakes = http_transport->getHandshakeCount() - cycle_handshakes;
+    metrics.error = error;
+    if (metrics.heap_min_free == UINT32_MAX)
+    {
+        metrics.heap_min_free = 0;
+    }
+    if (metrics_callback)
+    {
+        metrics_callback(metrics);
+    }
+}
+
+void ESP32_OTA_Updater::updaterTask(void *parameter)
+{
+    ESP32_OTA_Updater *updater = static_cast<ESP32_OTA_Updater *>(parameter);
+    for (;;)
+    {
+        // Yield for a tick between slices while working or serving a peer, idle states only have to look for new requests
+        updater->poll();
+        TickType_t ticks = updater->isBusy() || updater->peer_serving ? 1 : pdMS_TO_TICKS(ESP32_OTA_UPDATER_TASK_IDLE_DELAY);
+        if (updater->state == ESP32_OTA_Updater_State::OTA_DOWNLOADING && updater->throttle_wait > 0 && !updater->peer_serving)
+        {
+            // Sleeps until the rate limit allows the next slice, at most the idle delay so a new rate applies soon
+            const uint32_t wait = updater->throttle_wait;
+            ticks = pdMS_TO_TICKS(wait < ESP32_OTA_UPDATER_TASK_IDLE_DELAY ? wait : ESP32_OTA_UPDATER_TASK_IDLE_DELAY) + 1;
+        }
+        vTaskDelay(ticks);
+    }
+}
+
+bool ESP32_OTA_Updater::startTask(BaseType_t core, uint32_t stack_size, UBaseType_t priority)
+{
+    if (task_handle != NULL)
+    {
+        return false;
+    }
+    return xTaskCreatePinnedToCore(updaterTask, "ota_updater", stack_size, this, priority, &task_handle, core) == pdPASS;
+}
+
+void ESP32_OTA_Updater::stopTask()
+{
+    if (task_handle != NULL)
+    {
+        vTaskDelete(task_handle);
+        task_handle = NULL;
+    }
+}
+
+void ESP32_OTA_Updater::setDecryptionKey(const uint8_t *key)
+{
+    decryption_key_set = key != NULL;
+    if (decryption_key_set)
+    {
+        memcpy(decryption_key, key, STREAM_DECRYPTOR_KEY_SIZE);
+    }
+}
+
+void ESP32_OTA_Updater::setSigningKey(const char *public_key)
+{
+    signing_key = public_key;
+}
+
+void ESP32_OTA_Updater::setImageHeaderCheck(bool enabled, bool require_newer_version)
+{
+    image_header_checks = enabled;
+    image_version_check = require_newer_version;
+}
+
+void ESP32_OTA_Updater::setDeltaUpdates(bool enabled)
+{
+    delta_updates = enabled;
+}
+
+bool ESP32_OTA_Updater::addComponent(const char *asset_name, FirmwareSink *sink)
+{
+    if (component_count == ESP32_OTA_UPDATER_MAX_COMPONENTS || asset_name == NULL || sink == NULL)
+    {
+        return false;
+    }
+    Component &component = components[component_count++];
+    component.asset.name = asset_name;
+    component.asset.found = false;
+    component.asset.has_digest = false;
+    component.sink = sink;
+    component.pending = false;
+    return true;
+}
+
+void ESP32_OTA_Updater::setManifest(const char *asset_name)
+{
+    if (!copyValue(manifest_asset_name, asset_name != NULL ? asset_name : ""))
+    {
+        OTA_LOGE("Manifest name %s is too long, checking with the API!\n", asset_name);
+        manifest_asset_name[0] = '\0';
+    }
+}
+
+void ESP32_OTA_Updater::setPeerNetwork(PeerNetwork *network)
+{
+    peer_network = network;
+}
+
+#ifdef ARDUINO
+bool ESP32_OTA_Updater::addDataPartition(const char *asset_name, const char *partition_label)
+{
+    if (component_count == ESP32_OTA_UPDATER_MAX_COMPONENTS)
+    {
+        return false;
+    }
+    PartitionWriter &writer = esp32_data_partitions[component_count];
+    writer.setPartition(partition_label);
+    return addComponent(asset_name, &writer);
+}
+
+bool ESP32_OTA_Updater::setCertificateStore(CertificateStore *store, const char *asset_name)
+{
+    if (asset_name != NULL && !addComponent(asset_name, store))
+    {
+        return false;
+    }
+    esp32_transport.setCertificateStore(store);
+    return true;
+}
+#endif
+
+void ESP32_OTA_Updater::setResumableDownloads(bool enabled)
+{
+    resumable_downloads = enabled;
+    if (!enabled && error != ESP32_OTA_Updater_Error::NOT_INITIALIZED)
+    {
+        clearResumeState(); // Before begin() the namespace is not known yet, begin() clears it then
+    }
+}
+
+void ESP32_OTA_Updater::setPipeline(uint8_t buffer_count, size_t buffer_size)
+{
+    pipeline_buffers = buffer_count;
+    pipeline_buffer_size = buffer_size;
+}
+
+void ESP32_OTA_Updater::setWorkBuffers(uint8_t *pipeline_storage, size_t pipeline_capacity, void *decompressor_workspace)
+{
+    flash_pipeline.setStorage(pipeline_storage, pipeline_capacity);
+    download_decompressor.setWorkspace(decompressor_workspace);
+}
+
+const FlashPipelineStats &ESP32_OTA_Updater::getPipelineStats() const
+{
+    return flash_pipeline.getStats();
+}
+
+void ESP32_OTA_Updater::setCheckInterval(unsigned long interval_ms)
+{
+    check_scheduler.setInterval(interval_ms);
+}
+
+void ESP32_OTA_Updater::setCheckJitter(unsigned long jitter_ms)
+{
+    check_scheduler.setJitter(jitter_ms);
+}
+
+void ESP32_OTA_Updater::setCheckBackoff(CheckScheduler::Failure failure, unsigned long base_ms, unsigned long max_ms)
+{
+    check_scheduler.setBackoff(failure, base_ms, max_ms);
+}
+
+unsigned long ESP32_OTA_Updater::getTimeUntilCheck() const
+{
+    return check_scheduler.getTimeUntilDue(rtcTimeMillis());
+}
+
+void ESP32_OTA_Updater::setDeviceId(const char *id)
+{
+    strncpy(device_id, id, ESP32_OTA_UPDATER_SHORTSTRING_LENGTH - 1);
+    device_id[ESP32_OTA_UPDATER_SHORTSTRING_LENGTH - 1] = '\0';
+}
+
+void ESP32_OTA_Updater::setStagedRollout(bool enabled)
+{
+    staged_rollout = enabled;
+}
+
+bool ESP32_OTA_Updater::setReleaseChannel(const char *spec)
+{
+    ReleaseChannel channel;
+    if (spec == NULL || strlen(spec) >= sizeof(channel_spec) || !channel.parse(spec))
+    {
+        OTA_LOGE("Invalid release channel \"%s\".\n", spec != NULL ? spec : "");
+        return false;
+    }
+    if (strcmp(spec, channel_spec) == 0)
+    {
+        return true;
+    }
+    release_channel = channel;
+    strcpy(channel_spec, spec);
+    // The cached result belongs to the previous channel, before begin() it is not loaded yet
+    check_cache_valid = false;
+    release_etag[0] = '\0';
+    if (error != ESP32_OTA_Updater_Error::NOT_INITIALIZED)
+    {
+        check_scheduler.expedite(rtcTimeMillis());
+    }
+    return true;
+}
+
+void ESP32_OTA_Updater::setCheckCachePersistent(bool persistent)
+{
+    check_cache_persistent = persistent;
+}
+
+void ESP32_OTA_Updater::clearCheckCache()
+{
+    check_cache_valid = false;
+    new_version_available = false;
+    latest_tag[0] = '\0';
+    release_etag[0] = '\0';
+    binary_download_url[0] = '\0';
+    binary_size = 0;
+    binary_digest_known = false;
+    patch_download_url[0] = '\0';
+    patch_size = 0;
+    signature_download_url[0] = '\0';
+    signature_size = 0;
+    rollout_percent = 100;
+    for (uint8_t i = 0; i < component_count; i++)
+    {
+        components[i].asset.found = false;
+    }
+    check_scheduler.expedite(rtcTimeMillis());
+
+    Preferences preferences;
+    char name[NVS_NAMESPACE_SIZE];
+    if (check_cache_persistent && preferences.begin(preferencesNamespace(ESP32_OTA_UPDATER_PREFERENCES_NAMESPACE, name), false))
+    {
+        preferences.clear();
+        preferences.end();
+    }
+}
+
+void ESP32_OTA_Updater::loadCheckCache()
+{
+    check_cache_valid = false;
+    if (!check_cache_persistent)
+    {
+        return;
+    }
+
+    Preferences preferences;
+    char name[NVS_NAMESPACE_SIZE];
+    if (!preferences.begin(preferencesNamespace(ESP32_OTA_UPDATER_PREFERENCES_NAMESPACE, name), true))
+    {
+        return; // Nothing stored yet
+    }
+
+    // Only use the cache if it belongs to the same repository, asset and running version
+    char source[5 * ESP32_OTA_UPDATER_SHORTSTRING_LENGTH + 16];
+    char stored_source[5 * ESP32_OTA_UPDATER_SHORTSTRING_LENGTH + 16];
+    char running_version[ESP32_OTA_UPDATER_SHORTSTRING_LENGTH];
+    snprintf(source, sizeof(source), "%s/%s/%s@%s#%s", repositry_owner, repositry_name, firmware_asset_path,
+             current_version.toString(running_version, sizeof(running_version)), channel_spec);
+    if (preferences.getString("source", stored_source, sizeof(stored_source)) > 0 && strcmp(source, stored_source) == 0 &&
+        preferences.getString("tag", latest_tag, sizeof(latest_tag)) > 0 &&
+        preferences.getString("etag", release_etag, sizeof(release_etag)) > 0)
+    {
+        if (preferences.getString("url", binary_download_url, sizeof(binary_download_url)) == 0)
+        {
+            binary_download_url[0] = '\0';
+        }
+        binary_size = preferences.getInt("size", 0);
+        binary_digest_known = preferences.getBytes("dig", binary_digest, RELEASE_ASSET_DIGEST_SIZE) == RELEASE_ASSET_DIGEST_SIZE;
+        if (preferences.getString("purl", patch_download_url, sizeof(patch_download_url)) == 0)
+        {
+            patch_download_url[0] = '\0';
+        }
+        patch_size = preferences.getInt("psize", 0);
+        if (preferences.getString("surl", signature_download_url, sizeof(signature_download_url)) == 0)
+        {
+            signature_download_url[0] = '\0';
+        }
+        signature_size = preferences.getInt("ssize", 0);
+        rollout_percent = preferences.getUInt("roll", 100);
+        for (uint8_t i = 0; i < component_count; i++)
+        {
+            ReleaseAsset &asset = components[i].asset;
+            char key[12];
+            snprintf(key, sizeof(key), "c%uurl", i);
+            asset.found = preferences.getString(key, asset.url, sizeof(asset.url)) > 0;
+            snprintf(key, sizeof(key), "c%usize", i);
+            asset.size = preferences.getInt(key, 0);
+            snprintf(key, sizeof(key), "c%udig", i);
+            asset.has_digest = preferences.getBytes(key, asset.digest, RELEASE_ASSET_DIGEST_SIZE) == RELEASE_ASSET_DIGEST_SIZE;
+        }
+        check_cache_valid = true;
+        OTA_LOGD("Loaded cached release %s.\n", latest_tag);
+    }
+    else
+    {
+        latest_tag[0] = '\0';
+        release_etag[0] = '\0';
+    }
+    preferences.end();
+}
+
+const char *ESP32_OTA_Updater::preferencesNamespace(const char *prefix, char *name) const
+{
+    snprintf(name, NVS_NAMESPACE_SIZE, "%s%08x", prefix, (unsigned int)source_crc);
+    return name;
+}
+
+void ESP32_OTA_Updater::storeCheckCache()
+{
+    if (!check_cache_persistent || release_etag[0] == '\0')
+    {
+        return;
+    }
+
+    Preferences preferences;
+    char name[NVS_NAMESPACE_SIZE];
+    if (!preferences.begin(preferencesNamespace(ESP32_OTA_UPDATER_PREFERENCES_NAMESPACE, name), false))
+    {
+        OTA_LOGE("Failed to open NVS namespace, release check cache is not persisted.\n");
+        return;
+    }
+    char source[5 * ESP32_OTA_UPDATER_SHORTSTRING_LENGTH + 16];
+    char running_version[ESP32_OTA_UPDATER_SHORTSTRING_LENGTH];
+    snprintf(source, sizeof(source), "%s/%s/%s@%s#%s", repositry_owner, repositry_name, firmware_asset_path,
+             current_version.toString(running_version, sizeof(running_version)), channel_spec);
+    preferences.putString("source", source);
+    preferences.putString("tag", latest_tag);
+    preferences.putString("etag", release_etag);
+    preferences.putString("url", binary_download_url);
+    preferences.putInt("size", binary_size);
+    if (binary_digest_known)
+    {
+        preferences.putBytes("dig", binary_digest, RELEASE_ASSET_DIGEST_SIZE);
+    }
+    else
+    {
+        preferences.remove("dig");
+    }
+    preferences.putString("purl", patch_download_url);
+    preferences.putInt("psize", patch_size);
+    preferences.putString("surl", signature_download_url);
+    preferences.putInt("ssize", signature_size);
+    preferences.putUInt("roll", rollout_percent);
+    for (uint8_t i = 0; i < component_count; i++)
+    {
+        const ReleaseAsset &asset = components[i].asset;
+        char key[12];
+        snprintf(key, sizeof(key), "c%uurl", i);
+        preferences.putString(key, asset.found ? asset.url : "");
+        snprintf(key, sizeof(key), "c%usize", i);
+        preferences.putInt(key, asset.size);
+        snprintf(key, sizeof(key), "c%udig", i);
+        if (asset.found && asset.has_digest)
+        {
+            preferences.putBytes(key, asset.digest, RELEASE_ASSET_DIGEST_SIZE);
+        }
+        else
+        {
+            preferences.remove(key);
+        }
+    }
+    preferences.end();
+}
+
+bool ESP32_OTA_Updater::loadResumeState(const char *url, int size, uint32_t *offset, uint32_t *crc, uint8_t *head)
+{
+    Preferences preferences;
+    char name[NVS_NAMESPACE_SIZE];
+    if (!resumable_downloads || !preferences.begin(preferencesNamespace(ESP32_OTA_UPDATER_RESUME_NAMESPACE, name), true))
+    {
+        return false; // Nothing recorded yet
+    }
+
+    // Only resume the same asset, a new release has another URL
+    char stored_url[ESP32_OTA_UPDATER_LONGSTRING_LENGTH];
+    const bool recorded = preferences.getString("url", stored_url, sizeof(stored_url)) > 0;
+    const bool found = recorded && strcmp(url, stored_url) == 0 && preferences.getInt("size", 0) == size &&
+                       preferences.getBytes("head", head, FIRMWARE_SINK_HEAD_SIZE) == FIRMWARE_SINK_HEAD_SIZE;
+    if (found)
+    {
+        *offset = preferences.getUInt("offset", 0);
+        *crc = preferences.getUInt("crc", 0);
+    }
+    preferences.end();
+    if (recorded && !found)
+    {
+        clearResumeState();
+    }
+    return found && *offset > 0 && *offset < (uint32_t)size;
+}
+
+void ESP32_OTA_Updater::storeResumeState(uint32_t committed, uint32_t crc)
+{
+    Preferences preferences;
+    char name[NVS_NAMESPACE_SIZE];
+    if (!preferences.begin(preferencesNamespace(ESP32_OTA_UPDATER_RESUME_NAMESPACE, name), false))
+    {
+        OTA_LOGE("Failed to open NVS namespace, download progress is not persisted.\n");
+        return;
+    }
+    preferences.putString("url", binary_download_url);
+    preferences.putInt("size", binary_size);
+    preferences.putBytes("head", firmware_sink->getHead(), FIRMWARE_SINK_HEAD_SIZE);
+    preferences.putUInt("offset", committed);
+    preferences.putUInt("crc", crc);
+    preferences.end();
+}
+
+void ESP32_OTA_Updater::clearResumeState()
+{
+    Preferences preferences;
+    char name[NVS_NAMESPACE_SIZE];
+    if (preferences.begin(preferencesNamespace(ESP32_OTA_UPDATER_RESUME_NAMESPACE, name), false))
+    {
+        preferences.clear();
+        preferences.end();
+    }
+}
+
+bool ESP32_OTA_Updater::isComponentInstalled(const Component &component)
+{
+    if (!component.asset.has_digest)
+    {
+        return false; // Without a digest the installed asset can not be compared
+    }
+    Preferences preferences;
+    char name[NVS_NAMESPACE_SIZE];
+    if (!preferences.begin(preferencesNamespace(ESP32_OTA_UPDATER_COMPONENTS_NAMESPACE, name), true))
+    {
+        return false; // Nothing installed yet
+    }
+    // NVS keys are limited to 15 characters, so the asset is identified by the CRC32 of its name
+    char key[12];
+    snprintf(key, sizeof(key), "%08x", (unsigned int)Crc32::update(0, (const uint8_t *)component.asset.name, strlen(component.asset.name)));
+    uint8_t installed[RELEASE_ASSET_DIGEST_SIZE];
+    const bool stored = preferences.getBytes(key, installed, RELEASE_ASSET_DIGEST_SIZE) == RELEASE_ASSET_DIGEST_SIZE;
+    preferences.end();
+    return stored && memcmp(installed, component.asset.digest, RELEASE_ASSET_DIGEST_SIZE) == 0;
+}
+
+void ESP32_OTA_Updater::storeInstalledComponent(const Component &component)
+{
+    Preferences preferences;
+    char name[NVS_NAMESPACE_SIZE];
+    if (!preferences.begin(preferencesNamespace(ESP32_OTA_UPDATER_COMPONENTS_NAMESPACE, name), false))
+    {
+        OTA_LOGE("Failed to open NVS namespace, %s is installed again with the next update.\n", component.asset.name);
+        return;
+    }
+    char key[12];
+    snprintf(key, sizeof(key), "%08x", (unsigned int)Crc32::update(0, (const uint8_t *)component.asset.name, strlen(component.asset.name)));
+    if (component.asset.has_digest)
+    {
+        preferences.putBytes(key, component.asset.digest, RELEASE_ASSET_DIGEST_SIZE);
+    }
+    else
+    {
+        preferences.remove(key);
+    }
+    preferences.end();
+}
+
+void ESP32_OTA_Updater::offerInstalledImage()
+{
+    Preferences preferences;
+    char name[NVS_NAMESPACE_SIZE];
+    if (peer_network == NULL || running_image == NULL || !preferences.begin(preferencesNamespace(ESP32_OTA_UPDATER_PEER_NAMESPACE, name), true))
+    {
+        return; // No image installed by an update yet
+    }
+    PeerImage image;
+    const bool stored = preferences.getString("tag", image.tag, sizeof(image.tag)) > 0 &&
+                        preferences.getBytes("digest", image.digest, PEER_IMAGE_DIGEST_SIZE) == PEER_IMAGE_DIGEST_SIZE;
+    image.size = preferences.getUInt("size", 0);
+    preferences.end();
+
+    // After a rollback the running partition holds another image than the one installed last
+    if (stored && Version(image.tag) == current_version && image.size > 0 && image.size <= running_image->getSize())
+    {
+        OTA_LOGI("Offering the image of release %s to peers.\n", image.tag);
+        peer_network->offer(image, running_image);
+    }
+}
+
+void ESP32_OTA_Updater::storeInstalledImage(uint32_t size)
+{
+    Preferences preferences;
+    char name[NVS_NAMESPACE_SIZE];
+    if (!preferences.begin(preferencesNamespace(ESP32_OTA_UPDATER_PEER_NAMESPACE, name), false))
+    {
+        OTA_LOGE("Failed to open NVS namespace, the image is not offered to peers.\n");
+        return;
+    }
+    preferences.putString("tag", latest_tag);
+    preferences.putBytes("digest", image_verifier.getExpectedDigest(), PEER_IMAGE_DIGEST_SIZE);
+    preferences.putUInt("size", size);
+    preferences.end();
+}
+
+void ESP32_OTA_Updater::reboot()
+{
+    OTA_LOGI("Rebooting.\n");
+    ESP.restart();
+}
+
+ESP32_OTA_Updater_Error ESP32_OTA_Updater::getErrorCode()
+{
+    return error;
+}
+
+String ESP32_OTA_Updater::getErrorDescription()
+{
+    return String(getErrorMessage());
+}
+
+const char *ESP32_OTA_Updater::getErrorMessage() const
+{
+    return describe(error);
+}
+
+const char *ESP32_OTA_Updater::describe(ESP32_OTA_Updater_Error error)
+{
+    return error < sizeof(error_messages) / sizeof(error_messages[0]) ? error_messages[error] : "Unknown error";
 }
 
 void ESP32_OTA_Updater::debugf(const char *format, ...)
 {
-    if (debugPrinter != NULL)
+    if (ESP32_OTA_UPDATER_LOG_LEVEL > ESP32_OTA_UPDATER_LOG_NONE && debugPrinter != NULL)
     {
         const int len = 150;
         char buffer[len];
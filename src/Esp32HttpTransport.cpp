@@ -0,0 +1,380 @@
+#include "Esp32HttpTransport.h"
+
+#ifdef ARDUINO
+
+static String hostOf(const String &url)
+{
+    const int host_start = url.indexOf("://") + 3;
+    const int host_end = url.indexOf('/', host_start);
+    return host_end < 0 ? url.substring(host_start) : url.substring(host_start, host_end);
+}
+
+static bool isRedirect(int code)
+{
+    return code == 301 || code == 302 || code == 303 || code == 307 || code == 308;
+}
+
+void Esp32HttpTransport::setCACert(const char *root_certificate)
+{
+    this->root_certificate = root_certificate;
+    for (Connection &connection : connections)
+    {
+        connection.secure_client.setCACert(root_certificate);
+    }
+}
+
+bool Esp32HttpTransport::begin(const char *url)
+{
+    finishResponse();
+    this->url = url;
+    header_count = 0;
+    authorization = "";
+    collect_names[0] = "Location";
+    collect_names[1] = "Transfer-Encoding";
+    collect_count = 2;
+    return this->url.startsWith("https://") || this->url.startsWith("http://");
+}
+
+void Esp32HttpTransport::addHeader(const char *name, const char *value)
+{
+    if (header_count < ESP32_HTTP_TRANSPORT_MAX_HEADERS)
+    {
+        header_names[header_count] = name;
+        header_values[header_count] = value;
+        header_count++;
+    }
+}
+
+void Esp32HttpTransport::setAuthorization(const char *token)
+{
+    authorization = token;
+}
+
+void Esp32HttpTransport::collectHeaders(const char *names[], size_t count)
+{
+    collect_count = 2;
+    for (size_t i = 0; i < count && collect_count < ESP32_HTTP_TRANSPORT_MAX_HEADERS + 2; i++)
+    {
+        collect_names[collect_count++] = names[i];
+    }
+}
+
+int Esp32HttpTransport::GET()
+{
+    memset(&timing, 0, sizeof(timing));
+    const String origin = hostOf(url);
+    for (uint8_t redirects = 0;; redirects++)
+    {
+        const String host = hostOf(url);
+        Connection *connection = connectionFor(host);
+        if (connection == nullptr)
+        {
+            return HTTPC_ERROR_CONNECTION_REFUSED;
+        }
+        const bool authorize = host == origin; // Like curl, the token is not passed on to e.g. the asset server
+        const bool reused = connection->client->connected();
+        int code = sendRequest(connection, authorize);
+        if (code < 0 && reused)
+        {
+            // The server closed the idle connection in the meantime
+            connection->client->stop();
+            timing.retries++;
+            code = sendRequest(connection, authorize);
+        }
+
+        beginResponse(connection, code);
+        timing.redirects = redirects;
+
+        if (!isRedirect(code) || redirects >= ESP32_OTA_UPDATER_HTTP_MAX_REDIRECTS)
+        {
+            return code;
+        }
+        const String location = connection->http.header("Location");
+        finishResponse(); // Keeps the connection for the next request to this host
+        if (location.length() == 0)
+        {
+            return code;
+        }
+        url = location.startsWith("/") ? url.substring(0, url.indexOf("://") + 3) + host + location : location;
+    }
+}
+
+int Esp32HttpTransport::POST(const uint8_t *body, size_t length)
+{
+    memset(&timing, 0, sizeof(timing));
+    Connection *connection = connectionFor(hostOf(url));
+    if (connection == nullptr)
+    {
+        return HTTPC_ERROR_CONNECTION_REFUSED;
+    }
+    const bool reused = connection->client->connected();
+    int code = sendRequest(connection, true, body, length);
+    if (code < 0 && reused)
+    {
+        connection->client->stop();
+        timing.retries++;
+        code = sendRequest(connection, true, body, length);
+    }
+    beginResponse(connection, code);
+    return code;
+}
+
+void Esp32HttpTransport::beginResponse(Connection *connection, int code)
+{
+    active = connection;
+    content_length = code > 0 ? connection->http.getSize() : 0;
+    chunked = connection->http.header("Transfer-Encoding").equalsIgnoreCase("chunked");
+    body_read = 0;
+    chunk_remaining = 0;
+    body_complete = code <= 0 || code == 204 || code == 304 || content_length == 0;
+}
+
+int Esp32HttpTransport::sendRequest(Connection *connection, bool authorize, const uint8_t *body, size_t length)
+{
+    const bool reused = connection->client->connected();
+    timing.reused = reused;
+    if (!reused && url.startsWith("https://") && !connect(connection, hostOf(url)))
+    {
+        return HTTPC_ERROR_CONNECTION_REFUSED;
+    }
+    if (!connection->http.begin(*connection->client, url))
+    {
+        return HTTPC_ERROR_CONNECTION_REFUSED;
+    }
+    connection->http.setReuse(true);
+    connection->http.setTimeout(ESP32_OTA_UPDATER_HTTP_TIMEOUT);
+    connection->http.setFollowRedirects(HTTPC_DISABLE_FOLLOW_REDIRECTS);
+    connection->http.setUserAgent(http_useragent);
+    for (uint8_t i = 0; i < header_count; i++)
+    {
+        connection->http.addHeader(header_names[i], header_values[i]);
+    }
+    connection->http.setAuthorizationType("Bearer");
+    connection->http.setAuthorization(authorize ? authorization.c_str() : ""); // The HTTPClient keeps it between requests
+    connection->http.collectHeaders(collect_names, collect_count);
+
+    // HTTPClient reuses the connected client, so this only covers sending the request and waiting for the response
+    const unsigned long request_start = millis();
+    const int code = body != NULL ? connection->http.POST((uint8_t *)body, length) : connection->http.GET();
+    timing.ttfb_ms += millis() - request_start;
+    connection->last_used = millis();
+    return code;
+}
+
+bool Esp32HttpTransport::connect(Connection *connection, const String &host)
+{
+    // The connection is opened before HTTPClient sees it, to time the name lookup and the TLS handshake separately
+    const int port_start = host.indexOf(':');
+    const String name = port_start < 0 ? host : host.substring(0, port_start);
+    const uint16_t port = port_start < 0 ? 443 : host.substring(port_start + 1).toInt();
+
+    unsigned long start = millis();
+    IPAddress address;
+    const bool resolved = WiFi.hostByName(name.c_str(), address) == 1;
+    timing.dns_ms += millis() - start;
+    if (!resolved)
+    {
+        return false;
+    }
+    if (connection->client == &connection->secure_client)
+    {
+        applyTrustAnchors(connection->secure_client);
+    }
+    start = millis();
+    const bool connected = connection->client->connect(name.c_str(), port) == 1; // Resolved from the DNS cache of lwIP
+    timing.connect_ms += millis() - start;
+    handshake_count++;
+    return connected;
+}
+
+void Esp32HttpTransport::applyTrustAnchors(WiFiClientSecure &client)
+{
+    if (certificate_store == nullptr || !certificate_store->hasBundle())
+    {
+        client.setCACert(root_certificate);
+        return;
+    }
+    // The ssl client prefers PEM certificates over the bundle, whose verify callback only parses the anchor of the chain
+    client.setCACert(NULL);
+#if defined(ESP_ARDUINO_VERSION_MAJOR) && ESP_ARDUINO_VERSION_MAJOR >= 3
+    client.setCACertBundle(certificate_store->getBundle(), certificate_store->getBundleSize());
+#else
+    client.setCACertBundle(certificate_store->getBundle());
+#endif
+}
+
+Esp32HttpTransport::Connection *Esp32HttpTransport::connectionFor(const String &host)
+{
+    if (host.length() >= sizeof(connections[0].host))
+    {
+        return nullptr; // Connections are told apart by their host, a truncated one could match another host
+    }
+    Connection *least_recently_used = &connections[0];
+    for (Connection &connection : connections)
+    {
+        if (host == connection.host)
+        {
+            return &connection;
+        }
+        if (connection.host[0] == '\0' || (least_recently_used->host[0] != '\0' && connection.last_used < least_recently_used->last_used))
+        {
+            least_recently_used = &connection;
+        }
+    }
+    // A connection is only ever used for one host, HTTPClient reuses an open connection regardless of the host
+    least_recently_used->http.end();
+    least_recently_used->client->stop();
+    if (url.startsWith("https://"))
+    {
+        least_recently_used->client = &least_recently_used->secure_client;
+    }
+    else
+    {
+        least_recently_used->client = &least_recently_used->plain_client; // E.g. a peer on the local network
+    }
+    memcpy(least_recently_used->host, host.c_str(), host.length() + 1);
+    return least_recently_used;
+}
+
+int Esp32HttpTransport::getSize()
+{
+    return chunked ? -1 : content_length;
+}
+
+void Esp32HttpTransport::getHeader(const char *name, char *value, size_t capacity)
+{
+    value[0] = '\0';
+    if (active != nullptr)
+    {
+        const String header = active->http.header(name);
+        if (header.length() < capacity)
+        {
+            memcpy(value, header.c_str(), header.length() + 1);
+        }
+    }
+}
+
+int Esp32HttpTransport::available()
+{
+    if (active == nullptr || body_complete)
+    {
+        return 0;
+    }
+    // Chunked bodies also count the chunk headers, read() takes at most this many data bytes anyway
+    const int buffered = active->client->available();
+    if (!chunked && content_length >= 0 && buffered > (int)(content_length - body_read))
+    {
+        return content_length - body_read;
+    }
+    return buffered;
+}
+
+bool Esp32HttpTransport::connected()
+{
+    return active != nullptr && !body_complete && active->client->connected();
+}
+
+size_t Esp32HttpTransport::read(uint8_t *buffer, size_t size)
+{
+    if (active == nullptr || body_complete)
+    {
+        return 0;
+    }
+    WiFiClient *stream = active->client;
+    if (!chunked)
+    {
+        if (content_length >= 0 && size > content_length - body_read)
+        {
+            size = content_length - body_read;
+        }
+        const size_t received = stream->readBytes(buffer, size);
+        body_read += received;
+        body_complete = content_length >= 0 && body_read == (uint32_t)content_length;
+        return received;
+    }
+
+    size_t received = 0;
+    while (received < size && !body_complete)
+    {
+        if (chunk_remaining == 0)
+        {
+            if (!readChunkHeader(stream))
+            {
+                break;
+            }
+            continue;
+        }
+        const size_t part = size - received < chunk_remaining ? size - received : chunk_remaining;
+        const size_t chunk = stream->readBytes(buffer + received, part);
+        received += chunk;
+        chunk_remaining -= chunk;
+        body_read += chunk;
+        if (chunk < part)
+        {
+            break; // Timeout
+        }
+    }
+    return received;
+}
+
+bool Esp32HttpTransport::readChunkHeader(WiFiClient *stream)
+{
+    // Every chunk after the first one starts with the line break ending the data of the previous chunk
+    String line = stream->readStringUntil('\n');
+    line.trim();
+    if (line.length() == 0)
+    {
+        line = stream->readStringUntil('\n');
+        line.trim();
+    }
+    if (line.length() == 0)
+    {
+        return false; // Timeout
+    }
+    chunk_remaining = strtoul(line.c_str(), NULL, 16); // Stops at chunk extensions
+    if (chunk_remaining == 0)
+    {
+        // Last chunk, skip the trailer up to the empty line
+        while (stream->readStringUntil('\n').length() > 1)
+        {
+        }
+        body_complete = true;
+    }
+    return true;
+}
+
+void Esp32HttpTransport::end()
+{
+    finishResponse();
+}
+
+void Esp32HttpTransport::finishResponse()
+{
+    if (active == nullptr)
+    {
+        return;
+    }
+    // A short rest of the body is cheaper to receive than a new TLS handshake
+    if (!body_complete && (chunked || (content_length >= 0 && content_length - body_read <= ESP32_OTA_UPDATER_HTTP_DRAIN_LIMIT)))
+    {
+        uint8_t scratch[128];
+        for (uint32_t drained = 0; !body_complete && drained < ESP32_OTA_UPDATER_HTTP_DRAIN_LIMIT;)
+        {
+            const size_t received = read(scratch, sizeof(scratch));
+            if (received == 0)
+            {
+                break;
+            }
+            drained += received;
+        }
+    }
+    if (!body_complete)
+    {
+        active->client->stop(); // The rest of the body would be taken as the next response
+    }
+    active->http.end(); // Keeps the connection open if the server allows it
+    active = nullptr;
+    body_complete = true;
+}
+
+#endif // ARDUINO
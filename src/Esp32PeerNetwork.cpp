@@ -0,0 +1,215 @@
+#include "Esp32PeerNetwork.h"
+
+#ifdef ARDUINO
+
+#define PEER_MESSAGE_LENGTH (ESP32_OTA_UPDATER_SHORTSTRING_LENGTH + 2 * PEER_IMAGE_DIGEST_SIZE + 32) /**< Capacity of a discovery datagram. */
+
+/*
+ * Parses a discovery datagram, "OTAPEER? <tag> <digest>" (kind '?') or "OTAPEER! <tag> <digest> <size> <port>"
+ * (kind '!'). The message is modified.
+ */
+static bool parseMessage(char *message, char kind, PeerImage *image, uint16_t *port)
+{
+    char *position = NULL;
+    const char *magic = strtok_r(message, " \r\n", &position);
+    const char *tag = strtok_r(NULL, " \r\n", &position);
+    const char *digest = strtok_r(NULL, " \r\n", &position);
+    if (magic == NULL || strlen(magic) != 8 || strncmp(magic, "OTAPEER", 7) != 0 || magic[7] != kind || tag == NULL ||
+        strlen(tag) >= sizeof(image->tag) || digest == NULL || !image->parseDigest(digest))
+    {
+        return false;
+    }
+    strcpy(image->tag, tag);
+    image->size = 0;
+    if (kind == '?')
+    {
+        return true;
+    }
+    const char *size = strtok_r(NULL, " \r\n", &position);
+    const char *server_port = strtok_r(NULL, " \r\n", &position);
+    if (size == NULL || server_port == NULL)
+    {
+        return false;
+    }
+    image->size = strtoul(size, NULL, 10);
+    *port = (uint16_t)strtoul(server_port, NULL, 10);
+    return image->size > 0 && *port > 0;
+}
+
+Esp32PeerNetwork::Esp32PeerNetwork(uint16_t port) : port(port), server(port)
+{
+}
+
+void Esp32PeerNetwork::offer(const PeerImage &image, ByteSource *source)
+{
+    closeClient(); // A peer receiving the previous image would get a mix of both
+    offered = image;
+    this->source = source;
+}
+
+bool Esp32PeerNetwork::find(PeerImage *image, char *url, size_t capacity)
+{
+    if (!start())
+    {
+        return false;
+    }
+    char hex[2 * PEER_IMAGE_DIGEST_SIZE + 1];
+    image->formatDigest(hex);
+    char query[PEER_MESSAGE_LENGTH];
+    const int query_length = snprintf(query, sizeof(query), "OTAPEER? %s %s", image->tag, hex);
+
+    const unsigned long start_ms = millis();
+    for (uint8_t sent_queries = 0; millis() - start_ms < ESP32_OTA_UPDATER_PEER_QUERY_TIMEOUT;)
+    {
+        // Broadcasts are not acknowledged, the query is repeated halfway in case it was lost
+        if (sent_queries < 2 && millis() - start_ms >= sent_queries * (ESP32_OTA_UPDATER_PEER_QUERY_TIMEOUT / 2))
+        {
+            udp.beginPacket(IPAddress(255, 255, 255, 255), port);
+            udp.write((const uint8_t *)query, query_length);
+            udp.endPacket();
+            sent_queries++;
+        }
+        if (udp.parsePacket() <= 0)
+        {
+            delay(5);
+            continue;
+        }
+        char answer[PEER_MESSAGE_LENGTH];
+        const int length = udp.read(answer, sizeof(answer) - 1);
+        answer[length > 0 ? length : 0] = '\0';
+        PeerImage offered_image;
+        uint16_t server_port = 0;
+        if (parseMessage(answer, '!', &offered_image, &server_port) && offered_image.matches(*image))
+        {
+            image->size = offered_image.size;
+            snprintf(url, capacity, "http://%s:%u/ota/%s", udp.remoteIP().toString().c_str(), server_port, hex);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Esp32PeerNetwork::handle()
+{
+    if (source == nullptr || !start())
+    {
+        return false;
+    }
+    answerQueries();
+    if (!client.connected())
+    {
+        closeClient();
+        client = server.available();
+        if (!client)
+        {
+            return false;
+        }
+        last_activity = millis();
+    }
+    if (!responding && !readRequest())
+    {
+        if (millis() - last_activity > ESP32_OTA_UPDATER_HTTP_TIMEOUT)
+        {
+            closeClient();
+        }
+        return false;
+    }
+    return serveSlice();
+}
+
+bool Esp32PeerNetwork::start()
+{
+    if (!started && WiFi.status() == WL_CONNECTED && udp.begin(port) == 1)
+    {
+        server.begin(port);
+        started = true;
+    }
+    return started;
+}
+
+void Esp32PeerNetwork::answerQueries()
+{
+    char hex[2 * PEER_IMAGE_DIGEST_SIZE + 1];
+    offered.formatDigest(hex);
+    while (udp.parsePacket() > 0)
+    {
+        char query[PEER_MESSAGE_LENGTH];
+        const int length = udp.read(query, sizeof(query) - 1);
+        query[length > 0 ? length : 0] = '\0';
+        PeerImage wanted;
+        uint16_t unused;
+        if (!parseMessage(query, '?', &wanted, &unused) || !wanted.matches(offered))
+        {
+            continue;
+        }
+        char answer[PEER_MESSAGE_LENGTH];
+        const int answer_length = snprintf(answer, sizeof(answer), "OTAPEER! %s %s %u %u", offered.tag, hex, offered.size, port);
+        udp.beginPacket(udp.remoteIP(), udp.remotePort());
+        udp.write((const uint8_t *)answer, answer_length);
+        udp.endPacket();
+    }
+}
+
+bool Esp32PeerNetwork::readRequest()
+{
+    if (client.available() <= 0)
+    {
+        return false;
+    }
+    char hex[2 * PEER_IMAGE_DIGEST_SIZE + 1];
+    offered.formatDigest(hex);
+    char expected[2 * PEER_IMAGE_DIGEST_SIZE + 16];
+    snprintf(expected, sizeof(expected), "GET /ota/%s ", hex);
+    const String request_line = client.readStringUntil('\n');
+    // The request headers are not needed, they are skipped up to the empty line
+    while (client.connected() && client.readStringUntil('\n').length() > 1)
+    {
+    }
+    if (!request_line.startsWith(expected))
+    {
+        client.print("HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+        closeClient();
+        return false;
+    }
+    client.printf("HTTP/1.1 200 OK\r\nContent-Type: application/octet-stream\r\nContent-Length: %u\r\nConnection: close\r\n\r\n",
+                  offered.size);
+    responding = true;
+    sent = 0;
+    last_activity = millis();
+    return true;
+}
+
+bool Esp32PeerNetwork::serveSlice()
+{
+    uint8_t buffer[ESP32_OTA_UPDATER_POLL_SLICE_SIZE];
+    for (uint32_t slice = 0; slice < ESP32_OTA_UPDATER_PEER_SLICE_SIZE && sent < offered.size;)
+    {
+        const size_t length = offered.size - sent < sizeof(buffer) ? offered.size - sent : sizeof(buffer);
+        if (!source->read(sent, buffer, length) || client.write(buffer, length) != length)
+        {
+            closeClient();
+            return false;
+        }
+        sent += length;
+        slice += length;
+    }
+    last_activity = millis();
+    if (sent == offered.size)
+    {
+        closeClient(); // Closing sends the rest of the data, the response announced it
+        return false;
+    }
+    return true;
+}
+
+void Esp32PeerNetwork::closeClient()
+{
+    if (client)
+    {
+        client.stop();
+    }
+    responding = false;
+    sent = 0;
+}
+
+#endif // ARDUINO
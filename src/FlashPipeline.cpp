@@ -0,0 +1,276 @@
+#include "FlashPipeline.h"
+#include <stdlib.h>
+#include <string.h>
+
+void FlashPipeline::begin(FirmwareSink *writer, uint8_t buffer_count, size_t buffer_size)
+{
+    end();
+    this->writer = writer;
+    this->buffer_size = buffer_size;
+    memset(&stats, 0, sizeof(stats));
+    failed = false;
+    discard = false;
+    stopping = false;
+    writer_hung = false;
+    waiting = false;
+    committed = writer->getCommitted();
+    committed_crc = writer->getCommittedCrc();
+
+    if (portNUM_PROCESSORS < 2 || buffer_count == 0 || buffer_size == 0)
+    {
+        return; // Synchronous writes
+    }
+    buffers = storage != nullptr && buffer_count * buffer_size <= storage_capacity ? storage : (uint8_t *)malloc(buffer_count * buffer_size);
+    free_queue = xQueueCreate(buffer_count, sizeof(uint8_t *));
+    full_queue = xQueueCreate(buffer_count + 1, sizeof(Block)); // One more for a control block
+    done = xSemaphoreCreateBinary();
+    if (buffers != NULL && free_queue != NULL && full_queue != NULL && done != NULL)
+    {
+        for (uint8_t i = 0; i < buffer_count; i++)
+        {
+            uint8_t *buffer = buffers + i * buffer_size;
+            xQueueSend(free_queue, &buffer, 0);
+        }
+        // The flash writer runs on the other core than the download
+        const BaseType_t core = xPortGetCoreID() == 0 ? 1 : 0;
+        if (xTaskCreatePinnedToCore(writerTask, "ota_flash", ESP32_OTA_UPDATER_PIPELINE_TASK_STACK_SIZE, this, 2, &task_handle, core) == pdPASS)
+        {
+            return;
+        }
+        task_handle = NULL;
+    }
+    end(); // Not enough memory, write synchronously
+}
+
+void FlashPipeline::setStorage(uint8_t *storage, size_t capacity)
+{
+    end();
+    this->storage = storage;
+    storage_capacity = storage != nullptr ? capacity : 0;
+}
+
+bool FlashPipeline::write(const uint8_t *data, size_t length)
+{
+    stats.bytes_written += length;
+    if (task_handle == NULL)
+    {
+        const unsigned long start = micros();
+        const bool written = writer->write(data, length);
+        stats.flash_us += micros() - start;
+        if (!written)
+        {
+            return false;
+        }
+        committed = writer->getCommitted();
+        committed_crc = writer->getCommittedCrc();
+        return true;
+    }
+
+    while (length > 0)
+    {
+        if (failed)
+        {
+            return false;
+        }
+        if (current == NULL)
+        {
+            if (xQueueReceive(free_queue, &current, 0) != pdTRUE)
+            {
+                // All buffers are waiting for the flash
+                const unsigned long stall_start = millis();
+                const bool freed = xQueueReceive(free_queue, &current, pdMS_TO_TICKS(ESP32_OTA_UPDATER_PIPELINE_WRITE_TIMEOUT)) == pdTRUE;
+                stats.reader_stalls++;
+                stats.reader_stall_ms += millis() - stall_start;
+                if (!freed)
+                {
+                    current = nullptr;
+                    failed = true;
+                    writer_hung = true; // The flash hangs, the writer task is deleted by end()
+                    return false;
+                }
+            }
+            current_length = 0;
+        }
+        size_t chunk = buffer_size - current_length;
+        chunk = chunk < length ? chunk : length;
+        memcpy(current + current_length, data, chunk);
+        current_length += chunk;
+        data += chunk;
+        length -= chunk;
+        if (current_length == buffer_size)
+        {
+            sendCurrent();
+        }
+    }
+    return !failed;
+}
+
+bool FlashPipeline::canWrite(size_t length)
+{
+    if (task_handle == NULL || failed)
+    {
+        return true;
+    }
+    const size_t room = (current != NULL ? buffer_size - current_length : 0) + uxQueueMessagesWaiting(free_queue) * buffer_size;
+    if (room >= length)
+    {
+        if (waiting)
+        {
+            waiting = false;
+            stats.reader_stalls++;
+            stats.reader_stall_ms += millis() - waiting_since;
+        }
+        return true;
+    }
+    if (!waiting)
+    {
+        waiting = true;
+        waiting_since = millis();
+    }
+    else if (millis() - waiting_since > ESP32_OTA_UPDATER_PIPELINE_WRITE_TIMEOUT)
+    {
+        failed = true;
+        writer_hung = true; // The flash hangs, write() fails and end() deletes the writer task
+        return true;
+    }
+    return false;
+}
+
+bool FlashPipeline::flush()
+{
+    if (task_handle == NULL)
+    {
+        return true;
+    }
+    if (current != NULL && current_length > 0)
+    {
+        sendCurrent();
+    }
+    // Blocks are written in order, so all data is written once the control block is acknowledged
+    if (!sendControl())
+    {
+        failed = true;
+        writer_hung = true;
+    }
+    return !failed;
+}
+
+void FlashPipeline::end()
+{
+    if (task_handle != NULL)
+    {
+        discard = true;
+        stopping = true;
+        // The task deletes itself after the acknowledgement, unless it hangs in the firmware sink
+        if (writer_hung || !sendControl())
+        {
+            vTaskDelete(task_handle);
+        }
+        task_handle = NULL;
+    }
+    if (free_queue != NULL)
+    {
+        vQueueDelete(free_queue);
+        free_queue = NULL;
+    }
+    if (full_queue != NULL)
+    {
+        vQueueDelete(full_queue);
+        full_queue = NULL;
+    }
+    if (done != NULL)
+    {
+        vSemaphoreDelete(done);
+        done = NULL;
+    }
+    if (buffers != storage)
+    {
+        free(buffers);
+    }
+    buffers = nullptr;
+    current = nullptr;
+    current_length = 0;
+}
+
+void FlashPipeline::getCommitted(uint32_t *committed, uint32_t *crc)
+{
+    portENTER_CRITICAL(&snapshot_lock);
+    *committed = this->committed;
+    *crc = committed_crc;
+    portEXIT_CRITICAL(&snapshot_lock);
+}
+
+void FlashPipeline::sendCurrent()
+{
+    const Block block = {current, current_length};
+    xQueueSend(full_queue, &block, portMAX_DELAY); // Never blocks, there are more slots than buffers
+    current = nullptr;
+    current_length = 0;
+}
+
+bool FlashPipeline::sendControl()
+{
+    const Block block = {NULL, 0};
+    return xQueueSend(full_queue, &block, 0) == pdTRUE && // There is a slot more than buffers
+           xSemaphoreTake(done, pdMS_TO_TICKS(ESP32_OTA_UPDATER_PIPELINE_WRITE_TIMEOUT)) == pdTRUE;
+}
+
+void FlashPipeline::writeBlock(const Block &block)
+{
+    if (discard || failed)
+    {
+        return;
+    }
+    const unsigned long start = micros();
+    const bool written = writer->write(block.data, block.length);
+    stats.flash_us += micros() - start;
+    if (!written)
+    {
+        failed = true;
+        return;
+    }
+    portENTER_CRITICAL(&snapshot_lock);
+    committed = writer->getCommitted();
+    committed_crc = writer->getCommittedCrc();
+    portEXIT_CRITICAL(&snapshot_lock);
+}
+
+void FlashPipeline::writerTask(void *parameter)
+{
+    FlashPipeline *pipeline = static_cast<FlashPipeline *>(parameter);
+    for (;;)
+    {
+        Block block;
+        if (xQueueReceive(pipeline->full_queue, &block, 0) != pdTRUE)
+        {
+            // Nothing to write, prepare the sectors the next blocks go to. Nothing is erased before the first block
+            // arrived, so an image which is rejected by its header (see ImageHeaderCheck) leaves the partition as it was.
+            const unsigned long erase_start = micros();
+            if (!pipeline->failed && !pipeline->discard && pipeline->committed > 0 &&
+                pipeline->writer->eraseAhead(ESP32_OTA_UPDATER_PIPELINE_ERASE_AHEAD * FIRMWARE_SINK_SECTOR_SIZE))
+            {
+                pipeline->stats.sectors_erased_ahead++;
+                pipeline->stats.flash_us += micros() - erase_start;
+                continue;
+            }
+            const unsigned long stall_start = millis();
+            xQueueReceive(pipeline->full_queue, &block, portMAX_DELAY);
+            pipeline->stats.writer_stalls++;
+            pipeline->stats.writer_stall_ms += millis() - stall_start;
+        }
+
+        if (block.data == NULL)
+        {
+            const bool stop = pipeline->stopping;
+            xSemaphoreGive(pipeline->done);
+            if (stop)
+            {
+                vTaskDelete(NULL);
+                return;
+            }
+            continue;
+        }
+        pipeline->writeBlock(block);
+        xQueueSend(pipeline->free_queue, &block.data, portMAX_DELAY);
+    }
+}
@@ -0,0 +1,136 @@
+#include "ImageHeaderCheck.h"
+#include <string.h>
+
+static uint32_t littleEndian32(const uint8_t *data)
+{
+    return (uint32_t)data[0] | (uint32_t)data[1] << 8 | (uint32_t)data[2] << 16 | (uint32_t)data[3] << 24;
+}
+
+static void copyField(char *destination, const uint8_t *field)
+{
+    memcpy(destination, field, IMAGE_APP_DESC_STRING_SIZE);
+    destination[IMAGE_APP_DESC_STRING_SIZE] = '\0'; // A field which fills all 32 bytes has no terminator
+}
+
+bool ImageHeaderCheck::parse(const uint8_t *head, size_t length, ImageHeaderInfo *info)
+{
+    if (length < IMAGE_HEADER_CHECK_SIZE || head[0] != IMAGE_HEADER_MAGIC || head[1] == 0 || head[1] > IMAGE_MAX_SEGMENTS ||
+        littleEndian32(head + IMAGE_APP_DESC_OFFSET) != IMAGE_APP_DESC_MAGIC)
+    {
+        return false;
+    }
+    // esp_image_header_t: magic, segment count, SPI mode, SPI speed (low nibble) and size (high nibble), entry
+    // address, WP pin, pin drive settings, chip ID, ...
+    info->segment_count = head[1];
+    info->flash_size = head[3] >> 4;
+    info->chip_id = (uint16_t)(head[12] | head[13] << 8);
+    // esp_app_desc_t: magic word, secure version, 2 reserved words, version, project name, ...
+    copyField(info->version, head + IMAGE_APP_DESC_OFFSET + 16);
+    copyField(info->project_name, head + IMAGE_APP_DESC_OFFSET + 16 + IMAGE_APP_DESC_STRING_SIZE);
+    return true;
+}
+
+void ImageHeaderCheck::setReference(const ImageHeaderInfo *reference)
+{
+    has_reference = reference != NULL;
+    if (has_reference)
+    {
+        this->reference = *reference;
+    }
+}
+
+void ImageHeaderCheck::begin(ByteSink *next)
+{
+    this->next = next;
+    head_length = 0;
+    result = PENDING;
+    info = {};
+}
+
+bool ImageHeaderCheck::write(const uint8_t *data, size_t length)
+{
+    if (result == VALID)
+    {
+        return next->write(data, length);
+    }
+    if (result != PENDING)
+    {
+        return false;
+    }
+    const size_t missing = IMAGE_HEADER_CHECK_SIZE - head_length;
+    const size_t taken = length < missing ? length : missing;
+    memcpy(head + head_length, data, taken);
+    head_length += taken;
+    if (head_length < IMAGE_HEADER_CHECK_SIZE)
+    {
+        return true;
+    }
+    result = check();
+    if (result != VALID)
+    {
+        return false;
+    }
+    return next->write(head, head_length) && (taken == length || next->write(data + taken, length - taken));
+}
+
+bool ImageHeaderCheck::finish()
+{
+    if (result == PENDING)
+    {
+        result = TRUNCATED;
+    }
+    return result == VALID;
+}
+
+ImageHeaderCheck::Result ImageHeaderCheck::check()
+{
+    if (!parse(head, head_length, &info))
+    {
+        return NOT_AN_IMAGE;
+    }
+    if (has_reference && info.chip_id != reference.chip_id)
+    {
+        return WRONG_CHIP;
+    }
+    if (has_reference && info.flash_size > reference.flash_size)
+    {
+        return WRONG_FLASH_SIZE; // The app would not start on the flash the running one declares
+    }
+    if (has_reference && strcmp(info.project_name, reference.project_name) != 0)
+    {
+        return WRONG_PROJECT;
+    }
+    if (minimum_version != NULL)
+    {
+        const Version embedded(info.version);
+        if (!embedded.isValid() || embedded <= *minimum_version)
+        {
+            return WRONG_VERSION;
+        }
+    }
+    return VALID;
+}
+
+const char *ImageHeaderCheck::describe(Result result)
+{
+    switch (result)
+    {
+    case PENDING:
+        return "header incomplete";
+    case VALID:
+        return "header valid";
+    case NOT_AN_IMAGE:
+        return "not an app image";
+    case WRONG_CHIP:
+        return "built for another chip";
+    case WRONG_FLASH_SIZE:
+        return "built for a larger flash";
+    case WRONG_PROJECT:
+        return "built for another project";
+    case WRONG_VERSION:
+        return "embedded version is not newer";
+    case TRUNCATED:
+        return "truncated image";
+    }
+    return "unknown";
+}
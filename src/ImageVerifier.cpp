@@ -0,0 +1,103 @@
+#include "ImageVerifier.h"
+#include <Arduino.h>
+#include <mbedtls/version.h>
+#include <string.h>
+
+// Arduino-ESP32 2.x ships mbedtls 2.x, where only the "_ret" functions report errors
+#if MBEDTLS_VERSION_NUMBER < 0x03000000
+#define sha256_starts mbedtls_sha256_starts_ret
+#define sha256_update mbedtls_sha256_update_ret
+#define sha256_finish mbedtls_sha256_finish_ret
+#else
+#define sha256_starts mbedtls_sha256_starts
+#define sha256_update mbedtls_sha256_update
+#define sha256_finish mbedtls_sha256_finish
+#endif
+
+ImageVerifier::ImageVerifier()
+{
+    mbedtls_sha256_init(&sha256);
+}
+
+ImageVerifier::~ImageVerifier()
+{
+    mbedtls_sha256_free(&sha256);
+}
+
+void ImageVerifier::begin(ByteSink *next)
+{
+    this->next = next;
+    bytes_hashed = 0;
+    hash_time_us = 0;
+    mbedtls_sha256_free(&sha256);
+    mbedtls_sha256_init(&sha256);
+    sha256_starts(&sha256, 0);
+}
+
+bool ImageVerifier::write(const uint8_t *data, size_t length)
+{
+    hash(data, length);
+    return next->write(data, length);
+}
+
+void ImageVerifier::hash(const uint8_t *data, size_t length)
+{
+    const unsigned long start = micros();
+    sha256_update(&sha256, data, length);
+    hash_time_us += micros() - start;
+    bytes_hashed += length;
+}
+
+bool ImageVerifier::hashStored(ByteSource *source, uint32_t length)
+{
+    uint8_t chunk[256];
+    const unsigned long start = micros();
+    for (uint32_t position = 0; position < length;)
+    {
+        const size_t chunk_length = length - position < sizeof(chunk) ? length - position : sizeof(chunk);
+        if (!source->read(position, chunk, chunk_length))
+        {
+            return false;
+        }
+        sha256_update(&sha256, chunk, chunk_length);
+        position += chunk_length;
+    }
+    hash_time_us += micros() - start;
+    bytes_hashed += length;
+    return true;
+}
+
+bool ImageVerifier::setExpected(const uint8_t *data, size_t length)
+{
+    expected_loaded = false;
+    if (length < IMAGE_VERIFIER_DIGEST_SIZE || length - IMAGE_VERIFIER_DIGEST_SIZE > sizeof(signature))
+    {
+        return false;
+    }
+    memcpy(expected_digest, data, IMAGE_VERIFIER_DIGEST_SIZE);
+    signature_length = length - IMAGE_VERIFIER_DIGEST_SIZE;
+    memcpy(signature, data + IMAGE_VERIFIER_DIGEST_SIZE, signature_length);
+    expected_loaded = true;
+    return true;
+}
+
+bool ImageVerifier::verify(const char *public_key)
+{
+    const unsigned long start = micros();
+    uint8_t digest[IMAGE_VERIFIER_DIGEST_SIZE];
+    bool valid = expected_loaded && sha256_finish(&sha256, digest) == 0 &&
+                 memcmp(digest, expected_digest, IMAGE_VERIFIER_DIGEST_SIZE) == 0;
+
+    // The signature covers the digest, so checking it costs the same for every image size
+    if (valid && public_key != NULL)
+    {
+        mbedtls_pk_context key;
+        mbedtls_pk_init(&key);
+        valid = signature_length > 0 &&
+                mbedtls_pk_parse_public_key(&key, (const unsigned char *)public_key, strlen(public_key) + 1) == 0 &&
+                mbedtls_pk_verify(&key, MBEDTLS_MD_SHA256, digest, sizeof(digest), signature, signature_length) == 0;
+        mbedtls_pk_free(&key);
+    }
+    hash_time_us += micros() - start;
+    return valid;
+}
@@ -0,0 +1,319 @@
+#include "JsonStreamScanner.h"
+#include <string.h>
+
+void JsonStreamScanner::reset()
+{
+    status = SCANNING;
+    state = EXPECT_VALUE;
+    depth = 0;
+    array_bits = 0;
+    string_is_key = false;
+    unicode_digits = 0;
+
+    key[0] = '\0';
+    key_length = 0;
+    key_truncated = false;
+
+    value_buffer = NULL;
+    value_capacity = 0;
+    value_length = 0;
+    value_truncated = false;
+    value_type = NULL_VALUE;
+}
+
+size_t JsonStreamScanner::feed(const uint8_t *data, size_t length)
+{
+    size_t i = 0;
+    while (i < length && status == SCANNING)
+    {
+        const char c = (char)data[i];
+        switch (state)
+        {
+        case IN_STRING:
+            if (c == '"')
+            {
+                if (string_is_key)
+                {
+                    key[key_truncated ? 0 : key_length] = '\0'; // Keys which do not fit never match
+                    state = EXPECT_COLON;
+                }
+                else
+                {
+                    endValue();
+                    afterValue();
+                }
+            }
+            else if (c == '\\')
+            {
+                state = IN_STRING_ESCAPE;
+            }
+            else
+            {
+                appendChar(c);
+            }
+            break;
+
+        case IN_STRING_ESCAPE:
+            state = IN_STRING;
+            switch (c)
+            {
+            case 'n':
+                appendChar('\n');
+                break;
+            case 't':
+                appendChar('\t');
+                break;
+            case 'r':
+                appendChar('\r');
+                break;
+            case 'b':
+                appendChar('\b');
+                break;
+            case 'f':
+                appendChar('\f');
+                break;
+            case 'u':
+                appendChar('?'); // Unicode escapes are not decoded, none of the captured values uses them
+                unicode_digits = 0;
+                state = IN_STRING_UNICODE;
+                break;
+            default:
+                appendChar(c); // \" \\ and \/
+                break;
+            }
+            break;
+
+        case IN_STRING_UNICODE:
+            if (++unicode_digits == 4)
+            {
+                state = IN_STRING;
+            }
+            break;
+
+        case IN_SCALAR:
+            if ((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '-' || c == '+' || c == '.')
+            {
+                appendChar(c);
+                break;
+            }
+            endValue();
+            afterValue();
+            continue; // The delimiter is handled as a structural character
+
+        default:
+            if (c == ' ' || c == '\t' || c == '\n' || c == '\r')
+            {
+                break;
+            }
+            switch (state)
+            {
+            case EXPECT_VALUE:
+                if (c == '{')
+                {
+                    beginContainer(false);
+                }
+                else if (c == '[')
+                {
+                    beginContainer(true);
+                }
+                else if (c == '"')
+                {
+                    beginValue(STRING);
+                    state = IN_STRING;
+                }
+                else if (c == ']')
+                {
+                    endContainer(true); // Empty array
+                }
+                else if (c == '-' || (c >= '0' && c <= '9') || c == 't' || c == 'f' || c == 'n')
+                {
+                    beginValue(c == 't' || c == 'f' ? BOOLEAN : (c == 'n' ? NULL_VALUE : NUMBER));
+                    appendChar(c);
+                    state = IN_SCALAR;
+                }
+                else
+                {
+                    fail();
+                }
+                break;
+
+            case EXPECT_KEY:
+                if (c == '"')
+                {
+                    key_length = 0;
+                    key_truncated = false;
+                    string_is_key = true;
+                    state = IN_STRING;
+                }
+                else if (c == '}')
+                {
+                    endContainer(false); // Empty object
+                }
+                else
+                {
+                    fail();
+                }
+                break;
+
+            case EXPECT_COLON:
+                if (c == ':')
+                {
+                    state = EXPECT_VALUE;
+                }
+                else
+                {
+                    fail();
+                }
+                break;
+
+            case EXPECT_SEPARATOR:
+                if (c == ',')
+                {
+                    state = inArray() ? EXPECT_VALUE : EXPECT_KEY;
+                }
+                else if (c == '}' || c == ']')
+                {
+                    endContainer(c == ']');
+                }
+                else
+                {
+                    fail();
+                }
+                break;
+
+            default:
+                fail();
+                break;
+            }
+            break;
+        }
+        i++;
+    }
+    return i;
+}
+
+bool JsonStreamScanner::keyIs(const char *other) const
+{
+    return strcmp(key, other) == 0;
+}
+
+void JsonStreamScanner::stop()
+{
+    if (status == SCANNING)
+    {
+        status = STOPPED;
+    }
+}
+
+void JsonStreamScanner::fail()
+{
+    status = FAILED;
+}
+
+bool JsonStreamScanner::inArray() const
+{
+    return depth > 0 && (array_bits & (1UL << (depth - 1))) != 0;
+}
+
+bool JsonStreamScanner::beginContainer(bool is_array)
+{
+    if (depth >= JSON_STREAM_SCANNER_MAX_DEPTH)
+    {
+        fail();
+        return false;
+    }
+    if (is_array)
+    {
+        array_bits |= (1UL << depth);
+    }
+    else
+    {
+        array_bits &= ~(1UL << depth);
+    }
+    depth++;
+    onContainerBegin(is_array);
+
+    key[0] = '\0'; // Members of arrays have no key
+    state = is_array ? EXPECT_VALUE : EXPECT_KEY;
+    return true;
+}
+
+bool JsonStreamScanner::endContainer(bool is_array)
+{
+    if (depth == 0 || inArray() != is_array)
+    {
+        fail();
+        return false;
+    }
+    onContainerEnd(is_array);
+    depth--;
+    afterValue();
+    return true;
+}
+
+void JsonStreamScanner::beginValue(ValueType type)
+{
+    string_is_key = false;
+    value_type = type;
+    value_length = 0;
+    value_truncated = false;
+    value_capacity = 0;
+    value_buffer = onValueBegin(type, &value_capacity);
+    if (value_capacity == 0)
+    {
+        value_buffer = NULL;
+    }
+}
+
+void JsonStreamScanner::appendChar(char c)
+{
+    if (string_is_key)
+    {
+        if (key_length + 1 < JSON_STREAM_SCANNER_KEY_LENGTH)
+        {
+            key[key_length++] = c;
+        }
+        else
+        {
+            key_truncated = true;
+        }
+    }
+    else if (value_buffer != NULL)
+    {
+        if (value_length + 1 < value_capacity)
+        {
+            value_buffer[value_length++] = c;
+        }
+        else
+        {
+            value_truncated = true;
+        }
+    }
+}
+
+void JsonStreamScanner::endValue()
+{
+    if (value_buffer != NULL)
+    {
+        value_buffer[value_length] = '\0';
+        onValueEnd(value_type, value_buffer, value_length, value_truncated);
+        value_buffer = NULL;
+    }
+}
+
+void JsonStreamScanner::afterValue()
+{
+    if (depth == 0)
+    {
+        if (status == SCANNING)
+        {
+            status = FINISHED;
+        }
+        return;
+    }
+    if (inArray())
+    {
+        key[0] = '\0';
+    }
+    state = EXPECT_SEPARATOR;
+}
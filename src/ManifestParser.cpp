@@ -0,0 +1,211 @@
+#include "ManifestParser.h"
+#include <stdio.h>
+#include <string.h>
+
+#include "ByteStream.h"
+
+void ManifestParser::begin(const char *download_base)
+{
+    status = SCANNING;
+    crc = 0;
+    this->download_base = download_base;
+    tag[0] = '\0';
+    tag_found = false;
+    value_too_long = false;
+    rollout_percent = 100;
+    asset_count = 0;
+    match = NULL;
+    beginField(FIELD_HEADER, MANIFEST_HEADER_SIZE);
+}
+
+bool ManifestParser::addAsset(ReleaseAsset *asset)
+{
+    if (asset_count >= ESP32_OTA_UPDATER_MAX_ASSETS)
+    {
+        return false;
+    }
+    asset->url[0] = '\0';
+    asset->size = 0;
+    asset->has_digest = false;
+    asset->found = false;
+    assets[asset_count++] = asset;
+    return true;
+}
+
+void ManifestParser::feed(const uint8_t *data, size_t length)
+{
+    while (length > 0 && status == SCANNING)
+    {
+        const size_t consumed = consume(data, length);
+        data += consumed;
+        length -= consumed;
+    }
+}
+
+size_t ManifestParser::consume(const uint8_t *data, size_t length)
+{
+    const size_t missing = field_length - field_received;
+    const size_t taken = length < missing ? length : missing;
+    if (field != FIELD_CRC)
+    {
+        crc = Crc32::update(crc, data, taken);
+    }
+
+    // Strings and digests go straight to their destination, only integers and the header are collected
+    switch (field)
+    {
+    case FIELD_TAG:
+        memcpy(tag + field_received, data, taken);
+        break;
+    case FIELD_NAME:
+        if (!name_truncated)
+        {
+            memcpy(name + field_received, data, taken);
+        }
+        break;
+    case FIELD_DIGEST:
+        if (match != NULL)
+        {
+            memcpy(match->digest + field_received, data, taken);
+        }
+        break;
+    default:
+        memcpy(value + field_received, data, taken);
+        break;
+    }
+    field_received += taken;
+    if (field_received == field_length)
+    {
+        finishField();
+    }
+    return taken;
+}
+
+void ManifestParser::beginField(Field next, uint8_t length)
+{
+    field = next;
+    field_length = length;
+    field_received = 0;
+}
+
+void ManifestParser::finishField()
+{
+    switch (field)
+    {
+    case FIELD_HEADER:
+        if (memcmp(value, MANIFEST_MAGIC, 4) != 0 || value[4] != MANIFEST_VERSION)
+        {
+            fail();
+            return;
+        }
+        rollout_percent = value[5] > 100 ? 100 : value[5];
+        remaining_assets = value[6];
+        beginField(FIELD_TAG_LENGTH, 1);
+        break;
+    case FIELD_TAG_LENGTH:
+        if (value[0] == 0 || value[0] >= sizeof(tag))
+        {
+            value_too_long = value[0] != 0;
+            fail();
+            return;
+        }
+        beginField(FIELD_TAG, value[0]);
+        break;
+    case FIELD_TAG:
+        tag[field_length] = '\0';
+        tag_found = true;
+        if (remaining_assets > 0)
+        {
+            beginField(FIELD_NAME_LENGTH, 1);
+        }
+        else
+        {
+            beginField(FIELD_CRC, 4);
+        }
+        break;
+    case FIELD_NAME_LENGTH:
+        if (value[0] == 0)
+        {
+            fail();
+            return;
+        }
+        name_truncated = value[0] >= sizeof(name);
+        beginField(FIELD_NAME, value[0]);
+        break;
+    case FIELD_NAME:
+        finishName();
+        break;
+    case FIELD_SIZE:
+        asset_size = littleEndian();
+        beginField(FIELD_FLAGS, 1);
+        break;
+    case FIELD_FLAGS:
+        if (match != NULL)
+        {
+            match->size = asset_size;
+            match->has_digest = (value[0] & MANIFEST_FLAG_DIGEST) != 0;
+            match->found = true;
+        }
+        if (value[0] & MANIFEST_FLAG_DIGEST)
+        {
+            beginField(FIELD_DIGEST, RELEASE_ASSET_DIGEST_SIZE);
+        }
+        else
+        {
+            nextAsset();
+        }
+        break;
+    case FIELD_DIGEST:
+        nextAsset();
+        break;
+    case FIELD_CRC:
+        status = littleEndian() == crc ? FINISHED : FAILED;
+        break;
+    }
+}
+
+void ManifestParser::finishName()
+{
+    match = NULL;
+    if (!name_truncated)
+    {
+        name[field_length] = '\0';
+        for (uint8_t i = 0; i < asset_count && match == NULL; i++)
+        {
+            if (!assets[i]->found && ReleaseParser::matchName(assets[i]->name, name))
+            {
+                match = assets[i];
+            }
+        }
+    }
+    if (match != NULL && snprintf(match->url, sizeof(match->url), "%s/%s/%s", download_base, tag, name) >= (int)sizeof(match->url))
+    {
+        value_too_long = true;
+        fail();
+        return;
+    }
+    beginField(FIELD_SIZE, 4);
+}
+
+void ManifestParser::nextAsset()
+{
+    match = NULL;
+    if (--remaining_assets > 0)
+    {
+        beginField(FIELD_NAME_LENGTH, 1);
+    }
+    else
+    {
+        beginField(FIELD_CRC, 4);
+    }
+}
+
+void ManifestParser::fail()
+{
+    status = FAILED;
+}
+
+uint32_t ManifestParser::littleEndian() const
+{
+    return (uint32_t)value[0] | ((uint32_t)value[1] << 8) | ((uint32_t)value[2] << 16) | ((uint32_t)value[3] << 24);
+}
@@ -0,0 +1,191 @@
+#include "PartitionWriter.h"
+
+#ifdef ARDUINO
+
+#include <esp_ota_ops.h>
+#include <stdlib.h>
+#include <string.h>
+
+uint32_t PartitionWriter::getCapacity()
+{
+    const esp_partition_t *update_partition = findPartition();
+    return update_partition != NULL ? update_partition->size : 0;
+}
+
+const esp_partition_t *PartitionWriter::findPartition() const
+{
+    if (label != NULL)
+    {
+        return esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+    }
+    return esp_ota_get_next_update_partition(NULL);
+}
+
+bool PartitionWriter::begin(uint32_t offset, uint32_t crc, const uint8_t *head)
+{
+    abort();
+    const esp_partition_t *partition = findPartition();
+    if (partition == NULL || offset % FIRMWARE_SINK_SECTOR_SIZE != 0 || offset >= partition->size || (offset > 0 && head == NULL))
+    {
+        return false;
+    }
+    buffer = (uint8_t *)malloc(FIRMWARE_SINK_SECTOR_SIZE);
+    if (buffer == NULL)
+    {
+        return false;
+    }
+    this->partition = partition;
+    buffer_length = 0;
+    committed = offset;
+    committed_crc = crc;
+    erased_until = offset; // Sectors after the committed data may contain an earlier attempt
+    if (head != NULL)
+    {
+        memcpy(this->head, head, FIRMWARE_SINK_HEAD_SIZE);
+    }
+    return true;
+}
+
+bool PartitionWriter::write(const uint8_t *data, size_t length)
+{
+    if (buffer == NULL)
+    {
+        return false;
+    }
+    while (length > 0)
+    {
+        size_t chunk = FIRMWARE_SINK_SECTOR_SIZE - buffer_length;
+        chunk = chunk < length ? chunk : length;
+        memcpy(buffer + buffer_length, data, chunk);
+        buffer_length += chunk;
+        data += chunk;
+        length -= chunk;
+
+        if (buffer_length == FIRMWARE_SINK_SECTOR_SIZE && !flush())
+        {
+            abort();
+            return false;
+        }
+    }
+    return true;
+}
+
+bool PartitionWriter::flush()
+{
+    if (committed + buffer_length > partition->size)
+    {
+        return false; // The image does not fit into the partition
+    }
+    if (committed >= erased_until)
+    {
+        if (esp_partition_erase_range(partition, committed, FIRMWARE_SINK_SECTOR_SIZE) != ESP_OK)
+        {
+            return false;
+        }
+        erased_until = committed + FIRMWARE_SINK_SECTOR_SIZE;
+    }
+    // The head is written last, until then the erased magic byte keeps the bootloader from using the image
+    const size_t skip = committed == 0 ? FIRMWARE_SINK_HEAD_SIZE : 0;
+    if (skip > 0)
+    {
+        if (buffer_length < skip)
+        {
+            return false;
+        }
+        memcpy(head, buffer, skip);
+    }
+    if (esp_partition_write(partition, committed + skip, buffer + skip, buffer_length - skip) != ESP_OK)
+    {
+        return false;
+    }
+    committed_crc = Crc32::update(committed_crc, buffer, buffer_length);
+    committed += buffer_length;
+    buffer_length = 0;
+    return true;
+}
+
+bool PartitionWriter::eraseAhead(uint32_t distance)
+{
+    if (buffer == NULL || erased_until >= committed + distance || erased_until >= partition->size)
+    {
+        return false;
+    }
+    if (esp_partition_erase_range(partition, erased_until, FIRMWARE_SINK_SECTOR_SIZE) != ESP_OK)
+    {
+        return false;
+    }
+    erased_until += FIRMWARE_SINK_SECTOR_SIZE;
+    return true;
+}
+
+bool PartitionWriter::finish()
+{
+    if (buffer == NULL)
+    {
+        return false;
+    }
+    bool success = (buffer_length == 0 || flush()) && committed >= FIRMWARE_SINK_HEAD_SIZE &&
+                   esp_partition_write(partition, 0, head, FIRMWARE_SINK_HEAD_SIZE) == ESP_OK;
+    // Validates the image (including the appended SHA-256) before it is selected, data partitions are not booted
+    success = success && (label != NULL || esp_ota_set_boot_partition(partition) == ESP_OK);
+    abort();
+    return success;
+}
+
+void PartitionWriter::abort()
+{
+    free(buffer);
+    buffer = nullptr;
+    buffer_length = 0;
+}
+
+bool PartitionWriter::verify(uint32_t offset, uint32_t crc, const uint8_t *head)
+{
+    const esp_partition_t *partition = findPartition();
+    if (partition == NULL || offset < FIRMWARE_SINK_HEAD_SIZE || offset > partition->size)
+    {
+        return false;
+    }
+    uint32_t flash_crc = Crc32::update(0, head, FIRMWARE_SINK_HEAD_SIZE);
+    uint8_t chunk[256];
+    for (uint32_t position = FIRMWARE_SINK_HEAD_SIZE; position < offset;)
+    {
+        const size_t length = offset - position < sizeof(chunk) ? offset - position : sizeof(chunk);
+        if (esp_partition_read(partition, position, chunk, length) != ESP_OK)
+        {
+            return false;
+        }
+        flash_crc = Crc32::update(flash_crc, chunk, length);
+        position += length;
+    }
+    return flash_crc == crc;
+}
+
+bool PartitionWriter::read(uint32_t offset, uint8_t *data, size_t length)
+{
+    if (partition == NULL || offset + length > committed)
+    {
+        return false;
+    }
+    // The head is only written to flash in finish()
+    while (length > 0 && offset < FIRMWARE_SINK_HEAD_SIZE)
+    {
+        *data++ = head[offset++];
+        length--;
+    }
+    return length == 0 || esp_partition_read(partition, offset, data, length) == ESP_OK;
+}
+
+bool RunningPartitionSource::read(uint32_t offset, uint8_t *data, size_t length)
+{
+    const esp_partition_t *partition = esp_ota_get_running_partition();
+    return partition != NULL && esp_partition_read(partition, offset, data, length) == ESP_OK;
+}
+
+uint32_t RunningPartitionSource::getSize()
+{
+    const esp_partition_t *partition = esp_ota_get_running_partition();
+    return partition != NULL ? partition->size : 0;
+}
+
+#endif // ARDUINO
@@ -0,0 +1,38 @@
+#include "PeerNetwork.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void PeerImage::formatDigest(char *hex) const
+{
+    for (size_t i = 0; i < PEER_IMAGE_DIGEST_SIZE; i++)
+    {
+        snprintf(hex + 2 * i, 3, "%02x", digest[i]);
+    }
+}
+
+bool PeerImage::parseDigest(const char *hex)
+{
+    if (strlen(hex) != 2 * PEER_IMAGE_DIGEST_SIZE)
+    {
+        return false;
+    }
+    uint8_t parsed[PEER_IMAGE_DIGEST_SIZE];
+    for (size_t i = 0; i < PEER_IMAGE_DIGEST_SIZE; i++)
+    {
+        if (!isxdigit((unsigned char)hex[2 * i]) || !isxdigit((unsigned char)hex[2 * i + 1]))
+        {
+            return false;
+        }
+        const char pair[3] = {hex[2 * i], hex[2 * i + 1], '\0'};
+        parsed[i] = (uint8_t)strtoul(pair, NULL, 16);
+    }
+    memcpy(digest, parsed, sizeof(digest));
+    return true;
+}
+
+bool PeerImage::matches(const PeerImage &other) const
+{
+    return strcmp(tag, other.tag) == 0 && memcmp(digest, other.digest, PEER_IMAGE_DIGEST_SIZE) == 0;
+}
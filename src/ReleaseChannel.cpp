@@ -0,0 +1,93 @@
+#include "ReleaseChannel.h"
+#include <stdlib.h>
+#include <string.h>
+
+bool ReleaseChannel::parse(const char *spec)
+{
+    prereleases = false;
+    label[0] = '\0';
+    major = -1;
+    minor = -1;
+    bool valid = true;
+    while (spec != NULL && *spec != '\0')
+    {
+        const size_t length = strcspn(spec, " ");
+        if (length == 0)
+        {
+            spec++;
+            continue;
+        }
+        const char *term = spec;
+        spec += length;
+        if (length == 6 && strncmp(term, "stable", 6) == 0)
+        {
+            continue;
+        }
+        if (length == 10 && strncmp(term, "prerelease", 10) == 0)
+        {
+            prereleases = true;
+            continue;
+        }
+
+        // Version ranges: "^2", "2.x", "~2.3" and "2.3.x"
+        const bool tilde = *term == '~';
+        const char *number = *term == '^' || tilde ? term + 1 : term;
+        char *end;
+        if (*number >= '0' && *number <= '9')
+        {
+            const long range_major = strtol(number, &end, 10);
+            long range_minor = -1;
+            if (*end == '.' && end[1] >= '0' && end[1] <= '9')
+            {
+                range_minor = strtol(end + 1, &end, 10);
+            }
+            if (*end == '.' && (end[1] == 'x' || end[1] == '*'))
+            {
+                end += 2;
+            }
+            if (end != spec || range_major > SEMANTIC_VERSION_NUMBER_MAX || range_minor > SEMANTIC_VERSION_NUMBER_MAX ||
+                (tilde && range_minor < 0))
+            {
+                valid = false;
+                continue;
+            }
+            major = range_major;
+            minor = *term == '^' ? -1 : range_minor; // "^2.3" allows every 2.x from 2.3 on, older ones are not newer anyway
+            continue;
+        }
+
+        // Anything else is a pre-release label, e.g. "beta"
+        if (length >= sizeof(label))
+        {
+            valid = false;
+            continue;
+        }
+        memcpy(label, term, length);
+        label[length] = '\0';
+    }
+    if (!valid)
+    {
+        parse(NULL);
+    }
+    return valid;
+}
+
+bool ReleaseChannel::accepts(const Version &version, bool marked_prerelease) const
+{
+    if (!version.isValid() || (major >= 0 && version.getMajor() != major) || (minor >= 0 && version.getMinor() != minor))
+    {
+        return false;
+    }
+    const char *pre_release = version.getPreRelease();
+    if (!marked_prerelease && pre_release[0] == '\0')
+    {
+        return true;
+    }
+    if (prereleases)
+    {
+        return true;
+    }
+    // A label only matches whole identifiers, "beta" does not accept "betamax.1"
+    const size_t length = strlen(label);
+    return length > 0 && strncmp(pre_release, label, length) == 0 && (pre_release[length] == '\0' || pre_release[length] == '.');
+}
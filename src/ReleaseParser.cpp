@@ -0,0 +1,358 @@
+#include "ReleaseParser.h"
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+void ReleaseParser::begin()
+{
+    reset();
+    tag[0] = '\0';
+    tag_found = false;
+    value_too_long = false;
+    rollout_requested = false;
+    body_found = false;
+    rollout_percent = 100;
+    asset_count = 0;
+    assets_found = 0;
+    in_assets = false;
+    assets_complete = false;
+    in_asset = false;
+    field = FIELD_NONE;
+    channel = NULL;
+    floor = NULL;
+    release_selected = false;
+    release_count = 0;
+    floor_reached = false;
+}
+
+void ReleaseParser::beginList(const ReleaseChannel *channel, const Version *floor)
+{
+    begin();
+    this->channel = channel;
+    this->floor = floor;
+}
+
+void ReleaseParser::nextPage()
+{
+    reset();
+    release_count = 0;
+    in_assets = false;
+    in_asset = false;
+    field = FIELD_NONE;
+}
+
+void ReleaseParser::beginRelease()
+{
+    release_tag[0] = '\0';
+    release_tag_found = false;
+    release_draft = false;
+    release_prerelease = false;
+    release_selected = false;
+}
+
+void ReleaseParser::selectRelease()
+{
+    if (!release_tag_found || release_draft)
+    {
+        return; // Drafts are never installed, a release without a tag is skipped
+    }
+    const Version version(release_tag);
+    if (!channel->accepts(version, release_prerelease))
+    {
+        return;
+    }
+    if (version <= *floor)
+    {
+        floor_reached = true;
+        stop(); // The remaining releases were created earlier
+        return;
+    }
+    if (tag_found && version <= Version(tag))
+    {
+        return;
+    }
+
+    // The best release so far, its assets replace the ones of the previous best
+    release_selected = true;
+    memcpy(tag, release_tag, sizeof(tag));
+    tag_found = true;
+    rollout_percent = 100;
+    assets_found = 0;
+    for (uint8_t i = 0; i < asset_count; i++)
+    {
+        assets[i]->url[0] = '\0';
+        assets[i]->size = 0;
+        assets[i]->has_digest = false;
+        assets[i]->found = false;
+    }
+}
+
+bool ReleaseParser::addAsset(ReleaseAsset *asset)
+{
+    if (asset_count >= ESP32_OTA_UPDATER_MAX_ASSETS)
+    {
+        return false;
+    }
+    asset->url[0] = '\0';
+    asset->size = 0;
+    asset->has_digest = false;
+    asset->found = false;
+    assets[asset_count++] = asset;
+    return true;
+}
+
+void ReleaseParser::onContainerBegin(bool is_array)
+{
+    if (channel != NULL && !is_array && getDepth() == 2)
+    {
+        beginRelease();
+    }
+    else if (is_array && getDepth() == releaseDepth() + 1 && keyIs("assets"))
+    {
+        in_assets = true;
+        if (channel != NULL)
+        {
+            selectRelease();
+        }
+    }
+    else if (!is_array && in_assets && getDepth() == releaseDepth() + 2)
+    {
+        in_asset = true;
+        candidate_name[0] = '\0';
+        candidate_url[0] = '\0';
+        candidate_size[0] = '\0';
+        candidate_digest[0] = '\0';
+        candidate_name_truncated = false;
+        candidate_url_truncated = false;
+    }
+}
+
+void ReleaseParser::onContainerEnd(bool is_array)
+{
+    if (in_asset && getDepth() == releaseDepth() + 2)
+    {
+        in_asset = false;
+        finishAsset();
+    }
+    else if (in_assets && getDepth() == releaseDepth() + 1)
+    {
+        in_assets = false;
+        assets_complete = true;
+        checkComplete();
+    }
+    else if (channel != NULL && !is_array && getDepth() == 2)
+    {
+        release_count++;
+        release_selected = false;
+    }
+}
+
+char *ReleaseParser::onValueBegin(ValueType type, size_t *capacity)
+{
+    field = FIELD_NONE;
+    if (getDepth() == releaseDepth() && type == STRING && keyIs("tag_name"))
+    {
+        field = FIELD_TAG;
+        *capacity = sizeof(tag);
+        return channel != NULL ? release_tag : tag;
+    }
+    if (channel != NULL && getDepth() == 2 && type == BOOLEAN && (keyIs("draft") || keyIs("prerelease")))
+    {
+        field = keyIs("draft") ? FIELD_DRAFT : FIELD_PRERELEASE;
+        *capacity = sizeof(release_flag);
+        return release_flag;
+    }
+    if (getDepth() == releaseDepth() && rollout_requested && (channel == NULL || release_selected) && keyIs("body"))
+    {
+        if (type != STRING)
+        {
+            body_found = true; // No release notes (null)
+            checkComplete();
+            return NULL;
+        }
+        field = FIELD_BODY;
+        *capacity = sizeof(body_start);
+        return body_start;
+    }
+    if (in_asset && getDepth() == releaseDepth() + 2)
+    {
+        if (type == STRING && keyIs("name"))
+        {
+            field = FIELD_NAME;
+            *capacity = sizeof(candidate_name);
+            return candidate_name;
+        }
+        if (type == STRING && keyIs("url"))
+        {
+            field = FIELD_URL;
+            *capacity = sizeof(candidate_url);
+            return candidate_url;
+        }
+        if (type == NUMBER && keyIs("size"))
+        {
+            field = FIELD_SIZE;
+            *capacity = sizeof(candidate_size);
+            return candidate_size;
+        }
+        if (type == STRING && keyIs("digest"))
+        {
+            field = FIELD_DIGEST;
+            *capacity = sizeof(candidate_digest);
+            return candidate_digest;
+        }
+    }
+    return NULL;
+}
+
+void ReleaseParser::onValueEnd(ValueType type, const char *value, size_t length, bool truncated)
+{
+    switch (field)
+    {
+    case FIELD_TAG:
+        if (truncated && channel != NULL)
+        {
+            break; // Too long to be installed, the release is skipped
+        }
+        if (truncated)
+        {
+            value_too_long = true;
+            fail();
+            break;
+        }
+        if (channel != NULL)
+        {
+            release_tag_found = true;
+            break;
+        }
+        tag_found = true;
+        checkComplete();
+        break;
+    case FIELD_DRAFT:
+        release_draft = strcmp(value, "true") == 0;
+        break;
+    case FIELD_PRERELEASE:
+        release_prerelease = strcmp(value, "true") == 0;
+        break;
+    case FIELD_NAME:
+        candidate_name_truncated = truncated;
+        break;
+    case FIELD_URL:
+        candidate_url_truncated = truncated;
+        break;
+    case FIELD_SIZE:
+        if (truncated)
+        {
+            candidate_size[0] = '\0';
+        }
+        break;
+    case FIELD_DIGEST:
+        if (truncated)
+        {
+            candidate_digest[0] = '\0'; // Another algorithm, the asset is treated as if it had no digest
+        }
+        break;
+    case FIELD_BODY:
+        // Only the start is needed, longer release notes are truncated on purpose
+        if (strncmp(value, "Rollout:", 8) == 0)
+        {
+            const long percent = strtol(value + 8, NULL, 10);
+            rollout_percent = percent < 0 ? 0 : (percent > 100 ? 100 : (uint8_t)percent);
+        }
+        body_found = true;
+        checkComplete();
+        break;
+    default:
+        break;
+    }
+    field = FIELD_NONE;
+}
+
+void ReleaseParser::finishAsset()
+{
+    if (candidate_name_truncated || (channel != NULL && !release_selected))
+    {
+        return; // Can not be one of the requested assets, their names fit into the buffer
+    }
+    for (uint8_t i = 0; i < asset_count; i++)
+    {
+        ReleaseAsset *asset = assets[i];
+        if (asset->found || !matchName(asset->name, candidate_name))
+        {
+            continue;
+        }
+        if (candidate_url_truncated)
+        {
+            value_too_long = true;
+            fail();
+            return;
+        }
+        memcpy(asset->url, candidate_url, sizeof(asset->url));
+        asset->size = strtol(candidate_size, NULL, 10);
+        asset->has_digest = parseDigest(candidate_digest, asset->digest);
+        asset->found = true;
+        assets_found++;
+    }
+    checkComplete();
+}
+
+void ReleaseParser::checkComplete()
+{
+    // The releases list is scanned to its end or until the floor is reached
+    if (channel == NULL && tag_found && (assets_found == asset_count || assets_complete) && (body_found || !rollout_requested))
+    {
+        stop();
+    }
+}
+
+bool ReleaseParser::parseDigest(const char *text, uint8_t *digest)
+{
+    if (strncmp(text, "sha256:", 7) != 0 || strlen(text + 7) != 2 * RELEASE_ASSET_DIGEST_SIZE)
+    {
+        return false;
+    }
+    text += 7;
+    for (size_t i = 0; i < RELEASE_ASSET_DIGEST_SIZE; i++)
+    {
+        if (!isxdigit((unsigned char)text[2 * i]) || !isxdigit((unsigned char)text[2 * i + 1]))
+        {
+            return false;
+        }
+        const char pair[3] = {text[2 * i], text[2 * i + 1], '\0'};
+        digest[i] = (uint8_t)strtoul(pair, NULL, 16);
+    }
+    return true;
+}
+
+bool ReleaseParser::matchName(const char *pattern, const char *name)
+{
+    // Iterative glob matching, backtracking to the last '*' on a mismatch
+    const char *star = NULL;
+    const char *star_name = NULL;
+    while (*name != '\0')
+    {
+        if (*pattern == '*')
+        {
+            star = pattern++;
+            star_name = name;
+        }
+        else if (*pattern == *name)
+        {
+            pattern++;
+            name++;
+        }
+        else if (star != NULL)
+        {
+            pattern = star + 1;
+            name = ++star_name;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    while (*pattern == '*')
+    {
+        pattern++;
+    }
+    return *pattern == '\0';
+}
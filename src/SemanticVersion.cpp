@@ -0,0 +1,130 @@
+#include "SemanticVersion.h"
+#include <stdio.h>
+
+Version::Version(const char *version) : key(pack(0, 0, 0, true)), pre_release_key(0), pre_release(), build_offset(0), error(validate(version))
+{
+    if (error != NONE)
+    {
+        return;
+    }
+    size_t i = skipPrefix(version);
+    uint32_t numbers[3];
+    for (uint8_t part = 0; part < 3; part++)
+    {
+        const size_t end = digitsEnd(version, i);
+        numbers[part] = numberAt(version, i, end);
+        i = end + 1;
+    }
+    const char *label = version + i - 1; // The character after the patch number
+    if (*label == '-')
+    {
+        // validate() ensures the pre-release fits
+        const size_t length = strcspn(++label, "+");
+        memcpy(pre_release, label, length);
+        pre_release[length] = '\0';
+        build_offset = (uint8_t)length; // The terminating zero until there is build metadata
+        label += length;
+    }
+    if (*label == '+' && build_offset + 1 < SEMANTIC_VERSION_LABEL_LENGTH)
+    {
+        // The build metadata follows the pre-release in the same buffer, with what is left of it
+        build_offset++;
+        strncpy(pre_release + build_offset, label + 1, SEMANTIC_VERSION_LABEL_LENGTH - 1 - build_offset);
+    }
+    key = pack(numbers[0], numbers[1], numbers[2], pre_release[0] == '\0');
+    pre_release_key = packPreRelease(pre_release);
+}
+
+uint64_t Version::packPreRelease(const char *pre_release)
+{
+    // Orders like the first identifier: numeric ones by their value below alphanumeric ones by their first 7
+    // characters. Keys are only equal if the identifiers are too long to tell apart, comparePreRelease() decides then.
+    const size_t length = strcspn(pre_release, ".");
+    if (length == 0)
+    {
+        return 0;
+    }
+    uint64_t value = 0;
+    if (digitsEnd(pre_release, 0) == length)
+    {
+        for (size_t i = 0; i < length && value <= UINT32_MAX; i++)
+        {
+            value = value * 10 + (pre_release[i] - '0');
+        }
+        return value > UINT32_MAX ? (uint64_t)UINT32_MAX + 1 : value; // Larger numbers are told apart by comparePreRelease()
+    }
+    for (size_t i = 0; i < 7; i++)
+    {
+        value = value << 8 | (i < length ? (uint8_t)pre_release[i] : 0);
+    }
+    return (uint64_t)1 << 63 | value;
+}
+
+int Version::comparePreRelease(const Version &other) const
+{
+    // Identifiers are compared from left to right, numeric ones by their value and below alphanumeric ones
+    const char *a = pre_release;
+    const char *b = other.pre_release;
+    while (*a != '\0' && *b != '\0')
+    {
+        const size_t a_length = strcspn(a, ".");
+        const size_t b_length = strcspn(b, ".");
+        const bool a_numeric = digitsEnd(a, 0) == a_length;
+        const bool b_numeric = digitsEnd(b, 0) == b_length;
+        int result;
+        if (a_numeric != b_numeric)
+        {
+            result = a_numeric ? -1 : 1;
+        }
+        else if (a_numeric && a_length != b_length)
+        {
+            result = a_length < b_length ? -1 : 1; // Numbers have no leading zeros, the longer one is larger
+        }
+        else
+        {
+            result = strncmp(a, b, a_length < b_length ? a_length : b_length);
+            if (result == 0 && a_length != b_length)
+            {
+                result = a_length < b_length ? -1 : 1;
+            }
+        }
+        if (result != 0)
+        {
+            return result;
+        }
+        a += a_length + (a[a_length] == '.' ? 1 : 0);
+        b += b_length + (b[b_length] == '.' ? 1 : 0);
+    }
+    // A larger set of identifiers has a higher precedence if all preceding ones are equal
+    return (*a != '\0') - (*b != '\0');
+}
+
+char *Version::toString(char *buffer, size_t size) const
+{
+    snprintf(buffer, size, "%d.%d.%d%s%s", getMajor(), getMinor(), getPatch(), pre_release[0] != '\0' ? "-" : "", pre_release);
+    return buffer;
+}
+
+const char *Version::describe(ParseError error)
+{
+    switch (error)
+    {
+    case NONE:
+        return "valid";
+    case EMPTY:
+        return "empty";
+    case MISSING_NUMBER:
+        return "major, minor or patch missing";
+    case LEADING_ZERO:
+        return "leading zero";
+    case NUMBER_TOO_LARGE:
+        return "number too large";
+    case EMPTY_IDENTIFIER:
+        return "empty identifier";
+    case INVALID_CHARACTER:
+        return "invalid character";
+    case TOO_LONG:
+        return "pre-release too long";
+    }
+    return "unknown";
+}
@@ -0,0 +1,491 @@
+#include "StreamDecompressor.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if __has_include(<rom/miniz.h>)
+#include <rom/miniz.h>
+#elif __has_include(<esp32/rom/miniz.h>)
+#include <esp32/rom/miniz.h>
+#else
+#include <miniz.h>
+#endif
+
+static_assert(sizeof(tinfl_decompressor) <= INFLATE_DECODER_STATE_SIZE, "INFLATE_DECODER_STATE_SIZE is too small for the inflater");
+static_assert(TINFL_LZ_DICT_SIZE == INFLATE_DECODER_DICTIONARY_SIZE, "Unexpected deflate window size");
+
+#define GZIP_FLAG_HEADER_CRC 0x02
+#define GZIP_FLAG_EXTRA 0x04
+#define GZIP_FLAG_NAME 0x08
+#define GZIP_FLAG_COMMENT 0x10
+#define GZIP_FLAGS_RESERVED 0xE0
+
+/*
+ * InflateDecoder
+ */
+
+bool InflateDecoder::begin(bool zlib, ByteSink *output)
+{
+    end();
+    this->zlib = zlib;
+    this->output = output;
+    if (workspace != nullptr)
+    {
+        inflator = workspace;
+        dictionary = (uint8_t *)workspace + INFLATE_DECODER_STATE_SIZE;
+    }
+    else
+    {
+        inflator = malloc(sizeof(tinfl_decompressor));
+        dictionary = (uint8_t *)malloc(TINFL_LZ_DICT_SIZE);
+    }
+    if (inflator == nullptr || dictionary == nullptr)
+    {
+        end();
+        state = FAILED;
+        return false;
+    }
+    tinfl_init((tinfl_decompressor *)inflator);
+    dictionary_offset = 0;
+    crc = 0;
+    decoded = 0;
+    header_length = 0;
+    state = zlib ? DEFLATE : GZIP_HEADER;
+    return true;
+}
+
+bool InflateDecoder::write(const uint8_t *data, size_t length)
+{
+    while (length > 0)
+    {
+        size_t consumed = 1;
+        switch (state)
+        {
+        case GZIP_HEADER:
+            header[header_length++] = data[0];
+            if (header_length == sizeof(header))
+            {
+                if (header[0] != 0x1F || header[1] != 0x8B || header[2] != 8 || (header[3] & GZIP_FLAGS_RESERVED) != 0)
+                {
+                    return fail();
+                }
+                flags = header[3];
+                nextHeaderField();
+            }
+            break;
+
+        case GZIP_EXTRA_LENGTH:
+            header[header_length++] = data[0];
+            if (header_length == 2)
+            {
+                skip_remaining = header[0] | (header[1] << 8);
+                state = skip_remaining > 0 ? GZIP_EXTRA : state;
+                if (skip_remaining == 0)
+                {
+                    nextHeaderField();
+                }
+            }
+            break;
+
+        case GZIP_EXTRA:
+        case GZIP_HEADER_CRC:
+            consumed = skip_remaining < length ? skip_remaining : length;
+            skip_remaining -= consumed;
+            if (skip_remaining == 0)
+            {
+                nextHeaderField();
+            }
+            break;
+
+        case GZIP_NAME:
+        case GZIP_COMMENT:
+            if (data[0] == '\0')
+            {
+                nextHeaderField();
+            }
+            break;
+
+        case DEFLATE:
+            if (!inflate(data, length, &consumed))
+            {
+                return false;
+            }
+            break;
+
+        case GZIP_TRAILER:
+            header[header_length++] = data[0];
+            if (header_length == 8)
+            {
+                const uint32_t expected_crc = header[0] | (header[1] << 8) | (header[2] << 16) | ((uint32_t)header[3] << 24);
+                const uint32_t expected_size = header[4] | (header[5] << 8) | (header[6] << 16) | ((uint32_t)header[7] << 24);
+                if (expected_crc != crc || expected_size != decoded)
+                {
+                    return fail();
+                }
+                state = DONE;
+            }
+            break;
+
+        case DONE:
+            consumed = length; // Padding after the stream
+            break;
+
+        default:
+            return false;
+        }
+        data += consumed;
+        length -= consumed;
+    }
+    return true;
+}
+
+bool InflateDecoder::finish()
+{
+    return state == DONE;
+}
+
+void InflateDecoder::end()
+{
+    if (inflator != workspace)
+    {
+        free(inflator);
+        free(dictionary);
+    }
+    inflator = nullptr;
+    dictionary = nullptr;
+}
+
+void InflateDecoder::setWorkspace(void *workspace)
+{
+    end();
+    this->workspace = workspace;
+}
+
+bool InflateDecoder::inflate(const uint8_t *data, size_t length, size_t *consumed)
+{
+    const mz_uint32 decompress_flags = TINFL_FLAG_HAS_MORE_INPUT | (zlib ? TINFL_FLAG_PARSE_ZLIB_HEADER | TINFL_FLAG_COMPUTE_ADLER32 : 0);
+    *consumed = 0;
+    for (;;)
+    {
+        size_t in_bytes = length - *consumed;
+        size_t out_bytes = TINFL_LZ_DICT_SIZE - dictionary_offset;
+        const tinfl_status status = tinfl_decompress((tinfl_decompressor *)inflator, data + *consumed, &in_bytes, dictionary,
+                                                     dictionary + dictionary_offset, &out_bytes, decompress_flags);
+        *consumed += in_bytes;
+        if (out_bytes > 0)
+        {
+            if (!zlib)
+            {
+                crc = Crc32::update(crc, dictionary + dictionary_offset, out_bytes);
+            }
+            decoded += out_bytes;
+            if (!output->write(dictionary + dictionary_offset, out_bytes))
+            {
+                return fail();
+            }
+            dictionary_offset = (dictionary_offset + out_bytes) & (TINFL_LZ_DICT_SIZE - 1);
+        }
+        if (status < TINFL_STATUS_DONE)
+        {
+            return fail();
+        }
+        if (status == TINFL_STATUS_DONE)
+        {
+            state = zlib ? DONE : GZIP_TRAILER;
+            header_length = 0;
+            return true;
+        }
+        if (status == TINFL_STATUS_NEEDS_MORE_INPUT && *consumed == length)
+        {
+            return true;
+        }
+        if (in_bytes == 0 && out_bytes == 0)
+        {
+            return fail(); // No progress
+        }
+    }
+}
+
+bool InflateDecoder::nextHeaderField()
+{
+    header_length = 0;
+    if (flags & GZIP_FLAG_EXTRA)
+    {
+        flags &= ~GZIP_FLAG_EXTRA;
+        state = GZIP_EXTRA_LENGTH;
+    }
+    else if (flags & GZIP_FLAG_NAME)
+    {
+        flags &= ~GZIP_FLAG_NAME;
+        state = GZIP_NAME;
+    }
+    else if (flags & GZIP_FLAG_COMMENT)
+    {
+        flags &= ~GZIP_FLAG_COMMENT;
+        state = GZIP_COMMENT;
+    }
+    else if (flags & GZIP_FLAG_HEADER_CRC)
+    {
+        flags &= ~GZIP_FLAG_HEADER_CRC;
+        skip_remaining = 2;
+        state = GZIP_HEADER_CRC;
+    }
+    else
+    {
+        state = DEFLATE;
+    }
+    return true;
+}
+
+bool InflateDecoder::fail()
+{
+    state = FAILED;
+    return false;
+}
+
+/*
+ * HeatshrinkDecoder
+ */
+
+void HeatshrinkDecoder::begin(ByteSink *output)
+{
+    this->output = output;
+    state = TAG;
+    bits = 0;
+    bit_count = 0;
+    backref_index = 0;
+    head = 0;
+    buffer_length = 0;
+    failed = false;
+    memset(window, 0, sizeof(window)); // The encoder starts with a zeroed window as well
+}
+
+bool HeatshrinkDecoder::write(const uint8_t *data, size_t length)
+{
+    for (size_t i = 0; i < length && !failed; i++)
+    {
+        bits = (bits << 8) | data[i];
+        bit_count += 8;
+        for (;;)
+        {
+            const uint8_t needed = state == TAG ? 1 : (state == LITERAL ? 8 : (state == BACKREF_INDEX ? ESP32_OTA_UPDATER_HEATSHRINK_WINDOW_BITS : ESP32_OTA_UPDATER_HEATSHRINK_LOOKAHEAD_BITS));
+            if (bit_count < needed)
+            {
+                break;
+            }
+            bit_count -= needed;
+            const uint16_t value = (bits >> bit_count) & ((1UL << needed) - 1);
+            switch (state)
+            {
+            case TAG:
+                state = value ? LITERAL : BACKREF_INDEX;
+                break;
+            case LITERAL:
+                emit(value);
+                state = TAG;
+                break;
+            case BACKREF_INDEX:
+                backref_index = value;
+                state = BACKREF_COUNT;
+                break;
+            case BACKREF_COUNT:
+            {
+                const uint16_t offset = backref_index + 1;
+                for (uint16_t count = value + 1; count > 0; count--)
+                {
+                    emit(window[(uint16_t)(head - offset) & (sizeof(window) - 1)]);
+                }
+                state = TAG;
+                break;
+            }
+            }
+        }
+    }
+    return !failed;
+}
+
+bool HeatshrinkDecoder::finish()
+{
+    // The encoder pads the last byte with zero bits. More bits, or a set one, are the start of a token which was cut off.
+    const uint8_t token_bits = state == TAG ? 0 : state == BACKREF_INDEX ? 1 : state == LITERAL ? 8 : 1 + ESP32_OTA_UPDATER_HEATSHRINK_WINDOW_BITS;
+    if (token_bits + bit_count >= 8 || (bits & ((1UL << bit_count) - 1)) != 0)
+    {
+        failed = true;
+    }
+    return flush();
+}
+
+void HeatshrinkDecoder::emit(uint8_t value)
+{
+    window[head & (sizeof(window) - 1)] = value;
+    head++;
+    buffer[buffer_length++] = value;
+    if (buffer_length == sizeof(buffer))
+    {
+        flush();
+    }
+}
+
+bool HeatshrinkDecoder::flush()
+{
+    if (buffer_length > 0 && !failed)
+    {
+        failed = !output->write(buffer, buffer_length);
+        buffer_length = 0;
+    }
+    return !failed;
+}
+
+/*
+ * StreamDecompressor
+ */
+
+static bool extensionIs(const char *extension, size_t length, const char *expected)
+{
+    return length == strlen(expected) && strncmp(extension, expected, length) == 0;
+}
+
+StreamDecompressor::Codec StreamDecompressor::codecFromName(const char *name)
+{
+    // Encrypted assets keep the extension of their content, e.g. "firmware.bin.gz.enc"
+    size_t length = strlen(name);
+    if (length >= 4 && strcmp(name + length - 4, ".enc") == 0)
+    {
+        length -= 4;
+    }
+    size_t dot = length;
+    while (dot > 0 && name[dot - 1] != '.')
+    {
+        dot--;
+    }
+    if (dot == 0)
+    {
+        return CODEC_NONE;
+    }
+    const char *extension = name + dot - 1;
+    const size_t extension_length = length - dot + 1;
+    if (extensionIs(extension, extension_length, ".gz"))
+    {
+        return CODEC_GZIP;
+    }
+    if (extensionIs(extension, extension_length, ".zz") || extensionIs(extension, extension_length, ".zlib"))
+    {
+        return CODEC_ZLIB;
+    }
+    if (extensionIs(extension, extension_length, ".hs"))
+    {
+        return CODEC_HEATSHRINK;
+    }
+    return CODEC_NONE; // An uncompressed image may start with the bytes of a gzip or zlib header, it is never sniffed
+}
+
+bool StreamDecompressor::begin(Codec codec, ByteSink *output)
+{
+    end();
+    this->codec = codec;
+    counter.output = output;
+    counter.count = 0;
+    bytes_in = 0;
+    detect_length = 0;
+    failed = codec != CODEC_AUTO && !startDecoder();
+    return !failed;
+}
+
+bool StreamDecompressor::write(const uint8_t *data, size_t length)
+{
+    if (failed)
+    {
+        return false;
+    }
+    bytes_in += length;
+    if (codec == CODEC_AUTO)
+    {
+        // Collect the two bytes needed to tell gzip and zlib apart from uncompressed data
+        const size_t take = (size_t)(sizeof(detect_buffer) - detect_length) < length ? sizeof(detect_buffer) - detect_length : length;
+        memcpy(detect_buffer + detect_length, data, take);
+        detect_length += take;
+        data += take;
+        length -= take;
+        if (detect_length < sizeof(detect_buffer))
+        {
+            return true;
+        }
+        if (detect_buffer[0] == 0x1F && detect_buffer[1] == 0x8B)
+        {
+            codec = CODEC_GZIP;
+        }
+        else if ((detect_buffer[0] & 0x0F) == 8 && ((detect_buffer[0] << 8) | detect_buffer[1]) % 31 == 0)
+        {
+            codec = CODEC_ZLIB;
+        }
+        else
+        {
+            codec = CODEC_NONE;
+        }
+        if (!startDecoder() || !decode(detect_buffer, detect_length))
+        {
+            failed = true;
+            return false;
+        }
+    }
+    failed = !decode(data, length);
+    return !failed;
+}
+
+bool StreamDecompressor::finish()
+{
+    if (failed)
+    {
+        return false;
+    }
+    switch (codec)
+    {
+    case CODEC_AUTO:
+        codec = CODEC_NONE; // Less than two bytes, can only be uncompressed
+        return decode(detect_buffer, detect_length);
+    case CODEC_GZIP:
+    case CODEC_ZLIB:
+        return inflater.finish();
+    case CODEC_HEATSHRINK:
+        return heatshrink.finish();
+    default:
+        return true;
+    }
+}
+
+void StreamDecompressor::end()
+{
+    inflater.end();
+}
+
+bool StreamDecompressor::startDecoder()
+{
+    switch (codec)
+    {
+    case CODEC_GZIP:
+    case CODEC_ZLIB:
+        return inflater.begin(codec == CODEC_ZLIB, &counter);
+    case CODEC_HEATSHRINK:
+        heatshrink.begin(&counter);
+        return true;
+    default:
+        return true;
+    }
+}
+
+bool StreamDecompressor::decode(const uint8_t *data, size_t length)
+{
+    if (length == 0)
+    {
+        return true;
+    }
+    switch (codec)
+    {
+    case CODEC_GZIP:
+    case CODEC_ZLIB:
+        return inflater.write(data, length);
+    case CODEC_HEATSHRINK:
+        return heatshrink.write(data, length);
+    default:
+        return counter.write(data, length);
+    }
+}
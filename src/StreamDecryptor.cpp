@@ -0,0 +1,71 @@
+#include "StreamDecryptor.h"
+#include <Arduino.h>
+#include <string.h>
+
+static const uint8_t ENCRYPTED_MAGIC[4] = {'O', 'T', 'A', 'E'};
+
+StreamDecryptor::StreamDecryptor()
+{
+    mbedtls_aes_init(&aes);
+}
+
+StreamDecryptor::~StreamDecryptor()
+{
+    mbedtls_aes_free(&aes);
+}
+
+void StreamDecryptor::begin(const uint8_t *key)
+{
+    mbedtls_aes_free(&aes);
+    mbedtls_aes_init(&aes);
+    decrypting = key != NULL;
+    failed = decrypting && mbedtls_aes_setkey_enc(&aes, key, STREAM_DECRYPTOR_KEY_SIZE * 8) != 0; // CTR only uses the forward cipher
+    header_length = 0;
+    stream_offset = 0;
+    decrypt_time_us = 0;
+}
+
+uint8_t *StreamDecryptor::decrypt(uint8_t *data, size_t *length)
+{
+    if (!decrypting)
+    {
+        return data;
+    }
+    if (failed)
+    {
+        return NULL;
+    }
+
+    // The header may be split over several chunks
+    size_t header_part = 0;
+    if (header_length < STREAM_DECRYPTOR_HEADER_SIZE)
+    {
+        header_part = STREAM_DECRYPTOR_HEADER_SIZE - header_length;
+        header_part = header_part < *length ? header_part : *length;
+        memcpy(header + header_length, data, header_part);
+        header_length += header_part;
+        if (header_length < STREAM_DECRYPTOR_HEADER_SIZE)
+        {
+            *length = 0;
+            return data;
+        }
+        if (memcmp(header, ENCRYPTED_MAGIC, sizeof(ENCRYPTED_MAGIC)) != 0)
+        {
+            failed = true; // A plain asset although the device expects encrypted ones
+            return NULL;
+        }
+        memcpy(counter, header + sizeof(ENCRYPTED_MAGIC), STREAM_DECRYPTOR_NONCE_SIZE);
+        memset(counter + STREAM_DECRYPTOR_NONCE_SIZE, 0, sizeof(counter) - STREAM_DECRYPTOR_NONCE_SIZE);
+    }
+
+    uint8_t *plaintext = data + header_part;
+    *length -= header_part;
+    const unsigned long start = micros();
+    if (mbedtls_aes_crypt_ctr(&aes, *length, &stream_offset, counter, stream_block, plaintext, plaintext) != 0)
+    {
+        failed = true;
+        return NULL;
+    }
+    decrypt_time_us += micros() - start;
+    return plaintext;
+}
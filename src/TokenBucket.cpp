@@ -0,0 +1,58 @@
+#include "TokenBucket.h"
+
+void TokenBucket::setRate(uint32_t bytes_per_second, uint32_t burst_bytes)
+{
+    rate = bytes_per_second;
+    burst = burst_bytes > 0 ? burst_bytes : 1;
+}
+
+void TokenBucket::refill(unsigned long now)
+{
+    if (!started)
+    {
+        // A new bucket starts full, so the first slice is not delayed
+        started = true;
+        tokens = (uint64_t)burst * 1000;
+    }
+    else
+    {
+        tokens += (uint64_t)rate * (unsigned long)(now - refilled_at);
+    }
+    refilled_at = now;
+    if (tokens > (uint64_t)burst * 1000)
+    {
+        tokens = (uint64_t)burst * 1000;
+    }
+}
+
+size_t TokenBucket::getAvailable(unsigned long now, size_t wanted)
+{
+    if (rate == 0)
+    {
+        return wanted;
+    }
+    refill(now);
+    const uint64_t available = tokens / 1000;
+    return available < wanted ? (size_t)available : wanted;
+}
+
+void TokenBucket::consume(size_t length)
+{
+    if (rate == 0)
+    {
+        return;
+    }
+    const uint64_t taken = (uint64_t)length * 1000;
+    tokens = taken < tokens ? tokens - taken : 0;
+}
+
+unsigned long TokenBucket::getWait(unsigned long now, size_t wanted)
+{
+    if (rate == 0)
+    {
+        return 0;
+    }
+    refill(now);
+    const uint64_t needed = (uint64_t)(wanted < burst ? wanted : burst) * 1000;
+    return needed <= tokens ? 0 : (unsigned long)((needed - tokens + rate - 1) / rate);
+}
@@ -0,0 +1,114 @@
+#!/usr/bin/env python3
+"""Creates and reads certificate bundles for the ESP32-OTA-Updater (see include/CertificateStore.h for the format).
+
+    ota_certs.py create <out.bin> <certificate.pem|.der> ...
+    ota_certs.py dump <bundle.bin>
+
+A PEM file may contain several certificates. To install the bundle with a release, append its SHA-256 and signature
+like for "firmware.sig" (see the example workflow).
+"""
+import base64
+import hashlib
+import re
+import struct
+import sys
+
+PEM_CERTIFICATE = re.compile(rb"-----BEGIN CERTIFICATE-----(.+?)-----END CERTIFICATE-----", re.S)
+OID_COMMON_NAME = bytes([0x06, 0x03, 0x55, 0x04, 0x03])
+
+
+def read_tlv(data, position):
+    """Returns the start of the value and the end of the DER element at position."""
+    length = data[position + 1]
+    start = position + 2
+    if length & 0x80:
+        count = length & 0x7F
+        length = int.from_bytes(data[start:start + count], "big")
+        start += count
+    if start + length > len(data):
+        raise ValueError("truncated DER element")
+    return start, start + length
+
+
+def anchor(certificate):
+    """Returns the DER encoded subject and SubjectPublicKeyInfo of a certificate."""
+    tbs_start, tbs_end = read_tlv(certificate, read_tlv(certificate, 0)[0])
+    elements = []
+    position = tbs_start
+    while position < tbs_end:
+        _, end = read_tlv(certificate, position)
+        elements.append(certificate[position:end])
+        position = end
+    # [version], serial number, signature algorithm, issuer, validity, subject, subject public key info, ...
+    first = 1 if elements[0][0] == 0xA0 else 0  # Version 1 certificates have no explicit version
+    return elements[first + 4], elements[first + 5]
+
+
+def certificates(paths):
+    for path in paths:
+        with open(path, "rb") as f:
+            data = f.read()
+        blocks = PEM_CERTIFICATE.findall(data)
+        if blocks:
+            for block in blocks:
+                yield base64.b64decode(b"".join(block.split()))
+        else:
+            yield data
+
+
+def create(paths):
+    entries = {}
+    for certificate in certificates(paths):
+        subject, key = anchor(certificate)
+        entries.setdefault(subject, key)  # The first certificate of a subject is used, like on the device
+    # Sorted by subject, the device looks anchors up with a binary search
+    out = bytearray(struct.pack(">H", len(entries)))
+    for subject in sorted(entries):
+        out += struct.pack(">HH", len(subject), len(entries[subject])) + subject + entries[subject]
+    return bytes(out)
+
+
+def common_name(subject):
+    position = subject.rfind(OID_COMMON_NAME)
+    if position < 0:
+        return subject.hex()
+    start, end = read_tlv(subject, position + len(OID_COMMON_NAME))
+    return subject[start:end].decode(errors="replace")
+
+
+def dump(bundle):
+    count = struct.unpack_from(">H", bundle, 0)[0]
+    position = 2
+    lines = []
+    for _ in range(count):
+        subject_length, key_length = struct.unpack_from(">HH", bundle, position)
+        subject = bundle[position + 4:position + 4 + subject_length]
+        position += 4 + subject_length + key_length
+        lines.append("  %s (%d byte key)" % (common_name(subject), key_length))
+    if position > len(bundle):
+        raise ValueError("truncated bundle")
+    lines.insert(0, "%d certificates, %d bytes" % (count, position))
+    trailer = bundle[position:]
+    if trailer:
+        match = "matches" if trailer[:32] == hashlib.sha256(bundle[:position]).digest() else "does not match"
+        lines.append("SHA-256 %s, %d byte signature" % (match, len(trailer) - 32))
+    return "\n".join(lines)
+
+
+def main(argv):
+    if len(argv) >= 4 and argv[1] == "create":
+        bundle = create(argv[3:])
+        with open(argv[2], "wb") as f:
+            f.write(bundle)
+        print("%s: %d bytes for %d certificates" % (argv[2], len(bundle), struct.unpack_from(">H", bundle)[0]))
+        return 0
+    if len(argv) == 3 and argv[1] == "dump":
+        with open(argv[2], "rb") as f:
+            print(dump(f.read()))
+        return 0
+    print(__doc__)
+    return 2
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
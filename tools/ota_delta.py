@@ -0,0 +1,126 @@
+#!/usr/bin/env python3
+"""Creates and applies delta patches for the ESP32-OTA-Updater (see include/DeltaPatcher.h for the format).
+
+    ota_delta.py create <old.bin> <new.bin> <out.patch>
+    ota_delta.py apply <old.bin> <in.patch> <out.bin>
+"""
+import struct
+import sys
+import zlib
+
+MAGIC = b"OTAD"
+VERSION = 1
+OP_COPY = 0x01
+OP_INSERT = 0x02
+OP_ADD = 0x03
+
+BLOCK = 16  # Minimum length of an exact match
+ALIGN = 4  # Offsets of the old image that are indexed, app images are mostly word aligned
+
+
+def create(old, new):
+    index = {}
+    for offset in range(0, len(old) - BLOCK + 1, ALIGN):
+        index.setdefault(old[offset:offset + BLOCK], offset)
+
+    out = bytearray(MAGIC + bytes([VERSION, 0, 0, 0]))
+    out += struct.pack("<III", len(old), zlib.crc32(old) & 0xFFFFFFFF, len(new))
+    literal = bytearray()
+
+    def flush_literal():
+        if literal:
+            out.extend(struct.pack("<BI", OP_INSERT, len(literal)) + literal)
+            literal.clear()
+
+    position = 0
+    diagonal = None  # Source offset continuing the last match
+    while position < len(new):
+        block = new[position:position + BLOCK]
+        source = None
+        if diagonal is not None and old[diagonal:diagonal + BLOCK] == block:
+            source = diagonal
+        elif len(block) == BLOCK:
+            source = index.get(block)
+        if source is None:
+            literal.append(new[position])
+            position += 1
+            continue
+
+        # Exact match
+        length = BLOCK
+        while position + length < len(new) and source + length < len(old) and new[position + length] == old[source + length]:
+            length += 1
+        flush_literal()
+        out += struct.pack("<BII", OP_COPY, source, length)
+        position += length
+        source += length
+
+        # Continue on the same diagonal while most bytes match, e.g. code with shifted addresses
+        added = 0
+        while position + added + BLOCK <= len(new) and source + added + BLOCK <= len(old):
+            window_new = new[position + added:position + added + BLOCK]
+            window_old = old[source + added:source + added + BLOCK]
+            if window_new == window_old:
+                break
+            if sum(a == b for a, b in zip(window_new, window_old)) < BLOCK // 2:
+                break
+            added += BLOCK
+        if added:
+            diff = bytes((new[position + i] - old[source + i]) & 0xFF for i in range(added))
+            out += struct.pack("<BII", OP_ADD, source, added) + diff
+            position += added
+            source += added
+        diagonal = source
+
+    flush_literal()
+    return bytes(out)
+
+
+def apply(old, patch):
+    if patch[:4] != MAGIC or patch[4] != VERSION:
+        raise ValueError("not a delta patch")
+    source_size, source_crc, target_size = struct.unpack_from("<III", patch, 8)
+    if source_size != len(old) or zlib.crc32(old) & 0xFFFFFFFF != source_crc:
+        raise ValueError("patch was created for a different source image")
+    out = bytearray()
+    position = 20
+    while position < len(patch):
+        opcode = patch[position]
+        if opcode == OP_INSERT:
+            (length,) = struct.unpack_from("<I", patch, position + 1)
+            position += 5
+            out += patch[position:position + length]
+            position += length
+        elif opcode in (OP_COPY, OP_ADD):
+            offset, length = struct.unpack_from("<II", patch, position + 1)
+            position += 9
+            if opcode == OP_COPY:
+                out += old[offset:offset + length]
+            else:
+                out += bytes((old[offset + i] + patch[position + i]) & 0xFF for i in range(length))
+                position += length
+        else:
+            raise ValueError("invalid opcode 0x%02x" % opcode)
+    if len(out) != target_size:
+        raise ValueError("patch is incomplete")
+    return bytes(out)
+
+
+def main(argv):
+    if len(argv) != 5 or argv[1] not in ("create", "apply"):
+        print(__doc__)
+        return 2
+    with open(argv[2], "rb") as f:
+        old = f.read()
+    with open(argv[3], "rb") as f:
+        second = f.read()
+    result = create(old, second) if argv[1] == "create" else apply(old, second)
+    with open(argv[4], "wb") as f:
+        f.write(result)
+    if argv[1] == "create":
+        print("%s: %d bytes for a %d byte image" % (argv[4], len(result), len(second)))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
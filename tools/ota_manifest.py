@@ -0,0 +1,79 @@
+#!/usr/bin/env python3
+"""Creates and reads binary release manifests for the ESP32-OTA-Updater (see include/ManifestParser.h for the format).
+
+    ota_manifest.py create <tag> <out.bin> [--rollout <percent>] <asset> ...
+    ota_manifest.py dump <manifest.bin>
+"""
+import hashlib
+import os
+import struct
+import sys
+import zlib
+
+MAGIC = b"OTAM"
+VERSION = 1
+FLAG_DIGEST = 0x01
+
+
+def create(tag, assets, rollout=100):
+    if not 0 <= rollout <= 100:
+        raise ValueError("rollout has to be a percentage")
+    if len(assets) > 255:
+        raise ValueError("too many assets")
+    out = bytearray(MAGIC + bytes([VERSION, rollout, len(assets), 0]))
+    encoded_tag = tag.encode()
+    out += bytes([len(encoded_tag)]) + encoded_tag
+    for path in assets:
+        name = os.path.basename(path).encode()
+        with open(path, "rb") as f:
+            data = f.read()
+        out += bytes([len(name)]) + name + struct.pack("<IB", len(data), FLAG_DIGEST) + hashlib.sha256(data).digest()
+    out += struct.pack("<I", zlib.crc32(out) & 0xFFFFFFFF)
+    return bytes(out)
+
+
+def dump(manifest):
+    if manifest[:4] != MAGIC or manifest[4] != VERSION:
+        raise ValueError("not a release manifest")
+    if struct.unpack_from("<I", manifest, len(manifest) - 4)[0] != zlib.crc32(manifest[:-4]) & 0xFFFFFFFF:
+        raise ValueError("CRC32 does not match")
+    rollout, count = manifest[5], manifest[6]
+    position = 8
+    length = manifest[position]
+    lines = ["%s, rollout %d%%" % (manifest[position + 1:position + 1 + length].decode(), rollout)]
+    position += 1 + length
+    for _ in range(count):
+        length = manifest[position]
+        name = manifest[position + 1:position + 1 + length].decode()
+        size, flags = struct.unpack_from("<IB", manifest, position + 1 + length)
+        position += 1 + length + 5
+        digest = ""
+        if flags & FLAG_DIGEST:
+            digest = " sha256:" + manifest[position:position + 32].hex()
+            position += 32
+        lines.append("  %s %d bytes%s" % (name, size, digest))
+    return "\n".join(lines)
+
+
+def main(argv):
+    if len(argv) >= 4 and argv[1] == "create":
+        assets = argv[4:]
+        rollout = 100
+        if len(assets) >= 2 and assets[0] == "--rollout":
+            rollout = int(assets[1])
+            assets = assets[2:]
+        manifest = create(argv[2], assets, rollout)
+        with open(argv[3], "wb") as f:
+            f.write(manifest)
+        print("%s: %d bytes for %d assets" % (argv[3], len(manifest), len(assets)))
+        return 0
+    if len(argv) == 3 and argv[1] == "dump":
+        with open(argv[2], "rb") as f:
+            print(dump(f.read()))
+        return 0
+    print(__doc__)
+    return 2
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))